@@ -132,7 +132,7 @@ void Scene :: Idle() {
 		m_PrevTime = newTime;
 
 		dt = PMath::Clamp(dt, k1 / Real(60.0f), k1 / Real(20.0f));
-		m_Phys.Simulate(dt);
+		m_Phys.SimulateAsync(dt);						// transforms below come from the previous step
 
 		for (i = 0; i < m_PropList.size(); ++i) {
 			WOT* pObj = m_PropList.m_Objects[i];
@@ -379,7 +379,8 @@ static void RigidBodyRender(GraphObj::Base* pRender, float scale, float const*co
 
 void PhysicsDemo::Update(Real dt)
 {
-	m_Phys.Simulate(dt);
+	// the step runs while this frame renders the results of the previous one
+	m_Phys.SimulateAsync(dt);
 
 	int width, height;
 	GetWindowSize(width, height);
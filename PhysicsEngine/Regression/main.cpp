@@ -0,0 +1,747 @@
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+// main.cpp : headless regression and performance suite for the physics engine.
+//
+// Each canonical scene is loaded from its scene file, or built through the API if the scene file
+// can't hold it, and stepped a fixed number of frames. At checkpoints the positions of its bodies
+// and of its spring meshes' points, with the energy and momentum GetStepStats reports averaged since
+// the last checkpoint, are compared against the scene's golden file; a step the stability monitor
+// flags fails the scene as well. The contacts kept for a sphere in many faces of a heightfield are
+// checked too. The per-step timings are reported, so that a change to the engine shows whether it
+// altered the results, the speed, or both.
+//
+//	PhysicsRegression [-build | -golden] [directory]
+//
+//	-build		create the canonical scene files from the code below
+//	-golden		write new golden files from the engine as it is
+//
+// The directory holding the scene and golden files defaults to Regression/data, relative to the
+// PhysicsEngine project. The exit code is the number of scenes and checks that failed.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "PhysicsEngine.h"
+
+using namespace PMath;
+
+static const int	kMaxBodies		= 64;
+static const int	kMaxPoints		= 1024;			// of all a scene's spring meshes
+static const int	kFrames			= 240;			// four seconds at kFrameTime
+static const int	kCheckpoint		= 60;			// compare every second
+static const int	kPointStride	= 7;			// sample every seventh point of a spring mesh
+static const Real	kFrameTime		= k1 / Real(60.0f);
+
+// results may differ by this much between compilers and builds; see Compare for how it's scaled
+static const Real	kPositionTolerance	= Real(0.01f);
+static const Real	kEnergyTolerance	= Real(0.02f);
+static const Real	kMomentumTolerance	= Real(0.02f);
+
+enum ESampleKind { kSK_Position, kSK_Energy, kSK_Momentum, kSK_Point };
+
+static const char* kSampleNames[] = { "position", "energy", "momentum", "point" };
+
+/// one line of a golden file; an energy sample holds the kinetic, potential and spring energy
+class Sample {
+public:
+	int		m_Frame;
+	int		m_Kind;		//!< ESampleKind
+	int		m_Index;	//!< of the body in the scene file, of the point counting through the scene's spring meshes, or -1 for energy and momentum
+	Real	m_Value[3];
+};
+
+/// timings of one scene's steps, from StepStats
+class Timings {
+public:
+	Timings() : m_StepSeconds(0), m_MaxStepSeconds(0), m_IntegrateSeconds(0), m_CollideSeconds(0), m_Contacts(0), m_Unstable(0) { }
+	double	m_StepSeconds;
+	double	m_MaxStepSeconds;
+	double	m_IntegrateSeconds;
+	double	m_CollideSeconds;
+	int		m_Contacts;
+	int		m_Unstable;		//!< steps the stability monitor flagged; any fails the scene
+};
+
+/*
+	The canonical scenes. Each is chosen to be smooth rather than chaotic, so that rounding
+	differences between compilers stay within the tolerances instead of growing into different
+	outcomes: bodies that meet a few at a time, pendulums that swing only a little, and a stack and a
+	cradle lined up in a vertical plane, so that nothing pushes them out of it. A scene that needs a
+	spring mesh is built through the API each run, since a scene file can't hold one, and lists its
+	meshes for sampling.
+ */
+
+static uint32 AddSphere(Physics::Engine& phys, Real radius, Real mass, Real x, Real y, Real z, bool translatable)
+{
+	Vec3f	position	= {x, y, z};
+	uint32	retval		= phys.AddRigidBodySphere(radius);
+	phys.SetRigidBodyVec3f(retval,	Physics::Engine::propPosition,		position);
+	phys.SetRigidBodyScalar(retval,	Physics::Engine::propMass,			mass);
+	phys.SetRigidBodyBool(retval,	Physics::Engine::propTranslatable,	translatable);
+	phys.SetRigidBodyBool(retval,	Physics::Engine::propUseGravity,	translatable);
+	phys.SetRigidBodyBool(retval,	Physics::Engine::propCollidable,	true);
+	return retval;
+}
+
+static void AddGround(Physics::Engine& phys)
+{
+	Vec3f			origin	= {k0, k0, k0};
+	Vec3f			up		= {k0, k0, k1};
+	PMath::Plane	ground(origin, up);
+	uint32			plane	= phys.AddRigidBodyPlane(ground);
+	phys.SetRigidBodyBool(plane, Physics::Engine::propCollidable, true);
+}
+
+static uint32 AddSpring(Physics::Engine& phys, uint32 a, uint32 b, Real stiffness, Real damping, Real restLength, bool implicit)
+{
+	uint32 retval = phys.AddSpring();
+	phys.SetSpringUInt32(retval,	Physics::Engine::propBodyA,				a);
+	phys.SetSpringUInt32(retval,	Physics::Engine::propBodyB,				b);
+	phys.SetSpringBool(retval,		Physics::Engine::propResistCompression,	true);
+	phys.SetSpringBool(retval,		Physics::Engine::propSpringImplicit,	implicit);
+	phys.SetSpringScalar(retval,	Physics::Engine::propSpringStiffness,	stiffness);
+	phys.SetSpringScalar(retval,	Physics::Engine::propSpringDamping,		damping);
+	phys.SetSpringScalar(retval,	Physics::Engine::propSpringRestLength,	restLength);
+	return retval;
+}
+
+/// spheres of different sizes and masses dropped from different heights onto the ground, apart
+static void BuildDrop(Physics::Engine& phys, std::vector<uint32>&)
+{
+	AddGround(phys);
+	for (int i = 0; i < 5; ++i) {
+		AddSphere(phys, Real(0.25f) + Real(0.1f) * Real(i), k1 + Real(i), Real(3.0f) * Real(i), k0, Real(2.0f) + Real(0.5f) * Real(i), true);
+	}
+}
+
+/// two chains hanging from fixed anchors, one of explicit springs and one of implicit springs
+static void BuildSprings(Physics::Engine& phys, std::vector<uint32>&)
+{
+	for (int chain = 0; chain < 2; ++chain) {
+		Real	x		= Real(4.0f) * Real(chain);
+		uint32	prev	= AddSphere(phys, Real(0.1f), k1, x, k0, Real(10.0f), false);
+		for (int i = 1; i <= 4; ++i) {
+			uint32 link = AddSphere(phys, Real(0.1f), k1, x + Real(0.2f) * Real(i), k0, Real(10.0f) - Real(i), true);
+			phys.SetRigidBodyBool(link, Physics::Engine::propCollidable, false);
+			AddSpring(phys, prev, link, Real(150.0f), Real(0.1f), k1, chain == 1);
+			prev = link;
+		}
+	}
+}
+
+/// pendulums of distance constraints released a little off vertical, one of a single link and one of two
+static void BuildPendulum(Physics::Engine& phys, std::vector<uint32>&)
+{
+	uint32 anchor	= AddSphere(phys, Real(0.1f), k1, k0, k0, Real(10.0f), false);
+	uint32 bob		= AddSphere(phys, Real(0.2f), k1, Real(0.5f), k0, Real(10.0f) - Real(1.9365f), true);
+	phys.AddDistanceConstraint(anchor, bob, Real(2.0f), k0);
+
+	anchor			= AddSphere(phys, Real(0.1f), k1, Real(4.0f), k0, Real(10.0f), false);
+	uint32 middle	= AddSphere(phys, Real(0.2f), Real(2.0f), Real(4.2f), k0, Real(10.0f) - Real(0.9798f), true);
+	bob				= AddSphere(phys, Real(0.2f), k1, Real(4.4f), k0, Real(10.0f) - Real(1.9596f), true);
+	phys.AddDistanceConstraint(anchor, middle, k1, k0);
+	phys.AddDistanceConstraint(middle, bob, k1, k0);
+}
+
+/// spheres rolling down a heightfield shaped as a smooth valley along y
+static void BuildTerrain(Physics::Engine& phys, std::vector<uint32>&)
+{
+	const int	kSize = 17;
+	Real		heights[kSize * kSize];
+	for (int row = 0; row < kSize; ++row) {
+		for (int column = 0; column < kSize; ++column) {
+			Real x = Real(column - kSize / 2) / Real(kSize / 2);
+			heights[row * kSize + column] = Real(2.0f) * x * x + Real(0.05f) * Real(row);
+		}
+	}
+	Vec3f	origin		= {Real(-8.0f), Real(-8.0f), k0};
+	uint32	terrain		= phys.AddRigidBodyHeightfield(kSize, kSize, k1, origin, heights);
+	phys.SetRigidBodyBool(terrain, Physics::Engine::propCollidable, true);
+
+	for (int i = 0; i < 3; ++i) {
+		AddSphere(phys, Real(0.5f), k1, Real(-4.5f) + Real(4.0f) * Real(i), Real(-3.0f) + Real(3.0f) * Real(i), Real(3.0f), true);
+	}
+}
+
+/// spheres set down at rest on the ground and in a heightfield's hollow, which must stay at rest
+static void BuildRest(Physics::Engine& phys, std::vector<uint32>&)
+{
+	AddGround(phys);
+	for (int i = 0; i < 4; ++i) {
+		Real radius = Real(0.25f) + Real(0.25f) * Real(i);
+		AddSphere(phys, radius, k1 + Real(2.0f) * Real(i), Real(3.0f) * Real(i), k0, radius, true);
+	}
+
+	const int	kSize = 9;
+	Real		heights[kSize * kSize];
+	for (int row = 0; row < kSize; ++row) {
+		for (int column = 0; column < kSize; ++column) {
+			Real x = Real(column - kSize / 2);
+			Real y = Real(row - kSize / 2);
+			heights[row * kSize + column] = Real(0.1f) * (x * x + y * y);
+		}
+	}
+	Vec3f	origin		= {Real(16.0f), Real(-4.0f), Real(0.5f)};
+	uint32	terrain		= phys.AddRigidBodyHeightfield(kSize, kSize, k1, origin, heights);
+	phys.SetRigidBodyBool(terrain, Physics::Engine::propCollidable, true);
+	AddSphere(phys, Real(0.5f), k1, Real(20.0f), k0, Real(1.0f), true);
+}
+
+/// spheres meeting head on and at a glance, without gravity
+static void BuildCollide(Physics::Engine& phys, std::vector<uint32>&)
+{
+	Vec3f velocity = {Real(2.0f), k0, k0};
+	uint32 a = AddSphere(phys, Real(0.5f), k1, Real(-2.0f), k0, k0, true);
+	uint32 b = AddSphere(phys, Real(0.5f), Real(2.0f), Real(2.0f), k0, k0, true);
+	phys.SetRigidBodyVec3f(a, Physics::Engine::propVelocity, velocity);
+	velocity[0] = -velocity[0];
+	phys.SetRigidBodyVec3f(b, Physics::Engine::propVelocity, velocity);
+
+	velocity[0] = Real(1.5f);
+	uint32 c = AddSphere(phys, Real(0.5f), k1, Real(-3.0f), Real(5.0f), k0, true);
+	AddSphere(phys, Real(0.5f), k1, k0, Real(5.6f), k0, true);
+	phys.SetRigidBodyVec3f(c, Physics::Engine::propVelocity, velocity);
+
+	Vec3f gravity = {k0, k0, k0};
+	phys.SetGravity(gravity);
+}
+
+/**
+ * spheres stacked in a column on the ground, dropped a little apart so that they settle onto each other.
+ * Each contact is resolved once a step, so the weight of the column presses the lowest sphere slowly
+ * into the ground; a change to how contacts are resolved shows here first.
+ */
+static void BuildStack(Physics::Engine& phys, std::vector<uint32>&)
+{
+	AddGround(phys);
+	for (int i = 0; i < 3; ++i) {
+		AddSphere(phys, Real(0.5f), k1, k0, k0, Real(0.5f) + Real(1.02f) * Real(i), true);
+	}
+}
+
+/// an executive toy: five touching balls hung in a row by distance constraints, the first pulled aside and let go
+static void BuildCradle(Physics::Engine& phys, std::vector<uint32>&)
+{
+	for (int i = 0; i < 5; ++i) {
+		Real	x		= Real(0.5f) * Real(i);
+		uint32	anchor	= AddSphere(phys, Real(0.1f), k1, x, k0, Real(4.0f), false);
+		phys.SetRigidBodyBool(anchor, Physics::Engine::propCollidable, false);
+		uint32	ball	= i == 0 ? AddSphere(phys, Real(0.25f), k1, x - Real(1.5f), k0, Real(4.0f) - Real(2.5981f), true)
+								 : AddSphere(phys, Real(0.25f), k1, x, k0, k1, true);
+		phys.AddDistanceConstraint(anchor, ball, Real(3.0f), k0);
+	}
+}
+
+/// an arm of three links on revolute joints, hung from a fixed anchor a little off vertical and let go, saved with its joints
+static void BuildArm(Physics::Engine& phys, std::vector<uint32>&)
+{
+	uint32	anchor	= AddSphere(phys, Real(0.1f), k1, k0, k0, Real(6.0f), false);
+	uint32	arm		= phys.AddArticulation(anchor, true);
+	uint32	parent	= anchor;
+	Vec3f	axis	= {k0, k1, k0};
+	for (int i = 1; i <= 3; ++i) {
+		Vec3f	pivot	= {Real(0.1987f) * Real(i - 1), k0, Real(6.0f) - Real(0.9801f) * Real(i - 1)};
+		uint32	link	= AddSphere(phys, Real(0.2f), k1, Real(0.1987f) * Real(i), k0, Real(6.0f) - Real(0.9801f) * Real(i), true);
+		phys.AddArticulationJoint(arm, parent, link, Physics::kJ_Revolute, pivot, axis);
+		parent = link;
+	}
+}
+
+// a sphere set down into the dish is in its floor and its walls at once
+static const Real	kDishRadius		= Real(0.5f);
+static const Real	kDishSink		= Real(0.05f);		// into the floor, deeper than into the walls
+static const Real	kDishFloor		= Real(0.2f);		// radius of the floor
+static const Real	kDishCell		= Real(0.1f);
+
+/// a cone of small cells with a flat floor
+static void AddDish(Physics::Engine& phys)
+{
+	const int	kSize = 21;
+	Real		heights[kSize * kSize];
+	for (int row = 0; row < kSize; ++row) {
+		for (int column = 0; column < kSize; ++column) {
+			Real x = kDishCell * Real(column - kSize / 2);
+			Real y = kDishCell * Real(row - kSize / 2);
+			Real r = Sqrt(x * x + y * y);
+			heights[row * kSize + column] = r > kDishFloor ? r - kDishFloor : k0;
+		}
+	}
+	Vec3f	origin		= {-kDishCell * Real(kSize / 2), -kDishCell * Real(kSize / 2), k0};
+	uint32	terrain		= phys.AddRigidBodyHeightfield(kSize, kSize, kDishCell, origin, heights);
+	phys.SetRigidBodyBool(terrain, Physics::Engine::propCollidable, true);
+}
+
+/// a sphere dropped into a dish, where the ring of the walls holds it on more faces than a pair keeps contacts
+static void BuildDish(Physics::Engine& phys, std::vector<uint32>&)
+{
+	AddDish(phys);
+	AddSphere(phys, kDishRadius, k1, k0, k0, Real(0.51f), true);
+}
+
+/// a sphere set down into a dish, in its floor and in many faces of the walls around it at once
+static void BuildSunkDish(Physics::Engine& phys, std::vector<uint32>&)
+{
+	AddDish(phys);
+	AddSphere(phys, kDishRadius, k1, k0, k0, kDishRadius - kDishSink, true);
+}
+
+/**
+ * a square of cloth, an XPBD spring mesh braced across its squares, stretched by a tenth and dropped
+ * flat, so that it pulls itself back to its rest size as it falls onto the ground. Cloth draped over
+ * a sphere isn't used: with nothing to hold it, it slides off, and which way depends on rounding.
+ */
+static void BuildCloth(Physics::Engine& phys, std::vector<uint32>& meshes)
+{
+	AddGround(phys);
+
+	const int		kSize		= 15;
+	const Real		kSpacing	= Real(0.2f);
+	Vec3f			points[kSize * kSize];
+	std::vector<int> springs;
+	for (int row = 0; row < kSize; ++row) {
+		for (int column = 0; column < kSize; ++column) {
+			int i = row * kSize + column;
+			points[i][0] = kSpacing * Real(column - kSize / 2);
+			points[i][1] = kSpacing * Real(row - kSize / 2);
+			points[i][2] = Real(2.0f);
+			if (column + 1 < kSize) {
+				springs.push_back(i);
+				springs.push_back(i + 1);
+			}
+			if (row + 1 < kSize) {
+				springs.push_back(i);
+				springs.push_back(i + kSize);
+			}
+			if (row + 1 < kSize && column + 1 < kSize) {
+				springs.push_back(i);
+				springs.push_back(i + kSize + 1);
+				springs.push_back(i + 1);
+				springs.push_back(i + kSize);
+			}
+		}
+	}
+
+	// the rest lengths are taken from the points given before the springs
+	uint32 cloth = phys.AddSpringMesh();
+	phys.SetRigidBodyVectorArray(cloth,	Physics::Engine::propPositions,				points, sizeof(Vec3f), kSize * kSize);
+	phys.SetRigidBodyIntArray(cloth,	Physics::Engine::propIndices,				&springs[0], (int) springs.size() / 2);
+	for (int i = 0; i < kSize * kSize; ++i) {
+		points[i][0] *= Real(1.1f);
+		points[i][1] *= Real(1.1f);
+	}
+	phys.SetRigidBodyVectorArray(cloth,	Physics::Engine::propPositions,				points, sizeof(Vec3f), kSize * kSize);
+	phys.SetRigidBodyInt(cloth,			Physics::Engine::propSpringMeshSolver,		Physics::kSM_XPBD);
+	phys.SetRigidBodyInt(cloth,			Physics::Engine::propSpringMeshSubsteps,	8);
+	phys.SetRigidBodyScalar(cloth,		Physics::Engine::propSpringMeshCompliance,	Real(0.001f));
+	phys.SetRigidBodyScalar(cloth,		Physics::Engine::propSpringMeshDamping,		Real(0.1f));
+	phys.SetRigidBodyScalar(cloth,		Physics::Engine::propMass,					Real(0.01f));
+	phys.SetRigidBodyBool(cloth,		Physics::Engine::propUseGravity,			true);
+	phys.SetRigidBodyBool(cloth,		Physics::Engine::propCollidable,			true);
+	meshes.push_back(cloth);
+}
+
+typedef void (*BuildFn)(Physics::Engine& phys, std::vector<uint32>& meshes);
+
+class Scene {
+public:
+	const char*	m_pName;
+	BuildFn		m_Build;
+	bool		m_Saved;	//!< built once by -build and loaded from its scene file; otherwise built every run
+};
+
+static const Scene kScenes[] = {
+	{ "drop",		BuildDrop,		true	},
+	{ "springs",	BuildSprings,	true	},
+	{ "pendulum",	BuildPendulum,	true	},
+	{ "terrain",	BuildTerrain,	true	},
+	{ "collide",	BuildCollide,	true	},
+	{ "rest",		BuildRest,		true	},
+	{ "stack",		BuildStack,		true	},
+	{ "cradle",		BuildCradle,	true	},
+	{ "arm",		BuildArm,		true	},
+	{ "dish",		BuildDish,		true	},
+	{ "cloth",		BuildCloth,		false	}
+};
+
+static const int kNumScenes = sizeof(kScenes) / sizeof(kScenes[0]);
+
+/*
+	Running and comparing
+ */
+
+static void AddSample(std::vector<Sample>& samples, int frame, int kind, int index, const Real* pValue)
+{
+	Sample sample;
+	sample.m_Frame		= frame;
+	sample.m_Kind		= kind;
+	sample.m_Index		= index;
+	sample.m_Value[0]	= pValue[0];
+	sample.m_Value[1]	= pValue[1];
+	sample.m_Value[2]	= pValue[2];
+	samples.push_back(sample);
+}
+
+/// give the engine the settings every scene is built with, and build the scene
+static void BuildScene(const Scene& scene, Physics::Engine& phys, std::vector<uint32>& meshes)
+{
+	Vec3f gravity = {k0, k0, Real(-9.8f)};
+	phys.SetGravity(gravity);
+	phys.SetMinTimeStep(k1 / Real(120.0f));
+	scene.m_Build(phys, meshes);
+}
+
+/// load or build a scene, step it, and sample it at every checkpoint. @return false if it couldn't be loaded
+static bool RunScene(const Scene& scene, const char* pPath, std::vector<Sample>& samples, Timings& timings)
+{
+	Physics::Engine phys;
+	phys.SetThreadCount(1);					// the same order of work, whatever the machine
+	phys.SetStabilityMonitor(Real(0.1f));
+
+	uint32				ids[kMaxBodies];
+	int					count = 0;
+	std::vector<uint32>	meshes;
+	if (scene.m_Saved) {
+		count = phys.LoadScene(pPath, ids, kMaxBodies);
+		if (count < 0) {
+			return false;
+		}
+		count = count < kMaxBodies ? count : kMaxBodies;
+	}
+	else {
+		BuildScene(scene, phys, meshes);
+	}
+
+	// resting contacts make the energy and momentum jitter from step to step, so they're averaged between checkpoints
+	Real energy[3]		= { k0, k0, k0 };
+	Real momentum[3]	= { k0, k0, k0 };
+
+	static Vec3f points[kMaxPoints];
+	for (int frame = 1; frame <= kFrames; ++frame) {
+		phys.Simulate(kFrameTime);
+
+		Physics::StepStats stats;
+		phys.GetStepStats(stats);
+		energy[0]	+= stats.m_KineticEnergy	/ Real(kCheckpoint);
+		energy[1]	+= stats.m_PotentialEnergy	/ Real(kCheckpoint);
+		energy[2]	+= stats.m_SpringEnergy		/ Real(kCheckpoint);
+		for (int k = 0; k < 3; ++k) {
+			momentum[k] += stats.m_Momentum[k] / Real(kCheckpoint);
+		}
+		timings.m_StepSeconds		+= stats.m_StepSeconds;
+		timings.m_IntegrateSeconds	+= stats.m_IntegrateSeconds;
+		timings.m_CollideSeconds	+= stats.m_CollideSeconds;
+		timings.m_Contacts			+= stats.m_Contacts;
+		timings.m_Unstable			+= stats.m_Unstable ? 1 : 0;
+		if (stats.m_StepSeconds > timings.m_MaxStepSeconds) {
+			timings.m_MaxStepSeconds = stats.m_StepSeconds;
+		}
+
+		if (frame % kCheckpoint != 0) {
+			continue;
+		}
+		int i;
+		for (i = 0; i < count; ++i) {
+			if (ids[i] != 0) {
+				AddSample(samples, frame, kSK_Position, i, *phys.GetRigidBodyVec3fPtr(ids[i], Physics::Engine::propPosition));
+			}
+		}
+		int first = 0;
+		for (i = 0; i < (int) meshes.size(); ++i) {
+			int numPoints = phys.GetRigidBodyVectorArray(meshes[i], Physics::Engine::propPositions, points, sizeof(Vec3f), kMaxPoints - first);
+			for (int j = 0; j < numPoints; j += kPointStride) {
+				AddSample(samples, frame, kSK_Point, first + j, points[j]);
+			}
+			first += numPoints;
+		}
+		AddSample(samples, frame, kSK_Energy, -1, energy);
+		AddSample(samples, frame, kSK_Momentum, -1, momentum);
+		for (int k = 0; k < 3; ++k) {
+			energy[k]	= k0;
+			momentum[k]	= k0;
+		}
+	}
+	return true;
+}
+
+static bool WriteGolden(const char* pPath, const std::vector<Sample>& samples)
+{
+	FILE* pFile = fopen(pPath, "w");
+	if (pFile == 0) {
+		return false;
+	}
+	fprintf(pFile, "# frame kind index x y z; energy is kinetic, potential and spring\n");
+	for (int i = 0; i < (int) samples.size(); ++i) {
+		const Sample& s = samples[i];
+		fprintf(pFile, "%d %s %d %.6g %.6g %.6g\n", s.m_Frame, kSampleNames[s.m_Kind], s.m_Index,
+				(double) s.m_Value[0], (double) s.m_Value[1], (double) s.m_Value[2]);
+	}
+	fclose(pFile);
+	return true;
+}
+
+static bool ReadGolden(const char* pPath, std::vector<Sample>& samples)
+{
+	FILE* pFile = fopen(pPath, "r");
+	if (pFile == 0) {
+		return false;
+	}
+	char line[256];
+	while (fgets(line, sizeof(line), pFile) != 0) {
+		if (line[0] == '#') {
+			continue;
+		}
+		Sample	sample;
+		char	kind[32];
+		double	x, y, z;
+		if (sscanf(line, "%d %31s %d %lf %lf %lf", &sample.m_Frame, kind, &sample.m_Index, &x, &y, &z) != 6) {
+			continue;
+		}
+		sample.m_Kind = -1;
+		for (int k = kSK_Position; k <= kSK_Point; ++k) {
+			if (strcmp(kind, kSampleNames[k]) == 0) {
+				sample.m_Kind = k;
+			}
+		}
+		if (sample.m_Kind < 0) {
+			continue;
+		}
+		sample.m_Value[0] = (Real) x;
+		sample.m_Value[1] = (Real) y;
+		sample.m_Value[2] = (Real) z;
+		samples.push_back(sample);
+	}
+	fclose(pFile);
+	return true;
+}
+
+/**
+ * Positions and points may differ by their tolerance times one plus the golden value. Energy and
+ * momentum pass through zero, and at rest jitter about it, so each is allowed its tolerance times one
+ * plus the largest golden value of the same component over the run, rather than of the value itself.
+ *
+ * @return the number of samples that differ from the golden ones by more than the tolerances, reporting each
+ */
+static int Compare(const char* pName, const std::vector<Sample>& results, const std::vector<Sample>& golden)
+{
+	static const Real kTolerances[] = { kPositionTolerance, kEnergyTolerance, kMomentumTolerance, kPositionTolerance };
+
+	if (results.size() != golden.size()) {
+		printf("  %s: %d samples, the golden file has %d\n", pName, (int) results.size(), (int) golden.size());
+		return 1;
+	}
+
+	Real scales[kSK_Point + 1][3] = { { k0, k0, k0 }, { k0, k0, k0 }, { k0, k0, k0 }, { k0, k0, k0 } };
+	int i;
+	for (i = 0; i < (int) golden.size(); ++i) {
+		const Sample& g = golden[i];
+		for (int j = 0; j < 3; ++j) {
+			Real scale = Abs(g.m_Value[j]);
+			scales[g.m_Kind][j] = scale > scales[g.m_Kind][j] ? scale : scales[g.m_Kind][j];
+		}
+	}
+
+	int failures = 0;
+	for (i = 0; i < (int) golden.size(); ++i) {
+		const Sample& r = results[i];
+		const Sample& g = golden[i];
+		if (r.m_Frame != g.m_Frame || r.m_Kind != g.m_Kind || r.m_Index != g.m_Index) {
+			printf("  %s: sample %d doesn't match the golden file's layout\n", pName, i);
+			return failures + 1;
+		}
+		for (int j = 0; j < 3; ++j) {
+			bool position = g.m_Kind == kSK_Position || g.m_Kind == kSK_Point;
+			Real scale = position ? Abs(g.m_Value[j]) : scales[g.m_Kind][j];
+			Real error = Abs(r.m_Value[j] - g.m_Value[j]);
+			if (error > kTolerances[g.m_Kind] * (k1 + scale)) {
+				printf("  %s: frame %d %s %d [%d] is %g, expected %g\n", pName, g.m_Frame, kSampleNames[g.m_Kind], g.m_Index, j,
+						(double) r.m_Value[j], (double) g.m_Value[j]);
+				++failures;
+			}
+		}
+	}
+	return failures;
+}
+
+/*
+	Contact reduction. The first step of a sphere set down into the dish finds it in the floor
+	and in many faces of the walls, and the pair keeps four of those contacts: the deepest, which is the floor's,
+	straight under the sphere, and three spread around the walls, rather than the first three
+	the heightfield found, which lie together on one side.
+ */
+
+/// @return the number of checks of the contacts the sunk dish's first step kept that failed, reporting each
+static int CheckReduction()
+{
+	static const Scene	kSunkDish	= { "sunk dish", BuildSunkDish, false };
+	static const Real	kApart		= Real(0.7071f);	// cosine of the least angle around the dish between contacts kept on the walls
+
+	Physics::Engine		phys;
+	std::vector<uint32>	meshes;
+	phys.SetThreadCount(1);
+	BuildScene(kSunkDish, phys, meshes);
+	phys.SetRecordContacts(true);
+	phys.Simulate(kFrameTime * kHalf);				// one step, at the least time step BuildScene sets
+
+	Physics::StepStats stats;
+	phys.GetStepStats(stats);
+	int count = phys.GetContactEventCount();
+	const Physics::ContactEvent* pEvents = phys.GetContactEvents();
+	int failures = 0;
+
+	if (count != 4) {
+		printf("  reduction: %d contacts kept, expected 4\n", count);
+		return 1;
+	}
+	if (Abs(stats.m_MaxPenetration - kDishSink) > kEps) {
+		printf("  reduction: the deepest contact kept is %g deep, expected %g\n", (double) stats.m_MaxPenetration, (double) kDishSink);
+		++failures;
+	}
+
+	int floor = -1;
+	int i;
+	for (i = 0; i < count; ++i) {
+		if (Abs(pEvents[i].m_Normal[2]) > k1 - kEps) {
+			floor = i;
+		}
+	}
+	if (floor < 0) {
+		printf("  reduction: the floor's contact wasn't kept\n");
+		return failures + 1;
+	}
+
+	// the contacts on the walls, seen from the floor's
+	Vec3f directions[4];
+	for (i = 0; i < count; ++i) {
+		Vec3fSubtract(directions[i], pEvents[i].m_Position, pEvents[floor].m_Position);
+		directions[i][2] = k0;
+		Vec3fNormalize(directions[i], directions[i]);
+	}
+	for (i = 0; i < count; ++i) {
+		for (int k = i + 1; k < count; ++k) {
+			if (i != floor && k != floor && Vec3fDot(directions[i], directions[k]) > kApart) {
+				printf("  reduction: the contacts on the walls at %g, %g and %g, %g are bunched together\n",
+						(double) pEvents[i].m_Position[0], (double) pEvents[i].m_Position[1], (double) pEvents[k].m_Position[0], (double) pEvents[k].m_Position[1]);
+				++failures;
+			}
+		}
+	}
+	return failures;
+}
+
+int main(int argc, char* argv[])
+{
+	bool		build		= false;
+	bool		golden		= false;
+	const char*	pDirectory	= "Regression/data";
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-build") == 0) {
+			build = true;
+		}
+		else if (strcmp(argv[i], "-golden") == 0) {
+			golden = true;
+		}
+		else {
+			pDirectory = argv[i];
+		}
+	}
+
+	char scenePath[512];
+	char goldenPath[512];
+	Timings timings[kNumScenes];
+	int failed = 0;
+
+	for (int s = 0; s < kNumScenes; ++s) {
+		const char* pName = kScenes[s].m_pName;
+		sprintf(scenePath, "%.400s/%s.scene", pDirectory, pName);
+		sprintf(goldenPath, "%.400s/%s.golden", pDirectory, pName);
+
+		if (build) {
+			if (!kScenes[s].m_Saved) {
+				continue;
+			}
+			Physics::Engine		phys;
+			std::vector<uint32>	meshes;
+			BuildScene(kScenes[s], phys, meshes);
+			if (!phys.SaveScene(scenePath)) {
+				fprintf(stderr, "couldn't write %s\n", scenePath);
+				++failed;
+			}
+			continue;
+		}
+
+		std::vector<Sample> results;
+		if (!RunScene(kScenes[s], scenePath, results, timings[s])) {
+			fprintf(stderr, "couldn't load %s\n", scenePath);
+			++failed;
+			continue;
+		}
+
+		if (golden) {
+			if (!WriteGolden(goldenPath, results)) {
+				fprintf(stderr, "couldn't write %s\n", goldenPath);
+				++failed;
+			}
+			continue;
+		}
+
+		std::vector<Sample> expected;
+		if (!ReadGolden(goldenPath, expected)) {
+			fprintf(stderr, "couldn't read %s\n", goldenPath);
+			++failed;
+			continue;
+		}
+		int failures = Compare(pName, results, expected);
+		bool passed = failures == 0 && timings[s].m_Unstable == 0;
+		if (!passed) {
+			++failed;
+		}
+		printf("%-10s %s, %d samples differ, %d unstable steps\n", pName, passed ? "passed" : "FAILED", failures, timings[s].m_Unstable);
+	}
+
+	if (!build && !golden) {
+		int failures = CheckReduction();
+		if (failures != 0) {
+			++failed;
+		}
+		printf("%-10s %s, %d checks failed\n", "reduction", failures == 0 ? "passed" : "FAILED", failures);
+	}
+
+	if (!build) {
+		printf("\n%-10s %12s %12s %12s %12s %10s %10s\n", "scene", "step ms", "max step ms", "integrate ms", "collide ms", "contacts", "unstable");
+		for (int s = 0; s < kNumScenes; ++s) {
+			const Timings& t = timings[s];
+			printf("%-10s %12.4f %12.4f %12.4f %12.4f %10.1f %10d\n", kScenes[s].m_pName,
+					t.m_StepSeconds * 1000.0 / kFrames, t.m_MaxStepSeconds * 1000.0,
+					t.m_IntegrateSeconds * 1000.0 / kFrames, t.m_CollideSeconds * 1000.0 / kFrames,
+					(double) t.m_Contacts / kFrames, t.m_Unstable);
+		}
+	}
+
+	return failed;
+}
@@ -14,7 +14,7 @@
 #include "PMath.h"
 
 namespace Collision {
-	enum	ECollisionKind	{ kC_Plane = 0, kC_Sphere, kC_BoundedPlane, kC_Box, kC_ConvexHull, kC_Mesh }; 
+	enum	ECollisionKind	{ kC_Plane = 0, kC_Sphere, kC_Heightfield, kC_BoundedPlane, kC_Box, kC_ConvexHull, kC_Mesh }; 
 
 	/**	@class	ICallback
 		@brief	An application receives collision callbacks via this class
@@ -26,7 +26,7 @@ namespace Collision {
 		virtual ~ICallback() { }
 
 		// Override this function to respond to collisions as a they occur
-		/// @return true if the collision should be resolved, false if it should be ignored
+		/// @return true if the collision should be resolved, false to undo its resolution
 		virtual bool CollisionOccurred(
 			uint32 bodyA,					///< The first participant in the collision
 			uint32 bodyB,					///< The second participant in the collision
@@ -72,7 +72,69 @@ namespace Collision {
 		Real m_Radius;
 
 		uint32 GetKind() { return kC_Sphere; }
-		void* m_pAux;
+		void* m_pAux;											///< Opcode sphere, owned by the Collision::Engine that created this
+	};
+
+	/** @class Heightfield
+	 *  terrain for collision purposes
+	 *
+	 *  A regular grid of heights above the XY plane, z up. Sample (i, j) is at
+	 *  m_Origin + (i * m_CellSize, j * m_CellSize, height), and each cell is split into two
+	 *  triangles along the diagonal from sample (i, j) to (i + 1, j + 1). Queries find the
+	 *  cells under them directly, so their cost depends on the query's size, not the terrain's.
+	 */
+	class Heightfield : public IGeometry
+	{
+	public:
+		Heightfield(int columns, int rows, Real cellSize, const PMath::Vec3f origin, const Real* pHeights);
+		virtual ~Heightfield();
+
+		uint32 GetKind() { return kC_Heightfield; }
+
+		/// @return false if x, y is off the grid, otherwise the height of the surface and its normal there
+		bool	GetHeight(Real x, Real y, Real& height, PMath::Vec3f& normal) const;
+
+		/// @return true if the sphere penetrates the surface; normal and depth are of the deepest penetration
+		bool	SphereContact(const PMath::Vec3f center, Real radius, PMath::Vec3f& normal, Real& depth) const;
+
+		/**
+		* the faces the sphere penetrates, one for each plane they lie in, with that plane's normal, the
+		* depth of the deepest of its triangles, and which triangle that was, numbered 2 * cell + t
+		*
+		* @return the number found, at most max
+		*/
+		int		SphereContacts(const PMath::Vec3f center, Real radius, PMath::Vec3f* pNormals, Real* pDepths, uint32* pTriangles, int max) const;
+
+		/**
+		* sweep a sphere from c0 to c1, like Collide_InfPlane_Sphere.
+		* If the sphere already touches the surface at c0, u is zero.
+		*
+		* @return true if the sphere hits the surface; u is the normalized time of first contact
+		*/
+		bool	SweepSphere(const PMath::Vec3f c0, const PMath::Vec3f c1, Real radius, Real& u, PMath::Vec3f& normal) const;
+
+		/// @return true if the ray hits the surface within maxT; t is in units of dir, normal faces the ray
+		bool	RayCast(const PMath::Vec3f origin, const PMath::Vec3f dir, Real maxT, Real& t, PMath::Vec3f& normal) const;
+
+		/// @return true if the box reaches below the surface anywhere over the cells under it
+		bool	OverlapsBox(const PMath::Vec3f boxMin, const PMath::Vec3f boxMax) const;
+
+		int				m_Columns;								///< samples along x
+		int				m_Rows;									///< samples along y
+		Real			m_CellSize;
+		Real			m_OOCellSize;
+		PMath::Vec3f	m_Origin;
+		Real			m_MinHeight, m_MaxHeight;				///< world space bounds of the surface
+		const Real*		m_pHeights;								///< m_Columns * m_Rows heights, one row after another
+		void*			m_pStorage;								///< the copied heights or the mapped file, owned by the Collision::Engine that created this
+		bool			m_Mapped;								///< true if m_pStorage is a mapped file
+
+	protected:
+		/// the range of cells under the x, y bounds; @return false if there are none
+		bool	CellRange(Real minX, Real minY, Real maxX, Real maxY, int& i0, int& j0, int& i1, int& j1) const;
+
+		/// the corners of triangle t, 0 or 1, of cell i, j
+		void	Triangle(int i, int j, int t, PMath::Vec3f& a, PMath::Vec3f& b, PMath::Vec3f& c) const;
 	};
 }
 
@@ -76,6 +76,29 @@ namespace Physics {
 		*/
 		uint32	AddRigidBodySphere(Real radius);
 
+		/**
+		* create a heightfield terrain and add it to the physics engine.
+		* The terrain is a grid of heights above the XY plane, and never moves.
+		* Spheres and particles collide with it by looking up only the cells beneath them.
+		*
+		* @param columns	number of samples along x, at least two
+		* @param rows		number of samples along y, at least two
+		* @param cellSize	distance between neighboring samples
+		* @param origin		world position of the first sample, at height zero
+		* @param pHeights	columns * rows heights, one row after another; the engine keeps a copy
+		* @return the unique ID of the new rigid body
+		*/
+		uint32	AddRigidBodyHeightfield(int columns, int rows, Real cellSize, PMath::Vec3f origin, Real const*const pHeights);
+
+		/**
+		* create a heightfield terrain whose heights are memory mapped from a file, rather than copied.
+		* The file holds columns * rows Reals, one row after another, starting byteOffset bytes in.
+		* Only the parts of the terrain that are touched are paged into memory.
+		*
+		* @return the unique ID of the new rigid body, or 0 if the file can't be mapped or is too short
+		*/
+		uint32	AddRigidBodyHeightfieldFile(int columns, int rows, Real cellSize, PMath::Vec3f origin, const char* pPath, int byteOffset);
+
 		/**
 		* create a spring mesh and add it to the physics engine
 		* Adds body at rest, at the origin, and with default properties
@@ -96,10 +119,37 @@ namespace Physics {
 
 		void	RemoveAll();
 
+		/**
+		* Save the spheres, planes, heightfields, springs, distance constraints and articulations,
+		* with gravity and the minimum time step, to a binary scene file; an articulation keeps its
+		* joints' motion. Spring meshes, particles and force fields are not saved, nor are the
+		* springs and constraints attached to spring meshes.
+		*
+		* @return true if the file was written
+		*/
+		bool	SaveScene(const char* pPath);
+
+		/**
+		* Add the contents of a scene file written by SaveScene to the simulation, and take its gravity
+		* and minimum time step. The file is memory mapped and read in place; heightfields keep their
+		* heights mapped from it, so it must not be changed while they exist.
+		*
+		* @param pIds	receives the new ids of the first maxIds bodies, in the order of the ids they
+		*				were saved with; a body that couldn't be loaded gets id 0. May be zero
+		* @return the number of bodies in the file, or -1 if the file can't be read, or was written by
+		*		  a different version of the engine or with a different Real
+		*/
+		int		LoadScene(const char* pPath, uint32* pIds, int maxIds);
+
 		//----------------------- RigidBody Properties
 
 		enum ERigidBodyBool			{ propActive, propUseGravity, propCollidable, propSpinnable, propTranslatable };
-		enum ERigidBodyScalar		{ propAngularVelocityDamp, propLinearVelocityDamp, propMass };
+		enum ERigidBodyScalar		{ propAngularVelocityDamp, propLinearVelocityDamp, propMass,
+									  propSpringMeshStiffness, propSpringMeshDamping, propSpringMeshCompliance,
+									  propSpringMeshThickness };	// how far a spring mesh's points keep from each other; zero, the default, is no self collision
+		enum ERigidBodyInt			{ propSpringMeshSolver, propSpringMeshSubsteps, propSpringMeshIterations,	// propSpringMeshSolver takes an ESpringMeshSolver
+									  propUpdateInterval,	// read only, waits for a step started by SimulateAsync; the body is stepped every 1, 2, or 4 frames, see SetLODDistances
+									  propIntegrator };		// takes an EIntegrator; spring meshes ignore it
 		enum ERigidBodyVector		{ propExtent, propPosition, propVelocity };
 		enum ERigidBodyQuat 		{ propOrientation };
 		enum ERigidBodyVectorArray	{ propPositions };
@@ -109,6 +159,8 @@ namespace Physics {
 		bool				GetRigidBodyBool			(uint32 id, ERigidBodyBool			prop);
 		void				SetRigidBodyScalar			(uint32 id, ERigidBodyScalar		prop,	Real value);
 		Real				GetRigidBodyScalar			(uint32 id, ERigidBodyScalar		prop);
+		void				SetRigidBodyInt				(uint32 id, ERigidBodyInt			prop,	int value);
+		int					GetRigidBodyInt				(uint32 id, ERigidBodyInt			prop);
 		void 				SetRigidBodyVec3f			(uint32 id, ERigidBodyVector		prop,	PMath::Vec3f value);
 		PMath::Vec3f*		GetRigidBodyVec3fPtr		(uint32 id, ERigidBodyVector		prop);
 		void				SetRigidBodyQuat			(uint32 id, ERigidBodyQuat			prop,	PMath::Quaternion value);
@@ -117,8 +169,58 @@ namespace Physics {
 		void				SetRigidBodyVectorArray		(uint32 id,	ERigidBodyVectorArray	prop,	PMath::Vec3f const*const value, int byteStride, int count);
 		void				SetRigidBodyIntArray		(uint32 id, ERigidBodyIntArray		prop,	int const*const val, int count);
 
+		/// copy up to count vectors into pResult; waits for a step started by SimulateAsync. @return the number copied
+		int					GetRigidBodyVectorArray		(uint32 id,	ERigidBodyVectorArray	prop,	PMath::Vec3f* pResult, int byteStride, int count);
+
 		void				GetRigidBodyTransformMatrix	(uint32 id, Real *const pResult);
 
+		/*
+                 ____                 _   _      _
+                |  _ \   __ _  _ __ | |_ (_)  ___ | |  ___  ___
+                | |_) | / _` || '__|| __|| | / __|| | / _ \/ __|
+                |  __/ | (_| || |   | |_ | || (__ | ||  __/\__ \
+                |_|     \__,_||_|    \__||_| \___||_| \___||___/
+		*/
+		//----------------------- Particle Factory
+
+		/**
+		* create a set of particles and add it to the physics engine.
+		* Particles are spheres of a single radius with no orientation, no mass, and no collision geometry.
+		* They fall under gravity, and bounce off collidable planes and spheres without pushing them back,
+		* so a set of a million particles costs about as much as integrating a million points.
+		*
+		* @param count			number of particles
+		* @param radius			radius of every particle; zero for points
+		* @param pPositions		initial positions
+		* @param pVelocities	initial velocities, or zero to start at rest
+		* @param byteStride		number of bytes from one xyz tuple to the next, in both arrays
+		* @return the unique ID of the new particle set
+		*/
+		uint32	AddParticles(int count, Real radius, PMath::Vec3f const*const pPositions, PMath::Vec3f const*const pVelocities, int byteStride);
+
+		/// remove a set of particles from the simulation. @return true if successfully removed
+		bool	RemoveParticles(uint32 id);
+
+		//----------------------- Particle Properties
+
+		enum EParticleBool			{ propParticlesActive, propParticlesUseGravity, propParticlesCollidable };
+		enum EParticleScalar		{ propParticleRadius, propParticleRestitution, propParticleDrag };	// restitution is 0.5 and drag 0 by default
+		enum EParticleVectorArray	{ propParticlePositions, propParticleVelocities };
+
+		void				SetParticleBool				(uint32 id, EParticleBool			prop,	bool value);
+		bool				GetParticleBool				(uint32 id, EParticleBool			prop);
+		void				SetParticleScalar			(uint32 id, EParticleScalar			prop,	Real value);
+		Real				GetParticleScalar			(uint32 id, EParticleScalar			prop);
+
+		/// @return the number of particles in the set
+		int					GetParticleCount			(uint32 id);
+
+		/// overwrite count vectors starting at particle first. @return the number written
+		int					SetParticleVectorArray		(uint32 id, EParticleVectorArray	prop,	PMath::Vec3f const*const value, int byteStride, int first, int count);
+
+		/// copy count vectors starting at particle first into pResult; waits for a step started by SimulateAsync. @return the number copied
+		int					GetParticleVectorArray		(uint32 id, EParticleVectorArray	prop,	PMath::Vec3f* pResult, int byteStride, int first, int count);
+
 		/*
                       ____             _
                      / ___| _ __  _ __(_)_ __   __ _ ___
@@ -136,7 +238,8 @@ namespace Physics {
 		/// remove a spring from the system
 		bool	RemoveSpring(uint32 id);
 
-		enum ESpringBool	{ propResistCompression };	// if true, the spring will push if compressed, and pull if stretched. If false it will only pull if stretched.
+		enum ESpringBool	{ propResistCompression,	// if true, the spring will push if compressed, and pull if stretched. If false it will only pull if stretched.
+							  propSpringImplicit };		// if true, the spring is integrated by backward Euler, together with all the other implicit springs
 		enum ESpringScalar	{ propSpringStiffness, propSpringDamping, propSpringRestLength };
 		enum ESpringVector	{ propAttachPointA, propAttachPointB };
 		enum ESpringUint32	{ propBodyA, propBodyB };
@@ -169,6 +272,91 @@ namespace Physics {
 		void				SetConstraintScalar			(uint32 id, EConstraintScalar	prop, Real value);
 		Real				GetConstraintScalar			(uint32 id, EConstraintScalar	prop);
 
+		/*
+                     _       _       _
+                    | | ___ (_)_ __ | |_ ___
+                 _  | |/ _ \| | '_ \| __/ __|
+                | |_| | (_) | | | | | |_\__ \
+                 \___/ \___/|_|_| |_|\__|___/
+		*/
+		//----------------------- Articulation Factory
+
+		/**
+		* create an articulation, a tree of bodies joined by joints and stepped together in time linear
+		* in the number of links by Featherstone's articulated body algorithm. The joints can't stretch,
+		* whatever the time step. The root is the body given; a fixed root is held where it is, and a
+		* floating one moves with the tree. The links are still bodies of the engine, and collide with
+		* everything but each other; what their contacts and constraints do to them passes into the
+		* joints. Their masses and inertias are used as they are, and the inertia as if it were
+		* diagonal in the world.
+		*
+		* @return the unique ID of the new articulation, or 0 if the root is unknown or already a link
+		*/
+		uint32				AddArticulation				(uint32 root, bool fixedRoot);
+
+		/**
+		* join child to parent, a link of the articulation, at a pivot given in the world, where the
+		* bodies are now. kJ_Revolute turns the child about axis, kJ_Prismatic slides it along axis,
+		* and kJ_Spherical turns it freely about the pivot; axis is a world direction.
+		*
+		* @return false if the articulation or the bodies are unknown, parent isn't a link, or child already is
+		*/
+		bool				AddArticulationJoint		(uint32 id, uint32 parent, uint32 child, EJointKind kind,
+														 PMath::Vec3f pivot, PMath::Vec3f axis);
+
+		/// remove an articulation, and let its links go free with the translatable and spinnable flags they had before. Removing one of its bodies removes it too
+		bool				RemoveArticulation			(uint32 id);
+
+		/// an inactive articulation holds its links where they are; damping opposes each joint's motion, per unit of speed
+		enum EArticulationBool		{ propArticulationActive };
+		enum EArticulationScalar	{ propArticulationDamping };
+
+		void				SetArticulationBool			(uint32 id, EArticulationBool	prop, bool value);
+		bool				GetArticulationBool			(uint32 id, EArticulationBool	prop);
+		void				SetArticulationScalar		(uint32 id, EArticulationScalar	prop, Real value);
+		Real				GetArticulationScalar		(uint32 id, EArticulationScalar	prop);
+
+		/*
+                 _____ _      _     _
+                |  ___(_) ___| | __| |___
+                | |_  | |/ _ \ |/ _` / __|
+                |  _| | |  __/ | (_| \__ \
+                |_|   |_|\___|_|\__,_|___/
+		*/
+		//----------------------- Force Field Factory
+
+		/**
+		* create a force field, acting on the movable bodies with collision geometry within its reach.
+		* kFF_Attractor		accelerates bodies toward propFieldCenter by propFieldStrength, fading to nothing
+		*					at propFieldRadius; a negative strength repels
+		* kFF_Wind			brings bodies within propFieldRadius of propFieldCenter toward propFieldVelocity,
+		*					at propFieldStrength per second, fading in the same way
+		* kFF_Drag			slows bodies whose centers are in the box from propFieldMin to propFieldMax, by
+		*					propFieldLinearDrag per second plus propFieldQuadraticDrag per meter per second of speed
+		* kFF_Buoyancy		fills the box with water of propFieldDensity flowing at propFieldVelocity; the top
+		*					of the box is the surface. Bodies are lifted by the weight of the water their
+		*					spheres displace, and slowed by propFieldLinearDrag times the fraction submerged
+		*
+		* Fields are applied with the other forces in every substep, in one pass over each field's
+		* bodies; the bodies near each field are found through the broadphase once per world step.
+		* @return the unique ID of the new field
+		*/
+		uint32	AddForceField(EForceFieldKind kind);
+
+		/// remove a force field. @return true if successfully removed
+		bool	RemoveForceField(uint32 id);
+
+		enum EForceFieldBool	{ propFieldActive };
+		enum EForceFieldScalar	{ propFieldStrength, propFieldRadius, propFieldLinearDrag, propFieldQuadraticDrag, propFieldDensity };
+		enum EForceFieldVector	{ propFieldCenter, propFieldMin, propFieldMax, propFieldVelocity };
+
+		void				SetForceFieldBool			(uint32 id, EForceFieldBool		prop, bool value);
+		bool				GetForceFieldBool			(uint32 id, EForceFieldBool		prop);
+		void				SetForceFieldScalar			(uint32 id, EForceFieldScalar	prop, Real value);
+		Real				GetForceFieldScalar			(uint32 id, EForceFieldScalar	prop);
+		void				SetForceFieldVec3f			(uint32 id, EForceFieldVector	prop, PMath::Vec3f value);
+		PMath::Vec3f*		GetForceFieldVec3fPtr		(uint32 id, EForceFieldVector	prop);
+
 		/*
                  ____                              _
                 |  _ \ _   _ _ __   __ _ _ __ ___ (_) ___ ___
@@ -198,6 +386,39 @@ namespace Physics {
 		/// Set the gravity vector that applies to all bodies, if body's gravity flag is true
 		void				SetGravity					(PMath::Vec3f val);
 
+		/*
+                    ___                  _
+                   / _ \ _   _  ___ _ __(_) ___  ___
+                  | | | | | | |/ _ \ '__| |/ _ \/ __|
+                  | |_| | |_| |  __/ |  | |  __/\__ \
+                   \__\_\\__,_|\___|_|  |_|\___||___/
+		*/
+		//----------------------- Spatial queries against the bodies' collision geometry
+
+		/**
+		* The queries walk a bounding volume hierarchy the engine rebuilds every step, and test the
+		* bodies it finds against their spheres, planes and heightfields, where the last step left
+		* them. Planes and heightfields are solid behind their surfaces. Results are written into
+		* the caller's buffers, and nothing is allocated, so any number of threads may query at
+		* once between steps, as long as no other engine function is called meanwhile. The queries
+		* can't be made while a step started by SimulateAsync is running, and find nothing then.
+		*/
+
+		/// the nearest hit within maxDistance of origin along direction. @return true if anything was hit
+		bool				RayCast						(PMath::Vec3f origin, PMath::Vec3f direction, Real maxDistance, RayHit& hit);
+
+		/// the nearest maxHits hits, nearest first. @return the number of hits written to pHits
+		int					RayCastAll					(PMath::Vec3f origin, PMath::Vec3f direction, Real maxDistance, RayHit* pHits, int maxHits);
+
+		/// the nearest hit of each of count rays, rays that miss have a zero m_Body. @return the number of rays that hit
+		int					RayCastBatch				(int count, PMath::Vec3f const*const pOrigins, PMath::Vec3f const*const pDirections, Real maxDistance, RayHit* pHits);
+
+		/// the ids of up to maxBodies bodies that overlap the sphere. @return the number written to pBodies
+		int					OverlapSphere				(PMath::Vec3f center, Real radius, uint32* pBodies, int maxBodies);
+
+		/// the ids of up to maxBodies bodies that overlap the axis aligned box. @return the number written to pBodies
+		int					OverlapAABB					(PMath::Vec3f boxMin, PMath::Vec3f boxMax, uint32* pBodies, int maxBodies);
+
 
 		/*
                ____  _                 _       _   _
@@ -211,19 +432,182 @@ namespace Physics {
 		/**
 		* Sets a collision callback object. Note that the object is owned by the application,
 		* not the physics engine, and will not be deleted by the physics engine. It is illegal
-		* to call any physics engine functions from the callback.
+		* to call any physics engine functions from the callback, other than DeferImpulse and
+		* DeferRemoveRigidBody. The callback is called once each contact has been resolved,
+		* on the thread running the step.
 		* 
 		* @param pCB The callback object to use when collisions occur.
 		*/
 		void				SetCollisionCallback(Collision::ICallback* pCB);
 
-		/// Set the minimum time step to ensure stability
+		/// Record every contact resolved during a step, to be read once it is done. Off by default
+		void				SetRecordContacts(bool record);
+
+		/// @return the number of contacts recorded during the last step; waits for a step started by SimulateAsync
+		int					GetContactEventCount();
+
+		/// @return the contacts recorded during the last step, valid until the next step, or 0 if there were none
+		const ContactEvent*	GetContactEvents();
+
+		/// copy up to maxEvents of the last step's contacts involving body id into pResult. @return the number copied
+		int					GetContactEvents(uint32 id, ContactEvent* pResult, int maxEvents);
+
+		/**
+		* Queue an impulse, or the removal of a body, from a collision callback. The queue is applied
+		* in one batch when the step ends: by Simulate before it returns, or by Sync after SimulateAsync,
+		* before any changes the application made while the step ran.
+		*/
+		void				DeferImpulse(uint32 id, PMath::Vec3f force);
+		void				DeferRemoveRigidBody(uint32 id);
+
+		/// Set the minimum time step to ensure stability; collisions are detected once per step of this size
 		void				SetMinTimeStep(Real dt);
 
+		/**
+		* Bodies connected by springs and constraints form islands. Within each minimum time step,
+		* every island is substepped as finely as the stiffness and speed of its own springs need,
+		* so a stiff rig doesn't make the rest of the world more expensive.
+		*
+		* @param bodySubsteps	most body substeps per minimum time step, over the whole world; 0, the default, is unlimited.
+		*						If exceeded, the islands' extra substeps are scaled down to fit
+		* @param maxSubsteps	most substeps any one island may take per minimum time step, 16 by default
+		*/
+		void				SetSubstepBudget(int bodySubsteps, int maxSubsteps);
+
+		/**
+		* Choose how distance constraints are solved. Each time step, body positions are projected
+		* until every constraint is within its tolerance, or the iteration count runs out.
+		* Gauss-Seidel converges in fewer iterations; Jacobi runs on all the engine's threads,
+		* and is the better choice for many thousands of constraints.
+		* The default is Gauss-Seidel with 4 iterations.
+		*
+		* @param solver		kCS_GaussSeidel or kCS_Jacobi
+		* @param iterations	the most iterations to run per time step
+		*/
+		void				SetConstraintSolver(EConstraintSolver solver, int iterations);
+
+		/**
+		* Resolve contacts in order of when they happened within each minimum time step, rather than
+		* in the order they were found. The earliest contact is resolved, the pairs of the bodies it
+		* moved are tested again, and the earliest remaining contact is resolved next, until none are
+		* left. A body struck twice in one step is then struck in the right order, with the velocity
+		* the first blow gave it, without shrinking the minimum time step for the whole world.
+		* Past the cap, the remaining contacts are resolved in time order without testing again.
+		*
+		* @param maxEvents	most contacts to resolve with testing again per minimum time step;
+		*					0, the default, resolves contacts in the order found
+		*/
+		void				SetImpactOrdering(int maxEvents);
+
+		/**
+		* A sphere that moves more than a fraction of its radius in one minimum time step gets a
+		* speculative contact with any plane or sphere it is closing on fast enough to reach within the
+		* next step. Resolving one removes only the closing speed that would carry the sphere past the gap,
+		* so it arrives touching, however fast it was going, and the minimum time step can be raised for
+		* scenes full of projectiles. The sphere's bounds in the broadphase stretch to cover the next step.
+		* Speculative contacts aren't reported to the collision callback or recorded as contact events;
+		* the contact the sphere makes when it arrives is.
+		*
+		* @param fraction	of its radius a sphere must move in a step to get speculative contacts;
+		*					0, the default, turns them off
+		*/
+		void				SetSpeculativeContacts(Real fraction);
+
+		/**
+		* Bodies far from every focus point may be stepped less often, so that the cost of a large
+		* world follows the area of interest. A body farther than halfRate from the nearest focus point
+		* is stepped every other frame, and farther than quarterRate, every fourth frame; each step
+		* covers all the time the body waited. Bodies joined by springs or constraints are stepped at
+		* the rate of the fastest of them, and a body touched by a faster one speeds up to its rate.
+		* Bodies change rate only on frames they are stepped. A distance of zero, the default, turns
+		* that rate off; with no focus points, every body is stepped every frame.
+		*
+		* @param count		the number of focus points, typically the cameras or players
+		* @param pPoints	the focus points, copied
+		*/
+		void				SetLODFocusPoints(int count, PMath::Vec3f const*const pPoints);
+		void				SetLODDistances(Real halfRate, Real quarterRate);
+
+		/// Set the number of threads the parallel parts of a step may use, including the simulating thread; 0 means one per processor
+		void				SetThreadCount(int count);
+
+		/// Report the memory held by the engine's object pools; bodies, springs, constraints, geometry and contacts are all pooled
+		void				GetMemoryStats(MemoryStats& stats);
+
+		/**
+		* Report how long the last step took, in wall clock time, and how much work it did, with the
+		* kinetic energy and momentum of the bodies it left behind; waits for a step started by
+		* SimulateAsync. Comparing these from run to run shows whether a change to the engine
+		* altered its results, its speed, or both.
+		*/
+		void				GetStepStats(StepStats& stats);
+
+		/**
+		* Watch each step for signs of blowing up. The total energy, kinetic, potential and spring, is
+		* measured after every step; if it grew by more than growth times the kinetic and spring energy
+		* the step began with, or isn't a number, GetStepStats reports the step as unstable. What
+		* contacts change is left out, since pushing resting bodies apart lifts them; measuring it costs
+		* two more measurements each world step. Forces applied by the application and force fields add
+		* energy too, so growth should allow for them. Steps that add or remove bodies aren't judged.
+		*
+		* @param growth		fraction the energy may grow in one step; 0, the default, turns the monitor off
+		*/
+		void				SetStabilityMonitor(Real growth);
+
+		/**
+		* Keep each call to Simulate within a wall clock budget, so that a long frame can't make
+		* the next one longer. A step runs only as many minimum time steps as the last step's cost
+		* says will fit, and stops early if it runs over; the time left out is lost, and simulated time
+		* runs slow. While steps still lose time, they degrade in stages, one more after each step that
+		* lost time or ran over, and one less after each step under half the budget: the constraint
+		* solver runs half its iterations, then islands in the slower level of detail tiers wait, losing
+		* the time, then islands take at most a quarter of their substeps. GetStepStats reports what
+		* a step gave up.
+		*
+		* @param seconds	the most wall clock time a step should take; 0, the default, is no limit
+		*/
+		void				SetTimeBudget(double seconds);
+
+		/**
+		* Find the largest minimum time step that steps the scene stably, by simulating copies of it. The
+		* scene is copied in memory, in the state it is in, into scratch engines with this one's settings,
+		* which run for the given frames at each time step tried, halving from frameTime until none is
+		* unstable, then narrowing in between. Particle sets and the collision callback aren't copied.
+		* The stability monitor's growth is used, or 0.1 if it is off. This engine isn't changed.
+		*
+		* @return the time step to pass to SetMinTimeStep, or 0 if no time step down to 1/256 of
+		*		  frameTime was stable
+		*/
+		Real				FindStableTimeStep(Real frameTime, int frames);
+
 		///	Run one step of the simulation given dt in seconds
 		void				Simulate(Real dt);
 
+		/**
+		* Start one step of the simulation on a worker thread, and return immediately.
+		* Until Sync is called, GetRigidBodyTransformMatrix, GetRigidBodyQuatPtr, and GetRigidBodyVec3fPtr
+		* for propPosition and propVelocity read an immutable snapshot of the previous step's results.
+		* Property sets, impulses, twists, and gravity changes are queued, and applied by Sync.
+		* Adding or removing anything, or calling Simulate, implicitly calls Sync first.
+		* All calls must come from the same thread.
+		*
+		* @param dt time step in seconds
+		*/
+		void				SimulateAsync(Real dt);
+
+		/// Wait for the step started by SimulateAsync, publish its results, and apply queued changes
+		void				Sync();
+
+		/// @return true if a step started by SimulateAsync has not been synced yet
+		bool				IsSimulating() const;
+
 	protected:
+		void				Step(Real dt);					///< the body of Simulate, runs on either thread
+		static void			AsyncStep(void* pData);			///< worker thread entry point for SimulateAsync
+		void				SyncForEdit();					///< Sync, then invalidate the snapshot
+		void				ApplyPendingCommands();
+		bool				SteppedStably(Real dt, Real frameTime, int frames);	///< for FindStableTimeStep
+
 		PEAux*	m_pAux;
 	};
 
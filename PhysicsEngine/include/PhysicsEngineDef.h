@@ -18,8 +18,106 @@ namespace Physics {
 							kI_Cylinder, kI_CylinderBottomHeavy, kI_CylinderThinShell, kI_CylinderThinShellBottomHeavy,
 							kI_Torus, kI_Hoop };
 
+	/// how distance constraints are projected; Gauss-Seidel is sequential, Jacobi runs on all threads
+	enum	EConstraintSolver { kCS_GaussSeidel, kCS_Jacobi };
+
+	/// how a spring mesh is integrated; explicit Hooke springs, compliant position based constraints, or backward Euler
+	enum	ESpringMeshSolver { kSM_Explicit, kSM_XPBD, kSM_Implicit };
+
+	/// what a force field does to the bodies within it; see Engine::AddForceField
+	enum	EForceFieldKind { kFF_Attractor, kFF_Wind, kFF_Drag, kFF_Buoyancy };
+
+	/// how a rigid body is advanced; velocity Verlet, semi-implicit Euler, or Verlet with a fourth order Runge-Kutta rotation
+	enum	EIntegrator { kIN_Verlet, kIN_SemiImplicitEuler, kIN_VerletRK4Rotation };
+
+	/// how an articulation's link moves on its parent; a hinge about an axis, a slide along it, or a ball joint
+	enum	EJointKind { kJ_Revolute, kJ_Prismatic, kJ_Spherical };
+
 	class RigidBody;
 	class Engine;
+
+	/// one hit of a ray cast, filled in by Engine::RayCast and its variants
+	class RayHit {
+	public:
+		RayHit() : m_Body(0), m_Distance(0) { }
+		uint32			m_Body;				///< id of the body hit, or 0 if the ray hit nothing
+		Real			m_Distance;			///< from the ray's origin to the hit
+		PMath::Vec3f	m_Position;
+		PMath::Vec3f	m_Normal;			///< surface normal at the hit, facing the ray
+	};
+
+	/// one contact resolved during a step, recorded if Engine::SetRecordContacts is on
+	class ContactEvent {
+	public:
+		uint32			m_BodyA;
+		uint32			m_BodyB;
+		uint32			m_Feature;			///< which part of the bodies' shapes touched; the same from step to step while they touch there
+		PMath::Vec3f	m_Position;			///< where the bodies touched
+		PMath::Vec3f	m_Normal;			///< unit normal pointing from body A toward body B
+		PMath::Vec3f	m_ImpulseA;			///< momentum resolving the contact gave body A
+		PMath::Vec3f	m_ImpulseB;			///< momentum resolving the contact gave body B
+	};
+
+	/// what a step gave up to keep within the time budget, in StepStats::m_Degraded
+	enum EDegradation {
+		kDG_SolverIterations	= 1,		///< the constraint solver ran half its iterations
+		kDG_FarIslands			= 2,		///< islands in the slower level of detail tiers waited, losing the time
+		kDG_Substeps			= 4,		///< islands took at most a quarter of their most substeps
+		kDG_SimulatedTime		= 8			///< world steps were dropped; simulated time ran slow
+	};
+
+	/// what the last step did and how long it took, filled in by Engine::GetStepStats
+	class StepStats {
+	public:
+		StepStats() : m_StepSeconds(0), m_IntegrateSeconds(0), m_CollideSeconds(0), m_WorldSteps(0), m_Islands(0),
+			m_BodySubsteps(0), m_Contacts(0), m_KineticEnergy(0), m_PotentialEnergy(0), m_SpringEnergy(0),
+			m_MaxPenetration(0), m_ConstraintError(0), m_EnergyDrift(0), m_Unstable(false), m_Degraded(0), m_TimeDropped(0) { m_Momentum[0] = m_Momentum[1] = m_Momentum[2] = 0; }
+		double			m_StepSeconds;		///< wall clock time of the whole step
+		double			m_IntegrateSeconds;	///< of integrating the bodies, springs and constraints
+		double			m_CollideSeconds;	///< of finding and resolving contacts, spring meshes' included
+		int				m_WorldSteps;		///< the step was divided into this many minimum time steps
+		int				m_Islands;
+		int				m_BodySubsteps;		///< body integrations, summed over every substep of every world step
+		int				m_Contacts;			///< contacts resolved
+		Real			m_KineticEnergy;	///< linear kinetic energy of the movable bodies after the step, spring meshes aside
+		PMath::Vec3f	m_Momentum;			///< linear momentum of the same bodies
+		Real			m_PotentialEnergy;	///< of the same bodies in gravity, zero at the origin
+		Real			m_SpringEnergy;		///< stored in the springs between bodies
+		Real			m_MaxPenetration;	///< deepest the bodies of any contact overlapped when the contact was found
+		Real			m_ConstraintError;	///< largest error of any distance constraint after the step, as a fraction of its distance
+		Real			m_EnergyDrift;		///< change of the total energy over the step, contacts aside, if the stability monitor is on
+		bool			m_Unstable;			///< the stability monitor saw the energy grow too fast, or stop being a number
+		uint32			m_Degraded;			///< EDegradation flags, for what the step gave up to keep within the time budget
+		Real			m_TimeDropped;		///< simulated time the step left out to keep within the budget
+	};
+
+	/// memory usage of one of the engine's object pools
+	class PoolStats {
+	public:
+		PoolStats() : m_InUse(0), m_Capacity(0), m_ObjectSize(0), m_Bytes(0) { }
+		int		m_InUse;			///< objects currently allocated
+		int		m_Capacity;			///< objects that fit in the memory already reserved
+		int		m_ObjectSize;		///< bytes per object
+		int		m_Bytes;			///< total bytes reserved
+	};
+
+	/// memory usage of all of an engine's object pools, filled in by Engine::GetMemoryStats
+	class MemoryStats {
+	public:
+		PoolStats	m_RigidBodies;
+		PoolStats	m_SpringMeshes;
+		PoolStats	m_Springs;
+		PoolStats	m_DistanceConstraints;
+		PoolStats	m_Spheres;			///< sphere collision geometry
+		PoolStats	m_Planes;			///< plane collision geometry
+		PoolStats	m_Heightfields;		///< heightfield collision geometry, and heights not mapped from files
+		PoolStats	m_Contacts;
+		PoolStats	m_ParticleSystems;
+		PoolStats	m_ForceFields;
+		PoolStats	m_Particles;		///< the particle arrays of all the particle systems
+		PoolStats	m_Articulations;
+		int			m_TotalBytes;
+	};
 }
 
 #define APILOG printf
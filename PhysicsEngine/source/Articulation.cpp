@@ -0,0 +1,877 @@
+
+/** @file Articulation.cpp
+	@brief	Featherstone's articulated body algorithm, stepping trees of jointed bodies */
+
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#include "Articulation.h"
+#include "RigidBody.h"
+
+using namespace PMath;
+
+namespace Physics {
+
+	static const Real kAbsorbEpsilon = kEps * kEps;		// squared change in a link's state too small to take in
+	static const Real kMaxJointTurn = Real(0.1f);		// radians a joint may turn in one step, see StableTimeStep
+
+	/*
+		Spatial vectors here are Plucker coordinates along the world axes, about each link's own
+		center: a motion is the angular velocity, then the velocity of the center; a force is the
+		moment about the center, then the force. Passing a term between a link and its parent is
+		only a shift by the offset between their centers. About one point for all the links, the
+		large moments of the distant ones would cancel each other, and floats lose the difference.
+	 */
+
+	/// rotate v by the unit quaternion q
+	static void Rotate(Vec3f& result, const Quaternion q, const Vec3f v)
+	{
+		Vec3f u, t, r;
+		u[0] = q[0];
+		u[1] = q[1];
+		u[2] = q[2];
+		Vec3fCross(t, u, v);
+		Vec3fScale(t, k2);
+		Vec3fCross(r, u, t);
+		Vec3fMultiplyAccumulate(r, q[3], t);
+		Vec3fAdd(result, v, r);
+	}
+
+	/// rotate v by the inverse of the unit quaternion q
+	static void RotateInverse(Vec3f& result, const Quaternion q, const Vec3f v)
+	{
+		Quaternion conjugate;
+		conjugate[0] = -q[0];
+		conjugate[1] = -q[1];
+		conjugate[2] = -q[2];
+		conjugate[3] = q[3];
+		Rotate(result, conjugate, v);
+	}
+
+	/// a motion crossed with a motion
+	static void CrossMotion(Real* pResult, const Real* pV, const Real* pM)
+	{
+		Vec3f t;
+		Vec3fCross(*(Vec3f*) pResult, *(const Vec3f*) pV, *(const Vec3f*) pM);
+		Vec3fCross(*(Vec3f*) (pResult + 3), *(const Vec3f*) pV, *(const Vec3f*) (pM + 3));
+		Vec3fCross(t, *(const Vec3f*) (pV + 3), *(const Vec3f*) pM);
+		Vec3fAdd(*(Vec3f*) (pResult + 3), t);
+	}
+
+	/// a motion crossed with a force
+	static void CrossForce(Real* pResult, const Real* pV, const Real* pF)
+	{
+		Vec3f t;
+		Vec3fCross(*(Vec3f*) pResult, *(const Vec3f*) pV, *(const Vec3f*) pF);
+		Vec3fCross(t, *(const Vec3f*) (pV + 3), *(const Vec3f*) (pF + 3));
+		Vec3fAdd(*(Vec3f*) pResult, t);
+		Vec3fCross(*(Vec3f*) (pResult + 3), *(const Vec3f*) pV, *(const Vec3f*) (pF + 3));
+	}
+
+	/// move a motion from a parent's center to a child's, offset from it
+	static void ShiftMotion(Real* pResult, const Vec3f offset, const Real* pM)
+	{
+		Vec3fSet(*(Vec3f*) pResult, *(const Vec3f*) pM);
+		Vec3fCross(*(Vec3f*) (pResult + 3), *(const Vec3f*) pM, offset);
+		Vec3fAdd(*(Vec3f*) (pResult + 3), *(const Vec3f*) (pM + 3));
+	}
+
+	/// move a force from a child's center to its parent's, the child being offset from it
+	static void ShiftForce(Real* pResult, const Vec3f offset, const Real* pF)
+	{
+		Vec3fCross(*(Vec3f*) pResult, offset, *(const Vec3f*) (pF + 3));
+		Vec3fAdd(*(Vec3f*) pResult, *(const Vec3f*) pF);
+		Vec3fSet(*(Vec3f*) (pResult + 3), *(const Vec3f*) (pF + 3));
+	}
+
+	static void Multiply6(Real* pResult, const Real* pMatrix, const Real* pV)
+	{
+		for (int r = 0; r < 6; ++r) {
+			Real sum = k0;
+			for (int c = 0; c < 6; ++c) {
+				sum += pMatrix[r * 6 + c] * pV[c];
+			}
+			pResult[r] = sum;
+		}
+	}
+
+	/// add a child's inertia, seen through its parent's center, to the parent's
+	static void AccumulateInertia(Real* pParent, const Vec3f offset, const Real* pI)
+	{
+		for (int c = 0; c < 6; ++c) {
+			Real unit[6] = { k0, k0, k0, k0, k0, k0 };
+			Real motion[6], force[6], column[6];
+			unit[c] = k1;
+			ShiftMotion(motion, offset, unit);
+			Multiply6(force, pI, motion);
+			ShiftForce(column, offset, force);
+			for (int r = 0; r < 6; ++r) {
+				pParent[r * 6 + c] += column[r];
+			}
+		}
+	}
+
+	/// invert the n by n matrix by Gauss-Jordan elimination. @return false, with a zero inverse, if it is singular
+	static bool Invert(Real* pInverse, const Real* pMatrix, int n)
+	{
+		Real work[36];
+		int r, c;
+		for (r = 0; r < n * n; ++r) {
+			work[r] = pMatrix[r];
+			pInverse[r] = k0;
+		}
+		for (r = 0; r < n; ++r) {
+			pInverse[r * n + r] = k1;
+		}
+
+		for (c = 0; c < n; ++c) {
+			int pivot = c;
+			for (r = c + 1; r < n; ++r) {
+				if (Abs(work[r * n + c]) > Abs(work[pivot * n + c])) {
+					pivot = r;
+				}
+			}
+			if (Abs(work[pivot * n + c]) < Real(1.0e-12f)) {
+				for (r = 0; r < n * n; ++r) {
+					pInverse[r] = k0;
+				}
+				return false;
+			}
+			if (pivot != c) {
+				for (int j = 0; j < n; ++j) {
+					Real t = work[c * n + j];		work[c * n + j] = work[pivot * n + j];			work[pivot * n + j] = t;
+					t = pInverse[c * n + j];		pInverse[c * n + j] = pInverse[pivot * n + j];	pInverse[pivot * n + j] = t;
+				}
+			}
+			Real scale = k1 / work[c * n + c];
+			for (int j = 0; j < n; ++j) {
+				work[c * n + j] *= scale;
+				pInverse[c * n + j] *= scale;
+			}
+			for (r = 0; r < n; ++r) {
+				Real factor = work[r * n + c];
+				if (r == c || factor == k0) {
+					continue;
+				}
+				for (int j = 0; j < n; ++j) {
+					work[r * n + j] -= factor * work[c * n + j];
+					pInverse[r * n + j] -= factor * pInverse[c * n + j];
+				}
+			}
+		}
+		return true;
+	}
+
+	/// the spatial inertia of a body about its center
+	static void BodyInertia(Real* pI, const RigidBody* pBody)
+	{
+		Real mass = pBody->GetRawMass();
+		bool sphere = pBody->GetInertialKind() == kI_Sphere;
+		for (int j = 0; j < 36; ++j) {
+			pI[j] = k0;
+		}
+		for (int r = 0; r < 3; ++r) {
+			Real itd = pBody->m_InertiaITD[sphere ? 0 : r];
+			pI[r * 6 + r] = itd > k0 ? k1 / itd : k0;
+			pI[(r + 3) * 6 + r + 3] = mass;
+		}
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	Articulation :: Articulation() : m_Active(true), m_Damping(k0), m_FixedRoot(true)
+	{
+		Vec3fZero(m_Gravity);
+	}
+
+	void Articulation :: SetRoot(uint32 id, RigidBody* pRoot, bool fixed)
+	{
+		m_Links.resize(1);
+		ArticulationLink& root = m_Links[0];
+		root.m_pBody	= pRoot;
+		root.m_BodyId	= id;
+		root.m_Parent	= -1;
+		root.m_Kind		= kJ_Spherical;
+		root.m_Dofs		= 0;
+		root.m_Q		= k0;
+		root.m_WasTranslatable	= pRoot->GetTranslatable();
+		root.m_WasSpinnable		= pRoot->GetSpinnable();
+		pRoot->SetTranslatable(!fixed);
+		pRoot->SetSpinnable(!fixed);
+		for (int i = 0; i < 6; ++i) {
+			root.m_V[i] = k0;
+			root.m_C[i] = k0;
+		}
+		Vec3fSet(root.m_Position, pRoot->m_StateT1.m_Position);
+		QuatSet(root.m_Orientation, pRoot->m_StateT1.m_Orientation);
+		Vec3fSet(root.m_Pivot, root.m_Position);
+		m_FixedRoot = fixed;
+
+		// a free root starts with the body's motion
+		if (!fixed) {
+			Vec3fSet(*(Vec3f*) root.m_V, pRoot->m_StateT1.m_AngularVelocity);
+			Vec3fSet(*(Vec3f*) (root.m_V + 3), pRoot->m_StateT1.m_Velocity);
+		}
+		Vec3fSet(root.m_Velocity, *(Vec3f*) (root.m_V + 3));
+	}
+
+	bool Articulation :: AddLink(uint32 id, RigidBody* pChild, RigidBody* pParent, EJointKind kind, const Vec3f pivot, const Vec3f axis)
+	{
+		int parent = -1;
+		for (int i = 0; i < (int) m_Links.size(); ++i) {
+			if (m_Links[i].m_pBody == pParent) {
+				parent = i;
+			}
+		}
+		if (parent < 0) {
+			return false;
+		}
+
+		m_Links.push_back(ArticulationLink());
+		ArticulationLink& link = m_Links.back();
+		const ArticulationLink& up = m_Links[parent];
+		link.m_pBody	= pChild;
+		link.m_BodyId	= id;
+		link.m_Parent	= parent;
+		link.m_Kind		= kind;
+		link.m_Dofs		= kind == kJ_Spherical ? 3 : 1;
+		link.m_Q		= k0;
+		for (int d = 0; d < kMaxJointDofs; ++d) {
+			link.m_QDot[d] = k0;
+		}
+		link.m_WasTranslatable	= pChild->GetTranslatable();
+		link.m_WasSpinnable		= pChild->GetSpinnable();
+		pChild->SetTranslatable(true);
+		pChild->SetSpinnable(true);
+
+		// the joint, and the link's orientation, as seen from the parent where they are now
+		Vec3f offset;
+		Vec3fSubtract(offset, pivot, up.m_Position);
+		RotateInverse(link.m_PivotInParent, up.m_Orientation, offset);
+		Vec3fSubtract(offset, pivot, pChild->m_StateT1.m_Position);
+		RotateInverse(link.m_PivotInChild, pChild->m_StateT1.m_Orientation, offset);
+
+		Vec3f direction;
+		Vec3fSet(direction, axis);
+		Real length = Vec3fLength(direction);
+		if (length > kEps) {
+			Vec3fScale(direction, k1 / length);
+		}
+		else {
+			Vec3fZero(direction);
+			direction[2] = k1;
+		}
+		RotateInverse(link.m_Axis, pChild->m_StateT1.m_Orientation, direction);
+
+		Quaternion parentInverse;
+		parentInverse[0] = -up.m_Orientation[0];
+		parentInverse[1] = -up.m_Orientation[1];
+		parentInverse[2] = -up.m_Orientation[2];
+		parentInverse[3] = up.m_Orientation[3];
+		QuatMultiply(link.m_RestOrientation, parentInverse, pChild->m_StateT1.m_Orientation);
+		QuatSet(link.m_JointOrientation, link.m_RestOrientation);
+
+		PlaceLinks();
+		FindVelocities();
+		WriteBodies();
+		return true;
+	}
+
+	/*
+		Only the joints and their state are taken from the links given; the links are placed from
+		them, so a scene saved and loaded carries on exactly as it would have. The root's motion is
+		its body's, as in SetRoot.
+	 */
+
+	void Articulation :: Load(const ArticulationLink* pLinks, RigidBody* const* ppBodies, const uint32* pIds, int count, bool fixedRoot)
+	{
+		m_Links.resize(count);
+		m_FixedRoot = fixedRoot;
+		for (int i = 0; i < count; ++i) {
+			const ArticulationLink& saved = pLinks[i];
+			ArticulationLink& link = m_Links[i];
+			link.m_pBody			= ppBodies[i];
+			link.m_BodyId			= pIds[i];
+			link.m_Parent			= i == 0 ? -1 : saved.m_Parent;
+			link.m_Kind				= i == 0 ? kJ_Spherical : saved.m_Kind;
+			link.m_Dofs				= i == 0 ? 0 : link.m_Kind == kJ_Spherical ? 3 : 1;
+			link.m_Q				= saved.m_Q;
+			link.m_WasTranslatable	= saved.m_WasTranslatable;
+			link.m_WasSpinnable		= saved.m_WasSpinnable;
+			Vec3fSet(link.m_PivotInParent,		saved.m_PivotInParent);
+			Vec3fSet(link.m_PivotInChild,		saved.m_PivotInChild);
+			Vec3fSet(link.m_Axis,				saved.m_Axis);
+			QuatSet(link.m_RestOrientation,		saved.m_RestOrientation);
+			QuatSet(link.m_JointOrientation,	saved.m_JointOrientation);
+			for (int d = 0; d < kMaxJointDofs; ++d) {
+				link.m_QDot[d] = saved.m_QDot[d];
+			}
+			link.m_pBody->SetTranslatable(i != 0 || !fixedRoot);
+			link.m_pBody->SetSpinnable(i != 0 || !fixedRoot);
+		}
+
+		ArticulationLink& root = m_Links[0];
+		RigidBody* pRoot = root.m_pBody;
+		for (int j = 0; j < 6; ++j) {
+			root.m_V[j] = k0;
+			root.m_C[j] = k0;
+		}
+		Vec3fSet(root.m_Position, pRoot->m_StateT1.m_Position);
+		QuatSet(root.m_Orientation, pRoot->m_StateT1.m_Orientation);
+		Vec3fSet(root.m_Pivot, root.m_Position);
+		if (!fixedRoot) {
+			Vec3fSet(*(Vec3f*) root.m_V, pRoot->m_StateT1.m_AngularVelocity);
+			Vec3fSet(*(Vec3f*) (root.m_V + 3), pRoot->m_StateT1.m_Velocity);
+		}
+
+		PlaceLinks();
+		FindVelocities();
+		WriteBodies();
+	}
+
+	bool Articulation :: Contains(uint32 id) const
+	{
+		for (int i = 0; i < (int) m_Links.size(); ++i) {
+			if (m_Links[i].m_BodyId == id) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool Articulation :: Ready() const
+	{
+		if (!m_Active) {
+			return false;
+		}
+		for (int i = 0; i < (int) m_Links.size(); ++i) {
+			if (!m_Links[i].m_pBody->GetActive()) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/*
+		Stepping the joints explicitly gains energy when they turn far in one step, as the end of
+		a long chain does when it whips around, so the step is limited to turn no joint more than
+		kMaxJointTurn; it is the joints' own rates that matter, not the speed of the links.
+	 */
+
+	Real Articulation :: StableTimeStep() const
+	{
+		Real fastest = k0;
+		for (int i = 1; i < (int) m_Links.size(); ++i) {
+			const ArticulationLink& link = m_Links[i];
+			if (link.m_Kind == kJ_Prismatic) {
+				continue;
+			}
+			Real rate = link.m_Kind == kJ_Spherical ? Vec3fLength(*(const Vec3f*) link.m_QDot) : Abs(link.m_QDot[0]);
+			fastest = rate > fastest ? rate : fastest;
+		}
+		return fastest > k0 ? kMaxJointTurn / fastest : Real(1.0e30f);
+	}
+
+	void Articulation :: Release()
+	{
+		for (int i = 0; i < (int) m_Links.size(); ++i) {
+			ArticulationLink& link = m_Links[i];
+			link.m_pBody->m_pArticulation = 0;
+			link.m_pBody->SetTranslatable(link.m_WasTranslatable);
+			link.m_pBody->SetSpinnable(link.m_WasSpinnable);
+		}
+		m_Links.clear();
+	}
+
+	/// find each link's pose from its parent's and its joint's, and its joint's motion subspace
+	void Articulation :: PlaceLinks()
+	{
+		for (int i = 1; i < (int) m_Links.size(); ++i) {
+			ArticulationLink& link = m_Links[i];
+			const ArticulationLink& up = m_Links[link.m_Parent];
+
+			Vec3f offset;
+			Rotate(offset, up.m_Orientation, link.m_PivotInParent);
+			Vec3fAdd(link.m_Pivot, up.m_Position, offset);
+
+			Quaternion relative;
+			if (link.m_Kind == kJ_Revolute) {
+				Quaternion hinge;
+				Real s = Sin(kHalf * link.m_Q);
+				hinge[0] = s * link.m_Axis[0];
+				hinge[1] = s * link.m_Axis[1];
+				hinge[2] = s * link.m_Axis[2];
+				hinge[3] = Cos(kHalf * link.m_Q);
+				QuatMultiply(relative, link.m_RestOrientation, hinge);
+			}
+			else if (link.m_Kind == kJ_Prismatic) {
+				QuatSet(relative, link.m_RestOrientation);
+			}
+			else {
+				QuatSet(relative, link.m_JointOrientation);
+			}
+			QuatMultiply(link.m_Orientation, up.m_Orientation, relative);
+
+			Vec3f axis;
+			Rotate(axis, link.m_Orientation, link.m_Axis);
+			if (link.m_Kind == kJ_Prismatic) {
+				Vec3fMultiplyAccumulate(link.m_Pivot, link.m_Q, axis);
+			}
+			Rotate(offset, link.m_Orientation, link.m_PivotInChild);
+			Vec3fSubtract(link.m_Position, link.m_Pivot, offset);
+			Vec3fSubtract(link.m_FromParent, link.m_Position, up.m_Position);
+
+			// a hinge turns about a line through the pivot, a slide only translates, a ball turns about each of the link's axes
+			Real* pS = link.m_S;
+			Vec3f lever;
+			Vec3fSet(lever, offset);
+			Vec3fNegate(lever);
+			if (link.m_Kind == kJ_Revolute) {
+				Vec3fSet(*(Vec3f*) pS, axis);
+				Vec3fCross(*(Vec3f*) (pS + 3), axis, lever);
+			}
+			else if (link.m_Kind == kJ_Prismatic) {
+				Vec3fZero(*(Vec3f*) pS);
+				Vec3fSet(*(Vec3f*) (pS + 3), axis);
+			}
+			else {
+				for (int d = 0; d < 3; ++d) {
+					Vec3f unit;
+					Vec3fZero(unit);
+					unit[d] = k1;
+					Rotate(*(Vec3f*) (pS + d * 6), link.m_Orientation, unit);
+					Vec3fCross(*(Vec3f*) (pS + d * 6 + 3), *(Vec3f*) (pS + d * 6), lever);
+				}
+			}
+		}
+	}
+
+	/// find each link's spatial velocity, velocity product acceleration, and the velocity of its center
+	void Articulation :: FindVelocities()
+	{
+		ArticulationLink& root = m_Links[0];
+		if (m_FixedRoot) {
+			for (int j = 0; j < 6; ++j) {
+				root.m_V[j] = k0;
+			}
+		}
+		Vec3fSet(root.m_Velocity, *(Vec3f*) (root.m_V + 3));
+
+		for (int i = 1; i < (int) m_Links.size(); ++i) {
+			ArticulationLink& link = m_Links[i];
+			const ArticulationLink& up = m_Links[link.m_Parent];
+			Real joint[6];
+			int j;
+			ShiftMotion(link.m_V, link.m_FromParent, up.m_V);
+			for (j = 0; j < 6; ++j) {
+				joint[j] = k0;
+				for (int d = 0; d < link.m_Dofs; ++d) {
+					joint[j] += link.m_S[d * 6 + j] * link.m_QDot[d];
+				}
+				link.m_V[j] += joint[j];
+			}
+			CrossMotion(link.m_C, link.m_V, joint);
+			Vec3fSet(link.m_Velocity, *(Vec3f*) (link.m_V + 3));
+		}
+	}
+
+	/// copy the links' placement into their bodies' states
+	void Articulation :: WriteBodies()
+	{
+		for (int i = 0; i < (int) m_Links.size(); ++i) {
+			ArticulationLink& link = m_Links[i];
+			RigidBody* pBody = link.m_pBody;
+			Vec3fSet(pBody->m_StateT1.m_Position, link.m_Position);
+			QuatSet(pBody->m_StateT1.m_Orientation, link.m_Orientation);
+			Vec3fSet(pBody->m_StateT1.m_Velocity, link.m_Velocity);
+			Vec3fSet(pBody->m_StateT1.m_AngularVelocity, *(Vec3f*) link.m_V);
+
+			// the body's momentum must give back the spin, see SpinFromMomentum
+			bool sphere = pBody->GetInertialKind() == kI_Sphere;
+			for (int j = 0; j < 3; ++j) {
+				Real itd = pBody->m_InertiaITD[sphere ? 0 : j];
+				pBody->m_StateT1.m_AngularMomentum[j] = itd > k0 ? link.m_V[j] / itd : k0;
+			}
+		}
+	}
+
+	/*
+		The inward pass folds each link into its parent, leaves first, which is why a parent's
+		index is always lower than its children's. Without bias, only the articulated inertias
+		and the joint terms that depend on them are found, for SolveImpulses.
+	 */
+
+	void Articulation :: BuildInertias(bool bias)
+	{
+		int count = (int) m_Links.size();
+		int i, j, r, c, d;
+
+		for (i = 0; i < count; ++i) {
+			ArticulationLink& link = m_Links[i];
+			BodyInertia(link.m_IA, link.m_pBody);
+			if (!bias) {
+				continue;
+			}
+
+			// bias force, the velocity product less the external forces and gravity on the link
+			Real momentum[6], external[6];
+			RigidBody* pBody = link.m_pBody;
+			Multiply6(momentum, link.m_IA, link.m_V);
+			CrossForce(link.m_PA, link.m_V, momentum);
+
+			Vec3f* pForce = (Vec3f*) (external + 3);
+			Vec3fSet(*pForce, pBody->m_Acc.m_Force);
+			if (pBody->GetGravity()) {
+				Vec3fMultiplyAccumulate(*pForce, pBody->GetRawMass(), m_Gravity);
+			}
+			Vec3fSet(*(Vec3f*) external, pBody->m_Acc.m_Torque);
+			for (j = 0; j < 6; ++j) {
+				link.m_PA[j] -= external[j];
+			}
+		}
+
+		for (i = count - 1; i > 0; --i) {
+			ArticulationLink& link = m_Links[i];
+			ArticulationLink& up = m_Links[link.m_Parent];
+			int dofs = link.m_Dofs;
+
+			Real D[kMaxJointDofs * kMaxJointDofs];
+			for (d = 0; d < dofs; ++d) {
+				Multiply6(link.m_U + d * 6, link.m_IA, link.m_S + d * 6);
+			}
+			for (r = 0; r < dofs; ++r) {
+				for (c = 0; c < dofs; ++c) {
+					Real sum = k0;
+					for (j = 0; j < 6; ++j) {
+						sum += link.m_S[r * 6 + j] * link.m_U[c * 6 + j];
+					}
+					D[r * dofs + c] = sum;
+				}
+			}
+			Invert(link.m_DInv, D, dofs);
+
+			// U D^-1, one column per degree of freedom
+			Real UD[6 * kMaxJointDofs];
+			for (c = 0; c < dofs; ++c) {
+				for (j = 0; j < 6; ++j) {
+					Real sum = k0;
+					for (d = 0; d < dofs; ++d) {
+						sum += link.m_U[d * 6 + j] * link.m_DInv[d * dofs + c];
+					}
+					UD[c * 6 + j] = sum;
+				}
+			}
+
+			// what the parent feels through the joint: IA - U D^-1 U'
+			Real Ia[36];
+			for (r = 0; r < 6; ++r) {
+				for (c = 0; c < 6; ++c) {
+					Real sum = link.m_IA[r * 6 + c];
+					for (d = 0; d < dofs; ++d) {
+						sum -= UD[d * 6 + r] * link.m_U[d * 6 + c];
+					}
+					Ia[r * 6 + c] = sum;
+				}
+			}
+			AccumulateInertia(up.m_IA, link.m_FromParent, Ia);
+			if (!bias) {
+				continue;
+			}
+
+			// the joint force, here only damping, less the bias force's share
+			for (d = 0; d < dofs; ++d) {
+				Real sum = -m_Damping * link.m_QDot[d];
+				for (j = 0; j < 6; ++j) {
+					sum -= link.m_S[d * 6 + j] * link.m_PA[j];
+				}
+				link.m_Tau[d] = sum;
+			}
+			Real pa[6], shifted[6];
+			Multiply6(pa, Ia, link.m_C);
+			for (j = 0; j < 6; ++j) {
+				pa[j] += link.m_PA[j];
+				for (d = 0; d < dofs; ++d) {
+					pa[j] += UD[d * 6 + j] * link.m_Tau[d];
+				}
+			}
+			ShiftForce(shifted, link.m_FromParent, pa);
+			for (j = 0; j < 6; ++j) {
+				up.m_PA[j] += shifted[j];
+			}
+		}
+
+		if (!m_FixedRoot) {
+			Invert(m_RootInverse, m_Links[0].m_IA, 6);
+		}
+	}
+
+	/// the outward pass; with bias, the joint accelerations, without, the response to impulses
+	void Articulation :: SolveAccelerations(bool bias)
+	{
+		ArticulationLink& root = m_Links[0];
+		int j, d;
+		if (m_FixedRoot) {
+			for (j = 0; j < 6; ++j) {
+				root.m_A[j] = k0;
+			}
+		}
+		else {
+			Multiply6(root.m_A, m_RootInverse, root.m_PA);
+			for (j = 0; j < 6; ++j) {
+				root.m_A[j] = -root.m_A[j];
+			}
+		}
+
+		for (int i = 1; i < (int) m_Links.size(); ++i) {
+			ArticulationLink& link = m_Links[i];
+			const ArticulationLink& up = m_Links[link.m_Parent];
+			int dofs = link.m_Dofs;
+
+			Real a[6];
+			ShiftMotion(a, link.m_FromParent, up.m_A);
+			if (bias) {
+				for (j = 0; j < 6; ++j) {
+					a[j] += link.m_C[j];
+				}
+			}
+			Real rhs[kMaxJointDofs];
+			for (d = 0; d < dofs; ++d) {
+				Real sum = link.m_Tau[d];
+				for (j = 0; j < 6; ++j) {
+					sum -= link.m_U[d * 6 + j] * a[j];
+				}
+				rhs[d] = sum;
+			}
+			for (d = 0; d < dofs; ++d) {
+				Real sum = k0;
+				for (int e = 0; e < dofs; ++e) {
+					sum += link.m_DInv[d * dofs + e] * rhs[e];
+				}
+				link.m_Response[d] = sum;
+			}
+			for (j = 0; j < 6; ++j) {
+				Real sum = a[j];
+				for (d = 0; d < dofs; ++d) {
+					sum += link.m_S[d * 6 + j] * link.m_Response[d];
+				}
+				link.m_A[j] = sum;
+			}
+		}
+	}
+
+	void Articulation :: Step(Real dt, const Vec3f gravity)
+	{
+		if (m_Links.empty()) {
+			return;
+		}
+		int count = (int) m_Links.size();
+		int i, d;
+
+		Vec3fSet(m_Gravity, gravity);
+		PlaceLinks();
+		FindVelocities();
+		BuildInertias(true);
+		SolveAccelerations(true);
+
+		// semi-implicit Euler: the velocities first, then the positions move with the new velocities;
+		// the root's spatial acceleration is about where its center is, so the center also turns
+		// its velocity as it moves on
+		ArticulationLink& root = m_Links[0];
+		if (!m_FixedRoot) {
+			Vec3f turn;
+			Vec3fCross(turn, *(Vec3f*) root.m_V, *(Vec3f*) (root.m_V + 3));
+			Vec3fMultiplyAccumulate(*(Vec3f*) root.m_V, dt, *(Vec3f*) root.m_A);
+			Vec3fAdd(*(Vec3f*) (root.m_A + 3), turn);
+			Vec3fMultiplyAccumulate(*(Vec3f*) (root.m_V + 3), dt, *(Vec3f*) (root.m_A + 3));
+			MoveRoot(root.m_V, dt);
+		}
+		for (i = 1; i < count; ++i) {
+			ArticulationLink& link = m_Links[i];
+			for (d = 0; d < link.m_Dofs; ++d) {
+				link.m_QDot[d] += dt * link.m_Response[d];
+			}
+			MoveJoint(link, link.m_QDot, dt);
+		}
+
+		PlaceLinks();
+		FindVelocities();
+		WriteBodies();
+
+		for (i = 0; i < count; ++i) {
+			m_Links[i].m_pBody->m_Acc.Clear();
+		}
+	}
+
+	/// move the free root by a spatial motion over dt
+	void Articulation :: MoveRoot(const Real* pMotion, Real dt)
+	{
+		ArticulationLink& root = m_Links[0];
+		Vec3fMultiplyAccumulate(root.m_Position, dt, *(const Vec3f*) (pMotion + 3));
+		QuatInputAngularVelocity(root.m_Orientation, dt, root.m_Orientation, *(const Vec3f*) pMotion);
+	}
+
+	/// move a joint by its rates over dt; a spherical joint's rates are an angular velocity in the link's frame
+	void Articulation :: MoveJoint(ArticulationLink& link, const Real* pRates, Real dt)
+	{
+		if (link.m_Kind == kJ_Spherical) {
+			Vec3f spin;
+			Rotate(spin, link.m_JointOrientation, *(const Vec3f*) pRates);
+			QuatInputAngularVelocity(link.m_JointOrientation, dt, link.m_JointOrientation, spin);
+		}
+		else {
+			link.m_Q += dt * pRates[0];
+		}
+	}
+
+	/// find how the joints respond to a linear impulse through the center of each link, from m_Impulses
+	void Articulation :: SolveImpulses()
+	{
+		int count = (int) m_Links.size();
+		int i, j, d;
+		for (i = 0; i < count; ++i) {
+			Real* pPA = m_Links[i].m_PA;
+			Vec3fZero(*(Vec3f*) pPA);
+			Vec3fSet(*(Vec3f*) (pPA + 3), *(Vec3f*) &m_Impulses[i * 3]);
+			Vec3fNegate(*(Vec3f*) (pPA + 3));
+		}
+
+		for (i = count - 1; i > 0; --i) {
+			ArticulationLink& link = m_Links[i];
+			ArticulationLink& up = m_Links[link.m_Parent];
+			int dofs = link.m_Dofs;
+
+			Real w[kMaxJointDofs];
+			for (d = 0; d < dofs; ++d) {
+				Real sum = k0;
+				for (j = 0; j < 6; ++j) {
+					sum -= link.m_S[d * 6 + j] * link.m_PA[j];
+				}
+				link.m_Tau[d] = sum;
+			}
+			for (d = 0; d < dofs; ++d) {
+				Real sum = k0;
+				for (int e = 0; e < dofs; ++e) {
+					sum += link.m_DInv[d * dofs + e] * link.m_Tau[e];
+				}
+				w[d] = sum;
+			}
+			Real pa[6], shifted[6];
+			for (j = 0; j < 6; ++j) {
+				pa[j] = link.m_PA[j];
+				for (d = 0; d < dofs; ++d) {
+					pa[j] += link.m_U[d * 6 + j] * w[d];
+				}
+			}
+			ShiftForce(shifted, link.m_FromParent, pa);
+			for (j = 0; j < 6; ++j) {
+				up.m_PA[j] += shifted[j];
+			}
+		}
+
+		SolveAccelerations(false);
+	}
+
+	/// add the response to the last impulses to the joint velocities, or to the joint positions
+	void Articulation :: ApplyResponse(bool positions)
+	{
+		ArticulationLink& root = m_Links[0];
+		if (!m_FixedRoot) {
+			if (positions) {
+				MoveRoot(root.m_A, k1);
+			}
+			else {
+				for (int j = 0; j < 6; ++j) {
+					root.m_V[j] += root.m_A[j];
+				}
+			}
+		}
+		for (int i = 1; i < (int) m_Links.size(); ++i) {
+			ArticulationLink& link = m_Links[i];
+			if (positions) {
+				MoveJoint(link, link.m_Response, k1);
+			}
+			else {
+				for (int d = 0; d < link.m_Dofs; ++d) {
+					link.m_QDot[d] += link.m_Response[d];
+				}
+			}
+		}
+	}
+
+	/*
+		A contact's impulse on a free sphere passes through its center, and is its mass times
+		the change of its velocity, so that is what each link's change is taken to be. Through
+		the whole articulation, a link is harder to move than the free body the contact took it
+		for, so an impulse moves it less than the contact meant; what remains is found again in
+		the next step. Spin given to the links is dropped, which loses nothing for spheres.
+	 */
+
+	void Articulation :: Absorb()
+	{
+		if (m_Links.empty()) {
+			return;
+		}
+		int count = (int) m_Links.size();
+		int i;
+		bool built = false;
+
+		m_Impulses.assign(count * 3, k0);
+		for (int pass = 0; pass < 2; ++pass) {
+			bool positions = pass == 1;
+			bool changed = false;
+			for (i = m_FixedRoot ? 1 : 0; i < count; ++i) {
+				const ArticulationLink& link = m_Links[i];
+				const RigidBody* pBody = link.m_pBody;
+				Vec3f& impulse = *(Vec3f*) &m_Impulses[i * 3];
+				if (positions) {
+					Vec3fSubtract(impulse, pBody->m_StateT1.m_Position, link.m_Position);
+				}
+				else {
+					Vec3fSubtract(impulse, pBody->m_StateT1.m_Velocity, link.m_Velocity);
+				}
+				if (Vec3fDot(impulse, impulse) > kAbsorbEpsilon) {
+					changed = true;
+				}
+				Vec3fScale(impulse, pBody->GetRawMass());
+			}
+			if (!changed) {
+				continue;
+			}
+
+			if (!built) {
+				BuildInertias(false);
+				built = true;
+			}
+			SolveImpulses();
+			ApplyResponse(positions);
+		}
+
+		PlaceLinks();
+		FindVelocities();
+		WriteBodies();
+	}
+
+}	// end namespace Physics
@@ -0,0 +1,175 @@
+
+/** @file Articulation.h
+
+	an internal implementation file, trees of rigid bodies joined by revolute, prismatic and spherical joints
+ */
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#ifndef _ARTICULATION_H_
+#define _ARTICULATION_H_
+
+#include <vector>
+
+#include "PhysicsEngineDef.h"
+#include "PMath.h"
+
+namespace Physics {
+
+	class RigidBody;
+
+	/// most degrees of freedom of one joint; a spherical joint has three
+	static const int kMaxJointDofs = 3;
+
+	/** @class	ArticulationLink
+		@brief	One body of an articulation, and the joint that joins it to its parent
+
+		The spatial quantities are 6-vectors, angular part first, and 6x6 matrices stored by row,
+		all along the world axes, about the link's own center.
+	 */
+
+	class ArticulationLink
+	{
+	public:
+		RigidBody*			m_pBody;
+		uint32				m_BodyId;
+		int					m_Parent;				//!< index of the parent link, always lower; -1 for the root
+		EJointKind			m_Kind;
+		int					m_Dofs;					//!< 1 for revolute and prismatic joints, 3 for spherical; 0 for the root
+		PMath::Vec3f		m_PivotInParent;		//!< the joint, from the parent's center, in the parent's frame
+		PMath::Vec3f		m_PivotInChild;			//!< the joint, from this link's center, in its frame
+		PMath::Vec3f		m_Axis;					//!< hinge or slide, in this link's frame
+		PMath::Quaternion	m_RestOrientation;		//!< of this link relative to its parent, as joined
+		PMath::Quaternion	m_JointOrientation;		//!< of a spherical joint, this link relative to its parent
+		Real				m_Q;					//!< a revolute joint's angle, or a prismatic joint's slide
+		Real				m_QDot[kMaxJointDofs];	//!< joint velocity; a spherical joint's is an angular velocity in this link's frame
+		bool				m_WasTranslatable;		//!< the body's flags before it was joined, given back by Release
+		bool				m_WasSpinnable;
+
+		// where the articulation last placed the link, to see what contacts and constraints changed since
+		PMath::Vec3f		m_Position;
+		PMath::Quaternion	m_Orientation;
+		PMath::Vec3f		m_Velocity;
+		PMath::Vec3f		m_Pivot;				//!< the joint, in the world
+		PMath::Vec3f		m_FromParent;			//!< from the parent's center to this link's
+
+		// the terms of the articulated body algorithm
+		Real				m_S[6 * kMaxJointDofs];	//!< motion subspace, one column per degree of freedom
+		Real				m_V[6];					//!< spatial velocity
+		Real				m_C[6];					//!< velocity product acceleration
+		Real				m_IA[36];				//!< articulated inertia
+		Real				m_PA[6];				//!< articulated bias force
+		Real				m_U[6 * kMaxJointDofs];	//!< m_IA * m_S
+		Real				m_DInv[kMaxJointDofs * kMaxJointDofs];	//!< (m_S' * m_U) inverse
+		Real				m_Tau[kMaxJointDofs];	//!< joint force, less the bias force's share
+		Real				m_A[6];					//!< spatial acceleration, or velocity change from impulses
+		Real				m_Response[kMaxJointDofs];	//!< joint acceleration, or joint velocity change from impulses
+	};
+
+	/** @class	Articulation
+		@brief	A tree of rigid bodies joined by revolute, prismatic and spherical joints
+
+		The links are stepped in joint coordinates by Featherstone's articulated body algorithm:
+		one pass out from the root finds the links' velocities, one pass in folds each subtree
+		into the articulated inertia its parent feels through the joint, and one pass out finds
+		the joint accelerations. Every step costs time linear in the number of links, and the
+		joints can't stretch, however long the time step. The root is either fixed, or a free
+		body with six degrees of freedom. Joint velocities are integrated before positions, by
+		semi-implicit Euler, and the links are then placed from the joint positions.
+
+		The links remain bodies of the engine. Their springs, force fields and the application's
+		forces are gathered into their accumulators as usual, and the articulation takes them
+		from there. Contacts and distance constraints change the links' states as if they were
+		free; Absorb turns each link's change of velocity back into the impulse that made it,
+		and applies all of them to the articulation at once, by one more pass in and out without
+		the velocity terms. Changes of position are taken in the same way, as if they were
+		impulses over unit time. The links are then placed again.
+
+		Inertia tensors are diagonal in world space, as for every body in the engine.
+	 */
+
+	class Articulation
+	{
+	public:
+		Articulation();
+
+		/// start the tree at pRoot, where it is; a fixed root is held there, and made immovable so contacts push against it
+		void			SetRoot(uint32 id, RigidBody* pRoot, bool fixed);
+
+		/// join pChild, made movable, to the link holding pParent at a world pivot; axis is a world direction. @return false if pParent isn't a link
+		bool			AddLink(uint32 id, RigidBody* pChild, RigidBody* pParent, EJointKind kind, const PMath::Vec3f pivot, const PMath::Vec3f axis);
+
+		/// become a copy of count links as GetLink gave them, joined and moving as they were, on the bodies given, and place them there
+		void			Load(const ArticulationLink* pLinks, RigidBody* const* ppBodies, const uint32* pIds, int count, bool fixedRoot);
+		/// @return true if the body is one of the links
+		bool			Contains(uint32 id) const;
+
+		/// @return true if every link is active, so the articulation can be stepped
+		bool			Ready() const;
+
+		/// @return the longest step that turns no joint too far at the rates they have now
+		Real			StableTimeStep() const;
+
+		/// advance the joints by dt under the links' accumulated forces and gravity, and place the links
+		void			Step(Real dt, const PMath::Vec3f gravity);
+
+		/// take in the changes contacts and constraints made to the links since they were placed
+		void			Absorb();
+
+		/// let the links go free, as the articulation is removed, with the translatable and spinnable flags they had before
+		void			Release();
+
+		int				GetLinkCount() const			{ return (int) m_Links.size(); }
+		RigidBody*		GetLinkBody(int i) const		{ return m_Links[i].m_pBody; }
+		const ArticulationLink&	GetLink(int i) const	{ return m_Links[i]; }	///< its joint and joint state, to be saved
+		bool			GetFixedRoot() const			{ return m_FixedRoot; }
+		void			SetLinkBody(int i, RigidBody* pBody)	{ m_Links[i].m_pBody = pBody; }	///< for a copy of the articulation in another engine
+
+		bool			m_Active;
+		Real			m_Damping;				//!< joint force opposing each joint's velocity, per unit of velocity
+
+	protected:
+		void			PlaceLinks();
+		void			FindVelocities();
+		void			WriteBodies();
+		void			BuildInertias(bool bias);
+		void			SolveAccelerations(bool bias);
+		void			MoveRoot(const Real* pMotion, Real dt);
+		void			MoveJoint(ArticulationLink& link, const Real* pRates, Real dt);
+		void			SolveImpulses();
+		void			ApplyResponse(bool positions);
+
+		std::vector<ArticulationLink>	m_Links;
+		bool			m_FixedRoot;
+		Real			m_RootInverse[36];		//!< of the floating root's articulated inertia
+		PMath::Vec3f	m_Gravity;				//!< of the step in progress
+
+		std::vector<Real>				m_Impulses;			//!< through each link's center, during Absorb
+	};
+
+}	// end Physics namespace
+
+#endif
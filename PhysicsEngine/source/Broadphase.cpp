@@ -0,0 +1,733 @@
+
+/** @file Broadphase.cpp
+	@brief	bounding volume hierarchy, pair finding and spatial queries */
+
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#include <algorithm>
+
+#include "Broadphase.h"
+#include "CollisionEngineDef.h"
+#include "RigidBody.h"
+
+using namespace PMath;
+using namespace Collision;
+
+namespace Physics {
+
+	static const Real kFar = Real(1.0e30f);			// beyond the bounds of any world
+
+	/// orders entry indices by the center of their bounds along one axis
+	class CenterLess
+	{
+	public:
+		CenterLess(const Broadphase::Entry* pEntries, int axis) : m_pEntries(pEntries), m_Axis(axis) { }
+
+		bool operator()(int a, int b) const {
+			const Broadphase::Entry& ea = m_pEntries[a];
+			const Broadphase::Entry& eb = m_pEntries[b];
+			return ea.m_Min[m_Axis] + ea.m_Max[m_Axis] < eb.m_Min[m_Axis] + eb.m_Max[m_Axis];
+		}
+
+		const Broadphase::Entry*	m_pEntries;
+		int							m_Axis;
+	};
+
+	/// orders entries by id
+	static bool IdLess(const Broadphase::Entry& entry, uint32 id)
+	{
+		return entry.m_Id < id;
+	}
+
+	/// the bounds of the body's geometry, swept from the start to the end of the step
+	static void SetBounds(Broadphase::Entry& entry)
+	{
+		RigidBody* pBody = entry.m_pBody;
+		entry.m_Unbounded = false;
+
+		switch (pBody->m_pCollideGeo->GetKind()) {
+		case kC_Sphere:
+			{
+				// a fast sphere's bounds reach on to where it would be after its look ahead
+				Real radius = ((Collision::Sphere*) pBody->m_pCollideGeo)->m_Radius;
+				for (int axis = 0; axis < 3; ++axis) {
+					Real p0 = pBody->m_StateT0.m_Position[axis];
+					Real p1 = pBody->m_StateT1.m_Position[axis];
+					Real p2 = p1 + pBody->m_StateT1.m_Velocity[axis] * pBody->m_LookAhead;
+					Real lo = p0 < p1 ? p0 : p1;
+					Real hi = p0 > p1 ? p0 : p1;
+					entry.m_Min[axis] = (p2 < lo ? p2 : lo) - radius;
+					entry.m_Max[axis] = (p2 > hi ? p2 : hi) + radius;
+				}
+			}
+			break;
+
+		case kC_Heightfield:
+			{
+				// the terrain is solid all the way down
+				Collision::Heightfield* pField = (Collision::Heightfield*) pBody->m_pCollideGeo;
+				entry.m_Min[0] = pField->m_Origin[0];
+				entry.m_Min[1] = pField->m_Origin[1];
+				entry.m_Min[2] = -kFar;
+				entry.m_Max[0] = pField->m_Origin[0] + Real(pField->m_Columns - 1) * pField->m_CellSize;
+				entry.m_Max[1] = pField->m_Origin[1] + Real(pField->m_Rows - 1) * pField->m_CellSize;
+				entry.m_Max[2] = pField->m_MaxHeight;
+			}
+			break;
+
+		default:
+			entry.m_Unbounded = true;
+			for (int axis = 0; axis < 3; ++axis) {
+				entry.m_Min[axis] = -kFar;
+				entry.m_Max[axis] = kFar;
+			}
+			break;
+		}
+	}
+
+	/// grow the bounds pMin, pMax to hold the other bounds
+	static void GrowBounds(Real* pMin, Real* pMax, const Real* pOtherMin, const Real* pOtherMax)
+	{
+		for (int axis = 0; axis < 3; ++axis) {
+			pMin[axis] = pOtherMin[axis] < pMin[axis] ? pOtherMin[axis] : pMin[axis];
+			pMax[axis] = pOtherMax[axis] > pMax[axis] ? pOtherMax[axis] : pMax[axis];
+		}
+	}
+
+	static void EmptyBounds(Real* pMin, Real* pMax)
+	{
+		for (int axis = 0; axis < 3; ++axis) {
+			pMin[axis] = kFar;
+			pMax[axis] = -kFar;
+		}
+	}
+
+	/// a unit direction and its reciprocal, without infinities. @return false for a zero direction
+	static bool RayDirection(const Vec3f dir, Vec3f& unitDir, Vec3f& invDir)
+	{
+		Real length = Vec3fLength(dir);
+		if (length < kEps) {
+			return false;
+		}
+		Vec3fSetScaled(unitDir, k1 / length, dir);
+		for (int axis = 0; axis < 3; ++axis) {
+			if (Abs(unitDir[axis]) < kEps) {
+				invDir[axis] = unitDir[axis] < k0 ? -kFar : kFar;
+			}
+			else {
+				invDir[axis] = k1 / unitDir[axis];
+			}
+		}
+		return true;
+	}
+
+	/// slab test. @return true if the ray enters the box before maxT
+	static bool RayHitsBox(const Real* pOrigin, const Real* pInvDir, Real maxT, const Real* pMin, const Real* pMax)
+	{
+		Real tEnter = k0;
+		Real tExit = maxT;
+		for (int axis = 0; axis < 3; ++axis) {
+			Real t0 = (pMin[axis] - pOrigin[axis]) * pInvDir[axis];
+			Real t1 = (pMax[axis] - pOrigin[axis]) * pInvDir[axis];
+			if (t0 > t1) {
+				Real temp = t0;
+				t0 = t1;
+				t1 = temp;
+			}
+			tEnter = t0 > tEnter ? t0 : tEnter;
+			tExit = t1 < tExit ? t1 : tExit;
+			if (tEnter > tExit) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/// exact ray test against the body's geometry at the end of the step; dir is unit length
+	static bool RayCastBody(RigidBody* pBody, const Vec3f origin, const Vec3f dir, Real maxT, Real& t, Vec3f& normal)
+	{
+		switch (pBody->m_pCollideGeo->GetKind()) {
+		case kC_Sphere:
+			{
+				Real radius = ((Collision::Sphere*) pBody->m_pCollideGeo)->m_Radius;
+				Vec3f offset;
+				Vec3fSubtract(offset, origin, pBody->m_StateT1.m_Position);
+				Real b = Vec3fDot(offset, dir);
+				Real c = Vec3fDot(offset, offset) - radius * radius;
+				if (c <= k0) {
+					t = k0;								// the ray starts inside
+					Vec3fSetScaled(normal, kN1, dir);
+					return true;
+				}
+				Real discriminant = b * b - c;
+				if (b > k0 || discriminant < k0) {
+					return false;
+				}
+				t = -b - Sqrt(discriminant);
+				if (t > maxT) {
+					return false;
+				}
+				Vec3fSet(normal, offset);
+				Vec3fMultiplyAccumulate(normal, t, dir);
+				Vec3fScale(normal, k1 / radius);
+			}
+			return true;
+
+		case kC_Plane:
+			{
+				const PMath::Plane& plane = ((Collision::Plane*) pBody->m_pCollideGeo)->m_Plane;
+				Real denom = Vec3fDot(plane.m_Normal, dir);
+				if (Abs(denom) < kEps) {
+					return false;
+				}
+				t = -plane.DistanceToPoint(origin) / denom;
+				if (t < k0 || t > maxT) {
+					return false;
+				}
+				Vec3fSetScaled(normal, denom < k0 ? k1 : kN1, plane.m_Normal);
+			}
+			return true;
+
+		case kC_Heightfield:
+			return ((Collision::Heightfield*) pBody->m_pCollideGeo)->RayCast(origin, dir, maxT, t, normal);
+		}
+		return false;
+	}
+
+	/// exact test of a sphere against the body's geometry; planes and terrain are solid behind their surfaces
+	static bool SphereOverlapsBody(RigidBody* pBody, const Vec3f center, Real radius)
+	{
+		switch (pBody->m_pCollideGeo->GetKind()) {
+		case kC_Sphere:
+			{
+				Real sum = radius + ((Collision::Sphere*) pBody->m_pCollideGeo)->m_Radius;
+				Vec3f offset;
+				Vec3fSubtract(offset, center, pBody->m_StateT1.m_Position);
+				return Vec3fDot(offset, offset) < sum * sum;
+			}
+
+		case kC_Plane:
+			return ((Collision::Plane*) pBody->m_pCollideGeo)->m_Plane.DistanceToPoint(center) < radius;
+
+		case kC_Heightfield:
+			{
+				Vec3f normal;
+				Real depth;
+				return ((Collision::Heightfield*) pBody->m_pCollideGeo)->SphereContact(center, radius, normal, depth);
+			}
+		}
+		return false;
+	}
+
+	/// exact test of a box against the body's geometry
+	static bool BoxOverlapsBody(RigidBody* pBody, const Vec3f boxMin, const Vec3f boxMax)
+	{
+		switch (pBody->m_pCollideGeo->GetKind()) {
+		case kC_Sphere:
+			{
+				Real radius = ((Collision::Sphere*) pBody->m_pCollideGeo)->m_Radius;
+				const Real* pCenter = pBody->m_StateT1.m_Position;
+				Real distSq = k0;
+				for (int axis = 0; axis < 3; ++axis) {
+					Real d = pCenter[axis] < boxMin[axis] ? boxMin[axis] - pCenter[axis] :
+							 pCenter[axis] > boxMax[axis] ? pCenter[axis] - boxMax[axis] : k0;
+					distSq += d * d;
+				}
+				return distSq < radius * radius;
+			}
+
+		case kC_Plane:
+			{
+				// the corner deepest behind the plane
+				const PMath::Plane& plane = ((Collision::Plane*) pBody->m_pCollideGeo)->m_Plane;
+				Vec3f corner;
+				for (int axis = 0; axis < 3; ++axis) {
+					corner[axis] = plane.m_Normal[axis] > k0 ? boxMin[axis] : boxMax[axis];
+				}
+				return plane.DistanceToPoint(corner) < k0;
+			}
+
+		case kC_Heightfield:
+			return ((Collision::Heightfield*) pBody->m_pCollideGeo)->OverlapsBox(boxMin, boxMax);
+		}
+		return false;
+	}
+
+	/// test one ray against an entry, keeping the hit if it is the nearest so far
+	static void NearestHit(const Broadphase::Entry& entry, const Vec3f origin, const Vec3f dir, Real& maxT, RayHit& hit)
+	{
+		Real t;
+		Vec3f normal;
+		if (RayCastBody(entry.m_pBody, origin, dir, maxT, t, normal) && (hit.m_Body == 0 || t < maxT)) {
+			maxT			= t;
+			hit.m_Body		= entry.m_Id;
+			hit.m_Distance	= t;
+			Vec3fSet(hit.m_Position, origin);
+			Vec3fMultiplyAccumulate(hit.m_Position, t, dir);
+			Vec3fSet(hit.m_Normal, normal);
+		}
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	/// keeps the nearest hit of one ray
+	class NearestVisitor
+	{
+	public:
+		NearestVisitor(const Real* pOrigin, const Real* pDir, Real maxT, RayHit& hit) :
+			m_pOrigin(pOrigin), m_pDir(pDir), m_MaxT(maxT), m_Hit(hit) { }
+
+		void operator()(const Broadphase::Entry& entry) {
+			NearestHit(entry, m_pOrigin, m_pDir, m_MaxT, m_Hit);
+		}
+
+		const Real*		m_pOrigin;
+		const Real*		m_pDir;
+		Real			m_MaxT;
+		RayHit&			m_Hit;
+	};
+
+	/// keeps the nearest hits of one ray, sorted, in the caller's buffer
+	class AllHitsVisitor
+	{
+	public:
+		AllHitsVisitor(const Real* pOrigin, const Real* pDir, Real maxT, RayHit* pHits, int maxHits) :
+			m_pOrigin(pOrigin), m_pDir(pDir), m_MaxT(maxT), m_pHits(pHits), m_MaxHits(maxHits), m_Count(0) { }
+
+		void operator()(const Broadphase::Entry& entry) {
+			Real t;
+			Vec3f normal;
+			if (!RayCastBody(entry.m_pBody, m_pOrigin, m_pDir, m_MaxT, t, normal)) {
+				return;
+			}
+
+			// insert in order, dropping the farthest hit if the buffer is full
+			int i = m_Count < m_MaxHits ? m_Count++ : m_MaxHits - 1;
+			for ( ; i > 0 && m_pHits[i - 1].m_Distance > t; --i) {
+				m_pHits[i] = m_pHits[i - 1];
+			}
+			RayHit& hit		= m_pHits[i];
+			hit.m_Body		= entry.m_Id;
+			hit.m_Distance	= t;
+			Vec3fSet(hit.m_Position, m_pOrigin);
+			Vec3fMultiplyAccumulate(hit.m_Position, t, m_pDir);
+			Vec3fSet(hit.m_Normal, normal);
+
+			// once the buffer is full, nothing farther than its last hit can get in
+			if (m_Count == m_MaxHits) {
+				m_MaxT = m_pHits[m_Count - 1].m_Distance;
+			}
+		}
+
+		const Real*		m_pOrigin;
+		const Real*		m_pDir;
+		Real			m_MaxT;
+		RayHit*			m_pHits;
+		int				m_MaxHits;
+		int				m_Count;
+	};
+
+	/// writes the ids of the bodies overlapping a sphere
+	class SphereVisitor
+	{
+	public:
+		SphereVisitor(const Real* pCenter, Real radius, uint32* pBodies, int maxBodies) :
+			m_pCenter(pCenter), m_Radius(radius), m_pBodies(pBodies), m_MaxBodies(maxBodies), m_Count(0) { }
+
+		bool operator()(const Broadphase::Entry& entry) {
+			if (SphereOverlapsBody(entry.m_pBody, m_pCenter, m_Radius)) {
+				m_pBodies[m_Count++] = entry.m_Id;
+			}
+			return m_Count < m_MaxBodies;
+		}
+
+		const Real*		m_pCenter;
+		Real			m_Radius;
+		uint32*			m_pBodies;
+		int				m_MaxBodies;
+		int				m_Count;
+	};
+
+	/// writes the ids of the bodies overlapping a box
+	class BoxVisitor
+	{
+	public:
+		BoxVisitor(const Real* pMin, const Real* pMax, uint32* pBodies, int maxBodies) :
+			m_pMin(pMin), m_pMax(pMax), m_pBodies(pBodies), m_MaxBodies(maxBodies), m_Count(0) { }
+
+		bool operator()(const Broadphase::Entry& entry) {
+			if (BoxOverlapsBody(entry.m_pBody, m_pMin, m_pMax)) {
+				m_pBodies[m_Count++] = entry.m_Id;
+			}
+			return m_Count < m_MaxBodies;
+		}
+
+		const Real*		m_pMin;
+		const Real*		m_pMax;
+		uint32*			m_pBodies;
+		int				m_MaxBodies;
+		int				m_Count;
+	};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	Broadphase :: Broadphase()
+	{
+	}
+
+	void Broadphase :: Begin()
+	{
+		m_Entries.clear();
+		m_Loose.clear();
+		m_Leaves.clear();
+		m_Unbounded.clear();
+		m_Nodes.clear();
+	}
+
+	void Broadphase :: Add(uint32 id, RigidBody* pBody)
+	{
+		if (pBody->m_pCollideGeo == 0) {
+			return;
+		}
+		m_Entries.push_back(Entry());
+		Entry& entry	= m_Entries.back();
+		entry.m_Id		= id;
+		entry.m_pBody	= pBody;
+		SetBounds(entry);
+	}
+
+	void Broadphase :: Build()
+	{
+		m_Loose.clear();
+		m_Leaves.clear();
+		m_Unbounded.clear();
+		m_Nodes.clear();
+
+		for (int i = 0; i < (int) m_Entries.size(); ++i) {
+			if (m_Entries[i].m_Unbounded) {
+				m_Unbounded.push_back(i);
+			}
+			else {
+				m_Leaves.push_back(i);
+			}
+		}
+		if (!m_Leaves.empty()) {
+			BuildNode(0, (int) m_Leaves.size());
+		}
+	}
+
+	int Broadphase :: BuildNode(int first, int count)
+	{
+		int index = (int) m_Nodes.size();
+		m_Nodes.push_back(Node());
+
+		Real nodeMin[3], nodeMax[3], centerMin[3], centerMax[3];
+		EmptyBounds(nodeMin, nodeMax);
+		EmptyBounds(centerMin, centerMax);
+		for (int i = first; i < first + count; ++i) {
+			const Entry& entry = m_Entries[m_Leaves[i]];
+			Real center[3];
+			for (int axis = 0; axis < 3; ++axis) {
+				center[axis] = kHalf * (entry.m_Min[axis] + entry.m_Max[axis]);
+			}
+			GrowBounds(nodeMin, nodeMax, entry.m_Min, entry.m_Max);
+			GrowBounds(centerMin, centerMax, center, center);
+		}
+
+		Node& node = m_Nodes[index];
+		for (int axis = 0; axis < 3; ++axis) {
+			node.m_Min[axis] = nodeMin[axis];
+			node.m_Max[axis] = nodeMax[axis];
+		}
+		node.m_First	= first;
+		node.m_Right	= 0;
+
+		if (count <= kLeafSize) {
+			node.m_Count = count;
+			return index;
+		}
+		node.m_Count = 0;
+
+		int axis = 0;
+		for (int a = 1; a < 3; ++a) {
+			if (centerMax[a] - centerMin[a] > centerMax[axis] - centerMin[axis]) {
+				axis = a;
+			}
+		}
+
+		int half = count / 2;
+		std::nth_element(m_Leaves.begin() + first, m_Leaves.begin() + first + half, m_Leaves.begin() + first + count,
+			CenterLess(&m_Entries[0], axis));
+
+		BuildNode(first, half);							// the left child is the next node
+		int right = BuildNode(first + half, count - half);
+		m_Nodes[index].m_Right = right;					// node may have moved as m_Nodes grew
+		return index;
+	}
+
+	void Broadphase :: Refit()
+	{
+		for (int i = 0; i < (int) m_Entries.size(); ++i) {
+			if (m_Entries[i].m_pBody != 0) {
+				SetBounds(m_Entries[i]);
+			}
+		}
+
+		// children follow their parents, so walking backwards visits them first
+		for (int n = (int) m_Nodes.size() - 1; n >= 0; --n) {
+			Node& node = m_Nodes[n];
+			EmptyBounds(node.m_Min, node.m_Max);
+			if (node.m_Count > 0) {
+				for (int i = node.m_First; i < node.m_First + node.m_Count; ++i) {
+					const Entry& entry = m_Entries[m_Leaves[i]];
+					if (entry.m_pBody != 0) {
+						GrowBounds(node.m_Min, node.m_Max, entry.m_Min, entry.m_Max);
+					}
+				}
+			}
+			else {
+				GrowBounds(node.m_Min, node.m_Max, m_Nodes[n + 1].m_Min, m_Nodes[n + 1].m_Max);
+				GrowBounds(node.m_Min, node.m_Max, m_Nodes[node.m_Right].m_Min, m_Nodes[node.m_Right].m_Max);
+			}
+		}
+	}
+
+	void Broadphase :: Insert(uint32 id, RigidBody* pBody)
+	{
+		if (pBody->m_pCollideGeo == 0) {
+			return;
+		}
+		m_Loose.push_back(Entry());
+		Entry& entry	= m_Loose.back();
+		entry.m_Id		= id;
+		entry.m_pBody	= pBody;
+		SetBounds(entry);
+	}
+
+	void Broadphase :: Moved(uint32 id)
+	{
+		std::vector<Entry>::iterator iter = std::lower_bound(m_Entries.begin(), m_Entries.end(), id, IdLess);
+		if (iter != m_Entries.end() && iter->m_Id == id && iter->m_pBody != 0) {
+			m_Loose.push_back(*iter);
+			iter->m_pBody = 0;
+		}
+	}
+
+	void Broadphase :: Remove(uint32 id)
+	{
+		std::vector<Entry>::iterator iter = std::lower_bound(m_Entries.begin(), m_Entries.end(), id, IdLess);
+		if (iter != m_Entries.end() && iter->m_Id == id) {
+			iter->m_pBody = 0;
+		}
+		for (iter = m_Loose.begin(); iter != m_Loose.end(); ++iter) {
+			if (iter->m_Id == id) {
+				m_Loose.erase(iter);
+				break;
+			}
+		}
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	template <class Visitor>
+	void Broadphase :: RayTraverse(const Real* pOrigin, const Real* pInvDir, Visitor& visitor) const
+	{
+		int i;
+		for (i = 0; i < (int) m_Unbounded.size(); ++i) {
+			const Entry& entry = m_Entries[m_Unbounded[i]];
+			if (entry.m_pBody != 0) {
+				visitor(entry);
+			}
+		}
+		for (i = 0; i < (int) m_Loose.size(); ++i) {
+			visitor(m_Loose[i]);
+		}
+		if (m_Nodes.empty()) {
+			return;
+		}
+
+		int stack[kStackSize];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			int index = stack[--top];
+			const Node& node = m_Nodes[index];
+			if (!RayHitsBox(pOrigin, pInvDir, visitor.m_MaxT, node.m_Min, node.m_Max)) {
+				continue;
+			}
+			if (node.m_Count > 0) {
+				for (i = node.m_First; i < node.m_First + node.m_Count; ++i) {
+					const Entry& entry = m_Entries[m_Leaves[i]];
+					if (entry.m_pBody != 0 && RayHitsBox(pOrigin, pInvDir, visitor.m_MaxT, entry.m_Min, entry.m_Max)) {
+						visitor(entry);
+					}
+				}
+			}
+			else {
+				stack[top++] = node.m_Right;
+				stack[top++] = index + 1;
+			}
+		}
+	}
+
+	bool Broadphase :: RayCast(const Vec3f origin, const Vec3f dir, Real maxDistance, RayHit& hit) const
+	{
+		Vec3f unitDir, invDir;
+		hit.m_Body = 0;
+		if (!RayDirection(dir, unitDir, invDir)) {
+			return false;
+		}
+
+		NearestVisitor visitor(origin, unitDir, maxDistance, hit);
+		RayTraverse(origin, invDir, visitor);
+		return hit.m_Body != 0;
+	}
+
+	int Broadphase :: RayCastAll(const Vec3f origin, const Vec3f dir, Real maxDistance, RayHit* pHits, int maxHits) const
+	{
+		Vec3f unitDir, invDir;
+		if (maxHits <= 0 || !RayDirection(dir, unitDir, invDir)) {
+			return 0;
+		}
+
+		AllHitsVisitor visitor(origin, unitDir, maxDistance, pHits, maxHits);
+		RayTraverse(origin, invDir, visitor);
+		return visitor.m_Count;
+	}
+
+	/*
+		Rays cast together usually start near each other and point the same way, so they tend to
+		visit the same nodes. Each packet walks the hierarchy once, entering a node if any of its
+		rays enters it, so the nodes are fetched once per packet rather than once per ray.
+	 */
+
+	int Broadphase :: RayCastBatch(int count, Vec3f const* pOrigins, Vec3f const* pDirs, Real maxDistance, RayHit* pHits) const
+	{
+		int hits = 0;
+
+		for (int first = 0; first < count; first += kPacketSize) {
+			int size = count - first < kPacketSize ? count - first : kPacketSize;
+			const Vec3f* pOrigin = pOrigins + first;
+			RayHit* pHit = pHits + first;
+
+			Vec3f unitDir[kPacketSize];
+			Vec3f invDir[kPacketSize];
+			Real maxT[kPacketSize];
+			int k, i;
+			for (k = 0; k < size; ++k) {
+				pHit[k].m_Body = 0;
+				maxT[k] = RayDirection(pDirs[first + k], unitDir[k], invDir[k]) ? maxDistance : -k1;
+			}
+
+			for (i = 0; i < (int) m_Unbounded.size(); ++i) {
+				const Entry& entry = m_Entries[m_Unbounded[i]];
+				for (k = 0; k < size && entry.m_pBody != 0; ++k) {
+					if (maxT[k] >= k0) {
+						NearestHit(entry, pOrigin[k], unitDir[k], maxT[k], pHit[k]);
+					}
+				}
+			}
+			for (i = 0; i < (int) m_Loose.size(); ++i) {
+				for (k = 0; k < size; ++k) {
+					if (maxT[k] >= k0) {
+						NearestHit(m_Loose[i], pOrigin[k], unitDir[k], maxT[k], pHit[k]);
+					}
+				}
+			}
+
+			int stack[kStackSize];
+			int top = 0;
+			if (!m_Nodes.empty()) {
+				stack[top++] = 0;
+			}
+			while (top > 0) {
+				int index = stack[--top];
+				const Node& node = m_Nodes[index];
+
+				int mask = 0;
+				for (k = 0; k < size; ++k) {
+					if (maxT[k] >= k0 && RayHitsBox(pOrigin[k], invDir[k], maxT[k], node.m_Min, node.m_Max)) {
+						mask |= 1 << k;
+					}
+				}
+				if (mask == 0) {
+					continue;
+				}
+
+				if (node.m_Count > 0) {
+					for (i = node.m_First; i < node.m_First + node.m_Count; ++i) {
+						const Entry& entry = m_Entries[m_Leaves[i]];
+						if (entry.m_pBody == 0) {
+							continue;
+						}
+						for (k = 0; k < size; ++k) {
+							if ((mask & (1 << k)) != 0 && RayHitsBox(pOrigin[k], invDir[k], maxT[k], entry.m_Min, entry.m_Max)) {
+								NearestHit(entry, pOrigin[k], unitDir[k], maxT[k], pHit[k]);
+							}
+						}
+					}
+				}
+				else {
+					stack[top++] = node.m_Right;
+					stack[top++] = index + 1;
+				}
+			}
+
+			for (k = 0; k < size; ++k) {
+				if (pHit[k].m_Body != 0) {
+					++hits;
+				}
+			}
+		}
+		return hits;
+	}
+
+	int Broadphase :: OverlapSphere(const Vec3f center, Real radius, uint32* pBodies, int maxBodies) const
+	{
+		if (maxBodies <= 0) {
+			return 0;
+		}
+
+		Real boxMin[3] = { center[0] - radius, center[1] - radius, center[2] - radius };
+		Real boxMax[3] = { center[0] + radius, center[1] + radius, center[2] + radius };
+		SphereVisitor visitor(center, radius, pBodies, maxBodies);
+		VisitBox(boxMin, boxMax, visitor);
+		return visitor.m_Count;
+	}
+
+	int Broadphase :: OverlapAABB(const Vec3f boxMin, const Vec3f boxMax, uint32* pBodies, int maxBodies) const
+	{
+		if (maxBodies <= 0) {
+			return 0;
+		}
+
+		BoxVisitor visitor(boxMin, boxMax, pBodies, maxBodies);
+		VisitBox(boxMin, boxMax, visitor);
+		return visitor.m_Count;
+	}
+
+}	// end namespace Physics
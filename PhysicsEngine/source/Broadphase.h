@@ -0,0 +1,243 @@
+
+/** @file Broadphase.h
+
+	an internal implementation file, a bounding volume hierarchy over the bodies' collision geometry
+ */
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#ifndef _BROADPHASE_H_
+#define _BROADPHASE_H_
+
+#include <vector>
+
+#include "PhysicsEngineDef.h"
+
+namespace Physics {
+
+	/** @class	Broadphase
+		@brief	A bounding volume hierarchy over the bodies that have collision geometry
+
+		Every world step the bodies are added in order of increasing id, and Build splits them
+		top down at the median of their centers, along the longest axis, until each leaf holds a
+		few bodies. A sphere's bounds cover its sweep through the step, so the hierarchy finds
+		every pair the swept tests could find. Planes have no bounds; they are kept aside, and
+		visited by every query.
+
+		Between steps the hierarchy answers ray casts and overlap queries. The queries are const
+		and allocate nothing, so any number of threads may run them at once, as long as nothing
+		else calls the engine meanwhile. Bodies added, moved, or removed between steps are kept
+		current without a rebuild: a removed body's entry is disabled, and added or moved bodies
+		are kept in a short loose list that every query tests directly.
+	 */
+
+	class Broadphase
+	{
+	public:
+		/// a body, and the bounds of its geometry over the step
+		class Entry
+		{
+		public:
+			uint32		m_Id;
+			RigidBody*	m_pBody;						///< zero once the body has been removed
+			Real		m_Min[3];
+			Real		m_Max[3];
+			bool		m_Unbounded;					///< planes are tested against everything
+		};
+
+		Broadphase();
+
+		/// forget every body, ready for Add
+		void			Begin();
+
+		/// add a body with collision geometry; bodies must be added in order of increasing id
+		void			Add(uint32 id, RigidBody* pBody);
+
+		/// build the hierarchy over the bodies added since Begin
+		void			Build();
+
+		/// recompute every body's bounds, and the bounds of the nodes above them, without changing the hierarchy
+		void			Refit();
+
+		/// a body was added between steps
+		void			Insert(uint32 id, RigidBody* pBody);
+
+		/// a body was moved, or its geometry resized, between steps
+		void			Moved(uint32 id);
+
+		/// a body is about to be removed
+		void			Remove(uint32 id);
+
+		int				GetEntryCount() const			{ return (int) m_Entries.size(); }
+		const Entry&	GetEntry(int i) const			{ return m_Entries[i]; }
+
+		/**
+		* call visitor(entry) with the index of every entry added since Begin whose bounds overlap
+		* the box, and of every unbounded entry, in no particular order, until it returns false.
+		* The loose list is not visited.
+		*/
+		template <class Visitor>
+		void			Overlap(const Real* pMin, const Real* pMax, Visitor& visitor) const;
+
+		/// call visitor(entry) for every live entry a box may overlap, including the unbounded and loose ones, until it returns false
+		template <class Visitor>
+		void			VisitBox(const Real* pMin, const Real* pMax, Visitor& visitor) const;
+
+		/// the nearest hit within maxDistance of a ray; dir need not be unit length. @return false if nothing was hit
+		bool			RayCast(const PMath::Vec3f origin, const PMath::Vec3f dir, Real maxDistance, RayHit& hit) const;
+
+		/// the nearest maxHits hits, nearest first. @return the number of hits written
+		int				RayCastAll(const PMath::Vec3f origin, const PMath::Vec3f dir, Real maxDistance, RayHit* pHits, int maxHits) const;
+
+		/// the nearest hit of each ray, traced in packets that share the traversal. @return the number of rays that hit
+		int				RayCastBatch(int count, PMath::Vec3f const* pOrigins, PMath::Vec3f const* pDirs, Real maxDistance, RayHit* pHits) const;
+
+		/// the ids of up to maxBodies bodies whose geometry overlaps the sphere. @return the number written
+		int				OverlapSphere(const PMath::Vec3f center, Real radius, uint32* pBodies, int maxBodies) const;
+
+		/// the ids of up to maxBodies bodies whose geometry overlaps the box. @return the number written
+		int				OverlapAABB(const PMath::Vec3f boxMin, const PMath::Vec3f boxMax, uint32* pBodies, int maxBodies) const;
+
+	protected:
+		/// a leaf if m_Count is positive, otherwise its children are the next node and m_Right
+		class Node
+		{
+		public:
+			Real		m_Min[3];
+			Real		m_Max[3];
+			int			m_First;						///< first of the leaf's entries in m_Leaves
+			int			m_Count;
+			int			m_Right;
+		};
+
+		enum { kLeafSize = 4, kStackSize = 64, kPacketSize = 8 };
+
+		/// build the subtree over m_Leaves[first, first + count). @return the index of its root
+		int				BuildNode(int first, int count);
+
+		static bool		BoxesOverlap(const Real* pMinA, const Real* pMaxA, const Real* pMinB, const Real* pMaxB);
+
+		/// call visitor(entry) for every live entry a ray out to visitor.m_MaxT may hit, including the unbounded and loose ones
+		template <class Visitor>
+		void			RayTraverse(const Real* pOrigin, const Real* pInvDir, Visitor& visitor) const;
+
+		std::vector<Entry>	m_Entries;					///< ordered by id
+		std::vector<Entry>	m_Loose;					///< bodies added or moved since the last Build
+		std::vector<int>	m_Leaves;					///< the bounded entries, each leaf's contiguous
+		std::vector<int>	m_Unbounded;
+		std::vector<Node>	m_Nodes;					///< depth first, so every child follows its parent
+	};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	inline bool Broadphase :: BoxesOverlap(const Real* pMinA, const Real* pMaxA, const Real* pMinB, const Real* pMaxB)
+	{
+		return pMinA[0] <= pMaxB[0] && pMaxA[0] >= pMinB[0] &&
+			   pMinA[1] <= pMaxB[1] && pMaxA[1] >= pMinB[1] &&
+			   pMinA[2] <= pMaxB[2] && pMaxA[2] >= pMinB[2];
+	}
+
+	template <class Visitor>
+	void Broadphase :: Overlap(const Real* pMin, const Real* pMax, Visitor& visitor) const
+	{
+		for (int u = 0; u < (int) m_Unbounded.size(); ++u) {
+			if (!visitor(m_Unbounded[u])) {
+				return;
+			}
+		}
+		if (m_Nodes.empty()) {
+			return;
+		}
+
+		int stack[kStackSize];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const Node& node = m_Nodes[stack[--top]];
+			if (!BoxesOverlap(pMin, pMax, node.m_Min, node.m_Max)) {
+				continue;
+			}
+			if (node.m_Count > 0) {
+				for (int i = node.m_First; i < node.m_First + node.m_Count; ++i) {
+					const Entry& entry = m_Entries[m_Leaves[i]];
+					if (BoxesOverlap(pMin, pMax, entry.m_Min, entry.m_Max) && !visitor(m_Leaves[i])) {
+						return;
+					}
+				}
+			}
+			else {
+				stack[top++] = node.m_Right;
+				stack[top++] = (int) (&node - &m_Nodes[0]) + 1;
+			}
+		}
+	}
+
+	template <class Visitor>
+	void Broadphase :: VisitBox(const Real* pMin, const Real* pMax, Visitor& visitor) const
+	{
+		int i;
+		for (i = 0; i < (int) m_Unbounded.size(); ++i) {
+			const Entry& entry = m_Entries[m_Unbounded[i]];
+			if (entry.m_pBody != 0 && !visitor(entry)) {
+				return;
+			}
+		}
+		for (i = 0; i < (int) m_Loose.size(); ++i) {
+			if (!visitor(m_Loose[i])) {
+				return;
+			}
+		}
+		if (m_Nodes.empty()) {
+			return;
+		}
+
+		int stack[kStackSize];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			int index = stack[--top];
+			const Node& node = m_Nodes[index];
+			if (!BoxesOverlap(pMin, pMax, node.m_Min, node.m_Max)) {
+				continue;
+			}
+			if (node.m_Count > 0) {
+				for (i = node.m_First; i < node.m_First + node.m_Count; ++i) {
+					const Entry& entry = m_Entries[m_Leaves[i]];
+					if (entry.m_pBody != 0 && BoxesOverlap(pMin, pMax, entry.m_Min, entry.m_Max) && !visitor(entry)) {
+						return;
+					}
+				}
+			}
+			else {
+				stack[top++] = node.m_Right;
+				stack[top++] = index + 1;
+			}
+		}
+	}
+
+}	// end Physics namespace
+
+#endif
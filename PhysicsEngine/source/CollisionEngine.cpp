@@ -28,9 +28,13 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 ---------------------------------------------------------------------------------------------------
 */
 
+#include <algorithm>
+
 #include "PMath.h"
 #include "RigidBody.h"
 #include "CollisionEngine.h"
+#include "Pool.h"
+#include "MappedFile.h"
 #include "opcode.h"
 
 using namespace PMath;
@@ -39,21 +43,22 @@ using Physics::RigidBody;
 #define ICEMATHS_SPHERE(a, b) IceMaths::Sphere* a = (IceMaths::Sphere*) b;
 namespace Collision {
 
-	Sphere :: Sphere(const Real radius) : m_Radius(radius) {
-		m_pAux = (void*) new IceMaths::Sphere();
-		ICEMATHS_SPHERE(s, m_pAux);
-		s->SetRadius(radius);
+	Sphere :: Sphere(const Real radius) : m_Radius(radius), m_pAux(0) {
 	}
 
 	Sphere :: ~Sphere() { 
-		ICEMATHS_SPHERE(s, m_pAux);
-		delete s;
 	}
 }
 
 
 namespace Collision {
 
+	static const int kNumShapeKinds	= 3;						//!< planes, spheres and heightfields
+	static const int kNumPairKinds	= kNumShapeKinds * kNumShapeKinds;
+	static const int kMaxPairContacts	= 4;					//!< contacts kept per pair of bodies by ReducePairContacts
+	static const int kMaxManifold		= 16;					//!< contacts one test may find for a pair, before they are reduced
+	static const int kBackOuts			= 4;					//!< times a sphere is backed out of the faces of a heightfield
+
 	/** @class Contact
 		@brief records contact parameters
 	 */
@@ -65,14 +70,38 @@ namespace Collision {
 		PMath::Vec3f		m_Position;
 		PMath::Vec3f		m_Normal;
 		Real				m_ContactTime;
-		Real				m_PenetrationDepth;
+		Real				m_PenetrationDepth;	///< how far the bodies overlapped at the start of the step, zero if they didn't
+		uint32				m_Feature;			///< which part of the shapes touched; with the bodies, it names the contact from step to step
+		bool				m_Speculative;		///< the bodies haven't touched, but would within the faster one's look ahead
+		Real				m_Separation;		///< of a speculative contact, the gap between the bodies at the end of the step
 		Physics::RigidBody*	m_pBodyA;
 		Physics::RigidBody*	m_pBodyB;
+		uint32				m_BodyA;			///< the ids of the bodies, for reporting
+		uint32				m_BodyB;
+		int					m_Kinds;			///< the shape kind of body A * kNumShapeKinds + that of body B
+		int					m_Pair;				///< index of the pair it was found for, by TestPairs
 	};
 
 	Contact::Contact() {
 	}
 
+	/// EngineAux holds the pools that collision geometry and contacts are allocated from
+	class EngineAux
+	{
+	public:
+		EngineAux() : m_SpherePool(256), m_PlanePool(16), m_HeightfieldPool(4), m_OpcodeSpherePool(256), m_ContactPool(256), m_HeightfieldBytes(0) { }
+
+		Physics::Pool<Sphere>				m_SpherePool;
+		Physics::Pool<Plane>				m_PlanePool;
+		Physics::Pool<Heightfield>			m_HeightfieldPool;
+		Physics::Pool<IceMaths::Sphere>		m_OpcodeSpherePool;
+		Physics::Pool<Contact>				m_ContactPool;
+		int									m_HeightfieldBytes;		//!< heights copied into memory; mapped heights aren't counted
+
+		std::vector<int>					m_PairOrder;			//!< indices of the pairs TestPairs was given, by kind of pair
+		int									m_BucketStart[kNumPairKinds + 1];
+	};
+
 
 /*
                        ____      _ _ _     _
@@ -88,6 +117,7 @@ namespace Collision {
 
 
 typedef bool (*collfn)(Contact*, RigidBody* pBodyA, RigidBody* pBodyB);
+typedef int  (*manifoldfn)(Contact*, RigidBody* pBodyA, RigidBody* pBodyB);	///< fills up to kMaxManifold contacts, returning how many
 typedef void (*resfn) (Contact*);
 
 
@@ -105,6 +135,10 @@ bool Collide_InfPlane_InfPlane(Contact* pContact, RigidBody* pBodyA, RigidBody*
 		collided = true;
 	}
 
+	pContact->m_ContactTime = k0;
+	pContact->m_PenetrationDepth = k0;
+	pContact->m_Feature = 0;
+	pContact->m_Speculative = false;
 	return collided;
 }
 // cf: www.gamasutra.com/features/19991018/Gomez_1.htm
@@ -124,7 +158,9 @@ bool Collide_InfPlane_Sphere(Contact* pContact, RigidBody* pPlaneBody, RigidBody
 
 	if (PMath::Abs(d0) <= radius) {
 		Vec3fSet(pContact->m_Normal, pPlane->m_Normal);
+		Vec3fSet(pContact->m_Position, c0);
 		pContact->m_ContactTime = k0;
+		pContact->m_PenetrationDepth = radius - PMath::Abs(d0);
 		retval = true;							// not supposed to get here; this engine never allows intersected positions
 	}
 	else if (d0 > radius && d1 < radius) {		// if penetrated this frame
@@ -135,7 +171,24 @@ bool Collide_InfPlane_Sphere(Contact* pContact, RigidBody* pPlaneBody, RigidBody
 		Vec3fAdd(pContact->m_Position, c0, c1);		// calc center of sphere at point of first contact
 		retval = true;
 		pContact->m_ContactTime = u;
+		pContact->m_PenetrationDepth = k0;
+	}
+	else if (d1 > radius && pSphere->m_LookAhead > k0) {
+		// closing on the plane fast enough to cross the gap in the look ahead
+		Real gap = d1 - radius;
+		if (-Vec3fDot(pSphere->m_StateT1.m_Velocity, pPlane->m_Normal) * pSphere->m_LookAhead > gap) {
+			Vec3fSet(pContact->m_Normal, pPlane->m_Normal);
+			Vec3fSet(pContact->m_Position, c1);
+			pContact->m_ContactTime = k1;
+			pContact->m_PenetrationDepth = k0;
+			pContact->m_Feature = 0;
+			pContact->m_Speculative = true;
+			pContact->m_Separation = gap;
+			return true;
+		}
 	}
+	pContact->m_Feature = 0;
+	pContact->m_Speculative = false;
 	return retval;
 }
 
@@ -144,6 +197,104 @@ bool Collide_Sphere___InfPlane(Contact* pContact, RigidBody* pSphere, RigidBody*
 	return Collide_InfPlane_Sphere(pContact, pPlane, pSphere);
 }
 
+// terrain doesn't move, so it can't collide with planes or other terrain
+
+bool Collide_Static___Static(Contact*, RigidBody*, RigidBody*)
+{
+	return false;
+}
+
+// the contact is recorded the same way as Collide_InfPlane_Sphere's, so the sphere is resolved as if against a plane
+
+bool Collide_Heightfield_Sphere(Contact* pContact, RigidBody* pTerrain, RigidBody* pSphere)
+{
+	Collision::Heightfield* pField = (Collision::Heightfield*) pTerrain->m_pCollideGeo;
+	Real radius = ((Collision::Sphere*) pSphere->m_pCollideGeo)->m_Radius;
+
+	Real u;
+	if (!pField->SweepSphere(pSphere->m_StateT0.m_Position, pSphere->m_StateT1.m_Position, radius, u, pContact->m_Normal)) {
+		return false;
+	}
+
+	Vec3f c0, c1;
+	PMath::Vec3fSet(c0, pSphere->m_StateT0.m_Position);
+	PMath::Vec3fSet(c1, pSphere->m_StateT1.m_Position);
+	Vec3fScale(c1, u);
+	Vec3fScale(c0, k1 - u);
+	Vec3fAdd(pContact->m_Position, c0, c1);		// calc center of sphere at point of first contact
+
+	// the sphere started the step touching the terrain, so back it out along the normal, and again if that leaves it in another face
+	Real depth;
+	Vec3f normal;
+	pContact->m_PenetrationDepth = k0;
+	for (int k = 0; u == k0 && k < kBackOuts && pField->SphereContact(pContact->m_Position, radius, normal, depth); ++k) {
+		Vec3fMultiplyAccumulate(pContact->m_Position, depth, normal);
+		if (k == 0) {
+			pContact->m_PenetrationDepth = depth;		// the deepest it was in at the start of the step
+		}
+	}
+
+	// the triangle under the point of contact, numbered as Heightfield::SphereContacts numbers them
+	Real x = (pContact->m_Position[0] - pField->m_Origin[0]) * pField->m_OOCellSize;
+	Real y = (pContact->m_Position[1] - pField->m_Origin[1]) * pField->m_OOCellSize;
+	int i = x > k0 ? (int) x : 0;
+	int j = y > k0 ? (int) y : 0;
+	i = i < pField->m_Columns - 2 ? i : pField->m_Columns - 2;
+	j = j < pField->m_Rows - 2 ? j : pField->m_Rows - 2;
+	int t = x - Real(i) >= y - Real(j) ? 0 : 1;
+	pContact->m_Feature = (uint32) ((j * (pField->m_Columns - 1) + i) * 2 + t);
+	pContact->m_Speculative = false;
+
+	pContact->m_ContactTime = u;
+	return true;
+}
+
+bool Collide_Sphere___Heightfield(Contact* pContact, RigidBody* pSphere, RigidBody* pTerrain)
+{
+	return Collide_Heightfield_Sphere(pContact, pTerrain, pSphere);
+}
+
+/*
+	A sphere that starts the step in the terrain may be in several faces at once, in a hollow or
+	across a ridge. Collide_Heightfield_Sphere backs it out of all of them, and each face it was
+	in gets a contact of its own, with the face's normal and depth. They share the backed out
+	center, so resolving each against its face as against a plane moves the sphere to the same
+	place every time, and only turns its velocity out of each face in turn.
+ */
+
+int Manifold_Heightfield_Sphere(Contact* pContacts, RigidBody* pTerrain, RigidBody* pSphere)
+{
+	if (!Collide_Heightfield_Sphere(pContacts, pTerrain, pSphere)) {
+		return 0;
+	}
+	if (pContacts->m_ContactTime > k0) {
+		return 1;								// swept into the terrain, it first touched at one point
+	}
+
+	Collision::Heightfield* pField = (Collision::Heightfield*) pTerrain->m_pCollideGeo;
+	Real radius = ((Collision::Sphere*) pSphere->m_pCollideGeo)->m_Radius;
+	Vec3f normals[kMaxManifold];
+	Real depths[kMaxManifold];
+	uint32 triangles[kMaxManifold];
+	int count = pField->SphereContacts(pSphere->m_StateT0.m_Position, radius, normals, depths, triangles, kMaxManifold);
+	if (count < 2) {
+		return 1;
+	}
+
+	for (int i = 0; i < count; ++i) {
+		pContacts[i] = pContacts[0];
+		Vec3fSet(pContacts[i].m_Normal, normals[i]);
+		pContacts[i].m_PenetrationDepth = depths[i];
+		pContacts[i].m_Feature = triangles[i];
+	}
+	return count;
+}
+
+int Manifold_Sphere___Heightfield(Contact* pContacts, RigidBody* pSphere, RigidBody* pTerrain)
+{
+	return Manifold_Heightfield_Sphere(pContacts, pTerrain, pSphere);
+}
+
 // Quadratic Formula from http://www.gamasutra.com/features/19991018/Gomez_2.htm
 // returns true if both roots are real
 
@@ -213,16 +364,19 @@ bool Collide_Sphere___Sphere(Contact* pContact, RigidBody* pBodyA, RigidBody* pB
 #else
 
 	// test for overlap
+	pContact->m_PenetrationDepth = k0;
 	if (c <= k0) {
 		retval = true;
 		u0 = u1 = k0;
+		pContact->m_PenetrationDepth = rab - Sqrt(Vec3fDot(ab, ab));
 	}
 	else if (QuadraticFormula(a, b, c, u0, u1)) {
 		if ((u0 > k0) && (u0 <= u1)) {
 			retval = true;					// time of contact was u0
 		}
-		else if ((u1 > 0) && (u1 < k1)) {
-			retval = true;					// time of contact was u1
+		else if ((u1 < k1) && (b < k0)) {
+			retval = true;					// time of contact was u1; closing from apart, it can only be negative by rounding
+			u0 = u1 > k0 ? u1 : k0;
 		}
 	}
 	else {
@@ -233,46 +387,299 @@ bool Collide_Sphere___Sphere(Contact* pContact, RigidBody* pBodyA, RigidBody* pB
 
 
 	if (retval) {
-		Vec3fSubtract(pContact->m_Normal, pBodyA->m_StateT1.m_Position, pBodyB->m_StateT1.m_Position);
+		// the normal at the time of contact; by the end of the step, a fast sphere may have passed through
+		Real u = u0 < k1 ? u0 : k1;
+		Vec3fSetScaled(pContact->m_Normal, -k1, ab);
+		Vec3fMultiplyAccumulate(pContact->m_Normal, -u, vab);
 		Vec3fNormalize(pContact->m_Normal, pContact->m_Normal);
+		Vec3fSet(pContact->m_Position, pBodyA->m_StateT1.m_Position);
+		pContact->m_ContactTime = u0 < k1 ? u0 : k1;
 	}
+	else if (pBodyA->m_LookAhead > k0 || pBodyB->m_LookAhead > k0) {
+		// closing fast enough to cross the gap in the look ahead of the faster sphere
+		Real lookAhead = pBodyA->m_LookAhead > pBodyB->m_LookAhead ? pBodyA->m_LookAhead : pBodyB->m_LookAhead;
+		Vec3f normal, closing;
+		Vec3fSubtract(normal, pBodyA->m_StateT1.m_Position, pBodyB->m_StateT1.m_Position);
+		Real dist = Vec3fLength(normal);
+		Vec3fSubtract(closing, pBodyB->m_StateT1.m_Velocity, pBodyA->m_StateT1.m_Velocity);
+		if (dist > rab && Vec3fDot(closing, normal) * lookAhead > (dist - rab) * dist) {
+			Vec3fScale(pContact->m_Normal, k1 / dist, normal);
+			Vec3fSet(pContact->m_Position, pBodyA->m_StateT1.m_Position);
+			pContact->m_ContactTime = k1;
+			pContact->m_Feature = 0;
+			pContact->m_Speculative = true;
+			pContact->m_Separation = dist - rab;
+			return true;
+		}
+	}
+	pContact->m_Feature = 0;
+	pContact->m_Speculative = false;
 
 	return retval;
 }
 
-collfn CollisionFunctions[2][2] = {
+collfn CollisionFunctions[3][3] = {
 
-		// infinite plane			sphere
-	Collide_InfPlane_InfPlane,	Collide_InfPlane_Sphere,	// infinite plane
-	Collide_Sphere___InfPlane,	Collide_Sphere___Sphere,	// sphere
+		// infinite plane			sphere							heightfield
+	Collide_InfPlane_InfPlane,	Collide_InfPlane_Sphere,		Collide_Static___Static,		// infinite plane
+	Collide_Sphere___InfPlane,	Collide_Sphere___Sphere,		Collide_Sphere___Heightfield,	// sphere
+	Collide_Static___Static,	Collide_Heightfield_Sphere,		Collide_Static___Static,		// heightfield
 
 };
 
-Contact* Collision::Engine::TestCollision(RigidBody* pBodyA, RigidBody* pBodyB)
+Contact* Collision::Engine::TestCollision(RigidBody* pBodyA, RigidBody* pBodyB, uint32 idA, uint32 idB)
 {
 	Contact* pRetVal = 0;
 
-	// get a contact pointer
-	if (m_FreePool.size() == 0) {
-		APILOG("Contact FreePool is empty\n");
-	}
-
-	Contact* pContact = m_FreePool.front();		// get first available
-	m_FreePool.pop_front();						// and drop it out of the pool
+	Contact* pContact = m_pAux->m_ContactPool.New();	// get a contact from the pool
 
-	if (CollisionFunctions[pBodyA->m_pCollideGeo->GetKind()][pBodyB->m_pCollideGeo->GetKind()](pContact, pBodyA, pBodyB)) {
+	if (CollisionFunctions[pBodyA->m_ShapeKind][pBodyB->m_ShapeKind](pContact, pBodyA, pBodyB)) {
 		m_Contacts.push_back(pContact);
 		pContact->m_pBodyA = pBodyA;
 		pContact->m_pBodyB = pBodyB;
+		pContact->m_BodyA = idA;
+		pContact->m_BodyB = idB;
+		pContact->m_Kinds = pBodyA->m_ShapeKind * kNumShapeKinds + pBodyB->m_ShapeKind;
+		pContact->m_Pair = 0;
 		pRetVal = pContact;						// point to current contact
 	}
 	else {
-		m_FreePool.push_back(pContact);			// didn't need it, give it back
+		m_pAux->m_ContactPool.Delete(pContact);	// didn't need it, give it back
 	}
 
 	return pRetVal;
 }
 
+/*
+	The pairs are counted into buckets by kind of pair, and each bucket is tested by its own
+	instance of TestBucket, which calls that kind's test directly, so every pair in a loop takes
+	the same path. Contacts are found into a scratch contact, and only those that hit take one
+	from the pool. Pairs of static geometry have no kernel at all.
+ */
+
+typedef void (*bucketfn)(const std::vector<BodyPair>& pairs, const int* pOrder, int count, int kinds,
+						 Physics::Pool<Contact>& pool, std::vector<Contact*>& contacts);
+
+template <collfn Test>
+void TestBucket(const std::vector<BodyPair>& pairs, const int* pOrder, int count, int kinds,
+				Physics::Pool<Contact>& pool, std::vector<Contact*>& contacts)
+{
+	Contact found;
+	for (int i = 0; i < count; ++i) {
+		const BodyPair& pair = pairs[pOrder[i]];
+		if (Test(&found, pair.m_pBodyA, pair.m_pBodyB)) {
+			Contact* pContact = pool.New();
+			*pContact = found;
+			pContact->m_pBodyA = pair.m_pBodyA;
+			pContact->m_pBodyB = pair.m_pBodyB;
+			pContact->m_BodyA = pair.m_IdA;
+			pContact->m_BodyB = pair.m_IdB;
+			pContact->m_Kinds = kinds;
+			pContact->m_Pair = pOrder[i];
+			contacts.push_back(pContact);
+		}
+	}
+}
+
+/// as TestBucket, for kinds of pair whose test may find several contacts at once
+template <manifoldfn Test>
+void TestManifoldBucket(const std::vector<BodyPair>& pairs, const int* pOrder, int count, int kinds,
+						Physics::Pool<Contact>& pool, std::vector<Contact*>& contacts)
+{
+	Contact found[kMaxManifold];
+	for (int i = 0; i < count; ++i) {
+		const BodyPair& pair = pairs[pOrder[i]];
+		int n = Test(found, pair.m_pBodyA, pair.m_pBodyB);
+		for (int k = 0; k < n; ++k) {
+			Contact* pContact = pool.New();
+			*pContact = found[k];
+			pContact->m_pBodyA = pair.m_pBodyA;
+			pContact->m_pBodyB = pair.m_pBodyB;
+			pContact->m_BodyA = pair.m_IdA;
+			pContact->m_BodyB = pair.m_IdB;
+			pContact->m_Kinds = kinds;
+			pContact->m_Pair = pOrder[i];
+			contacts.push_back(pContact);
+		}
+	}
+}
+
+bucketfn BucketFunctions[kNumPairKinds] = {
+
+	// infinite plane							sphere												heightfield
+	TestBucket<Collide_InfPlane_InfPlane>,	TestBucket<Collide_InfPlane_Sphere>,				0,													// infinite plane
+	TestBucket<Collide_Sphere___InfPlane>,	TestBucket<Collide_Sphere___Sphere>,				TestManifoldBucket<Manifold_Sphere___Heightfield>,	// sphere
+	0,										TestManifoldBucket<Manifold_Heightfield_Sphere>,	0,													// heightfield
+};
+
+static bool PairLess(const Contact* pA, const Contact* pB)
+{
+	return pA->m_Pair < pB->m_Pair;
+}
+
+/*
+	After Moravanszky and Terdiman, "Fast Contact Reduction for Dynamics Simulation": a pair
+	keeps its deepest contact, the contact farthest from it, the one spanning the largest
+	triangle with those two, and the one farthest outside that triangle. The four span about
+	as much of the contact area as all of them did, so resting on them is as stable. The
+	survivors keep their order, and their features, so a cache keyed on them still finds them.
+	The contacts of a pair may share the sphere's center, so they are spread by where they
+	touch, on its surface facing each normal.
+ */
+
+/// where the bodies of a contact touch; every kind of contact but two planes' has a sphere, at m_Position, and a normal toward it
+static void ContactPoint(const Contact* pContact, Vec3f& point)
+{
+	Vec3fSet(point, pContact->m_Position);
+	const RigidBody* pSphere = pContact->m_pBodyA->m_ShapeKind == kC_Sphere ? pContact->m_pBodyA : pContact->m_pBodyB;
+	if (pSphere->m_ShapeKind == kC_Sphere) {
+		Vec3fMultiplyAccumulate(point, -((Collision::Sphere*) pSphere->m_pCollideGeo)->m_Radius, pContact->m_Normal);
+	}
+}
+
+/// the area of the triangle a, b, c, signed by the side of a to b that c is on, seen along normal
+static Real SignedArea(const Vec3f a, const Vec3f b, const Vec3f c, const Vec3f normal)
+{
+	Vec3f ab, ac, cross;
+	Vec3fSubtract(ab, b, a);
+	Vec3fSubtract(ac, c, a);
+	Vec3fCross(cross, ab, ac);
+	return Vec3fDot(cross, normal);
+}
+
+/// reduce count contacts of one pair to kMaxPairContacts, returning the rest to the pool; @return the number kept
+static int ReducePairContacts(Contact** ppContacts, int count, Physics::Pool<Contact>& pool)
+{
+	if (count <= kMaxPairContacts) {
+		return count;
+	}
+
+	int keep[kMaxPairContacts];
+	int i, k;
+
+	keep[0] = 0;
+	for (i = 1; i < count; ++i) {
+		const Contact* pBest = ppContacts[keep[0]];
+		if (ppContacts[i]->m_PenetrationDepth > pBest->m_PenetrationDepth ||
+			(ppContacts[i]->m_PenetrationDepth == pBest->m_PenetrationDepth && ppContacts[i]->m_ContactTime < pBest->m_ContactTime)) {
+			keep[0] = i;
+		}
+	}
+	Vec3f p0, p1, p2, p;
+	ContactPoint(ppContacts[keep[0]], p0);
+	const Real* normal = ppContacts[keep[0]]->m_Normal;
+
+	Real best = kN1;
+	for (i = 0; i < count; ++i) {
+		Vec3f d;
+		ContactPoint(ppContacts[i], p);
+		Vec3fSubtract(d, p, p0);
+		Real dist = Vec3fDot(d, d);
+		if (dist > best) {
+			best = dist;
+			keep[1] = i;
+		}
+	}
+	ContactPoint(ppContacts[keep[1]], p1);
+
+	// the triangle is wound counterclockwise about the normal, so points outside it have a negative area past some edge
+	best = kN1;
+	Real sign = k1;
+	for (i = 0; i < count; ++i) {
+		ContactPoint(ppContacts[i], p);
+		Real area = SignedArea(p0, p1, p, normal);
+		if (Abs(area) > best) {
+			best = Abs(area);
+			sign = area < k0 ? kN1 : k1;
+			keep[2] = i;
+		}
+	}
+	ContactPoint(ppContacts[keep[2]], p2);
+
+	best = kN1;
+	keep[3] = -1;
+	for (i = 0; i < count; ++i) {
+		if (i == keep[0] || i == keep[1] || i == keep[2]) {
+			continue;
+		}
+		ContactPoint(ppContacts[i], p);
+		Real outside = -sign * SignedArea(p0, p1, p, normal);
+		Real area = -sign * SignedArea(p1, p2, p, normal);
+		outside = area > outside ? area : outside;
+		area = -sign * SignedArea(p2, p0, p, normal);
+		outside = area > outside ? area : outside;
+		if (keep[3] < 0 || outside > best) {
+			best = outside;
+			keep[3] = i;
+		}
+	}
+
+	// the contacts may all lie in a line, or on one point, choosing the same contact more than once
+	int kept = 0;
+	for (i = 0; i < count; ++i) {
+		for (k = 0; k < kMaxPairContacts && keep[k] != i; ++k) {
+		}
+		if (k < kMaxPairContacts) {
+			ppContacts[kept++] = ppContacts[i];
+		}
+		else {
+			pool.Delete(ppContacts[i]);
+		}
+	}
+	return kept;
+}
+
+void Collision::Engine::TestPairs(const std::vector<BodyPair>& pairs)
+{
+	int count = (int) pairs.size();
+	int* pStart = m_pAux->m_BucketStart;
+	int i;
+
+	for (i = 0; i <= kNumPairKinds; ++i) {
+		pStart[i] = 0;
+	}
+	for (i = 0; i < count; ++i) {
+		++pStart[pairs[i].m_pBodyA->m_ShapeKind * kNumShapeKinds + pairs[i].m_pBodyB->m_ShapeKind + 1];
+	}
+	for (i = 0; i < kNumPairKinds; ++i) {
+		pStart[i + 1] += pStart[i];
+	}
+
+	// the buckets fill from their starts, leaving each start at the next bucket's
+	m_pAux->m_PairOrder.resize(count > 0 ? count : 1);
+	int* pOrder = &m_pAux->m_PairOrder[0];
+	for (i = 0; i < count; ++i) {
+		pOrder[pStart[pairs[i].m_pBodyA->m_ShapeKind * kNumShapeKinds + pairs[i].m_pBodyB->m_ShapeKind]++] = i;
+	}
+
+	int first = (int) m_Contacts.size();
+	int begin = 0;
+	for (i = 0; i < kNumPairKinds; ++i) {
+		int end = pStart[i];
+		if (end > begin && BucketFunctions[i] != 0) {
+			BucketFunctions[i](pairs, pOrder + begin, end - begin, i, m_pAux->m_ContactPool, m_Contacts);
+		}
+		begin = end;
+	}
+
+	std::stable_sort(m_Contacts.begin() + first, m_Contacts.end(), PairLess);
+
+	// reduce the contacts of each pair that found more than a few
+	int kept = first;
+	for (begin = first; begin < (int) m_Contacts.size(); ) {
+		int end = begin + 1;
+		while (end < (int) m_Contacts.size() && m_Contacts[end]->m_Pair == m_Contacts[begin]->m_Pair) {
+			++end;
+		}
+		int n = ReducePairContacts(&m_Contacts[begin], end - begin, m_pAux->m_ContactPool);
+		for (i = 0; i < n; ++i) {
+			m_Contacts[kept++] = m_Contacts[begin + i];
+		}
+		begin = end;
+	}
+	m_Contacts.resize(kept);
+}
+
 /*
                        ____      _ _ _     _
                       / ___|___ | | (_)___(_) ___  _ __
@@ -399,6 +806,25 @@ void Resolve_Sphere___InfPlane(Contact* pContact)
 	Resolve_InfPlane_Sphere(pContact);					/// @todo swap!!!
 }
 
+/// move a sphere back to where it was at time u in the step, then on for the rest of the step at its new velocity
+void _RewindSphere(RigidBody* pSphere, Real u, const Vec3f oldVelocity)
+{
+	if (pSphere->GetOOMass() <= k0) {
+		return;
+	}
+
+	Vec3f motion;
+	Vec3fSubtract(motion, pSphere->m_StateT1.m_Position, pSphere->m_StateT0.m_Position);
+	Vec3fMultiplyAccumulate(pSphere->m_StateT1.m_Position, u - k1, motion);
+
+	// the time left is measured by how far the old velocity carried it
+	Real oldSpeed = Vec3fLength(oldVelocity);
+	if (oldSpeed > kEps) {
+		Real remaining = (k1 - u) * Vec3fLength(motion) / oldSpeed;
+		Vec3fMultiplyAccumulate(pSphere->m_StateT1.m_Position, remaining, pSphere->m_StateT1.m_Velocity);
+	}
+}
+
 void Resolve_Sphere___Sphere(Contact* pContact)
 {
 	RigidBody* pBodyA = pContact->m_pBodyA;
@@ -473,6 +899,9 @@ void Resolve_Sphere___Sphere(Contact* pContact)
 
 		Vec3f impulse;
 		Vec3fSetScaled(impulse, (Real) result, pContact->m_Normal);
+		Vec3f oldVelocityA, oldVelocityB;
+		Vec3fSet(oldVelocityA, pBodyA->m_StateT1.m_Velocity);
+		Vec3fSet(oldVelocityB, pBodyB->m_StateT1.m_Velocity);
 		Vec3fMultiplyAccumulate(pBodyA->m_StateT1.m_Velocity, pBodyA->GetOOMass(), impulse);
 		
 		// apply opposite impulse to body B
@@ -492,30 +921,130 @@ void Resolve_Sphere___Sphere(Contact* pContact)
 		Vec3fAdd(pBodyB->m_StateT1.m_AngularMomentum, temp2);
 
 		// angular velocity will be recalculated on next time step
+
+		// as against a plane, take both back to where they touched, and send them on along their new velocities
+		_RewindSphere(pBodyA, pContact->m_ContactTime, oldVelocityA);
+		_RewindSphere(pBodyB, pContact->m_ContactTime, oldVelocityB);
 	}
 }
 
-resfn ResolveFunctions[2][2] = {
+// a sphere against a heightfield is resolved against the tangent plane at each point of contact
 
-	// infinite plane			sphere
-	Resolve_InfPlane_InfPlane,	Resolve_InfPlane_Sphere,	// infinite plane
-	Resolve_Sphere___InfPlane,	Resolve_Sphere___Sphere,	// sphere
+resfn ResolveFunctions[kNumPairKinds] = {
+
+	// infinite plane			sphere						heightfield
+	Resolve_InfPlane_InfPlane,	Resolve_InfPlane_Sphere,	Resolve_InfPlane_InfPlane,	// infinite plane
+	Resolve_Sphere___InfPlane,	Resolve_Sphere___Sphere,	Resolve_Sphere___InfPlane,	// sphere
+	Resolve_InfPlane_InfPlane,	Resolve_InfPlane_Sphere,	Resolve_InfPlane_InfPlane,	// heightfield
 };
 
+/*
+	A speculative contact takes away only as much closing speed as would carry the bodies
+	across the gap between them within the look ahead, so that they arrive touching, and the
+	contact found then is resolved as usual. Nothing bounces yet, and nothing moves, so the
+	bodies aren't marked as having collided.
+ */
+
+void ResolveSpeculative(Contact* pContact)
+{
+	RigidBody* pBodyA = pContact->m_pBodyA;
+	RigidBody* pBodyB = pContact->m_pBodyB;
+
+	// turn the normal to point from A to B, as DescribeContact does
+	Vec3f normal;
+	Vec3fSetScaled(normal, pBodyA->m_ShapeKind == kC_Sphere ? kN1 : k1, pContact->m_Normal);
+
+	Real lookAhead = pBodyA->m_LookAhead > pBodyB->m_LookAhead ? pBodyA->m_LookAhead : pBodyB->m_LookAhead;
+	Vec3f relative;
+	Vec3fSubtract(relative, pBodyA->m_StateT1.m_Velocity, pBodyB->m_StateT1.m_Velocity);
+	Real excess = Vec3fDot(relative, normal) - pContact->m_Separation / lookAhead;
+	Real ooMass = pBodyA->GetOOMass() + pBodyB->GetOOMass();
+
+	if (excess > k0 && ooMass > k0) {
+		Real impulse = excess / ooMass;
+		Vec3fMultiplyAccumulate(pBodyA->m_StateT1.m_Velocity, -impulse * pBodyA->GetOOMass(), normal);
+		Vec3fMultiplyAccumulate(pBodyB->m_StateT1.m_Velocity,  impulse * pBodyB->GetOOMass(), normal);
+	}
+}
+
+/*
+	The collision tests leave the normal pointing toward the sphere, which is body A in a contact
+	between two spheres, or a sphere and static geometry listed second. Events always point from A
+	to B. The point of contact is on the surface of the sphere facing the other body, when the
+	sphere first touched it if the test found that time, otherwise at the end of the step.
+ */
+
+void Engine::DescribeContact(const Contact* pContact, Physics::ContactEvent& event, RigidBody*& pBodyA, RigidBody*& pBodyB)
+{
+	pBodyA = pContact->m_pBodyA;
+	pBodyB = pContact->m_pBodyB;
+	event.m_BodyA = pContact->m_BodyA;
+	event.m_BodyB = pContact->m_BodyB;
+	event.m_Feature = pContact->m_Feature;
+
+	bool sphereA = pBodyA->m_ShapeKind == kC_Sphere;
+	Vec3fSetScaled(event.m_Normal, sphereA ? kN1 : k1, pContact->m_Normal);
+
+	if (sphereA) {
+		Real radius = ((Collision::Sphere*) pBodyA->m_pCollideGeo)->m_Radius;
+		Vec3fSet(event.m_Position, pBodyA->m_StateT1.m_Position);
+		Vec3fMultiplyAccumulate(event.m_Position, radius, event.m_Normal);
+	}
+	else if (pBodyB->m_ShapeKind == kC_Sphere) {
+		Real radius = ((Collision::Sphere*) pBodyB->m_pCollideGeo)->m_Radius;
+		Vec3fSet(event.m_Position, pContact->m_ContactTime > k0 ? pContact->m_Position : pBodyB->m_StateT1.m_Position);
+		Vec3fMultiplyAccumulate(event.m_Position, -radius, event.m_Normal);
+	}
+	else {
+		Vec3fSet(event.m_Position, pBodyB->m_StateT1.m_Position);		// two planes; there is no single point
+	}
+
+	Vec3fZero(event.m_ImpulseA);
+	Vec3fZero(event.m_ImpulseB);
+}
+
+Real Engine::GetContactTime(const Contact* pContact, RigidBody*& pBodyA, RigidBody*& pBodyB) const
+{
+	pBodyA = pContact->m_pBodyA;
+	pBodyB = pContact->m_pBodyB;
+	return pContact->m_ContactTime;
+}
+
+bool Engine::IsSpeculative(const Contact* pContact) const
+{
+	return pContact->m_Speculative;
+}
+
+Real Engine::GetMaxPenetration() const
+{
+	Real depth = k0;
+	for (int i = 0; i < (int) m_Contacts.size(); ++i) {
+		depth = m_Contacts[i]->m_PenetrationDepth > depth ? m_Contacts[i]->m_PenetrationDepth : depth;
+	}
+	return depth;
+}
+
 void Engine::Resolve(Contact* pContact)
 {
-	ResolveFunctions[pContact->m_pBodyA->m_pCollideGeo->GetKind()][pContact->m_pBodyB->m_pCollideGeo->GetKind()](pContact);
+	if (pContact->m_Speculative) {
+		ResolveSpeculative(pContact);
+		return;
+	}
+
+	ResolveFunctions[pContact->m_Kinds](pContact);
 	pContact->m_pBodyA->m_Collided = true;
 	pContact->m_pBodyB->m_Collided = true;
 }
 
-Engine::Engine()
+Engine::Engine() : m_pAux(new EngineAux())
 {
 	SetCapacity(1024);		// default maximum capacity
 }
 
 Engine::~Engine()
 {
+	End();
+	delete m_pAux;
 }
 
 void Engine::Begin()
@@ -527,18 +1056,113 @@ void Engine::End()
 	while (m_Contacts.size() > 0) {
 		Contact* pContact = m_Contacts.back();
 		m_Contacts.pop_back();
-		m_FreePool.push_back(pContact);
+		m_pAux->m_ContactPool.Delete(pContact);
 	}
 }
 
-// capacity can only increase
+// capacity can only increase; more contacts than this are still allocated, a chunk at a time
 
 void Engine::SetCapacity(int maxContacts)
 {
-	int numToAdd = maxContacts - (int) m_FreePool.size();
-	while (--numToAdd >= 0) {
-		m_FreePool.push_back(new Contact());
+	m_pAux->m_ContactPool.Reserve(maxContacts);
+}
+
+Sphere* Engine::NewSphere(Real radius)
+{
+	Sphere* pSphere = m_pAux->m_SpherePool.New(radius);
+	IceMaths::Sphere* pOpcodeSphere = m_pAux->m_OpcodeSpherePool.New();
+	pOpcodeSphere->SetRadius(radius);
+	pSphere->m_pAux = (void*) pOpcodeSphere;
+	return pSphere;
+}
+
+Plane* Engine::NewPlane(const PMath::Plane& plane)
+{
+	return m_pAux->m_PlanePool.New(plane);
+}
+
+Heightfield* Engine::NewHeightfield(int columns, int rows, Real cellSize, const PMath::Vec3f origin, const Real* pHeights)
+{
+	int count = columns * rows;
+	Real* pCopy = new Real[count];
+	for (int i = 0; i < count; ++i) {
+		pCopy[i] = pHeights[i];
 	}
+
+	Heightfield* pField = new (m_pAux->m_HeightfieldPool.Alloc()) Heightfield(columns, rows, cellSize, origin, pCopy);
+	pField->m_pStorage = (void*) pCopy;
+	m_pAux->m_HeightfieldBytes += count * sizeof(Real);
+	return pField;
+}
+
+Heightfield* Engine::NewHeightfield(int columns, int rows, Real cellSize, const PMath::Vec3f origin, const char* pPath, int byteOffset)
+{
+	Physics::MappedFile* pFile = new Physics::MappedFile();
+	if (!pFile->Open(pPath) || byteOffset < 0 || pFile->GetSize() - byteOffset < (int) (columns * rows * sizeof(Real))) {
+		delete pFile;
+		return 0;
+	}
+
+	const Real* pHeights = (const Real*) ((const char*) pFile->GetData() + byteOffset);
+	Heightfield* pField = new (m_pAux->m_HeightfieldPool.Alloc()) Heightfield(columns, rows, cellSize, origin, pHeights);
+	pField->m_pStorage	= (void*) pFile;
+	pField->m_Mapped	= true;
+	return pField;
+}
+
+void Engine::DeleteGeometry(IGeometry* pGeometry)
+{
+	if (pGeometry != 0) {
+		switch (pGeometry->GetKind()) {
+		case kC_Sphere:
+			{
+				Sphere* pSphere = (Sphere*) pGeometry;
+				ICEMATHS_SPHERE(s, pSphere->m_pAux);
+				m_pAux->m_OpcodeSpherePool.Delete(s);
+				m_pAux->m_SpherePool.Delete(pSphere);
+			}
+			break;
+
+		case kC_Plane:
+			m_pAux->m_PlanePool.Delete((Plane*) pGeometry);
+			break;
+
+		case kC_Heightfield:
+			{
+				Heightfield* pField = (Heightfield*) pGeometry;
+				if (pField->m_Mapped) {
+					delete (Physics::MappedFile*) pField->m_pStorage;
+				}
+				else {
+					m_pAux->m_HeightfieldBytes -= pField->m_Columns * pField->m_Rows * sizeof(Real);
+					delete [] (Real*) pField->m_pStorage;
+				}
+				m_pAux->m_HeightfieldPool.Delete(pField);
+			}
+			break;
+
+		default:
+			delete pGeometry;
+			break;
+		}
+	}
+}
+
+void Engine::GetMemoryStats(Physics::MemoryStats& stats)
+{
+	Physics::PoolStats opcodeStats;
+	m_pAux->m_SpherePool.GetStats(stats.m_Spheres);
+	m_pAux->m_OpcodeSpherePool.GetStats(opcodeStats);
+	m_pAux->m_PlanePool.GetStats(stats.m_Planes);
+	m_pAux->m_HeightfieldPool.GetStats(stats.m_Heightfields);
+	m_pAux->m_ContactPool.GetStats(stats.m_Contacts);
+
+	// the opcode sphere is part of the cost of a collision sphere
+	stats.m_Spheres.m_ObjectSize	+= opcodeStats.m_ObjectSize;
+	stats.m_Spheres.m_Bytes			+= opcodeStats.m_Bytes;
+
+	// as are the heights of a heightfield, unless they are mapped from a file
+	stats.m_Heightfields.m_Bytes	+= m_pAux->m_HeightfieldBytes;
 }
 
 }	// end namespace Collision
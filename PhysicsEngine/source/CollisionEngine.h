@@ -31,9 +31,9 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #define _COLLISIONENGINE_H_
 
 #include <vector>
-#include <list>
 
 #include "PhysicsEngineDef.h"
+#include "CollisionEngineDef.h"
 #include "PMath.h"
 
 /** @namespace Collision
@@ -46,6 +46,16 @@ namespace Collision {
 	class EngineAux;
 	class Contact;
 
+	/// two bodies whose bounds overlap, to be tested by Engine::TestPairs
+	class BodyPair
+	{
+	public:
+		Physics::RigidBody*	m_pBodyA;
+		Physics::RigidBody*	m_pBodyB;
+		uint32				m_IdA;
+		uint32				m_IdB;
+	};
+
 	/** @class Engine
 		Manages collision
 	 */
@@ -56,14 +66,52 @@ namespace Collision {
 		Engine();
 		~Engine();
 
-		/// set the number of contacts that can be managed by the physics engine
+		/// set the number of contacts that can be managed by the physics engine without further allocation
 		void SetCapacity(int maxContacts);
 
+		/// create sphere geometry from the engine's pools
+		Sphere* NewSphere(Real radius);
+
+		/// create plane geometry from the engine's pools
+		Plane* NewPlane(const PMath::Plane& plane);
+
+		/// create heightfield geometry from the engine's pools, with a copy of pHeights
+		Heightfield* NewHeightfield(int columns, int rows, Real cellSize, const PMath::Vec3f origin, const Real* pHeights);
+
+		/// create heightfield geometry whose heights are mapped from a file, starting byteOffset bytes in. @return 0 if the file can't be mapped
+		Heightfield* NewHeightfield(int columns, int rows, Real cellSize, const PMath::Vec3f origin, const char* pPath, int byteOffset);
+
+		/// return geometry created by NewSphere, NewPlane or NewHeightfield to its pool
+		void DeleteGeometry(IGeometry* pGeometry);
+
+		/// fill in the geometry and contact pool usage
+		void GetMemoryStats(Physics::MemoryStats& stats);
+
 		/// call to indicate beginning of collision phase
 		void Begin();	
 
 		/// first the physics engine has to submit all pairs of bodies for testing for collision
-		Contact* TestCollision(Physics::RigidBody* pBodyA, Physics::RigidBody* pBodyB);		// returns a Contact if in contact, 0 otherwise
+		Contact* TestCollision(Physics::RigidBody* pBodyA, Physics::RigidBody* pBodyB, uint32 idA, uint32 idB);		// returns a Contact if in contact, 0 otherwise
+
+		/**	test every pair, as if by TestCollision in order, adding the contacts found to m_Contacts
+
+			The pairs are sorted by the kinds of their shapes, and each kind of pair is tested in one
+			loop that calls its test directly. The contacts are put back in the order of the pairs,
+			and a pair that found more than four keeps only the four that best span its contact area.
+		 */
+		void TestPairs(const std::vector<BodyPair>& pairs);
+
+		/// describe a contact for the application, before it is resolved; the impulses are left for the caller
+		void DescribeContact(const Contact* pContact, Physics::ContactEvent& event, Physics::RigidBody*& pBodyA, Physics::RigidBody*& pBodyB);
+
+		/// the normalized time in the step at which the contact began, zero if its bodies started the step touching
+		Real GetContactTime(const Contact* pContact, Physics::RigidBody*& pBodyA, Physics::RigidBody*& pBodyB) const;
+
+		/// @return true if the contact's bodies haven't touched yet, and it only slows them so they arrive touching
+		bool IsSpeculative(const Contact* pContact) const;
+
+		/// the deepest any contact's bodies overlapped when it was found
+		Real GetMaxPenetration() const;
 
 		/// clear a contact
 		void Clear(Contact*);
@@ -76,7 +124,9 @@ namespace Collision {
 
 		/// between a Begin and End call, this vector contains all the detected contacts
 		std::vector<Contact*>	m_Contacts;
-		std::list<Contact*>		m_FreePool;
+
+	protected:
+		EngineAux*				m_pAux;
 	};
 
 } // namespace Collision
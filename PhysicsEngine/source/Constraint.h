@@ -25,12 +25,18 @@ namespace Physics {
 		virtual uint32 GetKind() const { return GetStaticKind(); }
 		static uint32 GetStaticKind() { return 'dist'; }
 
+		/**
+		* Calculate the position changes that would restore the distance, weighted by inverse mass,
+		* without moving anything. Reads the bodies' positions only, so may run concurrently.
+		*
+		* @return true if the distance is already within tolerance, in which case the deltas are zero
+		*/
+		bool Project(PMath::Vec3f& deltaA, PMath::Vec3f& deltaB) const;
+
 		uint32 m_BodyA, m_BodyB;
 		RigidBody *mp_BodyA, *mp_BodyB;
-		Real	m_Distance, m_Tolerance;
-
-	private:
-		Real	m_PrevLength;
+		Real	m_Distance;
+		Real	m_Tolerance;			//!< allowed error, as a fraction of m_Distance
 	};
 }
 
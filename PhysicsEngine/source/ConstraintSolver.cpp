@@ -0,0 +1,189 @@
+
+/** @file ConstraintSolver.cpp
+	@brief	iterative projection of distance constraints, sequential or parallel */
+
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#include "ConstraintSolver.h"
+#include "Constraint.h"
+#include "RigidBody.h"
+#include "PhysicsThread.h"
+
+using namespace Physics;
+using PMath::Vec3f;
+
+static const int kMinConstraintBatch	= 256;		// smallest number of constraints worth handing to another thread
+static const int kMinBodyBatch			= 256;
+
+ConstraintSolver :: ConstraintSolver() : m_Mode(kCS_GaussSeidel), m_Iterations(4), m_Relaxation(Real(1.5f))
+{
+}
+
+void ConstraintSolver :: SetMode(EConstraintSolver mode, int iterations)
+{
+	m_Mode = mode;
+	m_Iterations = iterations > 0 ? iterations : 1;
+}
+
+void ConstraintSolver :: AddBody(RigidBody* pBody)
+{
+	if (pBody->m_SolverIndex < 0) {
+		pBody->m_SolverIndex = (int) m_Bodies.size();
+		m_Bodies.push_back(pBody);
+		Vec3f& pos = pBody->m_StateT1.m_Position;
+		m_Start.push_back(pos[0]);
+		m_Start.push_back(pos[1]);
+		m_Start.push_back(pos[2]);
+	}
+}
+
+void ConstraintSolver :: Add(DistanceConstraint* pConstraint)
+{
+	m_Constraints.push_back(pConstraint);
+	AddBody(pConstraint->mp_BodyA);
+	AddBody(pConstraint->mp_BodyB);
+}
+
+int ConstraintSolver :: Solve(Real dt, ThreadPool& pool)
+{
+	int iterations = 0;
+	if (!m_Constraints.empty()) {
+		if (m_Mode == kCS_Jacobi) {
+			BuildAdjacency();
+		}
+
+		bool satisfied = false;
+		while (!satisfied && iterations < m_Iterations) {
+			satisfied = (m_Mode == kCS_Jacobi) ? IterateJacobi(pool) : IterateGaussSeidel();
+			++iterations;
+		}
+
+		// whatever distance the projection moved a body, it moved it in dt
+		Real oodt = k1 / dt;
+		int i;
+		for (i = 0; i < (int) m_Bodies.size(); ++i) {
+			RigidBody* pBody = m_Bodies[i];
+			if (pBody->GetTranslatable()) {
+				Vec3f moved;
+				PMath::Vec3fSubtract(moved, pBody->m_StateT1.m_Position, *(Vec3f*) &m_Start[i * 3]);
+				PMath::Vec3fMultiplyAccumulate(pBody->m_StateT1.m_Velocity, oodt, moved);
+			}
+			pBody->m_SolverIndex = -1;
+		}
+	}
+
+	m_Constraints.clear();
+	m_Bodies.clear();
+	m_Start.clear();
+	return iterations;
+}
+
+bool ConstraintSolver :: IterateGaussSeidel()
+{
+	bool satisfied = true;
+	std::vector<DistanceConstraint*>::iterator iter;
+	for (iter = m_Constraints.begin(); iter != m_Constraints.end(); ++iter) {
+		if (!(*iter)->Apply()) {
+			satisfied = false;
+		}
+	}
+	return satisfied;
+}
+
+void ConstraintSolver :: BuildAdjacency()
+{
+	int constraints	= (int) m_Constraints.size();
+	int bodies		= (int) m_Bodies.size();
+
+	m_Deltas.resize(constraints * 6);
+	m_Satisfied.resize(constraints);
+
+	// counting sort of the constraint ends by body
+	m_AdjStart.assign(bodies + 1, 0);
+	int i;
+	for (i = 0; i < constraints; ++i) {
+		++m_AdjStart[m_Constraints[i]->mp_BodyA->m_SolverIndex + 1];
+		++m_AdjStart[m_Constraints[i]->mp_BodyB->m_SolverIndex + 1];
+	}
+	for (i = 0; i < bodies; ++i) {
+		m_AdjStart[i + 1] += m_AdjStart[i];
+	}
+
+	m_Adj.resize(constraints * 2);
+	std::vector<int> fill(m_AdjStart.begin(), m_AdjStart.end() - 1);
+	for (i = 0; i < constraints; ++i) {
+		m_Adj[fill[m_Constraints[i]->mp_BodyA->m_SolverIndex]++] = i * 2;
+		m_Adj[fill[m_Constraints[i]->mp_BodyB->m_SolverIndex]++] = i * 2 + 1;
+	}
+}
+
+void ConstraintSolver :: ProjectRange(void* pData, int begin, int end)
+{
+	ConstraintSolver* pSolver = (ConstraintSolver*) pData;
+	for (int i = begin; i < end; ++i) {
+		Vec3f* pDeltas = (Vec3f*) &pSolver->m_Deltas[i * 6];
+		pSolver->m_Satisfied[i] = pSolver->m_Constraints[i]->Project(pDeltas[0], pDeltas[1]);
+	}
+}
+
+void ConstraintSolver :: MoveRange(void* pData, int begin, int end)
+{
+	ConstraintSolver* pSolver = (ConstraintSolver*) pData;
+	for (int i = begin; i < end; ++i) {
+		int first	= pSolver->m_AdjStart[i];
+		int last	= pSolver->m_AdjStart[i + 1];
+		if (first == last) {
+			continue;
+		}
+
+		Vec3f sum;
+		PMath::Vec3fZero(sum);
+		for (int j = first; j < last; ++j) {
+			PMath::Vec3fAdd(sum, *(Vec3f*) &pSolver->m_Deltas[pSolver->m_Adj[j] * 3]);
+		}
+		PMath::Vec3fMultiplyAccumulate(pSolver->m_Bodies[i]->m_StateT1.m_Position, pSolver->m_Relaxation / Real(last - first), sum);
+	}
+}
+
+bool ConstraintSolver :: IterateJacobi(ThreadPool& pool)
+{
+	pool.Run((int) m_Constraints.size(), ProjectRange, this, kMinConstraintBatch);
+
+	bool satisfied = true;
+	std::vector<char>::iterator iter;
+	for (iter = m_Satisfied.begin(); iter != m_Satisfied.end(); ++iter) {
+		if (!*iter) {
+			satisfied = false;
+			break;
+		}
+	}
+
+	if (!satisfied) {
+		pool.Run((int) m_Bodies.size(), MoveRange, this, kMinBodyBatch);
+	}
+	return satisfied;
+}
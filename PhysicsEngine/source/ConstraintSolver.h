@@ -0,0 +1,104 @@
+
+/** @file ConstraintSolver.h
+
+	an internal implementation file, iterative projection of distance constraints
+ */
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#ifndef _CONSTRAINTSOLVER_H_
+#define _CONSTRAINTSOLVER_H_
+
+#include <vector>
+
+#include "PhysicsEngineDef.h"
+
+namespace Physics {
+
+	class DistanceConstraint;
+	class ThreadPool;
+
+	/** @class	ConstraintSolver
+		@brief	Projects body positions until all distance constraints are within tolerance
+
+		The constraints to solve are added each time step, after the bodies have been integrated.
+		Each iteration moves the bodies directly; the iterations stop early once every constraint
+		is within its tolerance. The bodies' velocities are then corrected by the total distance
+		moved, so that the projection does not inject energy.
+
+		In Gauss-Seidel mode the constraints are projected one after another, which converges
+		quickly but is inherently sequential. In Jacobi mode every constraint's correction is
+		calculated from the same positions, in parallel, and each body then moves by the
+		over-relaxed average of the corrections on it, also in parallel.
+	 */
+
+	class ConstraintSolver
+	{
+	public:
+		ConstraintSolver();
+
+		void	SetMode(EConstraintSolver mode, int iterations);
+		EConstraintSolver	GetMode() const			{ return m_Mode;		}
+		int		GetIterations() const				{ return m_Iterations;	}
+
+		/// add a constraint to be solved in this time step
+		void	Add(DistanceConstraint* pConstraint);
+
+		/**
+		* Solve the added constraints, then forget them
+		*
+		* @param dt		the time step, used to correct velocities
+		* @param pool	threads to use in Jacobi mode
+		* @return		the number of iterations performed
+		*/
+		int		Solve(Real dt, ThreadPool& pool);
+
+	protected:
+		void	AddBody(RigidBody* pBody);
+		bool	IterateGaussSeidel();
+		bool	IterateJacobi(ThreadPool& pool);
+		void	BuildAdjacency();
+
+		static void	ProjectRange(void* pData, int begin, int end);		///< Jacobi pass 1, per constraint
+		static void	MoveRange(void* pData, int begin, int end);			///< Jacobi pass 2, per body
+
+		EConstraintSolver					m_Mode;
+		int									m_Iterations;
+		Real								m_Relaxation;	//!< Jacobi over-relaxation, applied to the averaged correction
+
+		std::vector<DistanceConstraint*>	m_Constraints;
+		std::vector<RigidBody*>				m_Bodies;		//!< bodies touched by m_Constraints, indexed by RigidBody::m_SolverIndex
+		std::vector<Real>					m_Start;		//!< body positions before the first iteration, 3 per body
+
+		std::vector<Real>					m_Deltas;		//!< Jacobi corrections, 6 per constraint: body A then body B
+		std::vector<char>					m_Satisfied;	//!< Jacobi, per constraint
+		std::vector<int>					m_AdjStart;		//!< Jacobi, per body, first entry in m_Adj; one extra at the end
+		std::vector<int>					m_Adj;			//!< Jacobi, indices into m_Deltas / 3 of the corrections on each body
+	};
+
+}	// end Physics namespace
+
+#endif
@@ -8,70 +8,54 @@ using PMath::Vec3f;
 
 DistanceConstraint :: DistanceConstraint(uint32 a, RigidBody* pBodyA, uint32 b, RigidBody* pBodyB, Real distance, Real tolerance) 
 	: m_BodyA(a), mp_BodyA(pBodyA), m_BodyB(b), mp_BodyB(pBodyB), 
-	m_Distance(distance), m_PrevLength(distance), m_Tolerance(tolerance) 
+	m_Distance(distance), m_Tolerance(tolerance) 
 {
 }
 
-bool DistanceConstraint :: Apply() {
-	bool retval = m_Active;
-	if (retval) {
-		Vec3f* pPosA = &mp_BodyA->m_StateT1.m_Position;
-		Vec3f* pPosB = &mp_BodyB->m_StateT1.m_Position;
-
-		Vec3f direction;
-		PMath::Vec3fSubtract(direction, *pPosA, *pPosB);
-		Real length = PMath::Vec3fLength(direction);
-
-		Real x = length - m_Distance;
-
-		if (1) {
-			Real force = 1000.0f /*pSpring->m_Stiffness*/ * x;
-
-			// damping -b * difference in length between this frame and previous
-			Real v = (m_PrevLength - x);
-			force += v * 0.95f; //pSpring->m_Damping;
+bool DistanceConstraint :: Project(Vec3f& deltaA, Vec3f& deltaB) const
+{
+	PMath::Vec3fZero(deltaA);
+	PMath::Vec3fZero(deltaB);
+
+	Real ooMassA = mp_BodyA->GetOOMass();
+	Real ooMassB = mp_BodyB->GetOOMass();
+	Real ooMassSum = ooMassA + ooMassB;
+	if (ooMassSum <= k0) {
+		return true;							// neither body can move, nothing to be done
+	}
 
-			m_PrevLength = length;
+	Vec3f distance;
+	PMath::Vec3fSubtract(distance, mp_BodyA->m_StateT1.m_Position, mp_BodyB->m_StateT1.m_Position);
+	Real dist = PMath::Vec3fLength(distance);
+	Real error = dist - m_Distance;
 
-			PMath::Vec3fMultiplyAccumulate(mp_BodyA->m_Acc.m_Force, -force, direction);
-			PMath::Vec3fMultiplyAccumulate(mp_BodyB->m_Acc.m_Force,  force, direction);
-		}
+	// if length is within tolerance, done
+	if (PMath::Abs(error) <= m_Tolerance * m_Distance) {
+		return true;
 	}
 
-	return retval;
+	// else move the bodies towards their correct mutual distance, proportionately to their masses
+	dist += Real(1.0e-4f);						// add a teeny bit to avoid divide by zero problems
+	Real delta = error / (dist * ooMassSum);
+
+	PMath::Vec3fSetScaled(deltaA, -ooMassA * delta, distance);
+	PMath::Vec3fSetScaled(deltaB,  ooMassB * delta, distance);
+	return false;
 }
 
-/*
 bool DistanceConstraint :: Apply() {
-	bool retval = m_Active;
+	bool retval = true;
 	if (m_Active) {
-		Vec3f distance;
-		Vec3f* pPosA = &mp_BodyA->m_StateT1.m_Position;
-		Vec3f* pPosB = &mp_BodyB->m_StateT1.m_Position;
-		PMath::Vec3fSubtract(distance, *pPosA, *pPosB);
-		Real distSquared = PMath::Vec3fDot(distance, distance);
-		Real desiredDistSquared = m_Distance * m_Distance;
-		Real tolSquared = m_Tolerance * m_Tolerance;
-
-		// if length is within tolerance, done
-		if (PMath::Abs(desiredDistSquared - distSquared) < tolSquared) {
-			retval = true;
-		}
-		else {
-			// else move the bodies towards their correct mutual distance, proportionately to their masses
-			Real dist = PMath::Sqrt(distSquared) + 1.0e-4f;	// add a teeny bit to avoid divide by zero problems
-			Real delta = (dist - m_Distance) / (dist * (mp_BodyA->GetOOMass() + mp_BodyB->GetOOMass()));
-
-			PMath::Vec3fMultiplyAccumulate(*pPosA, -mp_BodyA->GetOOMass() * delta, distance);
-			PMath::Vec3fMultiplyAccumulate(*pPosB,  mp_BodyB->GetOOMass() * delta, distance);
-
-			retval = PMath::Abs((dist - m_Distance) / m_Distance) < m_Tolerance;
+		Vec3f deltaA, deltaB;
+		retval = Project(deltaA, deltaB);
+		if (!retval) {
+			PMath::Vec3fAdd(mp_BodyA->m_StateT1.m_Position, deltaA);
+			PMath::Vec3fAdd(mp_BodyB->m_StateT1.m_Position, deltaB);
 		}
 	}
 
 	return retval;
 }
-*/
 
 /*
 	bool applyConstraint()
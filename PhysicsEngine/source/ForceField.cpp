@@ -0,0 +1,295 @@
+
+/** @file ForceField.cpp
+	@brief	attractors, wind, drag and buoyancy volumes, applied to batches of bodies */
+
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#include "ForceField.h"
+#include "RigidBody.h"
+#include "CollisionEngineDef.h"
+
+using PMath::Vec3f;
+
+namespace Physics {
+
+	static const Real kFieldEpsilon = Real(1.0e-6f);	// keeps the direction to an attractor finite at its center
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	ForceField :: ForceField() : m_Kind(kFF_Attractor), m_Active(true), m_Strength(k1), m_Radius(k1),
+		m_LinearDrag(k0), m_QuadraticDrag(k0), m_Density(k1)
+	{
+		PMath::Vec3fZero(m_Center);
+		PMath::Vec3fZero(m_Min);
+		PMath::Vec3fZero(m_Max);
+		PMath::Vec3fZero(m_Velocity);
+	}
+
+	void ForceField :: GetBounds(Real* pMin, Real* pMax) const
+	{
+		for (int i = 0; i < 3; ++i) {
+			if (m_Kind == kFF_Attractor || m_Kind == kFF_Wind) {
+				pMin[i] = m_Center[i] - m_Radius;
+				pMax[i] = m_Center[i] + m_Radius;
+			}
+			else {
+				pMin[i] = m_Min[i];
+				pMax[i] = m_Max[i];
+			}
+		}
+	}
+
+	void ForceField :: Apply(ForceFieldBatch& batch, int first, int count, const Vec3f gravity) const
+	{
+		switch (m_Kind) {
+			case kFF_Attractor:	ApplyAttractor(batch, first, count);			break;
+			case kFF_Wind:		ApplyWind(batch, first, count);				break;
+			case kFF_Drag:		ApplyDrag(batch, first, count);				break;
+			case kFF_Buoyancy:	ApplyBuoyancy(batch, first, count, gravity);	break;
+		}
+	}
+
+	/*
+		Each kernel reads the batch's arrays and accumulates into its force arrays; bodies
+		outside the field's reach are masked to zero force rather than skipped, so that the
+		loops have no branches, and vectorize.
+	 */
+
+	void ForceField :: ApplyAttractor(ForceFieldBatch& batch, int first, int count) const
+	{
+		const Real* x		= &batch.m_X[first];
+		const Real* y		= &batch.m_Y[first];
+		const Real* z		= &batch.m_Z[first];
+		const Real* mass	= &batch.m_Mass[first];
+		Real* fx			= &batch.m_FX[first];
+		Real* fy			= &batch.m_FY[first];
+		Real* fz			= &batch.m_FZ[first];
+
+		const Real cx		= m_Center[0];
+		const Real cy		= m_Center[1];
+		const Real cz		= m_Center[2];
+		const Real ooRadius	= m_Radius > k0 ? k1 / m_Radius : k0;
+		const Real strength	= m_Strength;
+
+		for (int i = 0; i < count; ++i) {
+			Real dx = cx - x[i];
+			Real dy = cy - y[i];
+			Real dz = cz - z[i];
+			Real dist = PMath::Sqrt(dx * dx + dy * dy + dz * dz);
+			Real falloff = k1 - dist * ooRadius;
+			falloff = falloff > k0 ? falloff : k0;
+			Real s = strength * falloff * mass[i] / (dist + kFieldEpsilon);
+			fx[i] += s * dx;
+			fy[i] += s * dy;
+			fz[i] += s * dz;
+		}
+	}
+
+	void ForceField :: ApplyWind(ForceFieldBatch& batch, int first, int count) const
+	{
+		const Real* x		= &batch.m_X[first];
+		const Real* y		= &batch.m_Y[first];
+		const Real* z		= &batch.m_Z[first];
+		const Real* vx		= &batch.m_VX[first];
+		const Real* vy		= &batch.m_VY[first];
+		const Real* vz		= &batch.m_VZ[first];
+		const Real* mass	= &batch.m_Mass[first];
+		Real* fx			= &batch.m_FX[first];
+		Real* fy			= &batch.m_FY[first];
+		Real* fz			= &batch.m_FZ[first];
+
+		const Real cx		= m_Center[0];
+		const Real cy		= m_Center[1];
+		const Real cz		= m_Center[2];
+		const Real wx		= m_Velocity[0];
+		const Real wy		= m_Velocity[1];
+		const Real wz		= m_Velocity[2];
+		const Real ooRadius	= m_Radius > k0 ? k1 / m_Radius : k0;
+		const Real strength	= m_Strength;
+
+		for (int i = 0; i < count; ++i) {
+			Real dx = cx - x[i];
+			Real dy = cy - y[i];
+			Real dz = cz - z[i];
+			Real dist = PMath::Sqrt(dx * dx + dy * dy + dz * dz);
+			Real falloff = k1 - dist * ooRadius;
+			falloff = falloff > k0 ? falloff : k0;
+			Real s = strength * falloff * mass[i];
+			fx[i] += s * (wx - vx[i]);
+			fy[i] += s * (wy - vy[i]);
+			fz[i] += s * (wz - vz[i]);
+		}
+	}
+
+	void ForceField :: ApplyDrag(ForceFieldBatch& batch, int first, int count) const
+	{
+		const Real* x		= &batch.m_X[first];
+		const Real* y		= &batch.m_Y[first];
+		const Real* z		= &batch.m_Z[first];
+		const Real* vx		= &batch.m_VX[first];
+		const Real* vy		= &batch.m_VY[first];
+		const Real* vz		= &batch.m_VZ[first];
+		const Real* mass	= &batch.m_Mass[first];
+		Real* fx			= &batch.m_FX[first];
+		Real* fy			= &batch.m_FY[first];
+		Real* fz			= &batch.m_FZ[first];
+
+		const Real minX = m_Min[0], minY = m_Min[1], minZ = m_Min[2];
+		const Real maxX = m_Max[0], maxY = m_Max[1], maxZ = m_Max[2];
+		const Real c1 = m_LinearDrag;
+		const Real c2 = m_QuadraticDrag;
+
+		for (int i = 0; i < count; ++i) {
+			Real inside =	(x[i] >= minX && x[i] <= maxX &&
+							 y[i] >= minY && y[i] <= maxY &&
+							 z[i] >= minZ && z[i] <= maxZ) ? k1 : k0;
+			Real speed = PMath::Sqrt(vx[i] * vx[i] + vy[i] * vy[i] + vz[i] * vz[i]);
+			Real s = -inside * mass[i] * (c1 + c2 * speed);
+			fx[i] += s * vx[i];
+			fy[i] += s * vy[i];
+			fz[i] += s * vz[i];
+		}
+	}
+
+	/*
+		The water's surface is the top of the box. A sphere of radius r whose lowest point is
+		h below the surface displaces the cap pi h^2 (3r - h) / 3, for h between 0 and 2r.
+	 */
+
+	void ForceField :: ApplyBuoyancy(ForceFieldBatch& batch, int first, int count, const Vec3f gravity) const
+	{
+		const Real* x		= &batch.m_X[first];
+		const Real* y		= &batch.m_Y[first];
+		const Real* z		= &batch.m_Z[first];
+		const Real* vx		= &batch.m_VX[first];
+		const Real* vy		= &batch.m_VY[first];
+		const Real* vz		= &batch.m_VZ[first];
+		const Real* mass	= &batch.m_Mass[first];
+		const Real* radius	= &batch.m_Radius[first];
+		Real* fx			= &batch.m_FX[first];
+		Real* fy			= &batch.m_FY[first];
+		Real* fz			= &batch.m_FZ[first];
+
+		const Real minX = m_Min[0], minY = m_Min[1], minZ = m_Min[2];
+		const Real maxX = m_Max[0], maxY = m_Max[1], surface = m_Max[2];
+		const Real wx = m_Velocity[0], wy = m_Velocity[1], wz = m_Velocity[2];
+		const Real liftX = -gravity[0] * m_Density * kPi / Real(3.0f);
+		const Real liftY = -gravity[1] * m_Density * kPi / Real(3.0f);
+		const Real liftZ = -gravity[2] * m_Density * kPi / Real(3.0f);
+		const Real c1 = m_LinearDrag;
+
+		for (int i = 0; i < count; ++i) {
+			Real r = radius[i];
+			Real inside =	(x[i] >= minX && x[i] <= maxX &&
+							 y[i] >= minY && y[i] <= maxY &&
+							 z[i] + r >= minZ) ? k1 : k0;
+			Real depth = surface - (z[i] - r);
+			depth = depth > k0 ? depth : k0;
+			depth = depth < r + r ? depth : r + r;
+			Real volume = inside * depth * depth * (Real(3.0f) * r - depth);
+			Real fraction = r > k0 ? inside * depth / (r + r) : inside;
+			Real s = -c1 * fraction * mass[i];
+			fx[i] += volume * liftX + s * (vx[i] - wx);
+			fy[i] += volume * liftY + s * (vy[i] - wy);
+			fz[i] += volume * liftZ + s * (vz[i] - wz);
+		}
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	void ForceFieldBatch :: Clear()
+	{
+		m_Bodies.clear();
+		m_Fields.clear();
+		m_RunFirst.clear();
+	}
+
+	void ForceFieldBatch :: Add(const ForceField* pField, RigidBody* pBody)
+	{
+		if (m_Fields.empty() || m_Fields.back() != pField) {
+			m_Fields.push_back(pField);
+			m_RunFirst.push_back((int) m_Bodies.size());
+		}
+		m_Bodies.push_back(pBody);
+	}
+
+	void ForceFieldBatch :: Apply(const Vec3f gravity)
+	{
+		if (m_Bodies.empty()) {
+			return;
+		}
+
+		Gather();
+		int runs = (int) m_Fields.size();
+		for (int i = 0; i < runs; ++i) {
+			int first	= m_RunFirst[i];
+			int end		= (i + 1 < runs) ? m_RunFirst[i + 1] : (int) m_Bodies.size();
+			m_Fields[i]->Apply(*this, first, end - first, gravity);
+		}
+		Scatter();
+	}
+
+	void ForceFieldBatch :: Gather()
+	{
+		int count = (int) m_Bodies.size();
+		m_X.resize(count);		m_Y.resize(count);		m_Z.resize(count);
+		m_VX.resize(count);		m_VY.resize(count);		m_VZ.resize(count);
+		m_Mass.resize(count);	m_Radius.resize(count);
+		m_FX.assign(count, k0);	m_FY.assign(count, k0);	m_FZ.assign(count, k0);
+
+		for (int i = 0; i < count; ++i) {
+			RigidBody* pBody = m_Bodies[i];
+			const DynamicState& state = pBody->m_StateT1;
+			m_X[i]	= state.m_Position[0];
+			m_Y[i]	= state.m_Position[1];
+			m_Z[i]	= state.m_Position[2];
+			m_VX[i]	= state.m_Velocity[0];
+			m_VY[i]	= state.m_Velocity[1];
+			m_VZ[i]	= state.m_Velocity[2];
+			m_Mass[i] = pBody->GetMass();
+
+			Collision::IGeometry* pGeo = pBody->m_pCollideGeo;
+			if (pGeo != 0 && pGeo->GetKind() == Collision::kC_Sphere) {
+				m_Radius[i] = ((Collision::Sphere*) pGeo)->m_Radius;
+			}
+			else {
+				m_Radius[i] = PMath::Max(pBody->m_Extent[0], PMath::Max(pBody->m_Extent[1], pBody->m_Extent[2]));
+			}
+		}
+	}
+
+	void ForceFieldBatch :: Scatter()
+	{
+		for (int i = 0; i < (int) m_Bodies.size(); ++i) {
+			Real* pForce = m_Bodies[i]->m_Acc.m_Force;
+			pForce[0] += m_FX[i];
+			pForce[1] += m_FY[i];
+			pForce[2] += m_FZ[i];
+		}
+	}
+
+}	// end namespace Physics
@@ -0,0 +1,127 @@
+
+/** @file ForceField.h
+
+	an internal implementation file, force fields acting on the bodies within a region
+ */
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#ifndef _FORCEFIELD_H_
+#define _FORCEFIELD_H_
+
+#include <vector>
+
+#include "PhysicsEngineDef.h"
+#include "PMath.h"
+
+namespace Physics {
+
+	class ForceFieldBatch;
+
+	/** @class	ForceField
+		@brief	A force acting on every body within a region
+
+		An attractor accelerates bodies toward its center, strongest at the center and fading to
+		nothing at its radius; a negative strength repels. Wind brings bodies toward the wind's
+		velocity, at a rate given by its strength, which fades in the same way. A drag volume
+		slows the bodies in its box, linearly and with the square of their speed. A buoyancy volume
+		is water filling its box: it lifts the bodies in it by the weight of the water their spheres
+		displace, up to the top of the box, and slows them in proportion to how deep they are.
+
+		Except for buoyancy, which is a true force, the fields are accelerations, so bodies of
+		any mass respond alike. Drag is applied explicitly, so its rates should stay well below
+		the number of substeps per second.
+	 */
+
+	class ForceField
+	{
+	public:
+		ForceField();
+
+		/// the box bodies must overlap to be affected
+		void			GetBounds(Real* pMin, Real* pMax) const;
+
+		/// add the field's force on bodies [first, first + count) of a gathered batch
+		void			Apply(ForceFieldBatch& batch, int first, int count, const PMath::Vec3f gravity) const;
+
+		EForceFieldKind	m_Kind;
+		bool			m_Active;
+		PMath::Vec3f	m_Center;				//!< of an attractor or of wind
+		PMath::Vec3f	m_Min;					//!< box of a drag or buoyancy volume
+		PMath::Vec3f	m_Max;
+		PMath::Vec3f	m_Velocity;				//!< of the wind, or of the water in a buoyancy volume
+		Real			m_Strength;				//!< acceleration at an attractor's center, or wind's rate per second
+		Real			m_Radius;				//!< of an attractor or of wind
+		Real			m_LinearDrag;			//!< per second
+		Real			m_QuadraticDrag;		//!< per meter
+		Real			m_Density;				//!< mass per unit volume of the water in a buoyancy volume
+
+	protected:
+		void			ApplyAttractor(ForceFieldBatch& batch, int first, int count) const;
+		void			ApplyWind(ForceFieldBatch& batch, int first, int count) const;
+		void			ApplyDrag(ForceFieldBatch& batch, int first, int count) const;
+		void			ApplyBuoyancy(ForceFieldBatch& batch, int first, int count, const PMath::Vec3f gravity) const;
+	};
+
+	/** @class	ForceFieldBatch
+		@brief	The bodies one group of islands has within reach of each force field
+
+		Found once per world step, from the broadphase, as runs of bodies per field; a body may be
+		in several runs. Every substep the bodies' positions, velocities, masses and radii are
+		gathered into arrays, each field runs down its run of the arrays without branching, and
+		the forces are scattered back into the bodies' accumulators.
+	 */
+
+	class ForceFieldBatch
+	{
+	public:
+		void		Clear();
+
+		/// add a body to the run of field; each field's bodies must be added together
+		void		Add(const ForceField* pField, RigidBody* pBody);
+
+		/// add every field's force on its bodies to the bodies' accumulated forces
+		void		Apply(const PMath::Vec3f gravity);
+
+		bool		Empty() const		{ return m_Bodies.empty(); }
+
+		std::vector<Real>			m_X, m_Y, m_Z;			//!< positions
+		std::vector<Real>			m_VX, m_VY, m_VZ;		//!< velocities
+		std::vector<Real>			m_Mass, m_Radius;
+		std::vector<Real>			m_FX, m_FY, m_FZ;		//!< forces, accumulated by the fields
+
+	protected:
+		void		Gather();
+		void		Scatter();
+
+		std::vector<RigidBody*>			m_Bodies;
+		std::vector<const ForceField*>	m_Fields;			//!< the field of each run
+		std::vector<int>				m_RunFirst;			//!< index of each run's first body
+	};
+
+}	// end Physics namespace
+
+#endif
@@ -0,0 +1,619 @@
+
+/** @file Heightfield.cpp
+	@brief	heightfield terrain collision queries */
+
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#include "CollisionEngineDef.h"
+#include "PMath.h"
+
+using namespace PMath;
+
+namespace Collision {
+
+	static const int kSweepRefinements = 10;		// bisections used to find the time of an edge or vertex hit
+	static const Real kFar = Real(1.0e30f);			// farther than any ray reaches
+
+	/// closest point to p on triangle abc; Ericson, Real-Time Collision Detection, 5.1.5
+	static void ClosestPointOnTriangle(Vec3f& result, const Vec3f p, const Vec3f a, const Vec3f b, const Vec3f c)
+	{
+		Vec3f ab, ac, ap, bp, cp;
+		Vec3fSubtract(ab, b, a);
+		Vec3fSubtract(ac, c, a);
+		Vec3fSubtract(ap, p, a);
+
+		Real d1 = Vec3fDot(ab, ap);
+		Real d2 = Vec3fDot(ac, ap);
+		if (d1 <= k0 && d2 <= k0) {
+			Vec3fSet(result, a);
+			return;
+		}
+
+		Vec3fSubtract(bp, p, b);
+		Real d3 = Vec3fDot(ab, bp);
+		Real d4 = Vec3fDot(ac, bp);
+		if (d3 >= k0 && d4 <= d3) {
+			Vec3fSet(result, b);
+			return;
+		}
+
+		Real vc = d1 * d4 - d3 * d2;
+		if (vc <= k0 && d1 >= k0 && d3 <= k0) {
+			Vec3fSet(result, a);
+			Vec3fMultiplyAccumulate(result, d1 / (d1 - d3), ab);
+			return;
+		}
+
+		Vec3fSubtract(cp, p, c);
+		Real d5 = Vec3fDot(ab, cp);
+		Real d6 = Vec3fDot(ac, cp);
+		if (d6 >= k0 && d5 <= d6) {
+			Vec3fSet(result, c);
+			return;
+		}
+
+		Real vb = d5 * d2 - d1 * d6;
+		if (vb <= k0 && d2 >= k0 && d6 <= k0) {
+			Vec3fSet(result, a);
+			Vec3fMultiplyAccumulate(result, d2 / (d2 - d6), ac);
+			return;
+		}
+
+		Real va = d3 * d6 - d5 * d4;
+		if (va <= k0 && (d4 - d3) >= k0 && (d5 - d6) >= k0) {
+			Vec3f bc;
+			Vec3fSubtract(bc, c, b);
+			Vec3fSet(result, b);
+			Vec3fMultiplyAccumulate(result, (d4 - d3) / ((d4 - d3) + (d5 - d6)), bc);
+			return;
+		}
+
+		Real denom = k1 / (va + vb + vc);
+		Vec3fSet(result, a);
+		Vec3fMultiplyAccumulate(result, vb * denom, ab);
+		Vec3fMultiplyAccumulate(result, vc * denom, ac);
+	}
+
+	/// upward unit normal of triangle abc, wound counterclockwise seen from above
+	static void TriangleNormal(Vec3f& result, const Vec3f a, const Vec3f b, const Vec3f c)
+	{
+		Vec3f ab, ac;
+		Vec3fSubtract(ab, b, a);
+		Vec3fSubtract(ac, c, a);
+		Vec3fCross(result, ab, ac);
+		Vec3fNormalize(result, result);
+	}
+
+	/// @return true if the projection of p onto the XY plane lies inside the projection of triangle abc
+	static bool InsideXY(const Vec3f p, const Vec3f a, const Vec3f b, const Vec3f c)
+	{
+		Real e0 = (b[0] - a[0]) * (p[1] - a[1]) - (b[1] - a[1]) * (p[0] - a[0]);
+		Real e1 = (c[0] - b[0]) * (p[1] - b[1]) - (c[1] - b[1]) * (p[0] - b[0]);
+		Real e2 = (a[0] - c[0]) * (p[1] - c[1]) - (a[1] - c[1]) * (p[0] - c[0]);
+		return e0 >= k0 && e1 >= k0 && e2 >= k0;
+	}
+
+	/// @return true if the ray hits triangle abc from either side; t is in units of dir. Moller and Trumbore
+	static bool RayTriangle(const Vec3f origin, const Vec3f dir, const Vec3f a, const Vec3f b, const Vec3f c, Real& t)
+	{
+		Vec3f ab, ac, p, s, q;
+		Vec3fSubtract(ab, b, a);
+		Vec3fSubtract(ac, c, a);
+		Vec3fCross(p, dir, ac);
+
+		Real det = Vec3fDot(ab, p);
+		if (Abs(det) < kEps * kEps) {
+			return false;					// the ray is parallel to the triangle
+		}
+		Real ooDet = k1 / det;
+
+		Vec3fSubtract(s, origin, a);
+		Real u = Vec3fDot(s, p) * ooDet;
+		if (u < k0 || u > k1) {
+			return false;
+		}
+
+		Vec3fCross(q, s, ab);
+		Real v = Vec3fDot(dir, q) * ooDet;
+		if (v < k0 || u + v > k1) {
+			return false;
+		}
+
+		t = Vec3fDot(ac, q) * ooDet;
+		return true;
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	Heightfield :: Heightfield(int columns, int rows, Real cellSize, const Vec3f origin, const Real* pHeights) :
+		m_Columns(columns), m_Rows(rows), m_CellSize(cellSize), m_OOCellSize(k1 / cellSize),
+		m_pHeights(pHeights), m_pStorage(0), m_Mapped(false)
+	{
+		Vec3fSet(m_Origin, origin);
+
+		Real minHeight = pHeights[0];
+		Real maxHeight = pHeights[0];
+		for (int i = 1; i < columns * rows; ++i) {
+			minHeight = pHeights[i] < minHeight ? pHeights[i] : minHeight;
+			maxHeight = pHeights[i] > maxHeight ? pHeights[i] : maxHeight;
+		}
+		m_MinHeight = m_Origin[2] + minHeight;
+		m_MaxHeight = m_Origin[2] + maxHeight;
+	}
+
+	Heightfield :: ~Heightfield()
+	{
+	}
+
+	bool Heightfield :: CellRange(Real minX, Real minY, Real maxX, Real maxY, int& i0, int& j0, int& i1, int& j1) const
+	{
+		Real fx0 = (minX - m_Origin[0]) * m_OOCellSize;
+		Real fy0 = (minY - m_Origin[1]) * m_OOCellSize;
+		Real fx1 = (maxX - m_Origin[0]) * m_OOCellSize;
+		Real fy1 = (maxY - m_Origin[1]) * m_OOCellSize;
+		Real lastX = Real(m_Columns - 1);
+		Real lastY = Real(m_Rows - 1);
+
+		if (fx1 < k0 || fy1 < k0 || fx0 >= lastX || fy0 >= lastY) {
+			return false;
+		}
+
+		// clamp before converting, so enormous queries can't overflow an int
+		i0 = fx0 > k0 ? (int) fx0 : 0;
+		j0 = fy0 > k0 ? (int) fy0 : 0;
+		i1 = fx1 < lastX ? (int) fx1 : m_Columns - 2;
+		j1 = fy1 < lastY ? (int) fy1 : m_Rows - 2;
+		return true;
+	}
+
+	void Heightfield :: Triangle(int i, int j, int t, Vec3f& a, Vec3f& b, Vec3f& c) const
+	{
+		const Real* pRow0 = m_pHeights + j * m_Columns + i;
+		const Real* pRow1 = pRow0 + m_Columns;
+		Real x0 = m_Origin[0] + Real(i) * m_CellSize;
+		Real y0 = m_Origin[1] + Real(j) * m_CellSize;
+		Real x1 = x0 + m_CellSize;
+		Real y1 = y0 + m_CellSize;
+		Real z = m_Origin[2];
+
+		a[0] = x0;	a[1] = y0;	a[2] = z + pRow0[0];
+		if (t == 0) {
+			b[0] = x1;	b[1] = y0;	b[2] = z + pRow0[1];
+			c[0] = x1;	c[1] = y1;	c[2] = z + pRow1[1];
+		}
+		else {
+			b[0] = x1;	b[1] = y1;	b[2] = z + pRow1[1];
+			c[0] = x0;	c[1] = y1;	c[2] = z + pRow1[0];
+		}
+	}
+
+	bool Heightfield :: GetHeight(Real x, Real y, Real& height, Vec3f& normal) const
+	{
+		Real fx = (x - m_Origin[0]) * m_OOCellSize;
+		Real fy = (y - m_Origin[1]) * m_OOCellSize;
+		if (fx < k0 || fy < k0 || fx >= Real(m_Columns - 1) || fy >= Real(m_Rows - 1)) {
+			return false;
+		}
+
+		int i = (int) fx;
+		int j = (int) fy;
+		fx -= Real(i);
+		fy -= Real(j);
+
+		const Real* pRow0 = m_pHeights + j * m_Columns + i;
+		const Real* pRow1 = pRow0 + m_Columns;
+		Real dx, dy;
+		if (fx >= fy) {
+			dx = pRow0[1] - pRow0[0];
+			dy = pRow1[1] - pRow0[1];
+		}
+		else {
+			dx = pRow1[1] - pRow1[0];
+			dy = pRow1[0] - pRow0[0];
+		}
+
+		height = m_Origin[2] + pRow0[0] + fx * dx + fy * dy;
+		normal[0] = -dx * m_OOCellSize;
+		normal[1] = -dy * m_OOCellSize;
+		normal[2] = k1;
+		Vec3fNormalize(normal, normal);
+		return true;
+	}
+
+	/*
+		Each triangle under the sphere is tested for its closest point to the center. If the center
+		is behind a triangle whose face it projects onto, the sphere is pushed out along that
+		triangle's normal, otherwise away from the closest point.
+	 */
+
+	bool Heightfield :: SphereContact(const Vec3f center, Real radius, Vec3f& normal, Real& depth) const
+	{
+		if (center[2] - radius > m_MaxHeight) {
+			return false;
+		}
+
+		int i0, j0, i1, j1;
+		if (!CellRange(center[0] - radius, center[1] - radius, center[0] + radius, center[1] + radius, i0, j0, i1, j1)) {
+			return false;
+		}
+
+		bool retval = false;
+		depth = k0;
+
+		for (int j = j0; j <= j1; ++j) {
+			for (int i = i0; i <= i1; ++i) {
+				for (int t = 0; t < 2; ++t) {
+					Vec3f a, b, c, closest, n, offset;
+					Triangle(i, j, t, a, b, c);
+					ClosestPointOnTriangle(closest, center, a, b, c);
+					TriangleNormal(n, a, b, c);
+					Vec3fSubtract(offset, center, closest);
+
+					Real dist = Vec3fLength(offset);
+					Real d;
+					if (Vec3fDot(offset, n) < k0) {
+						d = radius + dist;				// center is under the surface
+						if (d > depth) {
+							Vec3fSet(normal, n);
+						}
+					}
+					else {
+						d = radius - dist;
+						if (d > depth) {
+							if (dist > kEps) {
+								Vec3fSetScaled(normal, k1 / dist, offset);
+							}
+							else {
+								Vec3fSet(normal, n);
+							}
+						}
+					}
+					if (d > depth) {
+						depth = d;
+						retval = true;
+					}
+				}
+			}
+		}
+		return retval;
+	}
+
+	/**
+	 * make room for a plane of normal n and depth d among count full places: of the planes kept and
+	 * the new one, the two that face most nearly the same way are made one, the deeper of them.
+	 *
+	 * @return the place the new plane is to be written to, or -1 if it was the shallower of its two
+	 */
+	static int MergeClosest(Vec3f* pNormals, Real* pDepths, uint32* pTriangles, int count, const Vec3f n, Real d)
+	{
+		int a = 0;
+		int b = count;
+		Real closest = -k2;
+		for (int i = 0; i < count; ++i) {
+			Real dot = Vec3fDot(pNormals[i], n);
+			if (dot > closest) {
+				closest = dot;
+				a = i;
+				b = count;
+			}
+			for (int k = i + 1; k < count; ++k) {
+				dot = Vec3fDot(pNormals[i], pNormals[k]);
+				if (dot > closest) {
+					closest = dot;
+					a = i;
+					b = k;
+				}
+			}
+		}
+
+		if (b == count) {
+			return d > pDepths[a] ? a : -1;
+		}
+		if (pDepths[b] > pDepths[a]) {
+			Vec3fSet(pNormals[a], pNormals[b]);
+			pDepths[a] = pDepths[b];
+			pTriangles[a] = pTriangles[b];
+		}
+		return b;
+	}
+
+	/*
+		The triangles are measured as in SphereContact, but each plane keeps only its deepest
+		triangle, so that a sphere resting on flat ground of small cells is one contact, not one
+		for each triangle under it. What is found then is where the sphere is wedged: the faces of
+		a hollow or a crease, or the sides of a ridge. A sphere in a hollow of small cells may be
+		in more planes than there is room for; then the two closest in direction share a place,
+		so that those kept still face every way the sphere is held from, not just the way the
+		cells were searched first.
+	 */
+
+	int Heightfield :: SphereContacts(const Vec3f center, Real radius, Vec3f* pNormals, Real* pDepths, uint32* pTriangles, int max) const
+	{
+		if (center[2] - radius > m_MaxHeight) {
+			return 0;
+		}
+
+		int i0, j0, i1, j1;
+		if (!CellRange(center[0] - radius, center[1] - radius, center[0] + radius, center[1] + radius, i0, j0, i1, j1)) {
+			return 0;
+		}
+
+		int count = 0;
+		for (int j = j0; j <= j1; ++j) {
+			for (int i = i0; i <= i1; ++i) {
+				for (int t = 0; t < 2; ++t) {
+					Vec3f a, b, c, closest, n, offset;
+					Triangle(i, j, t, a, b, c);
+					ClosestPointOnTriangle(closest, center, a, b, c);
+					TriangleNormal(n, a, b, c);
+					Vec3fSubtract(offset, center, closest);
+
+					Real dist = Vec3fLength(offset);
+					Real d = Vec3fDot(offset, n) < k0 ? radius + dist : radius - dist;
+					if (d <= k0) {
+						continue;
+					}
+
+					int k;
+					for (k = 0; k < count && !Vec3fEqual(pNormals[k], n, kEps); ++k) {
+					}
+					if (k == count && count == max) {
+						k = MergeClosest(pNormals, pDepths, pTriangles, count, n, d);
+						if (k < 0) {
+							continue;
+						}
+					}
+					else if (k == count) {
+						++count;
+					}
+					else if (d <= pDepths[k]) {
+						continue;
+					}
+					Vec3fSet(pNormals[k], n);
+					pDepths[k] = d;
+					pTriangles[k] = (uint32) ((j * (m_Columns - 1) + i) * 2 + t);
+				}
+			}
+		}
+		return count;
+	}
+
+	/*
+		The sphere hits a face first where its distance to the face's plane falls to the radius,
+		exactly as in Collide_InfPlane_Sphere, if the point of contact is inside the face. If no
+		face is hit that way, the sphere may still end up touching an edge or a vertex; the time
+		of that contact is found by bisection.
+	 */
+
+	bool Heightfield :: SweepSphere(const Vec3f c0, const Vec3f c1, Real radius, Real& u, Vec3f& normal) const
+	{
+		Real depth;
+		if (SphereContact(c0, radius, normal, depth)) {
+			u = k0;
+			return true;
+		}
+
+		Real minZ = c0[2] < c1[2] ? c0[2] : c1[2];
+		if (minZ - radius > m_MaxHeight) {
+			return false;
+		}
+
+		int i0, j0, i1, j1;
+		Real minX = (c0[0] < c1[0] ? c0[0] : c1[0]) - radius;
+		Real minY = (c0[1] < c1[1] ? c0[1] : c1[1]) - radius;
+		Real maxX = (c0[0] > c1[0] ? c0[0] : c1[0]) + radius;
+		Real maxY = (c0[1] > c1[1] ? c0[1] : c1[1]) + radius;
+		if (!CellRange(minX, minY, maxX, maxY, i0, j0, i1, j1)) {
+			return false;
+		}
+
+		Vec3f motion;
+		Vec3fSubtract(motion, c1, c0);
+
+		bool retval = false;
+		u = k1;
+
+		for (int j = j0; j <= j1; ++j) {
+			for (int i = i0; i <= i1; ++i) {
+				for (int t = 0; t < 2; ++t) {
+					Vec3f a, b, c, n, p;
+					Triangle(i, j, t, a, b, c);
+					TriangleNormal(n, a, b, c);
+
+					Real planeD = -Vec3fDot(n, a);
+					Real d0 = Vec3fDot(n, c0) + planeD;
+					Real d1 = Vec3fDot(n, c1) + planeD;
+					if (d0 > radius && d1 < radius) {
+						Real hit = (d0 - radius) / (d0 - d1);
+						if (hit < u || !retval) {
+							Vec3fSet(p, c0);
+							Vec3fMultiplyAccumulate(p, hit, motion);
+							Vec3fMultiplyAccumulate(p, -radius, n);
+							if (InsideXY(p, a, b, c)) {
+								u = hit;
+								Vec3fSet(normal, n);
+								retval = true;
+							}
+						}
+					}
+				}
+			}
+		}
+
+		if (retval || !SphereContact(c1, radius, normal, depth)) {
+			return retval;
+		}
+
+		// an edge or vertex was hit; c0 is clear and c1 is not
+		Real lo = k0;
+		Real hi = k1;
+		for (int k = 0; k < kSweepRefinements; ++k) {
+			Real mid = kHalf * (lo + hi);
+			Vec3f p;
+			Vec3fSet(p, c0);
+			Vec3fMultiplyAccumulate(p, mid, motion);
+			Vec3f n;
+			if (SphereContact(p, radius, n, depth)) {
+				hi = mid;
+				Vec3fSet(normal, n);
+			}
+			else {
+				lo = mid;
+			}
+		}
+		u = lo;
+		return true;
+	}
+
+	/*
+		The ray is clipped to the bounds of the surface, then walks the cells under it in order,
+		stepping to whichever cell boundary it crosses next. A triangle's hits lie over its own
+		cell, so the first cell with a hit holds the nearest one.
+	 */
+
+	bool Heightfield :: RayCast(const Vec3f origin, const Vec3f dir, Real maxT, Real& t, Vec3f& normal) const
+	{
+		Real boundsMin[3] = { m_Origin[0], m_Origin[1], m_MinHeight };
+		Real boundsMax[3] = { m_Origin[0] + Real(m_Columns - 1) * m_CellSize, m_Origin[1] + Real(m_Rows - 1) * m_CellSize, m_MaxHeight };
+		Real tEnter = k0;
+		Real tExit = maxT;
+
+		for (int axis = 0; axis < 3; ++axis) {
+			if (Abs(dir[axis]) < kEps) {
+				if (origin[axis] < boundsMin[axis] || origin[axis] > boundsMax[axis]) {
+					return false;
+				}
+			}
+			else {
+				Real ooDir = k1 / dir[axis];
+				Real t0 = (boundsMin[axis] - origin[axis]) * ooDir;
+				Real t1 = (boundsMax[axis] - origin[axis]) * ooDir;
+				if (t0 > t1) {
+					Real temp = t0;
+					t0 = t1;
+					t1 = temp;
+				}
+				tEnter = t0 > tEnter ? t0 : tEnter;
+				tExit = t1 < tExit ? t1 : tExit;
+				if (tEnter > tExit) {
+					return false;
+				}
+			}
+		}
+
+		// the cell the ray enters, and when it crosses the next column and row boundaries
+
+		Real fx = (origin[0] + tEnter * dir[0] - m_Origin[0]) * m_OOCellSize;
+		Real fy = (origin[1] + tEnter * dir[1] - m_Origin[1]) * m_OOCellSize;
+		int i = fx > k0 ? (int) fx : 0;
+		int j = fy > k0 ? (int) fy : 0;
+		i = i < m_Columns - 2 ? i : m_Columns - 2;
+		j = j < m_Rows - 2 ? j : m_Rows - 2;
+
+		int stepI = 0;
+		int stepJ = 0;
+		Real nextX = kFar;
+		Real nextY = kFar;
+		Real deltaX = kFar;
+		Real deltaY = kFar;
+		if (Abs(dir[0]) >= kEps) {
+			stepI = dir[0] > k0 ? 1 : -1;
+			deltaX = m_CellSize / Abs(dir[0]);
+			nextX = (m_Origin[0] + Real(dir[0] > k0 ? i + 1 : i) * m_CellSize - origin[0]) / dir[0];
+		}
+		if (Abs(dir[1]) >= kEps) {
+			stepJ = dir[1] > k0 ? 1 : -1;
+			deltaY = m_CellSize / Abs(dir[1]);
+			nextY = (m_Origin[1] + Real(dir[1] > k0 ? j + 1 : j) * m_CellSize - origin[1]) / dir[1];
+		}
+
+		for (;;) {
+			bool hit = false;
+			for (int tri = 0; tri < 2; ++tri) {
+				Vec3f a, b, c;
+				Real u;
+				Triangle(i, j, tri, a, b, c);
+				if (RayTriangle(origin, dir, a, b, c, u) && u >= k0 && u <= maxT && (!hit || u < t)) {
+					t = u;
+					TriangleNormal(normal, a, b, c);
+					hit = true;
+				}
+			}
+			if (hit) {
+				if (Vec3fDot(normal, dir) > k0) {
+					Vec3fNegate(normal);			// hit from underneath
+				}
+				return true;
+			}
+
+			if (nextX < nextY) {
+				i += stepI;
+				if (nextX > tExit || i < 0 || i > m_Columns - 2) {
+					return false;
+				}
+				nextX += deltaX;
+			}
+			else {
+				j += stepJ;
+				if (nextY > tExit || j < 0 || j > m_Rows - 2) {
+					return false;
+				}
+				nextY += deltaY;
+			}
+		}
+	}
+
+	/*
+		The terrain is solid beneath its surface, so a box overlaps it if its bottom is below any
+		of the samples around the cells under it. Including the samples at the corners of those
+		cells makes the test slightly conservative.
+	 */
+
+	bool Heightfield :: OverlapsBox(const Vec3f boxMin, const Vec3f boxMax) const
+	{
+		if (boxMin[2] > m_MaxHeight) {
+			return false;
+		}
+
+		int i0, j0, i1, j1;
+		if (!CellRange(boxMin[0], boxMin[1], boxMax[0], boxMax[1], i0, j0, i1, j1)) {
+			return false;
+		}
+
+		Real minZ = boxMin[2] - m_Origin[2];
+		for (int j = j0; j <= j1 + 1; ++j) {
+			const Real* pRow = m_pHeights + j * m_Columns;
+			for (int i = i0; i <= i1 + 1; ++i) {
+				if (pRow[i] >= minZ) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+}	// end namespace Collision
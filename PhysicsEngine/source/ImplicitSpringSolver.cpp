@@ -0,0 +1,299 @@
+
+/** @file ImplicitSpringSolver.cpp
+	@brief	backward Euler integration of stiff springs, by preconditioned conjugate gradients */
+
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#include "ImplicitSpringSolver.h"
+#include "PhysicsThread.h"
+
+using namespace Physics;
+using PMath::Vec3f;
+
+static const int kMinLinkBatch	= 256;		// smallest number of springs worth handing to another thread
+static const int kMinPointBatch	= 256;
+
+ImplicitSpringSolver :: ImplicitSpringSolver() : m_MaxIterations(32), m_Tolerance(Real(1.0e-3f)), m_Dt(k0),
+	m_pThreads(0), m_NumPoints(0), m_pIn(0)
+{
+}
+
+void ImplicitSpringSolver :: SetIterations(int maxIterations, Real tolerance)
+{
+	m_MaxIterations = maxIterations > 0 ? maxIterations : 1;
+	m_Tolerance = tolerance;
+}
+
+void ImplicitSpringSolver :: Reset(int numPoints)
+{
+	m_NumPoints = numPoints;
+	m_X.resize(numPoints * 3);
+	m_V.resize(numPoints * 3);
+	m_F.resize(numPoints * 3);
+	m_OOMass.resize(numPoints);
+	m_Links.clear();
+}
+
+void ImplicitSpringSolver :: SetPoint(int i, const Vec3f pos, const Vec3f vel, Real ooMass, const Vec3f force)
+{
+	for (int j = 0; j < 3; ++j) {
+		m_X[i * 3 + j] = pos[j];
+		m_V[i * 3 + j] = vel[j];
+		m_F[i * 3 + j] = force[j];
+	}
+	m_OOMass[i] = ooMass;
+}
+
+void ImplicitSpringSolver :: AddSpring(int a, int b, Real restLength, Real stiffness, Real damping, bool resistCompression)
+{
+	Link link;
+	link.m_A					= a;
+	link.m_B					= b;
+	link.m_RestLength			= restLength;
+	link.m_Stiffness			= stiffness;
+	link.m_Damping				= damping;
+	link.m_ResistCompression	= resistCompression;
+	m_Links.push_back(link);
+}
+
+void ImplicitSpringSolver :: Run(int count, void (*job)(void*, int, int), int minBatch)
+{
+	if (m_pThreads != 0) {
+		m_pThreads->Run(count, job, this, minBatch);
+	}
+	else {
+		job(this, 0, count);
+	}
+}
+
+void ImplicitSpringSolver :: BuildAdjacency()
+{
+	int links = (int) m_Links.size();
+
+	// counting sort of the link ends by point
+	m_AdjStart.assign(m_NumPoints + 1, 0);
+	int i;
+	for (i = 0; i < links; ++i) {
+		++m_AdjStart[m_Links[i].m_A + 1];
+		++m_AdjStart[m_Links[i].m_B + 1];
+	}
+	for (i = 0; i < m_NumPoints; ++i) {
+		m_AdjStart[i + 1] += m_AdjStart[i];
+	}
+
+	m_Adj.resize(links * 2);
+	std::vector<int> fill(m_AdjStart.begin(), m_AdjStart.end() - 1);
+	for (i = 0; i < links; ++i) {
+		m_Adj[fill[m_Links[i].m_A]++] = i * 2;
+		m_Adj[fill[m_Links[i].m_B]++] = i * 2 + 1;
+	}
+}
+
+Real ImplicitSpringSolver :: Dot(const std::vector<Real>& a, const std::vector<Real>& b) const
+{
+	Real sum = k0;
+	int count = m_NumPoints * 3;
+	for (int i = 0; i < count; ++i) {
+		sum += a[i] * b[i];
+	}
+	return sum;
+}
+
+void ImplicitSpringSolver :: LinearizeRange(void* pData, int begin, int end)
+{
+	ImplicitSpringSolver* pSolver = (ImplicitSpringSolver*) pData;
+	Real dt = pSolver->m_Dt;
+
+	for (int i = begin; i < end; ++i) {
+		Link& link = pSolver->m_Links[i];
+		const Real* xa = &pSolver->m_X[link.m_A * 3];
+		const Real* xb = &pSolver->m_X[link.m_B * 3];
+		const Real* va = &pSolver->m_V[link.m_A * 3];
+		const Real* vb = &pSolver->m_V[link.m_B * 3];
+
+		Vec3f n, dv;
+		PMath::Vec3fSubtract(n, xa, xb);
+		PMath::Vec3fSubtract(dv, va, vb);
+		Real length = PMath::Vec3fLength(n);
+		Real stretch = length - link.m_RestLength;
+
+		if (length < kEps || (stretch < k0 && !link.m_ResistCompression)) {
+			for (int j = 0; j < 6; ++j) {
+				link.m_S[j] = k0;
+			}
+			PMath::Vec3fZero(link.m_Term);
+			continue;
+		}
+		PMath::Vec3fScale(n, k1 / length);
+
+		// force on a; Hooke's law plus damping along the spring
+		Real magnitude = -link.m_Stiffness * stretch - link.m_Damping * PMath::Vec3fDot(dv, n);
+
+		// -df/dx = k * (nn' + c * (I - nn')), with c clamped at zero for a compressed spring
+		Real c = k1 - link.m_RestLength / length;
+		if (c < k0) {
+			c = k0;
+		}
+		Real kn = dt * dt * link.m_Stiffness * (k1 - c) + dt * link.m_Damping;	// along nn', including -dt * df/dv = dt * b * nn'
+		Real ki = dt * dt * link.m_Stiffness * c;									// along I
+
+		link.m_S[0] = ki + kn * n[0] * n[0];
+		link.m_S[1] = ki + kn * n[1] * n[1];
+		link.m_S[2] = ki + kn * n[2] * n[2];
+		link.m_S[3] = kn * n[0] * n[1];
+		link.m_S[4] = kn * n[0] * n[2];
+		link.m_S[5] = kn * n[1] * n[2];
+
+		// right hand side term for a, f + dt * df/dx * (va - vb); -dt * df/dx is the stiffness part of S, divided by dt
+		Real kx = dt * link.m_Stiffness;
+		Real kxn = kx * (k1 - c) * PMath::Vec3fDot(n, dv);
+		for (int j = 0; j < 3; ++j) {
+			link.m_Term[j] = magnitude * n[j] - (kx * c * dv[j] + kxn * n[j]);
+		}
+	}
+}
+
+void ImplicitSpringSolver :: GatherRhsRange(void* pData, int begin, int end)
+{
+	ImplicitSpringSolver* pSolver = (ImplicitSpringSolver*) pData;
+	Real dt = pSolver->m_Dt;
+
+	for (int i = begin; i < end; ++i) {
+		Real* r		= &pSolver->m_R[i * 3];
+		Real* diag	= &pSolver->m_Diag[i * 3];
+		if (pSolver->m_OOMass[i] <= k0) {
+			PMath::Vec3fZero(*(Vec3f*) r);				// fixed points don't move
+			diag[0] = diag[1] = diag[2] = k1;
+			continue;
+		}
+
+		Vec3f f;
+		PMath::Vec3fSet(f, &pSolver->m_F[i * 3]);
+		Real mass = k1 / pSolver->m_OOMass[i];
+		diag[0] = diag[1] = diag[2] = mass;
+
+		for (int j = pSolver->m_AdjStart[i]; j < pSolver->m_AdjStart[i + 1]; ++j) {
+			Link& link = pSolver->m_Links[pSolver->m_Adj[j] >> 1];
+			PMath::Vec3fMultiplyAccumulate(f, (pSolver->m_Adj[j] & 1) ? -k1 : k1, link.m_Term);
+			diag[0] += link.m_S[0];
+			diag[1] += link.m_S[1];
+			diag[2] += link.m_S[2];
+		}
+		PMath::Vec3fScale(*(Vec3f*) r, dt, f);
+	}
+}
+
+void ImplicitSpringSolver :: MultiplyLinkRange(void* pData, int begin, int end)
+{
+	ImplicitSpringSolver* pSolver = (ImplicitSpringSolver*) pData;
+	const Real* pIn = pSolver->m_pIn;
+
+	for (int i = begin; i < end; ++i) {
+		Link& link = pSolver->m_Links[i];
+		const Real* s = link.m_S;
+		Vec3f y;
+		PMath::Vec3fSubtract(y, &pIn[link.m_A * 3], &pIn[link.m_B * 3]);
+		link.m_Term[0] = s[0] * y[0] + s[3] * y[1] + s[4] * y[2];
+		link.m_Term[1] = s[3] * y[0] + s[1] * y[1] + s[5] * y[2];
+		link.m_Term[2] = s[4] * y[0] + s[5] * y[1] + s[2] * y[2];
+	}
+}
+
+void ImplicitSpringSolver :: GatherProductRange(void* pData, int begin, int end)
+{
+	ImplicitSpringSolver* pSolver = (ImplicitSpringSolver*) pData;
+	const Real* pIn = pSolver->m_pIn;
+
+	for (int i = begin; i < end; ++i) {
+		Real* q = &pSolver->m_Q[i * 3];
+		if (pSolver->m_OOMass[i] <= k0) {
+			PMath::Vec3fZero(*(Vec3f*) q);
+			continue;
+		}
+
+		PMath::Vec3fScale(*(Vec3f*) q, k1 / pSolver->m_OOMass[i], &pIn[i * 3]);
+		for (int j = pSolver->m_AdjStart[i]; j < pSolver->m_AdjStart[i + 1]; ++j) {
+			Link& link = pSolver->m_Links[pSolver->m_Adj[j] >> 1];
+			PMath::Vec3fMultiplyAccumulate(*(Vec3f*) q, (pSolver->m_Adj[j] & 1) ? -k1 : k1, link.m_Term);
+		}
+	}
+}
+
+int ImplicitSpringSolver :: Solve(Real dt, ThreadPool* pThreads)
+{
+	m_Dt = dt;
+	m_pThreads = pThreads;
+
+	int count = m_NumPoints * 3;
+	m_DV.assign(count, k0);
+	m_R.resize(count);
+	m_Z.resize(count);
+	m_P.resize(count);
+	m_Q.resize(count);
+	m_Diag.resize(count);
+
+	BuildAdjacency();
+	Run((int) m_Links.size(), LinearizeRange, kMinLinkBatch);
+	Run(m_NumPoints, GatherRhsRange, kMinPointBatch);
+
+	// preconditioned conjugate gradients, starting from dv = 0
+	int i;
+	for (i = 0; i < count; ++i) {
+		m_Z[i] = m_R[i] / m_Diag[i];
+		m_P[i] = m_Z[i];
+	}
+	Real rz = Dot(m_R, m_Z);
+	Real limit = rz * m_Tolerance * m_Tolerance;
+
+	int iterations = 0;
+	while (iterations < m_MaxIterations && rz > limit && rz > k0) {
+		m_pIn = &m_P[0];
+		Run((int) m_Links.size(), MultiplyLinkRange, kMinLinkBatch);
+		Run(m_NumPoints, GatherProductRange, kMinPointBatch);
+
+		Real pq = Dot(m_P, m_Q);
+		if (pq <= k0) {
+			break;
+		}
+		Real alpha = rz / pq;
+		for (i = 0; i < count; ++i) {
+			m_DV[i] += alpha * m_P[i];
+			m_R[i] -= alpha * m_Q[i];
+			m_Z[i] = m_R[i] / m_Diag[i];
+		}
+
+		Real rzNext = Dot(m_R, m_Z);
+		Real beta = rzNext / rz;
+		rz = rzNext;
+		for (i = 0; i < count; ++i) {
+			m_P[i] = m_Z[i] + beta * m_P[i];
+		}
+		++iterations;
+	}
+
+	return iterations;
+}
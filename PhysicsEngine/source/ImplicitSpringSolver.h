@@ -0,0 +1,127 @@
+
+/** @file ImplicitSpringSolver.h
+
+	an internal implementation file, backward Euler integration of stiff springs
+ */
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#ifndef _IMPLICITSPRINGSOLVER_H_
+#define _IMPLICITSPRINGSOLVER_H_
+
+#include <vector>
+
+#include "PhysicsEngineDef.h"
+
+namespace Physics {
+
+	class ThreadPool;
+
+	/** @class	ImplicitSpringSolver
+		@brief	Solves for the velocity change of a network of springs over one backward Euler step
+
+		Following Baraff and Witkin, "Large Steps in Cloth Simulation", the velocity change dv satisfies
+
+			(M - dt * df/dv - dt^2 * df/dx) dv = dt * (f + dt * df/dx * v)
+
+		The springs' force Jacobians are linearized at the start of the step, with the stiffness of a
+		compressed spring clamped to keep the system positive definite, and the system is solved by
+		conjugate gradients with a Jacobi preconditioner. The matrix is never assembled; each spring's
+		3x3 block is kept, and the product with a vector is computed per spring, then gathered per point.
+		Both passes run on the thread pool. Points with zero inverse mass are fixed, their dv is zero.
+	 */
+
+	class ImplicitSpringSolver
+	{
+	public:
+		ImplicitSpringSolver();
+
+		/// @param maxIterations	most conjugate gradient iterations per solve
+		/// @param tolerance		stop when the preconditioned residual falls to this fraction of its initial value
+		void	SetIterations(int maxIterations, Real tolerance);
+		int		GetIterations() const				{ return m_MaxIterations; }
+		Real	GetTolerance() const				{ return m_Tolerance; }
+
+		/// forget all points and springs, and make room for numPoints points
+		void	Reset(int numPoints);
+
+		/// @param force the external force on the point, the springs' forces are added by Solve
+		void	SetPoint(int i, const PMath::Vec3f pos, const PMath::Vec3f vel, Real ooMass, const PMath::Vec3f force);
+
+		void	AddSpring(int a, int b, Real restLength, Real stiffness, Real damping, bool resistCompression);
+
+		/**
+		* Solve for the points' velocity changes over dt
+		*
+		* @param pThreads	runs the per spring and per point passes, may be 0
+		* @return			the number of conjugate gradient iterations performed
+		*/
+		int		Solve(Real dt, ThreadPool* pThreads);
+
+		/// @return the velocity change of point i, valid after Solve
+		const Real*	GetVelocityChange(int i) const	{ return &m_DV[i * 3]; }
+
+	protected:
+		/// a spring, and its linearization for the current solve
+		class Link {
+		public:
+			int		m_A, m_B;
+			Real	m_RestLength, m_Stiffness, m_Damping;
+			bool	m_ResistCompression;
+			Real	m_S[6];			//!< symmetric block -dt * df/dv - dt^2 * df/dx: xx, yy, zz, xy, xz, yz
+			Real	m_Term[3];		//!< per spring scratch, added to point a and subtracted from point b
+		};
+
+		void		Run(int count, void (*job)(void*, int, int), int minBatch);
+		void		BuildAdjacency();
+		Real		Dot(const std::vector<Real>& a, const std::vector<Real>& b) const;
+
+		static void	LinearizeRange(void* pData, int begin, int end);		///< per spring: forces, right hand side terms, blocks
+		static void	GatherRhsRange(void* pData, int begin, int end);		///< per point: right hand side and preconditioner
+		static void	MultiplyLinkRange(void* pData, int begin, int end);		///< per spring: block times m_pIn
+		static void	GatherProductRange(void* pData, int begin, int end);	///< per point: m_Q = A * m_pIn
+
+		int					m_MaxIterations;
+		Real				m_Tolerance;
+		Real				m_Dt;
+		ThreadPool*			m_pThreads;
+
+		int					m_NumPoints;
+		std::vector<Real>	m_X, m_V, m_F;				//!< 3 per point
+		std::vector<Real>	m_OOMass;					//!< 1 per point
+		std::vector<Link>	m_Links;
+
+		std::vector<int>	m_AdjStart;					//!< first entry of each point in m_Adj; one extra at the end
+		std::vector<int>	m_Adj;						//!< link index * 2, plus one if the point is the link's b end
+
+		std::vector<Real>	m_DV, m_R, m_Z, m_P, m_Q;	//!< conjugate gradient vectors, 3 per point
+		std::vector<Real>	m_Diag;						//!< Jacobi preconditioner, 3 per point
+		const Real*			m_pIn;						//!< the vector being multiplied
+	};
+
+}	// end Physics namespace
+
+#endif
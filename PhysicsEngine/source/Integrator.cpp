@@ -0,0 +1,141 @@
+
+/** @file Integrator.cpp
+	@brief	the loops that step each category of bodies */
+
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#include "Integrator.h"
+#include "SpringMesh.h"
+
+namespace Physics {
+
+	/** @class	BucketLoops
+		@brief	One category's loops, with the scheme and flags fixed, so each body's update is inlined
+	 */
+
+	template <class Scheme, bool kTranslate, bool kSpin>
+	class BucketLoops
+	{
+	public:
+		static void Reset(std::vector<RigidBody*>& bodies)
+		{
+			RigidBody** ppBody = bodies.empty() ? 0 : &bodies[0];
+			for (int i = 0, count = (int) bodies.size(); i < count; ++i) {
+				ppBody[i]->Reset<kTranslate, kSpin>();
+			}
+		}
+
+		static void Integrate1(std::vector<RigidBody*>& bodies, Real dt, const PMath::Vec3f)
+		{
+			RigidBody** ppBody = bodies.empty() ? 0 : &bodies[0];
+			for (int i = 0, count = (int) bodies.size(); i < count; ++i) {
+				ppBody[i]->Integrate1<Scheme, kTranslate, kSpin>(dt);
+			}
+		}
+
+		static void Integrate2(std::vector<RigidBody*>& bodies, Real dt, const PMath::Vec3f gravity)
+		{
+			RigidBody** ppBody = bodies.empty() ? 0 : &bodies[0];
+			for (int i = 0, count = (int) bodies.size(); i < count; ++i) {
+				ppBody[i]->Integrate2<Scheme, kTranslate, kSpin>(dt, gravity);
+			}
+		}
+	};
+
+	/** @class	SpringMeshLoops
+		@brief	Spring meshes step their own points, whatever scheme they were given
+	 */
+
+	class SpringMeshLoops
+	{
+	public:
+		static void Reset(std::vector<RigidBody*>& bodies)
+		{
+			for (int i = 0, count = (int) bodies.size(); i < count; ++i) {
+				((SpringMesh*) bodies[i])->ResetForNextTimeStep();
+			}
+		}
+
+		static void Integrate1(std::vector<RigidBody*>& bodies, Real dt, const PMath::Vec3f gravity)
+		{
+			for (int i = 0, count = (int) bodies.size(); i < count; ++i) {
+				((SpringMesh*) bodies[i])->Integrate1(dt, (Real*) gravity);
+			}
+		}
+
+		static void Integrate2(std::vector<RigidBody*>& bodies, Real dt, const PMath::Vec3f gravity)
+		{
+			for (int i = 0, count = (int) bodies.size(); i < count; ++i) {
+				((SpringMesh*) bodies[i])->Integrate2(dt, (Real*) gravity);
+			}
+		}
+	};
+
+	/** @class	ArticulatedLoops
+		@brief	The links of articulations only start each substep afresh; their articulations move them
+	 */
+
+	class ArticulatedLoops
+	{
+	public:
+		static void Reset(std::vector<RigidBody*>& bodies)
+		{
+			for (int i = 0, count = (int) bodies.size(); i < count; ++i) {
+				bodies[i]->m_StateT0 = bodies[i]->m_StateT1;
+				bodies[i]->m_Collided = false;
+			}
+		}
+
+		static void Integrate(std::vector<RigidBody*>&, Real, const PMath::Vec3f)
+		{
+		}
+	};
+
+	#define BUCKET(scheme, translate, spin) \
+		{ BucketLoops<scheme, translate, spin>::Reset, BucketLoops<scheme, translate, spin>::Integrate1, BucketLoops<scheme, translate, spin>::Integrate2 }
+
+	// in the order of BodyCategory: scheme * 4 + translatable + spinnable * 2
+	const BucketUpdate kBucketUpdates[kNumBodyCategories] = {
+		BUCKET(VerletScheme,			false,	false),
+		BUCKET(VerletScheme,			true,	false),
+		BUCKET(VerletScheme,			false,	true),
+		BUCKET(VerletScheme,			true,	true),
+		BUCKET(SemiImplicitEulerScheme,	false,	false),
+		BUCKET(SemiImplicitEulerScheme,	true,	false),
+		BUCKET(SemiImplicitEulerScheme,	false,	true),
+		BUCKET(SemiImplicitEulerScheme,	true,	true),
+		BUCKET(VerletRK4RotationScheme,	false,	false),
+		BUCKET(VerletRK4RotationScheme,	true,	false),
+		BUCKET(VerletRK4RotationScheme,	false,	true),
+		BUCKET(VerletRK4RotationScheme,	true,	true),
+		{ SpringMeshLoops::Reset, SpringMeshLoops::Integrate1, SpringMeshLoops::Integrate2 },
+		{ ArticulatedLoops::Reset, ArticulatedLoops::Integrate, ArticulatedLoops::Integrate }
+	};
+
+	#undef BUCKET
+
+}	// end namespace Physics
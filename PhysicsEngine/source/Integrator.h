@@ -0,0 +1,293 @@
+
+/** @file Integrator.h
+
+	an internal implementation file, the schemes rigid bodies are stepped with
+ */
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#ifndef _INTEGRATOR_H_
+#define _INTEGRATOR_H_
+
+#include <vector>
+
+#include "RigidBody.h"
+
+namespace Physics {
+
+	/*
+		A substep resets each body, integrates the first half of its step, gathers the spring
+		and field forces, then integrates the second half. A scheme supplies the two halves for
+		position (Drift, Kick) and for orientation (Turn, Twist), and RigidBody's Integrate1 and
+		Integrate2 are instantiated for each scheme and each combination of the body's
+		translatable and spinnable flags, so the flags are tested once per bucket of bodies
+		rather than once per body per substep.
+	 */
+
+	/// set the angular velocity from the angular momentum; the tensor is diagonal, so world and local space agree
+	inline void SpinFromMomentum(PMath::Vec3f& result, const PMath::Vec3f momentum, const PMath::Vec3f itd, bool sphere)
+	{
+		if (sphere) {
+			PMath::Vec3fSetScaled(result, itd[0], momentum);
+		}
+		else {
+			PMath::Vec3fMultiply(result, itd, momentum);
+		}
+	}
+
+	/** @class	VerletScheme
+		@brief	Velocity Verlet; the velocity takes half of the previous acceleration before the move, and half of the new one after
+	 */
+
+	class VerletScheme
+	{
+	public:
+		static void Drift(DynamicState& s, const PMath::Vec3f accelPrev, Real dt)
+		{
+			PMath::Vec3fMultiplyAccumulate(s.m_Velocity, dt * kHalf,		accelPrev);			// v += 1/2 a * t
+			PMath::Vec3fMultiplyAccumulate(s.m_Position, dt,				s.m_Velocity);		// pos += v * dt
+			PMath::Vec3fMultiplyAccumulate(s.m_Position, kHalf * dt * dt,	accelPrev);			// pos += 1/2 a * t * t
+		}
+
+		static void Kick(DynamicState& s, const PMath::Vec3f accel, Real dt)
+		{
+			PMath::Vec3fMultiplyAccumulate(s.m_Velocity, dt * kHalf, accel);					// v += 1/2 a * t
+		}
+
+		static void Turn(DynamicState& s, const PMath::Vec3f torquePrev, const PMath::Vec3f itd, bool sphere, Real dt)
+		{
+			PMath::Vec3fMultiplyAccumulate(s.m_AngularMomentum, dt * kHalf, torquePrev);		// L += 1/2 T * t
+			SpinFromMomentum(s.m_AngularVelocity, s.m_AngularMomentum, itd, sphere);
+			PMath::QuatInputAngularVelocity(s.m_Orientation, dt, s.m_Orientation, s.m_AngularVelocity);	// R += t * angular velocity
+		}
+
+		static void Twist(DynamicState& s, const PMath::Vec3f torque, const PMath::Vec3f, bool, Real dt)
+		{
+			PMath::Vec3fMultiplyAccumulate(s.m_AngularMomentum, dt * kHalf, torque);			// L += 1/2 T * t
+		}
+	};
+
+	/** @class	SemiImplicitEulerScheme
+		@brief	Symplectic Euler; the whole step happens after the forces, moving with the new velocity
+
+		Cheaper than Verlet, and as stable for the same step, but only first order accurate.
+	 */
+
+	class SemiImplicitEulerScheme
+	{
+	public:
+		static void Drift(DynamicState&, const PMath::Vec3f, Real)
+		{
+		}
+
+		static void Kick(DynamicState& s, const PMath::Vec3f accel, Real dt)
+		{
+			PMath::Vec3fMultiplyAccumulate(s.m_Velocity, dt, accel);							// v += a * t
+			PMath::Vec3fMultiplyAccumulate(s.m_Position, dt, s.m_Velocity);						// pos += v * t
+		}
+
+		static void Turn(DynamicState&, const PMath::Vec3f, const PMath::Vec3f, bool, Real)
+		{
+		}
+
+		static void Twist(DynamicState& s, const PMath::Vec3f torque, const PMath::Vec3f itd, bool sphere, Real dt)
+		{
+			PMath::Vec3fMultiplyAccumulate(s.m_AngularMomentum, dt, torque);					// L += T * t
+			SpinFromMomentum(s.m_AngularVelocity, s.m_AngularMomentum, itd, sphere);
+			PMath::QuatInputAngularVelocity(s.m_Orientation, dt, s.m_Orientation, s.m_AngularVelocity);
+		}
+	};
+
+	/** @class	VerletRK4RotationScheme
+		@brief	Velocity Verlet, with the orientation carried through the step by fourth order Runge-Kutta
+
+		The forces are gathered once per substep, so position can gain nothing from Runge-Kutta over
+		Verlet, which is exact for a constant acceleration. The orientation is another matter: the
+		first order quaternion update of the other schemes drifts for quickly spinning bodies, so here
+		dq/dt = 1/2 w q is integrated in four stages, with w following the momentum through the step.
+	 */
+
+	class VerletRK4RotationScheme : public VerletScheme
+	{
+	public:
+		static void Turn(DynamicState& s, const PMath::Vec3f torquePrev, const PMath::Vec3f itd, bool sphere, Real dt)
+		{
+			PMath::Vec3f wStart, wMid, wEnd, momentum;
+			SpinFromMomentum(wStart, s.m_AngularMomentum, itd, sphere);
+			PMath::Vec3fSet(momentum, s.m_AngularMomentum);
+			PMath::Vec3fMultiplyAccumulate(momentum, dt, torquePrev);
+			SpinFromMomentum(wEnd, momentum, itd, sphere);
+
+			PMath::Vec3fMultiplyAccumulate(s.m_AngularMomentum, dt * kHalf, torquePrev);		// L += 1/2 T * t
+			SpinFromMomentum(wMid, s.m_AngularMomentum, itd, sphere);
+			PMath::Vec3fSet(s.m_AngularVelocity, wMid);
+
+			PMath::Quaternion d1, d2, d3, d4, q;
+			Spin(d1, wStart, s.m_Orientation);
+			Stage(q, s.m_Orientation, dt * kHalf, d1);
+			Spin(d2, wMid, q);
+			Stage(q, s.m_Orientation, dt * kHalf, d2);
+			Spin(d3, wMid, q);
+			Stage(q, s.m_Orientation, dt, d3);
+			Spin(d4, wEnd, q);
+
+			Real sixth = dt / Real(6.0f);
+			for (int i = 0; i < 4; ++i) {
+				s.m_Orientation[i] += sixth * (d1[i] + d2[i] + d2[i] + d3[i] + d3[i] + d4[i]);
+			}
+			PMath::QuatNormalize(s.m_Orientation, s.m_Orientation);
+		}
+
+	protected:
+		/// dq/dt = 1/2 w q
+		static void Spin(PMath::Quaternion& result, const PMath::Vec3f w, const PMath::Quaternion q)
+		{
+			PMath::Quaternion velquat;
+			velquat[0] = w[0];
+			velquat[1] = w[1];
+			velquat[2] = w[2];
+			velquat[3] = k0;
+			PMath::QuatMultiply(result, velquat, q);
+			for (int i = 0; i < 4; ++i) {
+				result[i] *= kHalf;
+			}
+		}
+
+		static void Stage(PMath::Quaternion& result, const PMath::Quaternion q, Real t, const PMath::Quaternion dqdt)
+		{
+			for (int i = 0; i < 4; ++i) {
+				result[i] = q[i] + t * dqdt[i];
+			}
+		}
+	};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	template <bool kTranslate, bool kSpin>
+	inline void RigidBody :: Reset()
+	{
+		// normally in a Verlet integrator, you need the previous state in order to derive velocity
+		// in this engine, since we are tracking velocity explicitly, we can simply copy t1 over t0
+		// if you were to switch the engine to derive acceleration from velocity, you would need a different approach
+		m_StateT0 = m_StateT1;
+
+		if (kTranslate) {
+			if (m_Collided) {
+				// much more interesting friction is anisotropic; for example, a tire has much more transverse than lateral friction
+				// coulomb friction - a force opposing motion
+
+				Real vel = PMath::Vec3fLength(m_StateT0.m_Velocity);
+				PMath::Vec3fMultiplyAccumulate(m_Acc.m_Force, Real(-0.95f) * vel, m_StateT0.m_Velocity);
+			}
+			else {
+				// linear velocity damping, use to simulate viscosity
+				Real forceSquared = PMath::Vec3fDot(m_Acc.m_Force, m_Acc.m_Force);
+				if (forceSquared < kEps) {
+					PMath::Vec3fScale(m_StateT0.m_Velocity, m_LinearVelocityDamp);
+				}
+			}
+
+			//! @todo put body to sleep, if it is moving at less than v = sqrt(2*g*eps), the velocity
+			// of an object initially at rest would have falling through the collision envelope [Mirtich95]
+			// and if the body was in contact with an immobile object in the last frame
+		}
+
+		if (kSpin) {
+			Real aDamp = -m_Mass * m_AngularVelocityDamp;
+
+			/// @todo work out proper angular damping
+			PMath::Vec3fMultiplyAccumulate(m_Acc.m_Torque, aDamp, m_StateT0.m_AngularVelocity);	// input a torque opposing the angular velocity
+		}
+
+		m_Collided = false;
+	}
+
+	template <class Scheme, bool kTranslate, bool kSpin>
+	inline void RigidBody :: Integrate1(Real dt)
+	{
+		if (kTranslate) {
+			Scheme::Drift(m_StateT1, m_AccelPrev, dt);
+		}
+		if (kSpin) {
+			/// @todo if using full matrix for tensor, must do worldTensor = orientation * inverseinertiatensor * transpose(orientation) before multiplying
+			Scheme::Turn(m_StateT1, m_TorquePrev, m_InertiaITD, m_InertialKind == kI_Sphere, dt);
+		}
+	}
+
+	template <class Scheme, bool kTranslate, bool kSpin>
+	inline void RigidBody :: Integrate2(Real dt, const PMath::Vec3f gravity)
+	{
+		if (kTranslate) {
+			PMath::Vec3fSetScaled(m_AccelPrev, m_OOMass, m_Acc.m_Force);						// dvdt = f / m     works for gravity? yes:  f = mg    a = mg / m = g
+			if (m_Gravity) {
+				PMath::Vec3fAdd(m_AccelPrev, gravity);
+			}
+			Scheme::Kick(m_StateT1, m_AccelPrev, dt);
+			PMath::Vec3fZero(m_Acc.m_Force);													// clear out the force accumulator
+		}
+		if (kSpin) {
+			PMath::Vec3fSet(m_TorquePrev, m_Acc.m_Torque);
+			Scheme::Twist(m_StateT1, m_Acc.m_Torque, m_InertiaITD, m_InertialKind == kI_Sphere, dt);
+			PMath::Vec3fZero(m_Acc.m_Torque);													// clear the torque accumulator
+		}
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	/// bodies are stepped in buckets: one per scheme and combination of translatable and spinnable, one for spring meshes,
+	/// and one for the links of articulations, which their articulations step
+	static const int kNumBodyCategories	= 14;
+	static const int kBC_SpringMesh		= 12;
+	static const int kBC_Articulated	= 13;
+
+	inline int BodyCategory(const RigidBody* pBody)
+	{
+		if (pBody->m_pArticulation != 0) {
+			return kBC_Articulated;
+		}
+		if (pBody->GetInertialKind() == kI_SpringMesh) {
+			return kBC_SpringMesh;
+		}
+		return (int) pBody->GetIntegrator() * 4 + (pBody->GetTranslatable() ? 1 : 0) + (pBody->GetSpinnable() ? 2 : 0);
+	}
+
+	/** @class	BucketUpdate
+		@brief	The loops that step one category of bodies through a substep
+	 */
+
+	class BucketUpdate
+	{
+	public:
+		void	(*m_Reset)(std::vector<RigidBody*>& bodies);
+		void	(*m_Integrate1)(std::vector<RigidBody*>& bodies, Real dt, const PMath::Vec3f gravity);
+		void	(*m_Integrate2)(std::vector<RigidBody*>& bodies, Real dt, const PMath::Vec3f gravity);
+	};
+
+	extern const BucketUpdate kBucketUpdates[kNumBodyCategories];		//!< indexed by BodyCategory
+
+}	// end Physics namespace
+
+#endif
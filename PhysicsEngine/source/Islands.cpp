@@ -0,0 +1,267 @@
+
+/** @file Islands.cpp
+	@brief	partitions the simulation into independently substepped islands */
+
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#include "Islands.h"
+#include "RigidBody.h"
+#include "Spring.h"
+#include "Constraint.h"
+#include "Articulation.h"
+
+using namespace Physics;
+using PMath::Vec3f;
+
+static const Real kUnlimited = Real(1.0e30f);
+
+Islands :: Islands() : m_BodySubstepBudget(0), m_MaxSubsteps(16), m_NumGroups(0), m_NumIslands(0)
+{
+}
+
+void Islands :: SetBudget(int bodySubsteps, int maxSubsteps)
+{
+	m_BodySubstepBudget = bodySubsteps > 0 ? bodySubsteps : 0;
+	m_MaxSubsteps = maxSubsteps > 0 ? maxSubsteps : 1;
+}
+
+void Islands :: Begin()
+{
+	m_Bodies.clear();
+	m_Springs.clear();
+	m_Constraints.clear();
+	m_ConstraintBodies.clear();
+	m_Articulations.clear();
+}
+
+void Islands :: AddBody(RigidBody* pBody)
+{
+	pBody->m_Island = (int) m_Bodies.size();
+	m_Bodies.push_back(pBody);
+}
+
+void Islands :: AddSpring(Spring* pSpring)
+{
+	m_Springs.push_back(pSpring);
+}
+
+void Islands :: AddConstraint(Constraint* pConstraint, RigidBody* pBodyA, RigidBody* pBodyB)
+{
+	m_Constraints.push_back(pConstraint);
+	m_ConstraintBodies.push_back(pBodyA);
+	m_ConstraintBodies.push_back(pBodyB);
+}
+
+void Islands :: AddArticulation(Articulation* pArticulation)
+{
+	m_Articulations.push_back(pArticulation);
+}
+
+int Islands :: Find(int i)
+{
+	while (m_Parent[i] != i) {
+		m_Parent[i] = m_Parent[m_Parent[i]];		// path halving
+		i = m_Parent[i];
+	}
+	return i;
+}
+
+void Islands :: Union(RigidBody* pBodyA, RigidBody* pBodyB)
+{
+	// inactive bodies were not added, and don't join islands
+	if (pBodyA->GetActive() && pBodyB->GetActive()) {
+		int a = Find(pBodyA->m_Island);
+		int b = Find(pBodyB->m_Island);
+		if (a != b) {
+			m_Parent[a] = b;
+		}
+	}
+}
+
+void Islands :: Limit(RigidBody* pBody, Real dt)
+{
+	if (pBody->GetActive()) {
+		int root = Find(pBody->m_Island);
+		if (dt < m_StableDt[root]) {
+			m_StableDt[root] = dt;
+		}
+	}
+}
+
+int Islands :: GroupFor(int substeps, int tier)
+{
+	for (int i = 0; i < m_NumGroups; ++i) {
+		if (m_Groups[i].m_Substeps == substeps && m_Groups[i].m_Tier == tier) {
+			return i;
+		}
+	}
+	if (m_NumGroups == (int) m_Groups.size()) {
+		m_Groups.push_back(IslandGroup());
+	}
+	IslandGroup& group = m_Groups[m_NumGroups];
+	group.m_Substeps = substeps;
+	group.m_Tier = tier;
+	group.m_Bodies.clear();
+	for (int c = 0; c < kNumBodyCategories; ++c) {
+		group.m_Categories[c].clear();
+	}
+	group.m_Springs.clear();
+	group.m_Constraints.clear();
+	group.m_Articulations.clear();
+	return m_NumGroups++;
+}
+
+void Islands :: Build(Real dt, const Real* pTierScale)
+{
+	int numBodies = (int) m_Bodies.size();
+	int i;
+
+	m_Parent.resize(numBodies);
+	for (i = 0; i < numBodies; ++i) {
+		m_Parent[i] = i;
+	}
+
+	std::vector<Spring*>::iterator springIter;
+	for (springIter = m_Springs.begin(); springIter != m_Springs.end(); ++springIter) {
+		Union((*springIter)->GetBodyA(), (*springIter)->GetBodyB());
+	}
+	for (i = 0; i < (int) m_Constraints.size(); ++i) {
+		Union(m_ConstraintBodies[i * 2], m_ConstraintBodies[i * 2 + 1]);
+	}
+	std::vector<Articulation*>::iterator aIter;
+	for (aIter = m_Articulations.begin(); aIter != m_Articulations.end(); ++aIter) {
+		for (int link = 1; link < (*aIter)->GetLinkCount(); ++link) {
+			Union((*aIter)->GetLinkBody(0), (*aIter)->GetLinkBody(link));
+		}
+	}
+
+	// estimate each island's stable time step
+	m_StableDt.assign(numBodies, kUnlimited);
+	for (i = 0; i < numBodies; ++i) {
+		Limit(m_Bodies[i], m_Bodies[i]->StableTimeStep());
+	}
+	for (aIter = m_Articulations.begin(); aIter != m_Articulations.end(); ++aIter) {
+		Limit((*aIter)->GetLinkBody(0), (*aIter)->StableTimeStep());
+	}
+
+	for (springIter = m_Springs.begin(); springIter != m_Springs.end(); ++springIter) {
+		Spring* pSpring = *springIter;
+		RigidBody* pBodyA = pSpring->GetBodyA();
+		RigidBody* pBodyB = pSpring->GetBodyB();
+		Real ooMass = pBodyA->GetOOMass() + pBodyB->GetOOMass();
+		if (pSpring->m_Implicit || ooMass <= k0) {
+			continue;
+		}
+
+		Vec3f direction, velocity;
+		PMath::Vec3fSubtract(direction, pBodyA->m_StateT1.m_Position, pBodyB->m_StateT1.m_Position);
+		PMath::Vec3fSubtract(velocity, pBodyA->m_StateT1.m_Velocity, pBodyB->m_StateT1.m_Velocity);
+		Real length = PMath::Vec3fLength(direction);
+
+		Real limit = kUnlimited;
+		Real omegaSquared = pSpring->m_Stiffness * length * ooMass;
+		if (omegaSquared > k0) {
+			limit = k1 / PMath::Sqrt(omegaSquared);
+		}
+		Real speed = PMath::Vec3fLength(velocity);
+		if (speed * limit > pSpring->m_RestLength && pSpring->m_RestLength > k0) {
+			limit = pSpring->m_RestLength / speed;
+		}
+
+		Limit(pBodyA, limit);
+		Limit(pBodyB, limit);
+	}
+
+	// substeps per island, over the time its tier steps through
+	m_Size.assign(numBodies, 0);
+	m_Substeps.assign(numBodies, 1);
+	m_Tier.assign(numBodies, kNumLODTiers - 1);
+	int total = 0;
+	m_NumIslands = 0;
+	for (i = 0; i < numBodies; ++i) {
+		int root = Find(i);
+		++m_Size[root];
+		if (m_Bodies[i]->m_LODTier < m_Tier[root]) {
+			m_Tier[root] = m_Bodies[i]->m_LODTier;
+		}
+	}
+	for (i = 0; i < numBodies; ++i) {
+		if (m_Parent[i] == i) {
+			int substeps = 1;
+			Real stepDt = dt * pTierScale[m_Tier[i]];
+			if (m_StableDt[i] < stepDt) {
+				Real needed = stepDt / m_StableDt[i];
+				substeps = needed < Real(m_MaxSubsteps) ? 1 + (int) needed : m_MaxSubsteps;
+			}
+			m_Substeps[i] = substeps;
+			total += substeps * m_Size[i];
+			++m_NumIslands;
+		}
+	}
+
+	// fit the budget, by scaling down the substeps beyond the first
+	if (m_BodySubstepBudget > 0 && total > m_BodySubstepBudget && total > numBodies) {
+		Real scale = Real(m_BodySubstepBudget - numBodies) / Real(total - numBodies);
+		if (scale < k0) {
+			scale = k0;
+		}
+		for (i = 0; i < numBodies; ++i) {
+			if (m_Parent[i] == i) {
+				m_Substeps[i] = 1 + (int) (Real(m_Substeps[i] - 1) * scale);
+			}
+		}
+	}
+
+	// gather the islands into groups by substep count and tier
+	m_NumGroups = 0;
+	for (i = 0; i < numBodies; ++i) {
+		int root = Find(i);
+		int group = GroupFor(m_Substeps[root], m_Tier[root]);
+		m_Groups[group].m_Bodies.push_back(m_Bodies[i]);
+		m_Groups[group].m_Categories[BodyCategory(m_Bodies[i])].push_back(m_Bodies[i]);
+		m_Bodies[i]->m_Group = group;
+		m_Bodies[i]->m_LODTier = m_Tier[root];
+	}
+	for (springIter = m_Springs.begin(); springIter != m_Springs.end(); ++springIter) {
+		RigidBody* pBody = (*springIter)->GetBodyA()->GetActive() ? (*springIter)->GetBodyA() : (*springIter)->GetBodyB();
+		if (pBody->GetActive()) {
+			int root = Find(pBody->m_Island);
+			m_Groups[GroupFor(m_Substeps[root], m_Tier[root])].m_Springs.push_back(*springIter);
+		}
+	}
+	for (i = 0; i < (int) m_Constraints.size(); ++i) {
+		RigidBody* pBody = m_ConstraintBodies[i * 2]->GetActive() ? m_ConstraintBodies[i * 2] : m_ConstraintBodies[i * 2 + 1];
+		if (pBody->GetActive()) {
+			int root = Find(pBody->m_Island);
+			m_Groups[GroupFor(m_Substeps[root], m_Tier[root])].m_Constraints.push_back(m_Constraints[i]);
+		}
+	}
+	for (aIter = m_Articulations.begin(); aIter != m_Articulations.end(); ++aIter) {
+		int root = Find((*aIter)->GetLinkBody(0)->m_Island);
+		m_Groups[GroupFor(m_Substeps[root], m_Tier[root])].m_Articulations.push_back(*aIter);
+	}
+}
@@ -0,0 +1,138 @@
+
+/** @file Islands.h
+
+	an internal implementation file, partitions the simulation into independently substepped islands
+ */
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#ifndef _ISLANDS_H_
+#define _ISLANDS_H_
+
+#include <vector>
+
+#include "PhysicsEngineDef.h"
+#include "Integrator.h"
+
+namespace Physics {
+
+	class Articulation;
+	class Constraint;
+	class Spring;
+
+	/** @class	IslandGroup
+		@brief	All the islands of one level of detail tier that take the same number of substeps per world step
+	 */
+
+	class IslandGroup
+	{
+	public:
+		int							m_Substeps;
+		int							m_Tier;
+		std::vector<RigidBody*>		m_Bodies;
+		std::vector<RigidBody*>		m_Categories[kNumBodyCategories];	//!< the bodies again, by BodyCategory
+		std::vector<Spring*>		m_Springs;
+		std::vector<Constraint*>	m_Constraints;
+		std::vector<Articulation*>	m_Articulations;
+	};
+
+	/** @class	Islands
+		@brief	Finds the islands of bodies connected by springs and constraints, and how finely each must be stepped
+
+		Each world step, the active bodies, springs, constraints and articulations are added, then
+		Build joins bodies into islands, all of an articulation's links into one, and estimates a
+		stable time step for each island. An explicit spring limits its island's step to 1 / omega,
+		where omega^2 is its stiffness over the reduced mass of its ends;
+		since spring forces here scale with the spring's length, the stiffness is multiplied by the
+		length. A spring also limits the step so that its ends can't close by more than its rest length.
+		A body may limit its own step, see RigidBody::StableTimeStep, and so may an articulation, see
+		Articulation::StableTimeStep. Implicit springs don't limit the step at all.
+
+		Islands which need the same number of substeps are gathered into one group, so that an island
+		of thousands of unconnected bodies costs no more than one island of the same size. Within a
+		group the bodies are also sorted by how they're integrated, see BodyCategory. If the total
+		number of body substeps would exceed the budget, every island's extra substeps are scaled down
+		to fit, but every island takes at least one.
+
+		An island is stepped at the rate of its fastest body's level of detail tier, so that bodies
+		joined by springs and constraints always move together; its bodies are moved to that tier.
+		A slow tier's world steps cover all the time it waited, so its islands' stable time steps
+		are compared against that longer time.
+	 */
+
+	class Islands
+	{
+	public:
+		Islands();
+
+		/// @param bodySubsteps	most body substeps per world step, summed over all bodies; zero is unlimited
+		/// @param maxSubsteps	most substeps any island may take per world step
+		void	SetBudget(int bodySubsteps, int maxSubsteps);
+		int		GetBodySubstepBudget() const	{ return m_BodySubstepBudget; }
+		int		GetMaxSubsteps() const			{ return m_MaxSubsteps; }
+
+		void	Begin();
+		void	AddBody(RigidBody* pBody);
+		void	AddSpring(Spring* pSpring);
+		void	AddConstraint(Constraint* pConstraint, RigidBody* pBodyA, RigidBody* pBodyB);
+		void	AddArticulation(Articulation* pArticulation);
+
+		/// partition everything added since Begin, for world steps of dt; tier t's world steps are dt * pTierScale[t] long
+		void	Build(Real dt, const Real* pTierScale);
+
+		int				GetGroupCount() const		{ return m_NumGroups; }
+		IslandGroup&	GetGroup(int i)				{ return m_Groups[i]; }
+		int				GetIslandCount() const		{ return m_NumIslands; }
+
+	protected:
+		int		Find(int i);
+		void	Union(RigidBody* pBodyA, RigidBody* pBodyB);
+		void	Limit(RigidBody* pBody, Real dt);
+		int		GroupFor(int substeps, int tier);
+
+		int							m_BodySubstepBudget;
+		int							m_MaxSubsteps;
+
+		std::vector<RigidBody*>		m_Bodies;			//!< indexed by RigidBody::m_Island
+		std::vector<Spring*>		m_Springs;
+		std::vector<Constraint*>	m_Constraints;
+		std::vector<RigidBody*>		m_ConstraintBodies;	//!< two per constraint
+		std::vector<Articulation*>	m_Articulations;
+
+		std::vector<int>			m_Parent;			//!< union-find forest over m_Bodies
+		std::vector<Real>			m_StableDt;			//!< per root
+		std::vector<int>			m_Size;				//!< per root
+		std::vector<int>			m_Substeps;			//!< per root
+		std::vector<int>			m_Tier;				//!< per root, the fastest of its bodies' tiers
+
+		std::vector<IslandGroup>	m_Groups;			//!< kept between steps to reuse their storage
+		int							m_NumGroups;
+		int							m_NumIslands;
+	};
+
+}	// end Physics namespace
+
+#endif
@@ -0,0 +1,161 @@
+
+/** @file MappedFile.cpp
+	@brief	read only memory mapped files, Win32 and POSIX */
+
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#ifdef WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+namespace Physics {
+
+/** @class MappedFileAux
+	The platform specific parts of a MappedFile
+ */
+
+	class MappedFileAux
+	{
+	public:
+#ifdef WIN32
+		MappedFileAux() : m_File(INVALID_HANDLE_VALUE), m_Mapping(0) { }
+
+		HANDLE		m_File;
+		HANDLE		m_Mapping;
+#else
+		MappedFileAux() : m_File(-1) { }
+
+		int			m_File;
+#endif
+	};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	MappedFile :: MappedFile() : m_pAux(new MappedFileAux()), m_pData(0), m_Size(0)
+	{
+	}
+
+	MappedFile :: ~MappedFile()
+	{
+		Close();
+		delete m_pAux;
+	}
+
+#ifdef WIN32
+
+	bool MappedFile :: Open(const char* pPath)
+	{
+		Close();
+
+		m_pAux->m_File = CreateFileA(pPath, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+		if (m_pAux->m_File == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+
+		DWORD size = GetFileSize(m_pAux->m_File, 0);
+		if (size != INVALID_FILE_SIZE && size > 0) {
+			m_pAux->m_Mapping = CreateFileMapping(m_pAux->m_File, 0, PAGE_READONLY, 0, 0, 0);
+			if (m_pAux->m_Mapping != 0) {
+				m_pData = MapViewOfFile(m_pAux->m_Mapping, FILE_MAP_READ, 0, 0, 0);
+			}
+		}
+		if (m_pData == 0) {
+			Close();
+			return false;
+		}
+
+		m_Size = (int) size;
+		return true;
+	}
+
+	void MappedFile :: Close()
+	{
+		if (m_pData != 0) {
+			UnmapViewOfFile(m_pData);
+		}
+		if (m_pAux->m_Mapping != 0) {
+			CloseHandle(m_pAux->m_Mapping);
+		}
+		if (m_pAux->m_File != INVALID_HANDLE_VALUE) {
+			CloseHandle(m_pAux->m_File);
+		}
+		m_pAux->m_Mapping	= 0;
+		m_pAux->m_File		= INVALID_HANDLE_VALUE;
+		m_pData				= 0;
+		m_Size				= 0;
+	}
+
+#else
+
+	bool MappedFile :: Open(const char* pPath)
+	{
+		Close();
+
+		m_pAux->m_File = open(pPath, O_RDONLY);
+		if (m_pAux->m_File < 0) {
+			return false;
+		}
+
+		struct stat info;
+		if (fstat(m_pAux->m_File, &info) == 0 && info.st_size > 0) {
+			void* pData = mmap(0, (size_t) info.st_size, PROT_READ, MAP_SHARED, m_pAux->m_File, 0);
+			if (pData != MAP_FAILED) {
+				m_pData	= pData;
+				m_Size	= (int) info.st_size;
+			}
+		}
+		if (m_pData == 0) {
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void MappedFile :: Close()
+	{
+		if (m_pData != 0) {
+			munmap((void*) m_pData, (size_t) m_Size);
+		}
+		if (m_pAux->m_File >= 0) {
+			close(m_pAux->m_File);
+		}
+		m_pAux->m_File	= -1;
+		m_pData			= 0;
+		m_Size			= 0;
+	}
+
+#endif
+
+}	// end namespace Physics
@@ -0,0 +1,70 @@
+
+/** @file MappedFile.h
+
+	an internal implementation file, hides the platform memory mapping API from the engine
+ */
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#ifndef _MAPPEDFILE_H_
+#define _MAPPEDFILE_H_
+
+#include "PhysicsEngineDef.h"
+
+namespace Physics {
+
+	class MappedFileAux;	// forward declaration - hidden platform implementation
+
+	/** @class	MappedFile
+		@brief	A read only view of a whole file
+
+		The operating system pages the file in as it is touched, and can discard the pages
+		again under memory pressure, since they are backed by the file itself.
+	 */
+
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		/// map the file at pPath, closing any file already mapped. @return true if successful
+		bool		Open(const char* pPath);
+		void		Close();
+
+		/// @return the first byte of the file, or zero if no file is mapped
+		const void*	GetData() const		{ return m_pData; }
+		int			GetSize() const		{ return m_Size; }
+
+	protected:
+		MappedFileAux*	m_pAux;
+		const void*		m_pData;
+		int				m_Size;
+	};
+
+}	// end Physics namespace
+
+#endif
@@ -0,0 +1,391 @@
+
+/** @file ParticleSystem.cpp
+	@brief	structure of arrays particles, integrated and collided in blocks */
+
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#include "ParticleSystem.h"
+#include "PhysicsThread.h"
+
+using PMath::Vec3f;
+
+namespace Physics {
+
+	static const int kParticleBlock		= 256;		// particles integrated and collided together; small enough to stay in cache
+	static const int kMinParticleBlocks	= 8;		// smallest number of blocks worth handing to another thread
+	static const int kMaxBlockSpheres	= 64;		// spheres collided at once against a block; more are done in several passes
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	void ParticleColliders :: Clear()
+	{
+		m_PlaneNX.clear();	m_PlaneNY.clear();	m_PlaneNZ.clear();	m_PlaneD.clear();
+		m_SphereX.clear();	m_SphereY.clear();	m_SphereZ.clear();	m_SphereR.clear();
+		m_SphereVX.clear();	m_SphereVY.clear();	m_SphereVZ.clear();
+		m_Heightfields.clear();
+	}
+
+	void ParticleColliders :: AddPlane(const PMath::Plane& plane)
+	{
+		m_PlaneNX.push_back(plane.m_Normal[0]);
+		m_PlaneNY.push_back(plane.m_Normal[1]);
+		m_PlaneNZ.push_back(plane.m_Normal[2]);
+		m_PlaneD.push_back(plane.m_D);
+	}
+
+	void ParticleColliders :: AddSphere(const Vec3f& center, Real radius, const Vec3f& velocity)
+	{
+		m_SphereX.push_back(center[0]);
+		m_SphereY.push_back(center[1]);
+		m_SphereZ.push_back(center[2]);
+		m_SphereR.push_back(radius);
+		m_SphereVX.push_back(velocity[0]);
+		m_SphereVY.push_back(velocity[1]);
+		m_SphereVZ.push_back(velocity[2]);
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	ParticleSystem :: ParticleSystem() : m_Count(0), m_Radius(k0), m_Restitution(kHalf), m_Drag(k0),
+		m_Active(true), m_UseGravity(true), m_Collidable(true), m_StepDt(k0), m_pStepColliders(0)
+	{
+		PMath::Vec3fZero(m_StepGravity);
+	}
+
+	void ParticleSystem :: SetParticles(int count, Vec3f const*const pPositions, Vec3f const*const pVelocities, int byteStride)
+	{
+		m_Count = count > 0 ? count : 0;
+		m_X.resize(m_Count);	m_Y.resize(m_Count);	m_Z.resize(m_Count);
+		m_VX.resize(m_Count);	m_VY.resize(m_Count);	m_VZ.resize(m_Count);
+
+		for (int i = 0; i < m_Count; ++i) {
+			m_VX[i] = k0;	m_VY[i] = k0;	m_VZ[i] = k0;
+		}
+		SetVectors(false, 0, m_Count, pPositions, byteStride);
+		if (pVelocities != 0) {
+			SetVectors(true, 0, m_Count, pVelocities, byteStride);
+		}
+	}
+
+	int ParticleSystem :: SetVectors(bool velocities, int first, int count, Vec3f const*const pValues, int byteStride)
+	{
+		if (pValues == 0 || first < 0 || first >= m_Count) {
+			return 0;
+		}
+		if (count > m_Count - first) {
+			count = m_Count - first;
+		}
+
+		Real* pX = velocities ? &m_VX[first] : &m_X[first];
+		Real* pY = velocities ? &m_VY[first] : &m_Y[first];
+		Real* pZ = velocities ? &m_VZ[first] : &m_Z[first];
+		char const* pCurr = (char const*) pValues;
+		for (int i = 0; i < count; ++i) {
+			const Real* pV = *(Vec3f const*) pCurr;
+			pX[i] = pV[0];
+			pY[i] = pV[1];
+			pZ[i] = pV[2];
+			pCurr += byteStride;
+		}
+		return count;
+	}
+
+	int ParticleSystem :: GetVectors(bool velocities, int first, int count, Vec3f* pResult, int byteStride) const
+	{
+		if (pResult == 0 || first < 0 || first >= m_Count) {
+			return 0;
+		}
+		if (count > m_Count - first) {
+			count = m_Count - first;
+		}
+
+		const Real* pX = velocities ? &m_VX[first] : &m_X[first];
+		const Real* pY = velocities ? &m_VY[first] : &m_Y[first];
+		const Real* pZ = velocities ? &m_VZ[first] : &m_Z[first];
+		char* pCurr = (char*) pResult;
+		for (int i = 0; i < count; ++i) {
+			Real* pV = *(Vec3f*) pCurr;
+			pV[0] = pX[i];
+			pV[1] = pY[i];
+			pV[2] = pZ[i];
+			pCurr += byteStride;
+		}
+		return count;
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	void ParticleSystem :: Integrate(Real dt, const Vec3f gravity, const ParticleColliders& colliders, ThreadPool& threads)
+	{
+		if (!m_Active || m_Count == 0) {
+			return;
+		}
+
+		m_StepDt			= dt;
+		m_pStepColliders	= &colliders;
+		if (m_UseGravity) {
+			PMath::Vec3fSet(m_StepGravity, gravity);
+		}
+		else {
+			PMath::Vec3fZero(m_StepGravity);
+		}
+
+		int blocks = (m_Count + kParticleBlock - 1) / kParticleBlock;
+		threads.Run(blocks, IntegrateRange, this, kMinParticleBlocks);
+
+		m_pStepColliders = 0;
+	}
+
+	void ParticleSystem :: IntegrateRange(void* pData, int begin, int end)
+	{
+		ParticleSystem* pSystem = (ParticleSystem*) pData;
+		for (int block = begin; block < end; ++block) {
+			int first	= block * kParticleBlock;
+			int last	= first + kParticleBlock;
+			pSystem->IntegrateBlock(first, last < pSystem->m_Count ? last : pSystem->m_Count);
+		}
+	}
+
+	/*
+		Velocity Verlet, with a = g - c v:
+
+			x1 = x0 + h v0 + h^2/2 a0
+			v1 = v0 + h/2 (a0 + a1)
+
+		a1 depends on v1 through the drag, so solve for v1:
+
+			v1 = (v0 + h/2 (a0 + g)) / (1 + h/2 c)
+
+		The integration and plane loops have no branches or calls, and read and write each
+		array in order, so they vectorize.
+	 */
+
+	void ParticleSystem :: IntegrateBlock(int begin, int end)
+	{
+		Real* x		= &m_X[0];
+		Real* y		= &m_Y[0];
+		Real* z		= &m_Z[0];
+		Real* vx	= &m_VX[0];
+		Real* vy	= &m_VY[0];
+		Real* vz	= &m_VZ[0];
+
+		const Real h		= m_StepDt;
+		const Real halfH	= kHalf * h;
+		const Real halfH2	= halfH * h;
+		const Real c		= m_Drag;
+		const Real ooDen	= k1 / (k1 + halfH * c);
+		const Real gx		= m_StepGravity[0];
+		const Real gy		= m_StepGravity[1];
+		const Real gz		= m_StepGravity[2];
+
+		int i;
+		for (i = begin; i < end; ++i) {
+			Real ax = gx - c * vx[i];
+			Real ay = gy - c * vy[i];
+			Real az = gz - c * vz[i];
+			x[i] += h * vx[i] + halfH2 * ax;
+			y[i] += h * vy[i] + halfH2 * ay;
+			z[i] += h * vz[i] + halfH2 * az;
+			vx[i] = (vx[i] + halfH * (ax + gx)) * ooDen;
+			vy[i] = (vy[i] + halfH * (ay + gy)) * ooDen;
+			vz[i] = (vz[i] + halfH * (az + gz)) * ooDen;
+		}
+
+		if (!m_Collidable) {
+			return;
+		}
+
+		// bounds of the block's centers; the particle radius is added to each collider instead
+
+		Real minX = x[begin], maxX = x[begin];
+		Real minY = y[begin], maxY = y[begin];
+		Real minZ = z[begin], maxZ = z[begin];
+		for (i = begin + 1; i < end; ++i) {
+			minX = x[i] < minX ? x[i] : minX;	maxX = x[i] > maxX ? x[i] : maxX;
+			minY = y[i] < minY ? y[i] : minY;	maxY = y[i] > maxY ? y[i] : maxY;
+			minZ = z[i] < minZ ? z[i] : minZ;	maxZ = z[i] > maxZ ? z[i] : maxZ;
+		}
+
+		const Real r = m_Radius;
+		const Real e = k1 + m_Restitution;
+		const Real centerX = kHalf * (minX + maxX), extentX = kHalf * (maxX - minX);
+		const Real centerY = kHalf * (minY + maxY), extentY = kHalf * (maxY - minY);
+		const Real centerZ = kHalf * (minZ + maxZ), extentZ = kHalf * (maxZ - minZ);
+
+		// planes; skip any the whole block is in front of
+
+		const ParticleColliders& colliders = *m_pStepColliders;
+		int p;
+		for (p = 0; p < colliders.GetPlaneCount(); ++p) {
+			const Real nx = colliders.m_PlaneNX[p];
+			const Real ny = colliders.m_PlaneNY[p];
+			const Real nz = colliders.m_PlaneNZ[p];
+			const Real d  = colliders.m_PlaneD[p] - r;
+
+			Real nearest = nx * centerX + ny * centerY + nz * centerZ + d -
+				(PMath::Abs(nx) * extentX + PMath::Abs(ny) * extentY + PMath::Abs(nz) * extentZ);
+			if (nearest >= k0) {
+				continue;
+			}
+
+			for (i = begin; i < end; ++i) {
+				Real dist	= nx * x[i] + ny * y[i] + nz * z[i] + d;
+				Real vn		= nx * vx[i] + ny * vy[i] + nz * vz[i];
+				Real push	= dist < k0 ? -dist : k0;
+				Real bounce	= (dist < k0 && vn < k0) ? -e * vn : k0;
+				x[i] += push * nx;		y[i] += push * ny;		z[i] += push * nz;
+				vx[i] += bounce * nx;	vy[i] += bounce * ny;	vz[i] += bounce * nz;
+			}
+		}
+
+		// spheres that reach the block, a handful at a time
+
+		int spheres[kMaxBlockSpheres];
+		int sphereCount = 0;
+		for (int s = 0; s < colliders.GetSphereCount(); ++s) {
+			Real reach = colliders.m_SphereR[s] + r;
+			Real dx = PMath::Abs(colliders.m_SphereX[s] - centerX) - extentX;
+			Real dy = PMath::Abs(colliders.m_SphereY[s] - centerY) - extentY;
+			Real dz = PMath::Abs(colliders.m_SphereZ[s] - centerZ) - extentZ;
+			dx = dx > k0 ? dx : k0;
+			dy = dy > k0 ? dy : k0;
+			dz = dz > k0 ? dz : k0;
+			if (dx * dx + dy * dy + dz * dz < reach * reach) {
+				spheres[sphereCount++] = s;
+				if (sphereCount == kMaxBlockSpheres) {
+					CollideSpheres(begin, end, spheres, sphereCount);
+					sphereCount = 0;
+				}
+			}
+		}
+		if (sphereCount > 0) {
+			CollideSpheres(begin, end, spheres, sphereCount);
+		}
+
+		// heightfields the block is over, and not entirely above
+
+		for (int f = 0; f < (int) colliders.m_Heightfields.size(); ++f) {
+			const Collision::Heightfield& field = *colliders.m_Heightfields[f];
+			Real fieldMaxX = field.m_Origin[0] + Real(field.m_Columns - 1) * field.m_CellSize;
+			Real fieldMaxY = field.m_Origin[1] + Real(field.m_Rows - 1) * field.m_CellSize;
+			if (minZ - r < field.m_MaxHeight && maxX >= field.m_Origin[0] && maxY >= field.m_Origin[1] &&
+				minX < fieldMaxX && minY < fieldMaxY) {
+				CollideHeightfield(begin, end, field);
+			}
+		}
+	}
+
+	/// each particle looks up the one triangle beneath it, and is treated as touching that triangle's plane
+	void ParticleSystem :: CollideHeightfield(int begin, int end, const Collision::Heightfield& field)
+	{
+		Real* x		= &m_X[0];
+		Real* y		= &m_Y[0];
+		Real* z		= &m_Z[0];
+		Real* vx	= &m_VX[0];
+		Real* vy	= &m_VY[0];
+		Real* vz	= &m_VZ[0];
+
+		const Real e = k1 + m_Restitution;
+
+		for (int i = begin; i < end; ++i) {
+			Real height;
+			Vec3f n;
+			if (z[i] - m_Radius >= field.m_MaxHeight || !field.GetHeight(x[i], y[i], height, n)) {
+				continue;
+			}
+
+			// distance from the particle's center to the plane of the triangle beneath it
+			Real dist = (z[i] - height) * n[2] - m_Radius;
+			if (dist >= k0) {
+				continue;
+			}
+
+			x[i] -= dist * n[0];
+			y[i] -= dist * n[1];
+			z[i] -= dist * n[2];
+
+			Real vn = n[0] * vx[i] + n[1] * vy[i] + n[2] * vz[i];
+			if (vn < k0) {
+				vx[i] -= e * vn * n[0];
+				vy[i] -= e * vn * n[1];
+				vz[i] -= e * vn * n[2];
+			}
+		}
+	}
+
+	/// push particles out of the spheres, and bounce them off relative to each sphere's motion
+	void ParticleSystem :: CollideSpheres(int begin, int end, const int* pSpheres, int sphereCount)
+	{
+		Real* x		= &m_X[0];
+		Real* y		= &m_Y[0];
+		Real* z		= &m_Z[0];
+		Real* vx	= &m_VX[0];
+		Real* vy	= &m_VY[0];
+		Real* vz	= &m_VZ[0];
+
+		const ParticleColliders& colliders = *m_pStepColliders;
+		const Real e = k1 + m_Restitution;
+
+		for (int j = 0; j < sphereCount; ++j) {
+			int s = pSpheres[j];
+			const Real cx		= colliders.m_SphereX[s];
+			const Real cy		= colliders.m_SphereY[s];
+			const Real cz		= colliders.m_SphereZ[s];
+			const Real svx		= colliders.m_SphereVX[s];
+			const Real svy		= colliders.m_SphereVY[s];
+			const Real svz		= colliders.m_SphereVZ[s];
+			const Real reach	= colliders.m_SphereR[s] + m_Radius;
+			const Real reach2	= reach * reach;
+
+			for (int i = begin; i < end; ++i) {
+				Real dx = x[i] - cx;
+				Real dy = y[i] - cy;
+				Real dz = z[i] - cz;
+				Real dist2 = dx * dx + dy * dy + dz * dz;
+				if (dist2 >= reach2 || dist2 < kEps) {
+					continue;
+				}
+
+				Real ooDist = k1 / PMath::Sqrt(dist2);
+				Real nx = dx * ooDist;
+				Real ny = dy * ooDist;
+				Real nz = dz * ooDist;
+				x[i] = cx + nx * reach;
+				y[i] = cy + ny * reach;
+				z[i] = cz + nz * reach;
+
+				Real vn = nx * (vx[i] - svx) + ny * (vy[i] - svy) + nz * (vz[i] - svz);
+				if (vn < k0) {
+					vx[i] -= e * vn * nx;
+					vy[i] -= e * vn * ny;
+					vz[i] -= e * vn * nz;
+				}
+			}
+		}
+	}
+
+}	// end namespace Physics
@@ -0,0 +1,127 @@
+
+/** @file ParticleSystem.h
+
+	an internal implementation file, a set of non-rotating particles stored structure of arrays
+ */
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#ifndef _PARTICLESYSTEM_H_
+#define _PARTICLESYSTEM_H_
+
+#include <vector>
+
+#include "PhysicsEngineDef.h"
+#include "CollisionEngineDef.h"
+#include "PMath.h"
+
+namespace Physics {
+
+	class ThreadPool;
+
+	/** @class	ParticleColliders
+		@brief	The planes, spheres and heightfields particles collide with, gathered once per time step
+
+		Stored structure of arrays, like the particles themselves. Particles bounce off the
+		colliders, but don't push them; particles are meant for effects.
+	 */
+
+	class ParticleColliders
+	{
+	public:
+		void Clear();
+		void AddPlane(const PMath::Plane& plane);
+		void AddSphere(const PMath::Vec3f& center, Real radius, const PMath::Vec3f& velocity);
+
+		int		GetPlaneCount() const	{ return (int) m_PlaneD.size(); }
+		int		GetSphereCount() const	{ return (int) m_SphereR.size(); }
+
+		std::vector<Real>	m_PlaneNX, m_PlaneNY, m_PlaneNZ, m_PlaneD;
+		std::vector<Real>	m_SphereX, m_SphereY, m_SphereZ, m_SphereR;
+		std::vector<Real>	m_SphereVX, m_SphereVY, m_SphereVZ;
+		std::vector<const Collision::Heightfield*>	m_Heightfields;
+	};
+
+	/** @class	ParticleSystem
+		@brief	Many point masses of one radius, with no orientation and no collision geometry
+
+		Each component of position and velocity has its own array, so the integration kernel
+		streams through memory in straight lines that the compiler can vectorize. Particles
+		accelerate by gravity and linear drag, and are advanced by velocity Verlet; the drag
+		is treated implicitly, so it is stable for any time step. The particles are integrated
+		and collided in blocks; each block finds its bounds, culls the spheres that can't reach
+		it, then collides its particles against the planes and the surviving spheres.
+		Blocks run in parallel on the engine's threads.
+	 */
+
+	class ParticleSystem
+	{
+	public:
+		ParticleSystem();
+
+		/// replace the particles; pVelocities may be zero, in which case the particles start at rest
+		void	SetParticles(int count, PMath::Vec3f const*const pPositions, PMath::Vec3f const*const pVelocities, int byteStride);
+
+		/// overwrite count positions or velocities starting at first. @return the number written
+		int		SetVectors(bool velocities, int first, int count, PMath::Vec3f const*const pValues, int byteStride);
+
+		/// copy count positions or velocities starting at first. @return the number copied
+		int		GetVectors(bool velocities, int first, int count, PMath::Vec3f* pResult, int byteStride) const;
+
+		/// advance all the particles by dt, and collide them
+		void	Integrate(Real dt, const PMath::Vec3f gravity, const ParticleColliders& colliders, ThreadPool& threads);
+
+		int		GetCount() const		{ return m_Count; }
+
+		/// @return bytes reserved for the particle arrays
+		int		GetBytes() const		{ return (int) (6 * m_X.capacity() * sizeof(Real)); }
+
+		std::vector<Real>			m_X, m_Y, m_Z;			//!< positions
+		std::vector<Real>			m_VX, m_VY, m_VZ;		//!< velocities
+
+		int							m_Count;
+		Real						m_Radius;				//!< every particle's radius; zero for points
+		Real						m_Restitution;			//!< fraction of the normal velocity kept in a bounce
+		Real						m_Drag;					//!< linear drag, per second
+		bool						m_Active;
+		bool						m_UseGravity;
+		bool						m_Collidable;
+
+	protected:
+		static void					IntegrateRange(void* pData, int begin, int end);
+		void						IntegrateBlock(int begin, int end);
+		void						CollideSpheres(int begin, int end, const int* pSpheres, int sphereCount);
+		void						CollideHeightfield(int begin, int end, const Collision::Heightfield& field);
+
+		// the arguments of the Integrate in progress, for IntegrateRange
+		Real						m_StepDt;
+		PMath::Vec3f				m_StepGravity;
+		const ParticleColliders*	m_pStepColliders;
+	};
+
+}	// end Physics namespace
+
+#endif
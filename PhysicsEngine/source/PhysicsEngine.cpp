@@ -25,6 +25,10 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 */
 
 #include <map>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
 
 #ifdef WIN32
 	#define WIN32_LEAN_AND_MEAN
@@ -46,6 +50,17 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "Spring.h"
 #include "Constraint.h"
 #include "SpringMesh.h"
+#include "Articulation.h"
+#include "ConstraintSolver.h"
+#include "Islands.h"
+#include "Broadphase.h"
+#include "ImplicitSpringSolver.h"
+#include "ParticleSystem.h"
+#include "ForceField.h"
+#include "PhysicsThread.h"
+#include "MappedFile.h"
+#include "SceneFile.h"
+#include "Pool.h"
 
 // hoists
 
@@ -56,6 +71,16 @@ using Physics::Engine;
 using Physics::RigidBody;
 using Physics::Spring;
 using Physics::Constraint;
+using Physics::MappedFile;
+using Physics::SceneTable;
+using Physics::SceneHeader;
+using Physics::SceneBody;
+using Physics::SceneSpring;
+using Physics::SceneConstraint;
+using Physics::SceneArticulation;
+using Physics::SceneJoint;
+using Physics::Articulation;
+using Physics::ArticulationLink;
 
 // typedefs 
 
@@ -63,6 +88,9 @@ namespace Physics {
 	typedef std::map<int, RigidBody*>	RigidBodyMap;		//!< maps unique IDs to RigidBody pointers.
 	typedef std::map<int, Spring*>		SpringMap;
 	typedef std::map<int, Constraint*>	ConstraintMap;
+	typedef std::map<int, ParticleSystem*>	ParticleMap;
+	typedef std::map<int, ForceField*>		ForceFieldMap;
+	typedef std::map<int, Articulation*>	ArticulationMap;
 }
 
 
@@ -119,6 +147,21 @@ static char* SCALARPROPSTRING(Physics::Engine :: ERigidBodyScalar prop) {
 	case Physics::Engine :: propAngularVelocityDamp:	return "propAngularVelocityDamp";
 	case Physics::Engine :: propLinearVelocityDamp:	return "propLinearVelocityDamp";
 	case Physics::Engine :: propMass:					return "propMass";
+	case Physics::Engine :: propSpringMeshStiffness:	return "propSpringMeshStiffness";
+	case Physics::Engine :: propSpringMeshDamping:		return "propSpringMeshDamping";
+	case Physics::Engine :: propSpringMeshCompliance:	return "propSpringMeshCompliance";
+	case Physics::Engine :: propSpringMeshThickness:	return "propSpringMeshThickness";
+	}
+	return "unknown";
+}
+
+static char* INTPROPSTRING(Physics::Engine :: ERigidBodyInt prop) {
+	switch (prop) {
+	case Physics::Engine :: propSpringMeshSolver:		return "propSpringMeshSolver";
+	case Physics::Engine :: propSpringMeshSubsteps:		return "propSpringMeshSubsteps";
+	case Physics::Engine :: propSpringMeshIterations:	return "propSpringMeshIterations";
+	case Physics::Engine :: propUpdateInterval:			return "propUpdateInterval";
+	case Physics::Engine :: propIntegrator:				return "propIntegrator";
 	}
 	return "unknown";
 }
@@ -134,28 +177,1177 @@ static char* Vec3fPROPSTRING(Physics::Engine :: ERigidBodyVector prop) {
 
 
 namespace Physics {
+
+/** @class BodySnapshot
+	The readable state of one body, published at the end of an asynchronous step
+ */
+	class BodySnapshot
+	{
+	public:
+		uint32				m_Id;
+		Vec3f				m_Position;
+		Vec3f				m_Velocity;
+		Quaternion			m_Orientation;
+		bool				m_Spinnable;
+
+		bool operator < (uint32 id) const { return m_Id < id; }
+	};
+
+	typedef std::vector<BodySnapshot>	SnapshotVector;
+
+/** @class PendingCommand
+	A property change issued while an asynchronous step is running, applied by Sync(),
+	or a change deferred by a collision callback, applied when the step ends
+ */
+	class PendingCommand
+	{
+	public:
+		enum EKind {	kRigidBodyBool, kRigidBodyScalar, kRigidBodyInt, kRigidBodyVec3f, kRigidBodyQuat,
+						kSpringBool, kSpringUInt32, kSpringScalar, kSpringVec3f,
+						kConstraintBool, kConstraintScalar,
+						kParticleBool, kParticleScalar,
+						kForceFieldBool, kForceFieldScalar, kForceFieldVec3f,
+						kArticulationBool, kArticulationScalar,
+						kImpulse, kTwist, kStopMoving, kStopSpinning, kGravity, kRemoveRigidBody };
+
+		PendingCommand(EKind kind, uint32 id, int prop) : m_Kind(kind), m_Id(id), m_Prop(prop), m_Bool(false), m_Int(0), m_UInt(0), m_Scalar(k0) { }
+
+		EKind		m_Kind;
+		uint32		m_Id;					//!< body, spring, constraint, particle set, force field, or articulation the command applies to
+		int			m_Prop;					//!< property enum, cast to the appropriate type when applied
+		bool		m_Bool;
+		int			m_Int;
+		uint32		m_UInt;
+		Real		m_Scalar;
+		Vec3f		m_Vector;
+		Quaternion	m_Quat;
+	};
+
+/** @class PairCandidates
+	Collects the broadphase entries after one entry whose bounds overlap it
+ */
+	class PairCandidates
+	{
+	public:
+		PairCandidates(int self, std::vector<int>& candidates) : m_Self(self), m_Candidates(candidates) { }
+
+		bool operator()(int entry) {
+			if (entry > m_Self) {
+				m_Candidates.push_back(entry);
+			}
+			return true;
+		}
+
+		int					m_Self;
+		std::vector<int>&	m_Candidates;
+	};
+
+/** @class Impact
+	A contact waiting in the time of impact queue
+ */
+	class Impact
+	{
+	public:
+		Real		m_Time;
+		int			m_Order;				//!< breaks ties by the order the contacts were found
+		Contact*	m_pContact;
+		RigidBody*	m_pBodyA;
+		RigidBody*	m_pBodyB;
+		int			m_ImpactsA;				//!< the bodies' m_Impacts when it was found; if either has changed, it was tested again
+		int			m_ImpactsB;
+
+		/// the heap puts the greatest first, so the earliest impact compares greatest
+		bool operator<(const Impact& other) const {
+			return m_Time > other.m_Time || (m_Time == other.m_Time && m_Order > other.m_Order);
+		}
+	};
+
+/** @class PairRef
+	One of the pairs a body is in, sorted by body so that its pairs can be found again
+ */
+	class PairRef
+	{
+	public:
+		RigidBody*	m_pBody;
+		int			m_Pair;
+
+		bool operator<(const PairRef& other) const {
+			return m_pBody < other.m_pBody || (m_pBody == other.m_pBody && m_Pair < other.m_Pair);
+		}
+	};
+
+/** @class MeshColliders
+	Collects the collidable planes and spheres the broadphase finds near a spring mesh
+ */
+	class MeshColliders
+	{
+	public:
+		MeshColliders(std::vector<RigidBody*>& colliders) : m_Colliders(colliders) { }
+
+		bool operator()(const Broadphase::Entry& entry) {
+			RigidBody* pBody = entry.m_pBody;
+			uint32 kind = pBody->m_pCollideGeo->GetKind();
+			if (pBody->GetCollidable() && (kind == kC_Plane || kind == kC_Sphere)) {
+				m_Colliders.push_back(pBody);
+			}
+			return true;
+		}
+
+		std::vector<RigidBody*>&	m_Colliders;
+	};
+
+/** @class FieldCandidates
+	Adds the active, movable bodies the broadphase finds near a force field to their groups' batches
+ */
+	class FieldCandidates
+	{
+	public:
+		FieldCandidates(const ForceField* pField, std::vector<ForceFieldBatch>& batches) : m_pField(pField), m_Batches(batches) { }
+
+		bool operator()(const Broadphase::Entry& entry) {
+			RigidBody* pBody = entry.m_pBody;
+			if (pBody->GetActive() && pBody->GetTranslatable()) {
+				m_Batches[pBody->m_Group].Add(m_pField, pBody);
+			}
+			return true;
+		}
+
+		const ForceField*				m_pField;
+		std::vector<ForceFieldBatch>&	m_Batches;
+	};
+
+	static const Real	kDefaultStabilityGrowth	= Real(0.1f);	//!< used by FindStableTimeStep if the stability monitor is off
+	static const int	kStableSearchBisections	= 4;			//!< FindStableTimeStep's refinements after halving
+	static const int	kNumDegradeStages		= 3;			//!< fewer iterations, waiting far islands, fewer substeps
+
 /** @class PEAux
 	The auxiliary data structures, hidden from the user
  */
-	class PEAux 
+	class PEAux
 	{
 	public:
-		PEAux() : m_pCollisionCallback(0) { 
+		PEAux() : m_pCollisionCallback(0), m_RecordContacts(false), m_Simulating(false), m_FrontSnapshot(0), m_SnapshotStale(true),
+			m_RigidBodyPool(256), m_SpringMeshPool(16), m_SpringPool(256), m_DistanceConstraintPool(256), m_ParticleSystemPool(16), m_ForceFieldPool(16),
+			m_ArticulationPool(16) {
 			m_Gravity[0]	= k0;
 			m_Gravity[1]	= k0;
 			m_Gravity[2]	= Real(0.98);
 			m_MinTimeStep	= 1.0f / 50.0f;
+			m_AsyncDt		= k0;
+			m_LODHalfRate	= k0;
+			m_LODQuarterRate = k0;
+			m_LODFrame		= 0;
+			m_MaxImpacts	= 0;
+			m_SpeculativeFraction = k0;
+			m_StabilityGrowth = k0;
+			m_PrevEnergy	= k0;
+			m_PrevActiveEnergy = k0;
+			m_PrevBodyCount	= -1;
+			m_ContactWork	= k0;
+			m_TimeBudget	= 0;
+			m_DegradeStage	= 0;
+			m_WorldStepSeconds = 0;
+			m_FullIterations = 0;
+			m_FullSubsteps	= 0;
+			m_NextImpact	= 0;
+			for (int t = 0; t < kNumLODTiers; ++t) {
+				m_TierTime[t]	= k0;
+				m_TierScale[t]	= k1;
+				m_TierDue[t]	= true;
+			}
 		}
 
 		~PEAux() { }
 
+		/// queue cmd if a step is running, @return true if queued, false if the caller should apply it now
+		bool Defer(const PendingCommand& cmd)
+		{
+			if (m_Simulating) {
+				m_PendingCommands.push_back(cmd);
+				return true;
+			}
+			m_SnapshotStale = true;
+			return false;
+		}
+
+		/// destroy a body and its collision geometry, returning both to their pools
+		void DeleteBody(RigidBody* pBody)
+		{
+			m_CollisionEngine.DeleteGeometry(pBody->m_pCollideGeo);
+			if (pBody->GetInertialKind() == kI_SpringMesh) {
+				m_SpringMeshPool.Delete((SpringMesh*) pBody);
+			}
+			else {
+				m_RigidBodyPool.Delete(pBody);
+			}
+		}
+
+		/// add an immovable body for terrain geometry. @return its id
+		uint32 AddTerrain(IGeometry* pCollide)
+		{
+			uint32 id			= UniqueID();
+			RigidBody* pBody	= m_RigidBodyPool.New();
+			m_Bodies[id]		= pBody;
+
+			pBody->SetInertialKind(kI_Immobile);
+			pBody->SetCollisionObject(pCollide);
+			pBody->SetSpinnable(false);
+			pBody->SetTranslatable(false);
+			m_Broadphase.Insert(id, pBody);
+			return id;
+		}
+
+		/// destroy a constraint, returning it to its pool
+		void DeleteConstraint(Constraint* pConstraint)
+		{
+			if (pConstraint->GetKind() == DistanceConstraint::GetStaticKind()) {
+				m_DistanceConstraintPool.Delete((DistanceConstraint*) pConstraint);
+			}
+			else {
+				delete pConstraint;
+			}
+		}
+
+		/// partition the active bodies into islands, and decide how many substeps each takes in a world step of dt
+		void BuildIslands(Real dt)
+		{
+			m_Islands.Begin();
+			for (Physics::RigidBodyMap::iterator rbIter = m_Bodies.begin(); rbIter != m_Bodies.end(); ++rbIter) {
+				if (rbIter->second->GetActive()) {
+					m_Islands.AddBody(rbIter->second);
+				}
+			}
+			for (Physics::SpringMap::iterator springIter = m_Springs.begin(); springIter != m_Springs.end(); ++springIter) {
+				Spring* pSpring = springIter->second;
+				if (pSpring->mp_BodyA != 0 && pSpring->mp_BodyB != 0) {
+					m_Islands.AddSpring(pSpring);
+				}
+			}
+			for (Physics::ConstraintMap::iterator cIter = m_Constraints.begin(); cIter != m_Constraints.end(); ++cIter) {
+				if (cIter->second->GetKind() == DistanceConstraint::GetStaticKind()) {
+					DistanceConstraint* pDC = (DistanceConstraint*) cIter->second;
+					m_Islands.AddConstraint(pDC, pDC->mp_BodyA, pDC->mp_BodyB);
+				}
+			}
+			for (Physics::ArticulationMap::iterator aIter = m_Articulations.begin(); aIter != m_Articulations.end(); ++aIter) {
+				if (aIter->second->Ready()) {
+					m_Islands.AddArticulation(aIter->second);
+				}
+			}
+			m_Islands.Build(dt, m_TierScale);
+		}
+
+		/*
+			Level of detail tier t is stepped on every 2^t-th frame, through all the time it waited,
+			so a slow body covers the same time as a fast one, in fewer, longer steps. A body only
+			changes tier on a frame its tier is stepped, and only to a tier that is stepped on that
+			frame too, so no time is skipped or stepped twice. The frame after a slow body's tier
+			is stepped, its state is still where that step left it, and it takes part in collisions
+			as a body that doesn't move; contacts still change its velocity, which it moves with
+			when its tier is next stepped. A body touched by a faster one is promoted to the
+			faster tier when its own tier is next stepped.
+		 */
+
+		/// decide which tiers are stepped in a frame of dt, and how much time each covers
+		/// @return true if holdFarTiers kept any tier but the first from being stepped, losing the time it waited
+		bool BeginLODFrame(Real dt, bool holdFarTiers)
+		{
+			bool held = false;
+			holdFarTiers = holdFarTiers && !m_LODFocus.empty() && (m_LODHalfRate > k0 || m_LODQuarterRate > k0);
+			for (int t = 0; t < kNumLODTiers; ++t) {
+				m_TierTime[t] += dt;
+				m_TierDue[t] = ((m_LODFrame + 1) & ((1 << t) - 1)) == 0;
+				if (holdFarTiers && t > 0 && m_TierDue[t]) {
+					m_TierDue[t] = false;
+					m_TierTime[t] = k0;
+					held = true;
+				}
+				m_TierScale[t] = (m_TierDue[t] && dt > k0) ? m_TierTime[t] / dt : k1;
+			}
+			return held;
+		}
+
+		/// move the bodies whose tier was stepped to the tiers they belong in now
+		void EndLODFrame()
+		{
+			for (Physics::RigidBodyMap::iterator rbIter = m_Bodies.begin(); rbIter != m_Bodies.end(); ++rbIter) {
+				RigidBody* pBody = rbIter->second;
+				if (!pBody->GetActive()) {
+					pBody->m_LODTier = 0;			// starts at full rate when it wakes
+					pBody->m_LODPromote = kNumLODTiers - 1;
+					continue;
+				}
+				if (!m_TierDue[pBody->m_LODTier]) {
+					continue;
+				}
+
+				int tier = LODTierAt(pBody->m_StateT1.m_Position);
+				if (pBody->m_LODPromote < tier) {
+					tier = pBody->m_LODPromote;
+				}
+				while (!m_TierDue[tier]) {
+					--tier;							// tier 0 is always due
+				}
+				pBody->m_LODTier = tier;
+				pBody->m_LODPromote = kNumLODTiers - 1;
+			}
+
+			for (int t = 0; t < kNumLODTiers; ++t) {
+				if (m_TierDue[t]) {
+					m_TierTime[t] = k0;
+				}
+			}
+			++m_LODFrame;
+		}
+
+		/// @return the tier a body at position belongs in, by its distance to the nearest focus point
+		int LODTierAt(const Vec3f position) const
+		{
+			int count = (int) m_LODFocus.size() / 3;
+			if (count == 0 || (m_LODHalfRate <= k0 && m_LODQuarterRate <= k0)) {
+				return 0;
+			}
+
+			Real nearest = Real(1.0e30f);
+			for (int i = 0; i < count; ++i) {
+				Real dx = position[0] - m_LODFocus[i * 3];
+				Real dy = position[1] - m_LODFocus[i * 3 + 1];
+				Real dz = position[2] - m_LODFocus[i * 3 + 2];
+				Real d2 = dx * dx + dy * dy + dz * dz;
+				nearest = d2 < nearest ? d2 : nearest;
+			}
+
+			if (m_LODQuarterRate > k0 && nearest > m_LODQuarterRate * m_LODQuarterRate) {
+				return 2;
+			}
+			if (m_LODHalfRate > k0 && nearest > m_LODHalfRate * m_LODHalfRate) {
+				return 1;
+			}
+			return 0;
+		}
+
+		/// a movable body touching a slower one brings it up to its own tier
+		void PromoteSlower(RigidBody* pBodyA, RigidBody* pBodyB)
+		{
+			if (pBodyA->m_LODTier > pBodyB->m_LODTier) {
+				RigidBody* pTemp = pBodyA;
+				pBodyA = pBodyB;
+				pBodyB = pTemp;
+			}
+			if (pBodyA->m_LODTier < pBodyB->m_LODTier && pBodyA->GetActive() && pBodyA->GetOOMass() > k0 &&
+				pBodyA->m_LODTier < pBodyB->m_LODPromote) {
+				pBodyB->m_LODPromote = pBodyA->m_LODTier;
+			}
+		}
+
+		/// bodies whose tier isn't stepped this frame sweep nowhere
+		void HoldSkipped(IslandGroup& group)
+		{
+			for (std::vector<RigidBody*>::iterator rbIter = group.m_Bodies.begin(); rbIter != group.m_Bodies.end(); ++rbIter) {
+				(*rbIter)->m_StateT0 = (*rbIter)->m_StateT1;
+			}
+		}
+
+		/*
+			The bodies a field may reach are found once per world step, from where the broadphase
+			last saw them, so a body that enters a field's bounds during a world step feels it
+			from the next; each substep tests exactly where the bodies are.
+		 */
+
+		/// find the bodies near each active force field, sorted into the batches of their island groups
+		void GatherForceFields()
+		{
+			int groups = m_Islands.GetGroupCount();
+			if ((int) m_FieldBatches.size() < groups) {
+				m_FieldBatches.resize(groups);
+			}
+			for (int g = 0; g < groups; ++g) {
+				m_FieldBatches[g].Clear();
+			}
+
+			for (Physics::ForceFieldMap::iterator fIter = m_ForceFields.begin(); fIter != m_ForceFields.end(); ++fIter) {
+				ForceField* pField = fIter->second;
+				if (!pField->m_Active) {
+					continue;
+				}
+				Real boundsMin[3], boundsMax[3];
+				pField->GetBounds(boundsMin, boundsMax);
+				FieldCandidates candidates(pField, m_FieldBatches);
+				m_Broadphase.VisitBox(boundsMin, boundsMax, candidates);
+			}
+		}
+
+		/// advance one group of islands by one substep
+		void Integrate(IslandGroup& group, ForceFieldBatch& fields, Real dt)
+		{
+			std::vector<Spring*>::iterator		springIter;
+			std::vector<Constraint*>::iterator	cIter;
+			std::vector<Articulation*>::iterator	aIter;
+			int									c;
+
+			// reset simulation, then integrate the first half of the time step, a bucket of bodies at a time
+			/// @todo reawaken objects which have been put to sleep but which can't sleep any more
+			/// @todo bail early if asleep
+
+			for (c = 0; c < kNumBodyCategories; ++c) {
+				if (!group.m_Categories[c].empty()) {
+					kBucketUpdates[c].m_Reset(group.m_Categories[c]);
+				}
+			}
+			for (c = 0; c < kNumBodyCategories; ++c) {
+				if (!group.m_Categories[c].empty()) {
+					kBucketUpdates[c].m_Integrate1(group.m_Categories[c], dt, m_Gravity);
+				}
+			}
+
+			// loop over all springs
+			//		add forces to appropriate bodies
+
+			for (springIter = group.m_Springs.begin(); springIter != group.m_Springs.end(); ++springIter) {
+				Spring* pSpring = *springIter;
+				if (pSpring->m_Implicit) {
+					continue;
+				}
+
+				Vec3f* pPosA = &pSpring->mp_BodyA->m_StateT1.m_Position;
+				Vec3f* pPosB = &pSpring->mp_BodyB->m_StateT1.m_Position;
+
+				Vec3f direction;
+				Vec3fSubtract(direction, *pPosA, *pPosB);
+				Real length = Vec3fLength(direction);
+
+				Real x = length - pSpring->m_RestLength;
+
+				if (pSpring->m_ResistCompression || (x > k0)) {
+					Real force = pSpring->m_Stiffness * x;
+
+					// damping -b * difference in length between this frame and previous
+					Real v = (pSpring->m_PrevLength - x);
+					force += v * pSpring->m_Damping;
+
+					pSpring->m_PrevLength = length;
+
+					Vec3fMultiplyAccumulate(pSpring->mp_BodyA->m_Acc.m_Force, -force, direction);
+					Vec3fMultiplyAccumulate(pSpring->mp_BodyB->m_Acc.m_Force,  force, direction);
+				}
+			}
+
+			// force fields add their forces to the bodies within them
+
+			fields.Apply(m_Gravity);
+
+			// loop over all objects,
+			//			if not asleep
+			//				integrate second half of time step
+
+			for (c = 0; c < kNumBodyCategories; ++c) {
+				if (!group.m_Categories[c].empty()) {
+					kBucketUpdates[c].m_Integrate2(group.m_Categories[c], dt, m_Gravity);
+				}
+			}
+
+			// articulations move their links by the forces on them, in one pass over each tree
+
+			for (aIter = group.m_Articulations.begin(); aIter != group.m_Articulations.end(); ++aIter) {
+				(*aIter)->Step(dt, m_Gravity);
+			}
+
+			// springs marked implicit are integrated together, after the other forces
+
+			SolveImplicitSprings(group.m_Springs, dt);
+
+			// loop over all contraints
+			//		if active, 
+			//			satisfy constraints by projecting positions, then correct velocities
+
+			for (cIter = group.m_Constraints.begin(); cIter != group.m_Constraints.end(); ++cIter) {
+				DistanceConstraint* pDC = (DistanceConstraint*) *cIter;
+				if (pDC->m_Active && pDC->mp_BodyA->GetActive() && pDC->mp_BodyB->GetActive()) {
+					m_ConstraintSolver.Add(pDC);
+				}
+			}
+
+			m_ConstraintSolver.Solve(dt, m_Threads);
+
+			// what the springs and constraints did to the links passes into their joints
+
+			for (aIter = group.m_Articulations.begin(); aIter != group.m_Articulations.end(); ++aIter) {
+				(*aIter)->Absorb();
+			}
+		}
+
+		/// pass what the contacts did to the links of the articulations into their joints
+		void AbsorbContacts()
+		{
+			for (Physics::ArticulationMap::iterator aIter = m_Articulations.begin(); aIter != m_Articulations.end(); ++aIter) {
+				if (aIter->second->Ready()) {
+					aIter->second->Absorb();
+				}
+			}
+		}
+
+		/// integrate the springs marked implicit, and the bodies they connect, by one backward Euler step
+		void SolveImplicitSprings(std::vector<Spring*>& springs, Real dt)
+		{
+			m_ImplicitLinks.clear();
+			m_ImplicitBodies.clear();
+			for (std::vector<Spring*>::iterator iter = springs.begin(); iter != springs.end(); ++iter) {
+				Spring* pSpring = *iter;
+				if (pSpring->m_Implicit && pSpring->mp_BodyA->GetActive() && pSpring->mp_BodyB->GetActive()) {
+					m_ImplicitLinks.push_back(pSpring);
+					AddImplicitBody(pSpring->mp_BodyA);
+					AddImplicitBody(pSpring->mp_BodyB);
+				}
+			}
+			if (m_ImplicitLinks.empty()) {
+				return;
+			}
+
+			// the bodies' other forces have already been integrated; the springs are linearized at the start of the step
+			Vec3f noForce;
+			Vec3fZero(noForce);
+			int i;
+			m_ImplicitSprings.Reset((int) m_ImplicitBodies.size());
+			for (i = 0; i < (int) m_ImplicitBodies.size(); ++i) {
+				RigidBody* pBody = m_ImplicitBodies[i];
+				m_ImplicitSprings.SetPoint(i, pBody->m_StateT0.m_Position, pBody->m_StateT1.m_Velocity, pBody->GetOOMass(), noForce);
+			}
+			for (i = 0; i < (int) m_ImplicitLinks.size(); ++i) {
+				Spring* pSpring = m_ImplicitLinks[i];
+				m_ImplicitSprings.AddSpring(pSpring->mp_BodyA->m_SolverIndex, pSpring->mp_BodyB->m_SolverIndex,
+					pSpring->m_RestLength, pSpring->m_Stiffness, pSpring->m_Damping, pSpring->m_ResistCompression);
+			}
+
+			m_ImplicitSprings.Solve(dt, &m_Threads);
+
+			// the first half step moved the bodies with the old velocity, so add the difference
+			for (i = 0; i < (int) m_ImplicitBodies.size(); ++i) {
+				RigidBody* pBody = m_ImplicitBodies[i];
+				const Real* dv = m_ImplicitSprings.GetVelocityChange(i);
+				Vec3fAdd(pBody->m_StateT1.m_Velocity, dv);
+				Vec3fMultiplyAccumulate(pBody->m_StateT1.m_Position, dt, dv);
+				pBody->m_SolverIndex = -1;
+			}
+		}
+
+		void AddImplicitBody(RigidBody* pBody)
+		{
+			if (pBody->m_SolverIndex < 0) {
+				pBody->m_SolverIndex = (int) m_ImplicitBodies.size();
+				m_ImplicitBodies.push_back(pBody);
+			}
+		}
+
+		/// rebuild the broadphase around where the bodies swept this world step
+		/// dt is the minimum time step, which a fast sphere looks ahead for speculative contacts
+		void BuildBroadphase(Real dt)
+		{
+			m_Broadphase.Begin();
+			for (Physics::RigidBodyMap::iterator rbIter = m_Bodies.begin(); rbIter != m_Bodies.end(); ++rbIter) {
+				RigidBody* pBody = rbIter->second;
+				pBody->m_LookAhead = k0;
+				if (m_SpeculativeFraction > k0 && pBody->m_ShapeKind == kC_Sphere && pBody->GetTranslatable()) {
+					Real reach = m_SpeculativeFraction * ((Collision::Sphere*) pBody->m_pCollideGeo)->m_Radius;
+					Real speed = Vec3fLength(pBody->m_StateT1.m_Velocity);
+					if (speed * dt > reach) {
+						pBody->m_LookAhead = dt;
+					}
+				}
+				m_Broadphase.Add(rbIter->first, pBody);
+			}
+			m_Broadphase.Build();
+		}
+
+		/*
+			A pair is tested if the body with the lower id is collidable, with that body first,
+			just as when every pair was tested; the broadphase only skips the pairs whose
+			bounds don't overlap. The candidates are sorted so that contacts are found, and
+			resolved, in the same order as before; the narrowphase tests the pairs by kind,
+			but returns their contacts in this order.
+		 */
+
+		void FindContacts()
+		{
+			m_Pairs.clear();
+			for (int a = 0; a < m_Broadphase.GetEntryCount(); ++a) {
+				const Broadphase::Entry& entryA = m_Broadphase.GetEntry(a);
+				if (!entryA.m_pBody->GetCollidable()) {
+					continue;
+				}
+
+				m_Candidates.clear();
+				if (entryA.m_Unbounded) {
+					for (int b = a + 1; b < m_Broadphase.GetEntryCount(); ++b) {
+						m_Candidates.push_back(b);
+					}
+				}
+				else {
+					PairCandidates candidates(a, m_Candidates);
+					m_Broadphase.Overlap(entryA.m_Min, entryA.m_Max, candidates);
+					std::sort(m_Candidates.begin(), m_Candidates.end());
+				}
+
+				for (std::vector<int>::iterator iter = m_Candidates.begin(); iter != m_Candidates.end(); ++iter) {
+					const Broadphase::Entry& entryB = m_Broadphase.GetEntry(*iter);
+					if (entryA.m_pBody->m_pArticulation != 0 && entryA.m_pBody->m_pArticulation == entryB.m_pBody->m_pArticulation) {
+						continue;		// the joints keep the links of one articulation apart
+					}
+					PromoteSlower(entryA.m_pBody, entryB.m_pBody);
+
+					BodyPair pair;
+					pair.m_pBodyA	= entryA.m_pBody;
+					pair.m_pBodyB	= entryB.m_pBody;
+					pair.m_IdA		= entryA.m_Id;
+					pair.m_IdB		= entryB.m_Id;
+					m_Pairs.push_back(pair);
+				}
+			}
+
+			m_CollisionEngine.TestPairs(m_Pairs);
+		}
+
+		/*
+			Only if someone is listening is the contact described, and the momentum its
+			resolution gave each body measured. A callback that rejects the contact gets
+			the bodies' states back as they were before it was resolved. Speculative contacts
+			are between bodies that haven't touched, so they are resolved without a word.
+		 */
+
+		void ResolveContact(Contact* pContact)
+		{
+			if ((m_pCollisionCallback == 0 && !m_RecordContacts) || m_CollisionEngine.IsSpeculative(pContact)) {
+				m_CollisionEngine.Resolve(pContact);
+				return;
+			}
+
+			ContactEvent event;
+			RigidBody* pBodyA;
+			RigidBody* pBodyB;
+			m_CollisionEngine.DescribeContact(pContact, event, pBodyA, pBodyB);
+			DynamicState stateA;
+			DynamicState stateB;
+			stateA = pBodyA->m_StateT1;
+			stateB = pBodyB->m_StateT1;
+
+			m_CollisionEngine.Resolve(pContact);
+
+			if (pBodyA->GetOOMass() > k0) {
+				Vec3fSubtract(event.m_ImpulseA, pBodyA->m_StateT1.m_Velocity, stateA.m_Velocity);
+				Vec3fScale(event.m_ImpulseA, k1 / pBodyA->GetOOMass());
+			}
+			if (pBodyB->GetOOMass() > k0) {
+				Vec3fSubtract(event.m_ImpulseB, pBodyB->m_StateT1.m_Velocity, stateB.m_Velocity);
+				Vec3fScale(event.m_ImpulseB, k1 / pBodyB->GetOOMass());
+			}
+
+			if (m_pCollisionCallback != 0 &&
+				!m_pCollisionCallback->CollisionOccurred(event.m_BodyA, event.m_BodyB, event.m_Position, event.m_Normal, event.m_ImpulseA, event.m_ImpulseB)) {
+				pBodyA->m_StateT1 = stateA;
+				pBodyB->m_StateT1 = stateB;
+				return;
+			}
+
+			if (m_RecordContacts) {
+				m_ContactEvents.push_back(event);
+			}
+		}
+
+		/*
+			Resolving a contact changes its bodies' velocities, and may move them, so contacts found
+			against their old paths are stale; each of their pairs is tested again against the new
+			paths, and the queue skips contacts found before the bodies changed. Static bodies don't
+			move when struck, so their pairs aren't tested again, and their contacts never go stale.
+		 */
+
+		/// resolve the contacts found by FindContacts, earliest first
+		void ResolveInTimeOrder()
+		{
+			int i;
+			m_PairRefs.resize(m_Pairs.size() * 2);
+			for (i = 0; i < (int) m_Pairs.size(); ++i) {
+				m_PairRefs[i * 2].m_pBody		= m_Pairs[i].m_pBodyA;
+				m_PairRefs[i * 2].m_Pair		= i;
+				m_PairRefs[i * 2 + 1].m_pBody	= m_Pairs[i].m_pBodyB;
+				m_PairRefs[i * 2 + 1].m_Pair	= i;
+			}
+			std::sort(m_PairRefs.begin(), m_PairRefs.end());
+
+			m_ImpactQueue.clear();
+			m_NextImpact = 0;
+			int found = (int) m_CollisionEngine.m_Contacts.size();
+			for (i = 0; i < found; ++i) {
+				QueueImpact(m_CollisionEngine.m_Contacts[i]);
+			}
+
+			int events = 0;
+			while (!m_ImpactQueue.empty()) {
+				std::pop_heap(m_ImpactQueue.begin(), m_ImpactQueue.end());
+				Impact impact = m_ImpactQueue.back();
+				m_ImpactQueue.pop_back();
+				if (impact.m_ImpactsA != impact.m_pBodyA->m_Impacts || impact.m_ImpactsB != impact.m_pBodyB->m_Impacts) {
+					continue;
+				}
+
+				ResolveContact(impact.m_pContact);
+
+				// past the cap, the rest are resolved as they were found
+				if (events < m_MaxImpacts) {
+					++events;
+					RetestPairs(impact.m_pBodyA, impact.m_pBodyB);
+					RetestPairs(impact.m_pBodyB, impact.m_pBodyA);
+				}
+			}
+		}
+
+		void QueueImpact(Contact* pContact)
+		{
+			Impact impact;
+			impact.m_Time		= m_CollisionEngine.GetContactTime(pContact, impact.m_pBodyA, impact.m_pBodyB);
+			impact.m_Order		= m_NextImpact++;
+			impact.m_pContact	= pContact;
+			impact.m_ImpactsA	= impact.m_pBodyA->m_Impacts;
+			impact.m_ImpactsB	= impact.m_pBodyB->m_Impacts;
+			m_ImpactQueue.push_back(impact);
+			std::push_heap(m_ImpactQueue.begin(), m_ImpactQueue.end());
+		}
+
+		/// test the pairs of a body a contact just moved again, except the pair of that contact
+		void RetestPairs(RigidBody* pBody, RigidBody* pOther)
+		{
+			if (pBody->GetOOMass() <= k0) {
+				return;
+			}
+			++pBody->m_Impacts;
+
+			PairRef first;
+			first.m_pBody	= pBody;
+			first.m_Pair	= -1;
+			std::vector<PairRef>::iterator iter = std::lower_bound(m_PairRefs.begin(), m_PairRefs.end(), first);
+			for (; iter != m_PairRefs.end() && iter->m_pBody == pBody; ++iter) {
+				const BodyPair& pair = m_Pairs[iter->m_Pair];
+				if (pair.m_pBodyA == pOther || pair.m_pBodyB == pOther) {
+					continue;
+				}
+				Contact* pContact = m_CollisionEngine.TestCollision(pair.m_pBodyA, pair.m_pBodyB, pair.m_IdA, pair.m_IdB);
+				if (pContact != 0) {
+					QueueImpact(pContact);
+				}
+			}
+		}
+
+		/// fill in the energy, momentum and constraint error of the stats; spring meshes aren't measured
+		void MeasureEnergy(StepStats& stats)
+		{
+			stats.m_KineticEnergy	= k0;
+			stats.m_PotentialEnergy	= k0;
+			stats.m_SpringEnergy	= k0;
+			stats.m_ConstraintError	= k0;
+			Vec3fZero(stats.m_Momentum);
+
+			for (Physics::RigidBodyMap::iterator rbIter = m_Bodies.begin(); rbIter != m_Bodies.end(); ++rbIter) {
+				RigidBody* pBody = rbIter->second;
+				if (!pBody->GetActive() || pBody->GetOOMass() <= k0 || pBody->GetInertialKind() == kI_SpringMesh) {
+					continue;
+				}
+				Real mass = pBody->GetMass();
+				const Real* v = pBody->m_StateT1.m_Velocity;
+				stats.m_KineticEnergy += kHalf * mass * (v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+				stats.m_Momentum[0] += mass * v[0];
+				stats.m_Momentum[1] += mass * v[1];
+				stats.m_Momentum[2] += mass * v[2];
+				if (pBody->GetGravity()) {
+					stats.m_PotentialEnergy -= mass * Vec3fDot(m_Gravity, pBody->m_StateT1.m_Position);
+				}
+			}
+
+			for (Physics::SpringMap::iterator springIter = m_Springs.begin(); springIter != m_Springs.end(); ++springIter) {
+				Spring* pSpring = springIter->second;
+				if (pSpring->mp_BodyA == 0 || pSpring->mp_BodyB == 0) {
+					continue;
+				}
+				Vec3f direction;
+				Vec3fSubtract(direction, pSpring->mp_BodyA->m_StateT1.m_Position, pSpring->mp_BodyB->m_StateT1.m_Position);
+				Real length = Vec3fLength(direction);
+				Real rest = pSpring->m_RestLength;
+				Real x = length - rest;
+				if (pSpring->m_ResistCompression || x > k0) {
+					if (pSpring->m_Implicit) {
+						stats.m_SpringEnergy += kHalf * pSpring->m_Stiffness * x * x;
+					}
+					else {
+						// the explicit force, k x along the unnormalized direction, is k x L; its potential is zero at rest
+						stats.m_SpringEnergy += pSpring->m_Stiffness * (length * length * (length / Real(3.0f) - kHalf * rest) + rest * rest * rest / Real(6.0f));
+					}
+				}
+			}
+
+			for (Physics::ConstraintMap::iterator cIter = m_Constraints.begin(); cIter != m_Constraints.end(); ++cIter) {
+				if (cIter->second->GetKind() != DistanceConstraint::GetStaticKind()) {
+					continue;
+				}
+				DistanceConstraint* pDC = (DistanceConstraint*) cIter->second;
+				if (!pDC->m_Active || pDC->m_Distance <= k0) {
+					continue;
+				}
+				Vec3f direction;
+				Vec3fSubtract(direction, pDC->mp_BodyA->m_StateT1.m_Position, pDC->mp_BodyB->m_StateT1.m_Position);
+				Real error = Abs(Vec3fLength(direction) - pDC->m_Distance) / pDC->m_Distance;
+				stats.m_ConstraintError = error > stats.m_ConstraintError ? error : stats.m_ConstraintError;
+			}
+		}
+
+		/*
+			The energy a step may add is measured against the kinetic and spring energy it began
+			with, rather than the total, because the potential energy is only known up to a constant.
+			A blow up grows the energy geometrically, so it is caught within a few steps of starting.
+		 */
+
+		/// take the settings that change how a scene steps from another engine, for FindStableTimeStep
+		void CopySettings(const PEAux& other)
+		{
+			m_ConstraintSolver.SetMode(other.m_ConstraintSolver.GetMode(), other.m_ConstraintSolver.GetIterations());
+			m_Islands.SetBudget(other.m_Islands.GetBodySubstepBudget(), other.m_Islands.GetMaxSubsteps());
+			m_MaxImpacts			= other.m_MaxImpacts;
+			m_SpeculativeFraction	= other.m_SpeculativeFraction;
+			Vec3fSet(m_Gravity, other.m_Gravity);
+
+			m_LODFocus				= other.m_LODFocus;
+			m_LODHalfRate			= other.m_LODHalfRate;
+			m_LODQuarterRate		= other.m_LODQuarterRate;
+			m_LODFrame				= other.m_LODFrame;
+			for (int t = 0; t < kNumLODTiers; ++t) {
+				m_TierTime[t] = other.m_TierTime[t];
+			}
+		}
+
+		/*
+			The copy has every body, spring, constraint, force field and articulation, in the state
+			it is in, under the same ids, so that it steps just as the original would. Particle sets
+			are left out, since nothing they do reaches the bodies, and so is the collision callback,
+			so contacts it would have rejected are resolved.
+		 */
+
+		/// copy the scene, and the settings that change how it steps, from another engine into this empty one
+		void CopyScene(const PEAux& other)
+		{
+			CopySettings(other);
+
+			std::map<const RigidBody*, RigidBody*> copies;
+			copies[0] = 0;
+			for (Physics::RigidBodyMap::const_iterator rbIter = other.m_Bodies.begin(); rbIter != other.m_Bodies.end(); ++rbIter) {
+				const RigidBody* pBody = rbIter->second;
+				RigidBody* pCopy;
+				if (pBody->GetInertialKind() == kI_SpringMesh) {
+					SpringMesh* pMesh	= m_SpringMeshPool.New();
+					pMesh->CopyFrom(*(const SpringMesh*) pBody);
+					pMesh->m_pThreads	= &m_Threads;
+					pCopy = pMesh;
+				}
+				else {
+					pCopy	= m_RigidBodyPool.New();
+					*pCopy	= *pBody;
+				}
+				pCopy->SetCollisionObject(CopyGeometry(pBody->m_pCollideGeo));
+				pCopy->m_pArticulation = 0;
+				m_Bodies.insert(m_Bodies.end(), Physics::RigidBodyMap::value_type(rbIter->first, pCopy));
+				if (pCopy->m_pCollideGeo != 0) {
+					m_Broadphase.Insert(rbIter->first, pCopy);
+				}
+				copies[pBody] = pCopy;
+			}
+
+			for (Physics::SpringMap::const_iterator springIter = other.m_Springs.begin(); springIter != other.m_Springs.end(); ++springIter) {
+				Spring* pSpring		= m_SpringPool.New(*springIter->second);
+				pSpring->mp_BodyA	= copies[pSpring->mp_BodyA];
+				pSpring->mp_BodyB	= copies[pSpring->mp_BodyB];
+				m_Springs.insert(m_Springs.end(), Physics::SpringMap::value_type(springIter->first, pSpring));
+			}
+
+			for (Physics::ConstraintMap::const_iterator cIter = other.m_Constraints.begin(); cIter != other.m_Constraints.end(); ++cIter) {
+				if (cIter->second->GetKind() != DistanceConstraint::GetStaticKind()) {
+					continue;
+				}
+				const DistanceConstraint* pDC = (const DistanceConstraint*) cIter->second;
+				void* pMem = m_DistanceConstraintPool.Alloc();
+				DistanceConstraint* pCopy = new (pMem) DistanceConstraint(pDC->m_BodyA, copies[pDC->mp_BodyA], pDC->m_BodyB, copies[pDC->mp_BodyB],
+																		  pDC->m_Distance, pDC->m_Tolerance);
+				pCopy->m_Active = pDC->m_Active;
+				m_Constraints.insert(m_Constraints.end(), Physics::ConstraintMap::value_type(cIter->first, pCopy));
+			}
+
+			for (Physics::ForceFieldMap::const_iterator fIter = other.m_ForceFields.begin(); fIter != other.m_ForceFields.end(); ++fIter) {
+				m_ForceFields.insert(m_ForceFields.end(), Physics::ForceFieldMap::value_type(fIter->first, m_ForceFieldPool.New(*fIter->second)));
+			}
+
+			for (Physics::ArticulationMap::const_iterator aIter = other.m_Articulations.begin(); aIter != other.m_Articulations.end(); ++aIter) {
+				Articulation* pArticulation = m_ArticulationPool.New(*aIter->second);
+				for (int i = 0; i < pArticulation->GetLinkCount(); ++i) {
+					RigidBody* pLink = copies[pArticulation->GetLinkBody(i)];
+					pArticulation->SetLinkBody(i, pLink);
+					pLink->m_pArticulation = pArticulation;
+				}
+				m_Articulations.insert(m_Articulations.end(), Physics::ArticulationMap::value_type(aIter->first, pArticulation));
+			}
+		}
+
+		/// @return new geometry from this engine's pools, shaped as pGeo; a mapped heightfield's heights are copied
+		IGeometry* CopyGeometry(IGeometry* pGeo)
+		{
+			if (pGeo == 0) {
+				return 0;
+			}
+			switch (pGeo->GetKind()) {
+			case kC_Sphere:
+				return m_CollisionEngine.NewSphere(((Collision::Sphere*) pGeo)->m_Radius);
+
+			case kC_Plane:
+				return m_CollisionEngine.NewPlane(((Collision::Plane*) pGeo)->m_Plane);
+
+			case kC_Heightfield:
+				{
+					const Heightfield* pField = (const Heightfield*) pGeo;
+					return m_CollisionEngine.NewHeightfield(pField->m_Columns, pField->m_Rows, pField->m_CellSize, pField->m_Origin, pField->m_pHeights);
+				}
+			}
+			return 0;
+		}
+
+		/*
+			The stages are taken in order, each only once those before it haven't let a step run all
+			its world steps within the budget. Dropping world steps takes no stage, since it is what
+			keeps a single long frame from running over; how many fit is judged by the cost of the
+			last step's world steps, which the degradations lower.
+		 */
+
+		/// degrade the coming step as far as the stage says; @return the world steps that fit the budget
+		int BeginBudget(int steps, Real dt, StepStats& stats)
+		{
+			m_FullIterations = m_ConstraintSolver.GetIterations();
+			m_FullSubsteps = m_Islands.GetMaxSubsteps();
+
+			if (m_DegradeStage >= 1 && m_FullIterations > 1) {
+				m_ConstraintSolver.SetMode(m_ConstraintSolver.GetMode(), m_FullIterations / 2);
+				stats.m_Degraded |= kDG_SolverIterations;
+			}
+			if (m_DegradeStage >= 3 && m_FullSubsteps > 1) {
+				m_Islands.SetBudget(m_Islands.GetBodySubstepBudget(), m_FullSubsteps / 4);
+				stats.m_Degraded |= kDG_Substeps;
+			}
+
+			int fit = steps;
+			if (m_WorldStepSeconds > 0) {
+				double room = m_TimeBudget / m_WorldStepSeconds;
+				fit = room < double(steps) ? (int) room : steps;
+				fit = fit > 1 ? fit : 1;
+			}
+			if (fit < steps) {
+				stats.m_Degraded |= kDG_SimulatedTime;
+				stats.m_TimeDropped += dt * Real(steps - fit);
+			}
+			return fit;
+		}
+
+		/// undo the degradations, and choose the stage of the next step by what this one cost
+		void EndBudget(double seconds, int worldSteps, bool droppedTime)
+		{
+			m_ConstraintSolver.SetMode(m_ConstraintSolver.GetMode(), m_FullIterations);
+			m_Islands.SetBudget(m_Islands.GetBodySubstepBudget(), m_FullSubsteps);
+
+			m_WorldStepSeconds = seconds / double(worldSteps > 1 ? worldSteps : 1);
+			if (droppedTime || seconds > m_TimeBudget) {
+				m_DegradeStage = m_DegradeStage < kNumDegradeStages ? m_DegradeStage + 1 : kNumDegradeStages;
+			}
+			else if (seconds < m_TimeBudget * 0.5) {
+				m_DegradeStage = m_DegradeStage > 0 ? m_DegradeStage - 1 : 0;
+			}
+		}
+
+		/// @return the kinetic, potential and spring energy of the bodies, for the stability monitor
+		Real TotalEnergy()
+		{
+			StepStats energy;
+			MeasureEnergy(energy);
+			return energy.m_KineticEnergy + energy.m_PotentialEnergy + energy.m_SpringEnergy;
+		}
+
+		/// compare the energy after a step to the energy before it, leaving out what contacts changed
+		void MonitorStability(StepStats& stats)
+		{
+			StepStats energy;
+			MeasureEnergy(energy);
+			Real total = energy.m_KineticEnergy + energy.m_PotentialEnergy + energy.m_SpringEnergy;
+			int bodies = (int) m_Bodies.size();
+
+			if (!(total - total == k0)) {
+				stats.m_Unstable = true;				// infinite, or not a number
+			}
+			else if (m_PrevBodyCount == bodies) {
+				stats.m_EnergyDrift = total - m_PrevEnergy - m_ContactWork;
+				stats.m_Unstable = stats.m_EnergyDrift > m_StabilityGrowth * (m_PrevActiveEnergy + kEps);
+			}
+
+			m_PrevEnergy		= total;
+			m_PrevActiveEnergy	= energy.m_KineticEnergy + energy.m_SpringEnergy;
+			m_PrevBodyCount		= bodies;
+		}
+
+		/// push the points of the collidable spring meshes out of the planes and spheres near them
+		void CollideSpringMeshes()
+		{
+			for (Physics::RigidBodyMap::iterator rbIter = m_Bodies.begin(); rbIter != m_Bodies.end(); ++rbIter) {
+				RigidBody* pBody = rbIter->second;
+				if (pBody->GetInertialKind() != kI_SpringMesh || !pBody->GetActive() || !pBody->GetCollidable()) {
+					continue;
+				}
+
+				SpringMesh* pMesh = (SpringMesh*) pBody;
+				Real radius = kHalf * pMesh->m_Thickness;
+				pMesh->UpdateBounds(radius);
+
+				m_MeshColliders.clear();
+				MeshColliders colliders(m_MeshColliders);
+				m_Broadphase.VisitBox(pMesh->m_BoundsMin, pMesh->m_BoundsMax, colliders);
+
+				for (std::vector<RigidBody*>::iterator cIter = m_MeshColliders.begin(); cIter != m_MeshColliders.end(); ++cIter) {
+					IGeometry* pGeo = (*cIter)->m_pCollideGeo;
+					if (pGeo->GetKind() == kC_Plane) {
+						pMesh->CollidePlane(((Collision::Plane*) pGeo)->m_Plane, radius);
+					}
+					else {
+						pMesh->CollideSphere(*cIter, ((Collision::Sphere*) pGeo)->m_Radius, radius);
+					}
+				}
+			}
+		}
+
+		/// queue the commands collision callbacks deferred during the step ahead of any the application queued
+		void TakeDeferredCommands()
+		{
+			m_PendingCommands.insert(m_PendingCommands.begin(), m_DeferredCommands.begin(), m_DeferredCommands.end());
+			m_DeferredCommands.clear();
+		}
+
+		/// collect the collidable planes and spheres, and advance every particle set by dt
+		void IntegrateParticles(Real dt)
+		{
+			if (m_Particles.empty()) {
+				return;
+			}
+
+			m_ParticleColliders.Clear();
+			for (Physics::RigidBodyMap::iterator rbIter = m_Bodies.begin(); rbIter != m_Bodies.end(); ++rbIter) {
+				RigidBody* pBody = rbIter->second;
+				if (!pBody->GetCollidable() || pBody->m_pCollideGeo == 0) {
+					continue;
+				}
+				switch (pBody->m_pCollideGeo->GetKind()) {
+				case kC_Plane:
+					m_ParticleColliders.AddPlane(((Collision::Plane*) pBody->m_pCollideGeo)->m_Plane);
+					break;
+				case kC_Sphere:
+					m_ParticleColliders.AddSphere(pBody->m_StateT1.m_Position, ((Collision::Sphere*) pBody->m_pCollideGeo)->m_Radius,
+						pBody->m_StateT1.m_Velocity);
+					break;
+				case kC_Heightfield:
+					m_ParticleColliders.m_Heightfields.push_back((Collision::Heightfield*) pBody->m_pCollideGeo);
+					break;
+				}
+			}
+
+			for (Physics::ParticleMap::iterator pIter = m_Particles.begin(); pIter != m_Particles.end(); ++pIter) {
+				pIter->second->Integrate(dt, m_Gravity, m_ParticleColliders, m_Threads);
+			}
+		}
+
+		/// copy the readable state of every body into snapshots, ordered by id
+		void CaptureSnapshot(SnapshotVector& snapshots)
+		{
+			snapshots.resize(m_Bodies.size());
+			int i = 0;
+			for (Physics::RigidBodyMap::iterator iter = m_Bodies.begin(); iter != m_Bodies.end(); ++iter, ++i) {
+				RigidBody* pBody = iter->second;
+				BodySnapshot& snap = snapshots[i];
+				snap.m_Id = iter->first;
+				Vec3fSet(snap.m_Position,		pBody->m_StateT1.m_Position);
+				Vec3fSet(snap.m_Velocity,		pBody->m_StateT1.m_Velocity);
+				QuatSet(snap.m_Orientation,		pBody->m_StateT1.m_Orientation);
+				snap.m_Spinnable = pBody->GetSpinnable();
+			}
+		}
+
+		/// @return the published snapshot of body id, or 0 if it has none
+		BodySnapshot* FindSnapshot(uint32 id)
+		{
+			SnapshotVector& snapshots = m_Snapshots[m_FrontSnapshot];
+			SnapshotVector::iterator iter = std::lower_bound(snapshots.begin(), snapshots.end(), id);
+			return (iter != snapshots.end() && iter->m_Id == id) ? &(*iter) : 0;
+		}
+
 		Real					m_MinTimeStep;
 		Vec3f					m_Gravity;
 		Physics::RigidBodyMap	m_Bodies;				//!< contains all the bodies in the simulation
 		Physics::SpringMap		m_Springs;				//!< contains all the springs in the simulation
 		Physics::ConstraintMap	m_Constraints;			//!< contains all the constraints in the simulation
+		Physics::ParticleMap	m_Particles;			//!< contains all the particle sets in the simulation
+		Physics::ForceFieldMap	m_ForceFields;			//!< contains all the force fields in the simulation
+		Physics::ArticulationMap	m_Articulations;	//!< contains all the articulations in the simulation
 		ICallback*				m_pCollisionCallback;
+		bool					m_RecordContacts;
+		std::vector<ContactEvent>	m_ContactEvents;	//!< the contacts resolved during the last step, if recorded
+		StepStats				m_StepStats;			//!< timings and counts of the last step; the energy and momentum are measured when asked for
+		std::vector<PendingCommand>	m_DeferredCommands;	//!< changes collision callbacks asked for during the step
 		Collision::Engine		m_CollisionEngine;
+
+		Islands					m_Islands;
+		std::vector<Real>		m_LODFocus;				//!< x, y, z of each level of detail focus point
+		Real					m_LODHalfRate;			//!< distance from the focus beyond which bodies are stepped every other frame
+		Real					m_LODQuarterRate;		//!< and beyond which every fourth frame
+		uint32					m_LODFrame;
+		Real					m_TierTime[kNumLODTiers];	//!< time each tier has waited, including this frame
+		Real					m_TierScale[kNumLODTiers];	//!< length of a tier's world steps this frame, relative to the world step
+		bool					m_TierDue[kNumLODTiers];	//!< if the tier is stepped this frame
+		Broadphase				m_Broadphase;			//!< where the bodies are; rebuilt every world step, queried between steps
+		std::vector<int>		m_Candidates;			//!< the broadphase entries one body may touch
+		std::vector<BodyPair>	m_Pairs;				//!< every pair of bodies whose bounds overlap, for the narrowphase
+		int						m_MaxImpacts;			//!< most contacts resolved in time order with testing again; zero resolves in the order found
+		Real					m_SpeculativeFraction;	//!< of its radius a sphere moves in a step to get speculative contacts; zero for none
+		Real					m_StabilityGrowth;		//!< fraction the energy may grow in a step before it is called unstable; zero turns the monitor off
+		Real					m_PrevEnergy;			//!< total energy after the last step the monitor watched
+		Real					m_PrevActiveEnergy;		//!< the kinetic and spring part of it
+		int						m_PrevBodyCount;		//!< bodies in that step, or -1 if there was none
+		Real					m_ContactWork;			//!< energy the contacts of the current step added or took away
+		double					m_TimeBudget;			//!< most seconds a step should take; zero is no limit
+		int						m_DegradeStage;			//!< how many of the degradations the next step takes, 0 to kNumDegradeStages
+		double					m_WorldStepSeconds;		//!< what one world step cost in the last step
+		int						m_FullIterations;		//!< the constraint solver's iterations, while a degraded step runs
+		int						m_FullSubsteps;			//!< the islands' most substeps, while a degraded step runs
+		std::vector<Impact>		m_ImpactQueue;			//!< a heap, earliest first
+		std::vector<PairRef>	m_PairRefs;				//!< both bodies of every pair, sorted by body
+		int						m_NextImpact;
+		std::vector<RigidBody*>	m_MeshColliders;		//!< the planes and spheres one spring mesh may touch
+		ConstraintSolver		m_ConstraintSolver;
+		ImplicitSpringSolver	m_ImplicitSprings;
+		std::vector<Spring*>	m_ImplicitLinks;		//!< the implicit springs in this time step
+		std::vector<RigidBody*>	m_ImplicitBodies;		//!< the bodies they connect, indexed by RigidBody::m_SolverIndex
+		ParticleColliders		m_ParticleColliders;	//!< what the particles collide with in this time step
+		std::vector<ForceFieldBatch>	m_FieldBatches;	//!< the bodies near the force fields, one batch per island group
+		ThreadPool				m_Threads;				//!< shared by the parallel parts of a step
+
+		WorkerThread			m_Worker;				//!< runs steps kicked by SimulateAsync
+		bool					m_Simulating;			//!< true between SimulateAsync and Sync
+		Real					m_AsyncDt;				//!< time step of the step in flight
+		SnapshotVector			m_Snapshots[2];			//!< front is readable while a step runs, back is written by the step
+		int						m_FrontSnapshot;
+		bool					m_SnapshotStale;		//!< the front snapshot no longer matches the bodies
+		std::vector<PendingCommand>	m_PendingCommands;	//!< changes requested while a step was running
+
+		Pool<RigidBody>			m_RigidBodyPool;		//!< simulation objects; geometry and contacts are pooled by m_CollisionEngine
+		Pool<SpringMesh>		m_SpringMeshPool;
+		Pool<Spring>			m_SpringPool;
+		Pool<DistanceConstraint>	m_DistanceConstraintPool;
+		Pool<ParticleSystem>	m_ParticleSystemPool;
+		Pool<ForceField>		m_ForceFieldPool;
+		Pool<Articulation>		m_ArticulationPool;
 	};
 }
 
@@ -173,6 +1365,7 @@ Physics::Engine :: Engine()
 
 Physics::Engine :: ~Engine()
 {
+	RemoveAll();
 	ShutdownOpcode();
 
 	delete m_pAux;
@@ -186,6 +1379,12 @@ Physics::Engine :: ~Engine()
 
 void Physics::Engine :: SetGravity(PMath::Vec3f val)
 {
+	PendingCommand cmd(PendingCommand::kGravity, 0, 0);
+	Vec3fSet(cmd.m_Vector, val);
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
 	Vec3fSet(m_pAux->m_Gravity, val);
 
 	//--------------------------------------------------------------
@@ -195,6 +1394,7 @@ void Physics::Engine :: SetGravity(PMath::Vec3f val)
 
 void Physics::Engine :: SetCollisionCallback(ICallback* pCB)
 {
+	Sync();
 	m_pAux->m_pCollisionCallback = pCB;
 
 	//--------------------------------------------------------------
@@ -202,15 +1402,73 @@ void Physics::Engine :: SetCollisionCallback(ICallback* pCB)
 	//--------------------------------------------------------------
 }
 
+void Physics::Engine :: SetRecordContacts(bool record)
+{
+	Sync();
+	m_pAux->m_RecordContacts = record;
+	if (!record) {
+		m_pAux->m_ContactEvents.clear();
+	}
+
+	//--------------------------------------------------------------
+	APILOG("SetRecordContacts(%s);\n", BOOLSTRING(record));
+	//--------------------------------------------------------------
+}
+
+int Physics::Engine :: GetContactEventCount()
+{
+	Sync();
+	return (int) m_pAux->m_ContactEvents.size();
+}
+
+const Physics::ContactEvent* Physics::Engine :: GetContactEvents()
+{
+	Sync();
+	return m_pAux->m_ContactEvents.empty() ? 0 : &m_pAux->m_ContactEvents[0];
+}
+
+int Physics::Engine :: GetContactEvents(uint32 id, ContactEvent* pResult, int maxEvents)
+{
+	Sync();
+
+	int count = 0;
+	std::vector<ContactEvent>::iterator iter;
+	for (iter = m_pAux->m_ContactEvents.begin(); iter != m_pAux->m_ContactEvents.end() && count < maxEvents; ++iter) {
+		if (iter->m_BodyA == id || iter->m_BodyB == id) {
+			pResult[count++] = *iter;
+		}
+	}
+	return count;
+}
+
+/*
+	Deferred commands only append to a queue, so they are safe to call from a collision callback,
+	on whichever thread is running the step.
+ */
+
+void Physics::Engine :: DeferImpulse(uint32 id, Vec3f force)
+{
+	PendingCommand cmd(PendingCommand::kImpulse, id, 0);
+	Vec3fSet(cmd.m_Vector, force);
+	m_pAux->m_DeferredCommands.push_back(cmd);
+}
+
+void Physics::Engine :: DeferRemoveRigidBody(uint32 id)
+{
+	m_pAux->m_DeferredCommands.push_back(PendingCommand(PendingCommand::kRemoveRigidBody, id, 0));
+}
+
 uint32 Physics::Engine :: AddRigidBodySphere(Real radius)
 {
+	SyncForEdit();
 	uint32 id				= UniqueID();
-	RigidBody* pBody		= new RigidBody();
-	IGeometry* pCollide		= new Collision::Sphere(radius);
+	RigidBody* pBody		= m_pAux->m_RigidBodyPool.New();
+	IGeometry* pCollide		= m_pAux->m_CollisionEngine.NewSphere(radius);
 	m_pAux->m_Bodies[id]	= pBody;				// add it to the sim
 
 	pBody->SetInertialKind(kI_Sphere);
 	pBody->SetCollisionObject(pCollide);
+	m_pAux->m_Broadphase.Insert(id, pBody);
 
 	//--------------------------------------------------------------
 	APILOG("%d = AddRigidBodySphere(%f)\n", id, radius);
@@ -219,17 +1477,61 @@ uint32 Physics::Engine :: AddRigidBodySphere(Real radius)
 	return id;
 }
 
+uint32 Physics::Engine :: AddRigidBodyHeightfield(int columns, int rows, Real cellSize, PMath::Vec3f origin, Real const*const pHeights)
+{
+	if (columns < 2 || rows < 2 || cellSize <= k0) {
+		APILOG("AddRigidBodyHeightfield - a heightfield needs at least 2 x 2 samples and a positive cell size\n");
+		return 0;
+	}
+
+	SyncForEdit();
+	IGeometry* pCollide		= m_pAux->m_CollisionEngine.NewHeightfield(columns, rows, cellSize, origin, pHeights);
+	uint32 id				= m_pAux->AddTerrain(pCollide);
+
+	//--------------------------------------------------------------
+	APILOG("%d = AddRigidBodyHeightfield(%d, %d, %f)\n", id, columns, rows, cellSize);
+	//--------------------------------------------------------------
+
+	return id;
+}
+
+uint32 Physics::Engine :: AddRigidBodyHeightfieldFile(int columns, int rows, Real cellSize, PMath::Vec3f origin, const char* pPath, int byteOffset)
+{
+	if (columns < 2 || rows < 2 || cellSize <= k0) {
+		APILOG("AddRigidBodyHeightfieldFile - a heightfield needs at least 2 x 2 samples and a positive cell size\n");
+		return 0;
+	}
+
+	SyncForEdit();
+	uint32 id = 0;
+	IGeometry* pCollide = m_pAux->m_CollisionEngine.NewHeightfield(columns, rows, cellSize, origin, pPath, byteOffset);
+	if (pCollide != 0) {
+		id = m_pAux->AddTerrain(pCollide);
+	}
+	else {
+		APILOG("AddRigidBodyHeightfieldFile - can't map %d x %d heights from %s\n", columns, rows, pPath);
+	}
+
+	//--------------------------------------------------------------
+	APILOG("%d = AddRigidBodyHeightfieldFile(%d, %d, %f, \"%s\", %d)\n", id, columns, rows, cellSize, pPath, byteOffset);
+	//--------------------------------------------------------------
+
+	return id;
+}
+
 uint32 Physics::Engine :: AddRigidBodyPlane(PMath::Plane& plane)
 {
+	SyncForEdit();
 	uint32 id				= UniqueID();
-	RigidBody* pBody		= new RigidBody();
-	IGeometry* pCollide		= new Collision::Plane(plane);
+	RigidBody* pBody		= m_pAux->m_RigidBodyPool.New();
+	IGeometry* pCollide		= m_pAux->m_CollisionEngine.NewPlane(plane);
 	m_pAux->m_Bodies[id]	= pBody;				// add it to the sim
 
 	pBody->SetInertialKind(kI_Immobile);
 	pBody->SetCollisionObject(pCollide);
 	pBody->SetSpinnable(false);
 	pBody->SetTranslatable(false);
+	m_pAux->m_Broadphase.Insert(id, pBody);
 
 	//--------------------------------------------------------------
 	APILOG("%d = AddRigidBodyPlane()\n", id);
@@ -240,13 +1542,15 @@ uint32 Physics::Engine :: AddRigidBodyPlane(PMath::Plane& plane)
 		
 uint32	Physics::Engine :: AddSpringMesh()
 {
+	SyncForEdit();
 	uint32 id				= UniqueID();
-	SpringMesh* pBody		= new SpringMesh();
+	SpringMesh* pBody		= m_pAux->m_SpringMeshPool.New();
 	m_pAux->m_Bodies[id]	= pBody;				// add it to the sim
 
 	pBody->SetInertialKind(kI_SpringMesh);
 	pBody->SetSpinnable(false);
 	pBody->SetTranslatable(false);
+	pBody->m_pThreads		= &m_pAux->m_Threads;
 
 	//--------------------------------------------------------------
 	APILOG("%d = AddSpringMesh()\n", id);
@@ -262,38 +1566,56 @@ uint32	Physics::Engine :: AddSpringMesh()
 
 bool Physics::Engine :: RemoveRigidBody(uint32 id)
 {
+	SyncForEdit();
+
 	bool retval = false;
 
 	if (m_pAux->m_Bodies.count(id) != 0) {
 
 		// scan all springs, and remove any that are attached to the current object
+		// the iterator is advanced before removal, since a removed spring's node no longer exists
 		Physics::SpringMap::iterator iter;
-		for (iter = m_pAux->m_Springs.begin(); iter != m_pAux->m_Springs.end(); ++iter) {
+		for (iter = m_pAux->m_Springs.begin(); iter != m_pAux->m_Springs.end(); ) {
+			uint32 springId = iter->first;
 			Spring* pSpring = iter->second;
+			++iter;
 			if (pSpring->m_BodyA == id || pSpring->m_BodyB == id) {
-				APILOG("RemoveRigidBody side-effect: Removing Spring %d\n", iter->first);
-				RemoveSpring(iter->first);
-				iter = m_pAux->m_Springs.begin();
+				APILOG("RemoveRigidBody side-effect: Removing Spring %d\n", springId);
+				RemoveSpring(springId);
 			}
 		}
 
 		// scan all constraints, and remove any that are attached to the current object
 		Physics::ConstraintMap::iterator citer;
-		for (citer = m_pAux->m_Constraints.begin(); citer != m_pAux->m_Constraints.end(); ++citer) {
+		for (citer = m_pAux->m_Constraints.begin(); citer != m_pAux->m_Constraints.end(); ) {
+			uint32 constraintId = citer->first;
 			Constraint* pConstraint = citer->second;
+			++citer;
 			if (pConstraint->GetKind() == DistanceConstraint::GetStaticKind()) {
 				DistanceConstraint* pDC = (DistanceConstraint*) pConstraint;
 				if (pDC->m_BodyA == id || pDC->m_BodyB == id) {
-					APILOG("RemoveRigidBody side-effect: Removing Constraint %d\n", citer->first);
-					RemoveConstraint(citer->first);
-					citer = m_pAux->m_Constraints.begin();
+					APILOG("RemoveRigidBody side-effect: Removing Constraint %d\n", constraintId);
+					RemoveConstraint(constraintId);
 				}
 			}
 		}
 
+		// and the articulation it is a link of
+		Physics::ArticulationMap::iterator aiter;
+		for (aiter = m_pAux->m_Articulations.begin(); aiter != m_pAux->m_Articulations.end(); ) {
+			uint32 articulationId = aiter->first;
+			Articulation* pArticulation = aiter->second;
+			++aiter;
+			if (pArticulation->Contains(id)) {
+				APILOG("RemoveRigidBody side-effect: Removing Articulation %d\n", articulationId);
+				RemoveArticulation(articulationId);
+			}
+		}
+
 		RigidBody* pBody = m_pAux->m_Bodies[id];
 		m_pAux->m_Bodies.erase(id);
-		delete pBody;
+		m_pAux->m_Broadphase.Remove(id);
+		m_pAux->DeleteBody(pBody);
 		retval = true;
 	}
 	else {
@@ -301,40 +1623,485 @@ bool Physics::Engine :: RemoveRigidBody(uint32 id)
 	}
 
 	//--------------------------------------------------------------
-	APILOG("%s = RemoveRigidBody(%d)\n", BOOLSTRING(retval), id);
+	APILOG("%s = RemoveRigidBody(%d)\n", BOOLSTRING(retval), id);
+	//--------------------------------------------------------------
+
+	return retval;
+}
+
+void Physics::Engine :: RemoveAll()
+{
+	SyncForEdit();
+
+	Physics::RigidBodyMap::iterator		rbIter;
+	Physics::SpringMap::iterator		springIter;
+	Physics::ConstraintMap::iterator	cIter;
+	Physics::ParticleMap::iterator		pIter;
+	Physics::ForceFieldMap::iterator	fIter;
+	Physics::ArticulationMap::iterator	aIter;
+
+	for (aIter = m_pAux->m_Articulations.begin(); aIter != m_pAux->m_Articulations.end(); ++aIter) {
+		m_pAux->m_ArticulationPool.Delete(aIter->second);
+	}
+	for (rbIter = m_pAux->m_Bodies.begin(); rbIter != m_pAux->m_Bodies.end(); ++rbIter) {
+		RigidBody* pBody = rbIter->second;
+		m_pAux->DeleteBody(pBody);
+	}
+	for (springIter = m_pAux->m_Springs.begin(); springIter != m_pAux->m_Springs.end(); ++springIter) {
+		Spring* pSpring = springIter->second;
+		m_pAux->m_SpringPool.Delete(pSpring);
+	}
+	for (cIter = m_pAux->m_Constraints.begin(); cIter != m_pAux->m_Constraints.end(); ++cIter) {
+		Constraint* pConstraint = cIter->second;
+		m_pAux->DeleteConstraint(pConstraint);
+	}
+	for (pIter = m_pAux->m_Particles.begin(); pIter != m_pAux->m_Particles.end(); ++pIter) {
+		m_pAux->m_ParticleSystemPool.Delete(pIter->second);
+	}
+	for (fIter = m_pAux->m_ForceFields.begin(); fIter != m_pAux->m_ForceFields.end(); ++fIter) {
+		m_pAux->m_ForceFieldPool.Delete(fIter->second);
+	}
+
+	m_pAux->m_Bodies.clear();
+	m_pAux->m_Springs.clear();
+	m_pAux->m_Constraints.clear();
+	m_pAux->m_Particles.clear();
+	m_pAux->m_ForceFields.clear();
+	m_pAux->m_Articulations.clear();
+	m_pAux->m_Broadphase.Begin();
+}
+
+/*
+	Scenes are saved in id order, so that loading gives the bodies new ids in the same order.
+	Loading creates the objects directly, without the logging and checking of the property
+	setters, so its cost is that of allocating the objects; the file itself is only mapped,
+	and a heightfield's heights are paged in from it as the heightfield is touched.
+ */
+
+/// @return the index of the body in the sorted saved ids, or -1 if it isn't saved
+static int SceneIndex(const std::vector<uint32>& ids, uint32 id, RigidBody* pBody)
+{
+	if (pBody == 0) {
+		return -1;
+	}
+	std::vector<uint32>::const_iterator iter = std::lower_bound(ids.begin(), ids.end(), id);
+	return (iter != ids.end() && *iter == id) ? (int) (iter - ids.begin()) : -1;
+}
+
+/// @return the offset of a table of count records after offset, aligned for reading in place
+static uint32 SceneTableAfter(SceneTable& table, uint32 offset, int count, int recordSize)
+{
+	table.m_Offset	= (offset + Physics::kSceneAlign - 1) & ~(uint32) (Physics::kSceneAlign - 1);
+	table.m_Count	= (uint32) count;
+	return table.m_Offset + (uint32) (count * recordSize);
+}
+
+/// write a table's records, after padding the file to where the table starts
+static bool WriteSceneTable(FILE* pFile, const SceneTable& table, const void* pRecords, int recordSize)
+{
+	static const char padding[Physics::kSceneAlign] = { 0 };
+	long position = ftell(pFile);
+	if (position < 0 || (uint32) position > table.m_Offset ||
+		fwrite(padding, 1, table.m_Offset - (uint32) position, pFile) != table.m_Offset - (uint32) position) {
+		return false;
+	}
+	return table.m_Count == 0 || fwrite(pRecords, recordSize, table.m_Count, pFile) == table.m_Count;
+}
+
+/// @return true if the table lies within the file, aligned for reading in place
+static bool SceneTableValid(const SceneTable& table, int recordSize, int fileSize)
+{
+	return (table.m_Offset % sizeof(Real)) == 0 && table.m_Offset <= (uint32) fileSize &&
+		   table.m_Count <= ((uint32) fileSize - table.m_Offset) / (uint32) recordSize;
+}
+
+bool Physics::Engine :: SaveScene(const char* pPath)
+{
+	Sync();
+
+	SceneHeader header;
+	memset(&header, 0, sizeof(header));
+	header.m_Magic			= kSceneMagic;
+	header.m_Version		= kSceneVersion;
+	header.m_RealSize		= sizeof(Real);
+	header.m_MinTimeStep	= m_pAux->m_MinTimeStep;
+	Vec3fSet(header.m_Gravity, m_pAux->m_Gravity);
+
+	std::vector<uint32>				ids;
+	std::vector<SceneBody>			bodies;
+	std::vector<SceneSpring>		springs;
+	std::vector<SceneConstraint>	constraints;
+	std::vector<Real>				heights;
+	std::vector<SceneArticulation>	articulations;
+	std::vector<SceneJoint>			joints;
+
+	// spring meshes have no collision geometry, and aren't saved
+	for (Physics::RigidBodyMap::iterator rbIter = m_pAux->m_Bodies.begin(); rbIter != m_pAux->m_Bodies.end(); ++rbIter) {
+		RigidBody* pBody = rbIter->second;
+		IGeometry* pGeo = pBody->m_pCollideGeo;
+		if (pGeo == 0) {
+			continue;
+		}
+
+		SceneBody record;
+		memset(&record, 0, sizeof(record));
+		record.m_Kind			= pGeo->GetKind();
+		record.m_Flags			= (pBody->GetActive()		? kSB_Active		: 0) |
+								  (pBody->GetGravity()		? kSB_UseGravity	: 0) |
+								  (pBody->GetCollidable()	? kSB_Collidable	: 0) |
+								  (pBody->GetSpinnable()	? kSB_Spinnable		: 0) |
+								  (pBody->GetTranslatable()	? kSB_Translatable	: 0) |
+								  (pBody->GetIntegrator() << kSB_IntegratorShift);
+		record.m_Mass			= pBody->GetRawMass();
+		record.m_LinearDamp		= pBody->GetLinearVelocityDamp();
+		record.m_AngularDamp	= pBody->GetAngularVelocityDamp();
+		Vec3fSet(record.m_Extent,			pBody->m_Extent);
+		Vec3fSet(record.m_Position,			pBody->m_StateT1.m_Position);
+		Vec3fSet(record.m_Velocity,			pBody->m_StateT1.m_Velocity);
+		QuatSet(record.m_Orientation,		pBody->m_StateT1.m_Orientation);
+		Vec3fSet(record.m_AngularVelocity,	pBody->m_StateT1.m_AngularVelocity);
+
+		switch (record.m_Kind) {
+		case kC_Sphere:
+			record.m_Scalar = ((Collision::Sphere*) pGeo)->m_Radius;
+			break;
+
+		case kC_Plane:
+			Vec3fSet(record.m_Vector, ((Collision::Plane*) pGeo)->m_Plane.m_Normal);
+			record.m_Scalar = ((Collision::Plane*) pGeo)->m_Plane.m_D;
+			break;
+
+		case kC_Heightfield:
+			{
+				Heightfield* pField = (Heightfield*) pGeo;
+				Vec3fSet(record.m_Vector, pField->m_Origin);
+				record.m_Scalar			= pField->m_CellSize;
+				record.m_Columns		= pField->m_Columns;
+				record.m_Rows			= pField->m_Rows;
+				record.m_FirstHeight	= (uint32) heights.size();
+				heights.insert(heights.end(), pField->m_pHeights, pField->m_pHeights + pField->m_Columns * pField->m_Rows);
+			}
+			break;
+
+		default:
+			continue;
+		}
+
+		ids.push_back(rbIter->first);
+		bodies.push_back(record);
+	}
+
+	for (Physics::SpringMap::iterator springIter = m_pAux->m_Springs.begin(); springIter != m_pAux->m_Springs.end(); ++springIter) {
+		Spring* pSpring = springIter->second;
+		SceneSpring record;
+		record.m_BodyA		= SceneIndex(ids, pSpring->m_BodyA, pSpring->mp_BodyA);
+		record.m_BodyB		= SceneIndex(ids, pSpring->m_BodyB, pSpring->mp_BodyB);
+		if ((record.m_BodyA < 0 && pSpring->mp_BodyA != 0) || (record.m_BodyB < 0 && pSpring->mp_BodyB != 0)) {
+			continue;			// attached to a spring mesh
+		}
+		record.m_Flags		= (pSpring->m_ResistCompression ? kSS_ResistCompression : 0) | (pSpring->m_Implicit ? kSS_Implicit : 0);
+		record.m_Stiffness	= pSpring->m_Stiffness;
+		record.m_Damping	= pSpring->m_Damping;
+		record.m_RestLength	= pSpring->m_RestLength;
+		Vec3fSet(record.m_PosA, pSpring->m_PosA);
+		Vec3fSet(record.m_PosB, pSpring->m_PosB);
+		springs.push_back(record);
+	}
+
+	for (Physics::ConstraintMap::iterator cIter = m_pAux->m_Constraints.begin(); cIter != m_pAux->m_Constraints.end(); ++cIter) {
+		if (cIter->second->GetKind() != DistanceConstraint::GetStaticKind()) {
+			continue;
+		}
+		DistanceConstraint* pDC = (DistanceConstraint*) cIter->second;
+		SceneConstraint record;
+		record.m_BodyA		= SceneIndex(ids, pDC->m_BodyA, pDC->mp_BodyA);
+		record.m_BodyB		= SceneIndex(ids, pDC->m_BodyB, pDC->mp_BodyB);
+		record.m_Active		= pDC->m_Active ? 1 : 0;
+		record.m_Distance	= pDC->m_Distance;
+		record.m_Tolerance	= pDC->m_Tolerance;
+		if (record.m_BodyA >= 0 && record.m_BodyB >= 0) {
+			constraints.push_back(record);
+		}
+	}
+
+	// an articulation is saved with its joints' state, so that it carries on as it was when loaded
+	for (Physics::ArticulationMap::iterator aIter = m_pAux->m_Articulations.begin(); aIter != m_pAux->m_Articulations.end(); ++aIter) {
+		Articulation* pArticulation = aIter->second;
+		SceneArticulation record;
+		record.m_Flags		= (pArticulation->m_Active ? kSA_Active : 0) | (pArticulation->GetFixedRoot() ? kSA_FixedRoot : 0);
+		record.m_Damping	= pArticulation->m_Damping;
+		record.m_FirstJoint	= (uint32) joints.size();
+		record.m_Links		= (uint32) pArticulation->GetLinkCount();
+
+		int i;
+		for (i = 0; i < pArticulation->GetLinkCount(); ++i) {
+			const ArticulationLink& link = pArticulation->GetLink(i);
+			SceneJoint joint;
+			joint.m_Body		= SceneIndex(ids, link.m_BodyId, link.m_pBody);
+			joint.m_Parent		= link.m_Parent;
+			joint.m_Kind		= (uint32) link.m_Kind;
+			joint.m_Flags		= (link.m_WasTranslatable ? kSJ_WasTranslatable : 0) | (link.m_WasSpinnable ? kSJ_WasSpinnable : 0);
+			joint.m_Q			= link.m_Q;
+			Vec3fSet(joint.m_PivotInParent,		link.m_PivotInParent);
+			Vec3fSet(joint.m_PivotInChild,		link.m_PivotInChild);
+			Vec3fSet(joint.m_Axis,				link.m_Axis);
+			QuatSet(joint.m_RestOrientation,	link.m_RestOrientation);
+			QuatSet(joint.m_JointOrientation,	link.m_JointOrientation);
+			Vec3fSet(joint.m_QDot,				link.m_QDot);
+			if (joint.m_Body < 0) {
+				break;
+			}
+			joints.push_back(joint);
+		}
+		if (i < pArticulation->GetLinkCount()) {
+			APILOG("SaveScene - articulation %d has a link that can't be saved, and is left out\n", aIter->first);
+			joints.resize(record.m_FirstJoint);
+			continue;
+		}
+		articulations.push_back(record);
+	}
+
+	uint32 offset = sizeof(SceneHeader);
+	offset = SceneTableAfter(header.m_Bodies,		offset, (int) bodies.size(),		sizeof(SceneBody));
+	offset = SceneTableAfter(header.m_Springs,		offset, (int) springs.size(),		sizeof(SceneSpring));
+	offset = SceneTableAfter(header.m_Constraints,	offset, (int) constraints.size(),	sizeof(SceneConstraint));
+	offset = SceneTableAfter(header.m_Heights,		offset, (int) heights.size(),		sizeof(Real));
+	offset = SceneTableAfter(header.m_Articulations,	offset, (int) articulations.size(),	sizeof(SceneArticulation));
+	offset = SceneTableAfter(header.m_Joints,		offset, (int) joints.size(),		sizeof(SceneJoint));
+	header.m_FileSize = offset;
+
+	FILE* pFile = fopen(pPath, "wb");
+	bool retval = pFile != 0 &&
+				  fwrite(&header, sizeof(header), 1, pFile) == 1 &&
+				  WriteSceneTable(pFile, header.m_Bodies,		bodies.empty()		? 0 : &bodies[0],		sizeof(SceneBody)) &&
+				  WriteSceneTable(pFile, header.m_Springs,		springs.empty()		? 0 : &springs[0],		sizeof(SceneSpring)) &&
+				  WriteSceneTable(pFile, header.m_Constraints,	constraints.empty()	? 0 : &constraints[0],	sizeof(SceneConstraint)) &&
+				  WriteSceneTable(pFile, header.m_Heights,		heights.empty()		? 0 : &heights[0],		sizeof(Real)) &&
+				  WriteSceneTable(pFile, header.m_Articulations,	articulations.empty()	? 0 : &articulations[0],	sizeof(SceneArticulation)) &&
+				  WriteSceneTable(pFile, header.m_Joints,		joints.empty()		? 0 : &joints[0],		sizeof(SceneJoint));
+	if (pFile != 0 && fclose(pFile) != 0) {
+		retval = false;
+	}
+
+	//--------------------------------------------------------------
+	APILOG("%s = SaveScene(\"%s\") %d bodies, %d springs, %d constraints, %d articulations\n", BOOLSTRING(retval), pPath,
+		(int) bodies.size(), (int) springs.size(), (int) constraints.size(), (int) articulations.size());
 	//--------------------------------------------------------------
 
 	return retval;
 }
 
-void Physics::Engine :: RemoveAll()
+int Physics::Engine :: LoadScene(const char* pPath, uint32* pIds, int maxIds)
 {
-	Physics::RigidBodyMap::iterator		rbIter;
-	Physics::SpringMap::iterator		springIter;
-	Physics::ConstraintMap::iterator	cIter;
+	SyncForEdit();
+
+	MappedFile file;
+	if (!file.Open(pPath) || file.GetSize() < (int) sizeof(SceneHeader)) {
+		APILOG("LoadScene - can't read %s\n", pPath);
+		return -1;
+	}
+
+	const char* pData = (const char*) file.GetData();
+	const SceneHeader* pHeader = (const SceneHeader*) pData;
+	if (pHeader->m_Magic != kSceneMagic || pHeader->m_Version != kSceneVersion || pHeader->m_RealSize != sizeof(Real) ||
+		pHeader->m_FileSize != (uint32) file.GetSize() ||
+		!SceneTableValid(pHeader->m_Bodies,			sizeof(SceneBody),			file.GetSize()) ||
+		!SceneTableValid(pHeader->m_Springs,		sizeof(SceneSpring),		file.GetSize()) ||
+		!SceneTableValid(pHeader->m_Constraints,	sizeof(SceneConstraint),	file.GetSize()) ||
+		!SceneTableValid(pHeader->m_Heights,		sizeof(Real),				file.GetSize()) ||
+		!SceneTableValid(pHeader->m_Articulations,	sizeof(SceneArticulation),	file.GetSize()) ||
+		!SceneTableValid(pHeader->m_Joints,			sizeof(SceneJoint),			file.GetSize())) {
+		APILOG("LoadScene - %s is not a scene this engine can read\n", pPath);
+		return -1;
+	}
+
+	Vec3fSet(m_pAux->m_Gravity, pHeader->m_Gravity);
+	m_pAux->m_MinTimeStep = pHeader->m_MinTimeStep;
+
+	const SceneBody* pBodies = (const SceneBody*) (pData + pHeader->m_Bodies.m_Offset);
+	int numBodies = (int) pHeader->m_Bodies.m_Count;
+	std::vector<uint32> ids(numBodies, 0);
+	std::vector<RigidBody*> pointers(numBodies, (RigidBody*) 0);
+	int i;
+
+	for (i = 0; i < numBodies; ++i) {
+		const SceneBody& record = pBodies[i];
+		IGeometry* pCollide = 0;
+		switch (record.m_Kind) {
+		case kC_Sphere:
+			pCollide = m_pAux->m_CollisionEngine.NewSphere(record.m_Scalar);
+			break;
 
-	for (rbIter = m_pAux->m_Bodies.begin(); rbIter != m_pAux->m_Bodies.end(); ++rbIter) {
-		RigidBody* pBody = rbIter->second;
-		delete pBody;
-	}
-	for (springIter = m_pAux->m_Springs.begin(); springIter != m_pAux->m_Springs.end(); ++springIter) {
-		Spring* pSpring = springIter->second;
-		delete pSpring;
+		case kC_Plane:
+			{
+				Vec3f origin;
+				Vec3fZero(origin);
+				PMath::Plane plane(origin, record.m_Vector);
+				plane.m_D = record.m_Scalar;
+				pCollide = m_pAux->m_CollisionEngine.NewPlane(plane);
+			}
+			break;
+
+		case kC_Heightfield:
+			// the heightfield maps its heights from the scene file, which checks they fit in it
+			if (record.m_Columns >= 2 && record.m_Rows >= 2 && record.m_Scalar > k0 &&
+				record.m_FirstHeight <= pHeader->m_Heights.m_Count) {
+				int byteOffset = (int) (pHeader->m_Heights.m_Offset + record.m_FirstHeight * sizeof(Real));
+				pCollide = m_pAux->m_CollisionEngine.NewHeightfield(record.m_Columns, record.m_Rows, record.m_Scalar, record.m_Vector, pPath, byteOffset);
+			}
+			break;
+		}
+		if (pCollide == 0) {
+			APILOG("LoadScene - skipped body %d of %s\n", i, pPath);
+			continue;
+		}
+
+		uint32 id			= UniqueID();
+		RigidBody* pBody	= m_pAux->m_RigidBodyPool.New();
+		m_pAux->m_Bodies.insert(m_pAux->m_Bodies.end(), Physics::RigidBodyMap::value_type(id, pBody));
+
+		Vec3fSet(pBody->m_Extent, record.m_Extent);
+		pBody->SetInertialKind(record.m_Kind == kC_Sphere ? kI_Sphere : kI_Immobile);
+		pBody->SetCollisionObject(pCollide);
+		if (record.m_Mass > k0) {
+			pBody->SetMass(record.m_Mass);
+		}
+		pBody->SetActive(		(record.m_Flags & kSB_Active)		!= 0);
+		pBody->SetGravity(		(record.m_Flags & kSB_UseGravity)	!= 0);
+		pBody->SetCollidable(	(record.m_Flags & kSB_Collidable)	!= 0);
+		pBody->SetSpinnable(	(record.m_Flags & kSB_Spinnable)	!= 0);
+		pBody->SetTranslatable(	(record.m_Flags & kSB_Translatable)	!= 0);
+		int integrator = (record.m_Flags & kSB_IntegratorMask) >> kSB_IntegratorShift;
+		pBody->SetIntegrator(integrator <= kIN_VerletRK4Rotation ? (EIntegrator) integrator : kIN_Verlet);
+		pBody->SetLinearVelocityDamp(record.m_LinearDamp);
+		pBody->SetAngularVelocityDamp(record.m_AngularDamp);
+		Vec3fSet(pBody->m_StateT1.m_Position,			record.m_Position);
+		Vec3fSet(pBody->m_StateT1.m_Velocity,			record.m_Velocity);
+		QuatSet(pBody->m_StateT1.m_Orientation,			record.m_Orientation);
+		Vec3fSet(pBody->m_StateT1.m_AngularVelocity,	record.m_AngularVelocity);
+		pBody->m_StateT0 = pBody->m_StateT1;
+		m_pAux->m_Broadphase.Insert(id, pBody);
+
+		ids[i]		= id;
+		pointers[i]	= pBody;
+	}
+
+	const SceneSpring* pSprings = (const SceneSpring*) (pData + pHeader->m_Springs.m_Offset);
+	for (i = 0; i < (int) pHeader->m_Springs.m_Count; ++i) {
+		const SceneSpring& record = pSprings[i];
+		if (record.m_BodyA < -1 || record.m_BodyA >= numBodies || record.m_BodyB < -1 || record.m_BodyB >= numBodies) {
+			continue;
+		}
+
+		uint32 id = UniqueID();
+		Spring* pSpring = m_pAux->m_SpringPool.New();
+		m_pAux->m_Springs.insert(m_pAux->m_Springs.end(), Physics::SpringMap::value_type(id, pSpring));
+
+		pSpring->m_BodyA				= record.m_BodyA >= 0 ? ids[record.m_BodyA] : 0;
+		pSpring->mp_BodyA				= record.m_BodyA >= 0 ? pointers[record.m_BodyA] : 0;
+		pSpring->m_BodyB				= record.m_BodyB >= 0 ? ids[record.m_BodyB] : 0;
+		pSpring->mp_BodyB				= record.m_BodyB >= 0 ? pointers[record.m_BodyB] : 0;
+		pSpring->m_ResistCompression	= (record.m_Flags & kSS_ResistCompression) != 0;
+		pSpring->m_Implicit				= (record.m_Flags & kSS_Implicit) != 0;
+		pSpring->m_Stiffness			= record.m_Stiffness;
+		pSpring->m_Damping				= record.m_Damping;
+		pSpring->m_RestLength			= record.m_RestLength;
+		Vec3fSet(pSpring->m_PosA, record.m_PosA);
+		Vec3fSet(pSpring->m_PosB, record.m_PosB);
+		pSpring->m_CenterAttachA		= Vec3fIsZero(pSpring->m_PosA);
+		pSpring->m_CenterAttachB		= Vec3fIsZero(pSpring->m_PosB);
+	}
+
+	const SceneConstraint* pConstraints = (const SceneConstraint*) (pData + pHeader->m_Constraints.m_Offset);
+	for (i = 0; i < (int) pHeader->m_Constraints.m_Count; ++i) {
+		const SceneConstraint& record = pConstraints[i];
+		if (record.m_BodyA < 0 || record.m_BodyA >= numBodies || record.m_BodyB < 0 || record.m_BodyB >= numBodies ||
+			pointers[record.m_BodyA] == 0 || pointers[record.m_BodyB] == 0) {
+			continue;
+		}
+
+		uint32 id = UniqueID();
+		void* pMem = m_pAux->m_DistanceConstraintPool.Alloc();
+		DistanceConstraint* pConstraint = new (pMem) DistanceConstraint(ids[record.m_BodyA], pointers[record.m_BodyA],
+			ids[record.m_BodyB], pointers[record.m_BodyB], record.m_Distance, record.m_Tolerance);
+		pConstraint->m_Active = record.m_Active != 0;
+		m_pAux->m_Constraints.insert(m_pAux->m_Constraints.end(), Physics::ConstraintMap::value_type(id, pConstraint));
+	}
+
+	// an articulation is skipped whole if any of its joints is unsound, or its bodies weren't loaded or are taken
+	const SceneArticulation* pArticulations = (const SceneArticulation*) (pData + pHeader->m_Articulations.m_Offset);
+	const SceneJoint* pJoints = (const SceneJoint*) (pData + pHeader->m_Joints.m_Offset);
+	int numArticulations = 0;
+	for (i = 0; i < (int) pHeader->m_Articulations.m_Count; ++i) {
+		const SceneArticulation& record = pArticulations[i];
+		int count = (int) record.m_Links;
+		bool sound = count > 0 && record.m_FirstJoint <= pHeader->m_Joints.m_Count &&
+					 record.m_Links <= pHeader->m_Joints.m_Count - record.m_FirstJoint;
+
+		std::vector<ArticulationLink>	links(sound ? count : 0);
+		std::vector<RigidBody*>			linkBodies(sound ? count : 0, (RigidBody*) 0);
+		std::vector<uint32>				linkIds(sound ? count : 0, 0);
+		for (int j = 0; sound && j < count; ++j) {
+			const SceneJoint& joint = pJoints[record.m_FirstJoint + j];
+			sound = joint.m_Body >= 0 && joint.m_Body < numBodies && pointers[joint.m_Body] != 0 &&
+					pointers[joint.m_Body]->m_pArticulation == 0 && joint.m_Kind <= (uint32) kJ_Spherical &&
+					(j == 0 ? joint.m_Parent == -1 : joint.m_Parent >= 0 && joint.m_Parent < j);
+			for (int k = 0; sound && k < j; ++k) {
+				sound = linkBodies[k] != pointers[joint.m_Body];
+			}
+			if (!sound) {
+				break;
+			}
+
+			ArticulationLink& link	= links[j];
+			link.m_Parent			= joint.m_Parent;
+			link.m_Kind				= (Physics::EJointKind) joint.m_Kind;
+			link.m_Q				= joint.m_Q;
+			link.m_WasTranslatable	= (joint.m_Flags & kSJ_WasTranslatable) != 0;
+			link.m_WasSpinnable		= (joint.m_Flags & kSJ_WasSpinnable) != 0;
+			Vec3fSet(link.m_PivotInParent,		joint.m_PivotInParent);
+			Vec3fSet(link.m_PivotInChild,		joint.m_PivotInChild);
+			Vec3fSet(link.m_Axis,				joint.m_Axis);
+			QuatSet(link.m_RestOrientation,		joint.m_RestOrientation);
+			QuatSet(link.m_JointOrientation,	joint.m_JointOrientation);
+			Vec3fSet(link.m_QDot,				joint.m_QDot);
+			linkBodies[j]	= pointers[joint.m_Body];
+			linkIds[j]		= ids[joint.m_Body];
+		}
+		if (!sound) {
+			APILOG("LoadScene - skipped articulation %d of %s\n", i, pPath);
+			continue;
+		}
+
+		uint32 id = UniqueID();
+		Articulation* pArticulation = m_pAux->m_ArticulationPool.New();
+		pArticulation->Load(&links[0], &linkBodies[0], &linkIds[0], count, (record.m_Flags & kSA_FixedRoot) != 0);
+		pArticulation->m_Active		= (record.m_Flags & kSA_Active) != 0;
+		pArticulation->m_Damping	= record.m_Damping;
+		for (int j = 0; j < count; ++j) {
+			linkBodies[j]->m_pArticulation = pArticulation;
+		}
+		m_pAux->m_Articulations.insert(m_pAux->m_Articulations.end(), Physics::ArticulationMap::value_type(id, pArticulation));
+		++numArticulations;
 	}
-	for (cIter = m_pAux->m_Constraints.begin(); cIter != m_pAux->m_Constraints.end(); ++cIter) {
-		Constraint* pConstraint = cIter->second;
-		delete pConstraint;
+
+	for (i = 0; i < numBodies && i < maxIds && pIds != 0; ++i) {
+		pIds[i] = ids[i];
 	}
 
-	m_pAux->m_Bodies.clear();
-	m_pAux->m_Springs.clear();
-	m_pAux->m_Constraints.clear();
+	//--------------------------------------------------------------
+	APILOG("%d = LoadScene(\"%s\") %d springs, %d constraints, %d articulations\n", numBodies, pPath,
+		(int) pHeader->m_Springs.m_Count, (int) pHeader->m_Constraints.m_Count, numArticulations);
+	//--------------------------------------------------------------
+
+	return numBodies;
 }
 
 uint32 Physics::Engine :: AddSpring()
 {
+	Sync();
 	uint32 id = UniqueID();
-	Spring* pSpring = new Spring();
+	Spring* pSpring = m_pAux->m_SpringPool.New();
 	m_pAux->m_Springs[id] = pSpring;
 
 	//--------------------------------------------------------------
@@ -346,11 +2113,13 @@ uint32 Physics::Engine :: AddSpring()
 
 bool Physics::Engine :: RemoveSpring(uint32 id)
 {
+	Sync();
+
 	bool retval = false;
 	if (m_pAux->m_Springs.count(id) != 0) {
 		Spring* pSpring = m_pAux->m_Springs[id];
 		m_pAux->m_Springs.erase(id);
-		delete pSpring;
+		m_pAux->m_SpringPool.Delete(pSpring);
 		retval = true;
 	}
 	else {
@@ -367,6 +2136,12 @@ bool Physics::Engine :: RemoveSpring(uint32 id)
 
 void Physics::Engine :: SetRigidBodyBool(uint32 id, ERigidBodyBool prop, bool value)
 {
+	PendingCommand cmd(PendingCommand::kRigidBodyBool, id, prop);
+	cmd.m_Bool = value;
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
 	if (m_pAux->m_Bodies.count(id) != 0) {
 		RigidBody* pBody = m_pAux->m_Bodies[id];
 		switch (prop) {
@@ -408,6 +2183,12 @@ bool Physics::Engine :: GetRigidBodyBool(uint32 id, ERigidBodyBool prop)
 
 void Physics::Engine :: SetRigidBodyScalar(uint32 id, ERigidBodyScalar prop, Real value)
 {
+	PendingCommand cmd(PendingCommand::kRigidBodyScalar, id, prop);
+	cmd.m_Scalar = value;
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
 	if (m_pAux->m_Bodies.count(id) != 0) {
 		RigidBody* pBody = m_pAux->m_Bodies[id];
 		switch (prop) {
@@ -419,6 +2200,18 @@ void Physics::Engine :: SetRigidBodyScalar(uint32 id, ERigidBodyScalar prop, Rea
 				APILOG("Mass less than 0.2 will not collide properly due to float resolution\n");
 			}
 			break;
+		case propSpringMeshStiffness:
+		case propSpringMeshDamping:
+		case propSpringMeshCompliance:
+		case propSpringMeshThickness:
+			if (pBody->GetInertialKind() == kI_SpringMesh) {
+				SpringMesh* pSM = (SpringMesh*) pBody;
+				if		(prop == propSpringMeshStiffness)	pSM->m_Stiffness	= value;
+				else if (prop == propSpringMeshDamping)		pSM->m_Damping		= value;
+				else if (prop == propSpringMeshCompliance)	pSM->m_Compliance	= value;
+				else										pSM->m_Thickness	= value;
+			}
+			break;
 		}
 	}
 	else {
@@ -439,6 +2232,18 @@ Real Physics::Engine :: GetRigidBodyScalar(uint32 id, ERigidBodyScalar prop)
 		case propAngularVelocityDamp:	retval = pBody->GetAngularVelocityDamp();	break;
 		case propLinearVelocityDamp:	retval = pBody->GetLinearVelocityDamp();	break;
 		case propMass:					retval = pBody->GetMass();					break;
+		case propSpringMeshStiffness:
+		case propSpringMeshDamping:
+		case propSpringMeshCompliance:
+		case propSpringMeshThickness:
+			if (pBody->GetInertialKind() == kI_SpringMesh) {
+				SpringMesh* pSM = (SpringMesh*) pBody;
+				if		(prop == propSpringMeshStiffness)	retval = pSM->m_Stiffness;
+				else if (prop == propSpringMeshDamping)		retval = pSM->m_Damping;
+				else if (prop == propSpringMeshCompliance)	retval = pSM->m_Compliance;
+				else										retval = pSM->m_Thickness;
+			}
+			break;
 		}
 	}
 	else {
@@ -447,8 +2252,79 @@ Real Physics::Engine :: GetRigidBodyScalar(uint32 id, ERigidBodyScalar prop)
 	return retval;
 }
 
+void Physics::Engine :: SetRigidBodyInt(uint32 id, ERigidBodyInt prop, int value)
+{
+	PendingCommand cmd(PendingCommand::kRigidBodyInt, id, prop);
+	cmd.m_Int = value;
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
+	if (m_pAux->m_Bodies.count(id) != 0) {
+		RigidBody* pBody = m_pAux->m_Bodies[id];
+		if (prop == propIntegrator) {
+			if (value >= kIN_Verlet && value <= kIN_VerletRK4Rotation) {
+				pBody->SetIntegrator((EIntegrator) value);
+			}
+		}
+		else if (pBody->GetInertialKind() == kI_SpringMesh) {
+			SpringMesh* pSM = (SpringMesh*) pBody;
+			switch (prop) {
+			case propSpringMeshSolver:		pSM->m_Solver = (ESpringMeshSolver) value;		break;
+			case propSpringMeshSubsteps:	pSM->m_Substeps = value > 0 ? value : 1;		break;
+			case propSpringMeshIterations:	pSM->m_Implicit.SetIterations(value, Real(1.0e-3f));	break;
+			case propUpdateInterval:		break;		// read only
+			case propIntegrator:			break;
+			}
+		}
+	}
+	else {
+		APILOG("SetRigidBodyInt - unknown id %d\n", id);
+	}
+
+	//--------------------------------------------------------------
+	APILOG("SetRigidBodyInt(%d, %s, %d)\n", id, INTPROPSTRING(prop), value);
+	//--------------------------------------------------------------
+}
+
+int Physics::Engine :: GetRigidBodyInt(uint32 id, ERigidBodyInt prop)
+{
+	Sync();		// a step in flight moves bodies between tiers
+
+	int retval = 0;
+	if (m_pAux->m_Bodies.count(id) != 0) {
+		RigidBody* pBody = m_pAux->m_Bodies[id];
+		if (prop == propUpdateInterval) {
+			retval = 1 << pBody->m_LODTier;
+		}
+		else if (prop == propIntegrator) {
+			retval = pBody->GetIntegrator();
+		}
+		else if (pBody->GetInertialKind() == kI_SpringMesh) {
+			SpringMesh* pSM = (SpringMesh*) pBody;
+			switch (prop) {
+			case propSpringMeshSolver:		retval = pSM->m_Solver;		break;
+			case propSpringMeshSubsteps:	retval = pSM->m_Substeps;	break;
+			case propSpringMeshIterations:	retval = pSM->m_Implicit.GetIterations();	break;
+			case propUpdateInterval:		break;
+			case propIntegrator:			break;
+			}
+		}
+	}
+	else {
+		APILOG("GetRigidBodyInt - unknown id %d\n", id);
+	}
+	return retval;
+}
+
 void Physics::Engine :: SetRigidBodyVec3f(uint32 id, ERigidBodyVector prop, Vec3f value)
 {
+	PendingCommand cmd(PendingCommand::kRigidBodyVec3f, id, prop);
+	Vec3fSet(cmd.m_Vector, value);
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
 	if (m_pAux->m_Bodies.count(id) != 0) {
 		RigidBody* pBody = m_pAux->m_Bodies[id];
 		switch (prop) {
@@ -458,131 +2334,343 @@ void Physics::Engine :: SetRigidBodyVec3f(uint32 id, ERigidBodyVector prop, Vec3
 				Collision::Sphere* pCSphere = (Collision::Sphere*) pBody->m_pCollideGeo;
 				pCSphere->m_Radius = value[0] * kHalf;
 			}
+			m_pAux->m_Broadphase.Moved(id);
+			break;
+
+		case propPosition:
+			Vec3fSet(pBody->m_StateT1.m_Position, value);
+			m_pAux->m_Broadphase.Moved(id);
+			break;
+
+		case propVelocity:				Vec3fSet(pBody->m_StateT1.m_Velocity, value);	break;
+		}
+	}
+	else {
+		APILOG("SetRigidBodyVec3f - unknown id %d\n", id);
+	}
+
+	//--------------------------------------------------------------
+	APILOG("SetVec3fProperty(%d, %s, %f, %f, %f)\n", id, Vec3fPROPSTRING(prop), value[0], value[1], value[2]);
+	//--------------------------------------------------------------
+}
+
+static Vec3f vdummy = { k0, k0, k0 };
+
+Vec3f* Physics::Engine :: GetRigidBodyVec3fPtr(uint32 id, ERigidBodyVector prop)
+{
+	Vec3f* retval = &vdummy;
+	if (m_pAux->m_Bodies.count(id) != 0) {
+		RigidBody* pBody = m_pAux->m_Bodies[id];
+		BodySnapshot* pSnap = m_pAux->m_Simulating ? m_pAux->FindSnapshot(id) : 0;
+		switch (prop) {
+		case propExtent:				retval = &pBody->m_Extent;					break;
+		case propPosition:				retval = pSnap ? &pSnap->m_Position : &pBody->m_StateT1.m_Position;		break;
+		case propVelocity:				retval = pSnap ? &pSnap->m_Velocity : &pBody->m_StateT1.m_Velocity;		break;
+		}
+	}
+	else {
+		APILOG("GetRigidBodyVec3fPtr - unknown id %d\n", id);
+	}
+	return retval;
+}
+
+
+void Physics::Engine :: SetRigidBodyQuat(uint32 id, ERigidBodyQuat prop, Quaternion value)
+{
+	PendingCommand cmd(PendingCommand::kRigidBodyQuat, id, prop);
+	QuatSet(cmd.m_Quat, value);
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
+	if (m_pAux->m_Bodies.count(id) != 0) {
+		RigidBody* pBody = m_pAux->m_Bodies[id];
+		switch (prop) {
+		case propOrientation:			QuatSet(pBody->m_StateT1.m_Orientation, value);	break;
+		}
+	}
+	else {
+		APILOG("SetRigidBodyQuat - unknown id %d\n", id);
+	}
+}
+
+static Quaternion qdummy = { k0, k0, k0, k1 };
+
+Quaternion* Physics::Engine :: GetRigidBodyQuatPtr(uint32 id, ERigidBodyQuat prop)
+{
+	Quaternion* retval = &qdummy;
+	if (m_pAux->m_Bodies.count(id) != 0) {
+		RigidBody* pBody = m_pAux->m_Bodies[id];
+		BodySnapshot* pSnap = m_pAux->m_Simulating ? m_pAux->FindSnapshot(id) : 0;
+		switch (prop) {
+		case propOrientation:			retval = pSnap ? &pSnap->m_Orientation : &pBody->m_StateT1.m_Orientation;	break;
+		}
+	}
+	else {
+		APILOG("GetRigidBodyQuatPtr - unknown id %d\n", id);
+	}
+	return retval;
+}
+
+void Physics::Engine :: SetRigidBodyVectorArray		(uint32 id,	ERigidBodyVectorArray	prop,	PMath::Vec3f const*const value, int byteStride, int count)
+{
+	SyncForEdit();
+
+	if (m_pAux->m_Bodies.count(id) != 0) {
+		RigidBody* pBody = m_pAux->m_Bodies[id];
+		switch (prop) {
+		case propPositions:
+			if (pBody->GetInertialKind() == kI_SpringMesh) {
+				SpringMesh* pSM = (SpringMesh*) pBody;
+				pSM->SetPoints(count, byteStride, value);
+			}
+			break;
+		}
+	}
+	else {
+		APILOG("SetRigidBodyVectorArray - unknown id %d\n", id);
+	}
+}
+
+void Physics::Engine :: SetRigidBodyIntArray		(uint32 id, ERigidBodyIntArray		prop,	int const*const val, int count)
+{
+	SyncForEdit();
+
+	if (m_pAux->m_Bodies.count(id) != 0) {
+		RigidBody* pBody = m_pAux->m_Bodies[id];
+		switch (prop) {
+		case propIndices:
+			if (pBody->GetInertialKind() == kI_SpringMesh) {
+				SpringMesh* pSM = (SpringMesh*) pBody;
+				pSM->SetSprings(count, val);
+				if (pSM->m_Points != 0) {
+					pSM->SetRestLengths();
+				}
+			}
+			break;
+		}
+	}
+	else {
+		APILOG("SetRigidBodyIntArray - unknown id %d\n", id);
+	}
+}
+
+int Physics::Engine :: GetRigidBodyVectorArray		(uint32 id,	ERigidBodyVectorArray	prop,	PMath::Vec3f* pResult, int byteStride, int count)
+{
+	Sync();
+
+	int retval = 0;
+	if (m_pAux->m_Bodies.count(id) != 0) {
+		RigidBody* pBody = m_pAux->m_Bodies[id];
+		switch (prop) {
+		case propPositions:
+			if (pBody->GetInertialKind() == kI_SpringMesh) {
+				SpringMesh* pSM = (SpringMesh*) pBody;
+				char* pCurr = (char*) pResult;
+				for ( ; retval < count && retval < pSM->m_NumPoints; ++retval) {
+					Vec3fSet(*(Vec3f*) pCurr, pSM->m_Points[retval].m_Pos1);
+					pCurr += byteStride;
+				}
+			}
 			break;
+		}
+	}
+	else {
+		APILOG("GetRigidBodyVectorArray - unknown id %d\n", id);
+	}
+	return retval;
+}
+
+void Physics::Engine :: GetRigidBodyTransformMatrix(uint32 id, Mat44& pResult)
+{
+	if (m_pAux->m_Bodies.count(id) != 0) {
+		RigidBody* pBody = m_pAux->m_Bodies[id];
+		BodySnapshot* pSnap = m_pAux->m_Simulating ? m_pAux->FindSnapshot(id) : 0;
+		bool spinnable = pSnap ? pSnap->m_Spinnable : pBody->GetSpinnable();
+		if (spinnable) {
+			QuatToBasis(pResult, pSnap ? pSnap->m_Orientation : pBody->m_StateT1.m_Orientation);
+			pResult[3] = k0; pResult[7] = k0; pResult[11] = k0; pResult[15] = k1;
+		}
+		else {
+			Mat44Identity(pResult);
+		}
+		Mat44SetTranslation(pResult, pSnap ? pSnap->m_Position : pBody->m_StateT1.m_Position);
+	}
+	else {
+		APILOG("GetRigidBodyTransformMatrix - unknown id %d\n", id);
+	}
+}
+
+uint32 Physics::Engine :: AddParticles(int count, Real radius, Vec3f const*const pPositions, Vec3f const*const pVelocities, int byteStride)
+{
+	SyncForEdit();
+	uint32 id					= UniqueID();
+	ParticleSystem* pSystem		= m_pAux->m_ParticleSystemPool.New();
+	m_pAux->m_Particles[id]		= pSystem;				// add it to the sim
+
+	pSystem->m_Radius = radius;
+	pSystem->SetParticles(count, pPositions, pVelocities, byteStride);
+
+	//--------------------------------------------------------------
+	APILOG("%d = AddParticles(%d, %f)\n", id, count, radius);
+	//--------------------------------------------------------------
+
+	return id;
+}
+
+bool Physics::Engine :: RemoveParticles(uint32 id)
+{
+	SyncForEdit();
+
+	bool retval = false;
+	if (m_pAux->m_Particles.count(id) != 0) {
+		ParticleSystem* pSystem = m_pAux->m_Particles[id];
+		m_pAux->m_Particles.erase(id);
+		m_pAux->m_ParticleSystemPool.Delete(pSystem);
+		retval = true;
+	}
+	else {
+		APILOG("RemoveParticles - unknown id %d\n", id);
+	}
+
+	//--------------------------------------------------------------
+	APILOG("%s = RemoveParticles(%d)\n", BOOLSTRING(retval), id);
+	//--------------------------------------------------------------
+
+	return retval;
+}
+
+void Physics::Engine :: SetParticleBool(uint32 id, EParticleBool prop, bool value)
+{
+	PendingCommand cmd(PendingCommand::kParticleBool, id, prop);
+	cmd.m_Bool = value;
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
 
-		case propPosition:				Vec3fSet(pBody->m_StateT1.m_Position, value);	break;
-		case propVelocity:				Vec3fSet(pBody->m_StateT1.m_Velocity, value);	break;
+	if (m_pAux->m_Particles.count(id) != 0) {
+		ParticleSystem* pSystem = m_pAux->m_Particles[id];
+		switch (prop) {
+		case propParticlesActive:		pSystem->m_Active		= value;	break;
+		case propParticlesUseGravity:	pSystem->m_UseGravity	= value;	break;
+		case propParticlesCollidable:	pSystem->m_Collidable	= value;	break;
 		}
 	}
 	else {
-		APILOG("SetRigidBodyVec3f - unknown id %d\n", id);
+		APILOG("SetParticleBool - unknown id %d\n", id);
 	}
-
-	//--------------------------------------------------------------
-	APILOG("SetVec3fProperty(%d, %s, %f, %f, %f)\n", id, Vec3fPROPSTRING(prop), value[0], value[1], value[2]);
-	//--------------------------------------------------------------
 }
 
-static Vec3f vdummy = { k0, k0, k0 };
-
-Vec3f* Physics::Engine :: GetRigidBodyVec3fPtr(uint32 id, ERigidBodyVector prop)
+bool Physics::Engine :: GetParticleBool(uint32 id, EParticleBool prop)
 {
-	Vec3f* retval = &vdummy;
-	if (m_pAux->m_Bodies.count(id) != 0) {
-		RigidBody* pBody = m_pAux->m_Bodies[id];
+	bool retval = false;
+	if (m_pAux->m_Particles.count(id) != 0) {
+		ParticleSystem* pSystem = m_pAux->m_Particles[id];
 		switch (prop) {
-		case propExtent:				retval = &pBody->m_Extent;					break;
-		case propPosition:				retval = &pBody->m_StateT1.m_Position;		break;
-		case propVelocity:				retval = &pBody->m_StateT1.m_Velocity;		break;
+		case propParticlesActive:		retval = pSystem->m_Active;			break;
+		case propParticlesUseGravity:	retval = pSystem->m_UseGravity;		break;
+		case propParticlesCollidable:	retval = pSystem->m_Collidable;		break;
 		}
 	}
 	else {
-		APILOG("GetRigidBodyVec3fPtr - unknown id %d\n", id);
+		APILOG("GetParticleBool - unknown id %d\n", id);
 	}
 	return retval;
 }
 
-
-void Physics::Engine :: SetRigidBodyQuat(uint32 id, ERigidBodyQuat prop, Quaternion value)
+void Physics::Engine :: SetParticleScalar(uint32 id, EParticleScalar prop, Real value)
 {
-	if (m_pAux->m_Bodies.count(id) != 0) {
-		RigidBody* pBody = m_pAux->m_Bodies[id];
+	PendingCommand cmd(PendingCommand::kParticleScalar, id, prop);
+	cmd.m_Scalar = value;
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
+	if (m_pAux->m_Particles.count(id) != 0) {
+		ParticleSystem* pSystem = m_pAux->m_Particles[id];
 		switch (prop) {
-		case propOrientation:			QuatSet(pBody->m_StateT1.m_Orientation, value);	break;
+		case propParticleRadius:		pSystem->m_Radius		= value;	break;
+		case propParticleRestitution:	pSystem->m_Restitution	= value;	break;
+		case propParticleDrag:			pSystem->m_Drag			= value;	break;
 		}
 	}
 	else {
-		APILOG("SetRigidBodyQuat - unknown id %d\n", id);
+		APILOG("SetParticleScalar - unknown id %d\n", id);
 	}
 }
 
-static Quaternion qdummy = { k0, k0, k0, k1 };
-
-Quaternion* Physics::Engine :: GetRigidBodyQuatPtr(uint32 id, ERigidBodyQuat prop)
+Real Physics::Engine :: GetParticleScalar(uint32 id, EParticleScalar prop)
 {
-	Quaternion* retval = &qdummy;
-	if (m_pAux->m_Bodies.count(id) != 0) {
-		RigidBody* pBody = m_pAux->m_Bodies[id];
+	Real retval = k0;
+	if (m_pAux->m_Particles.count(id) != 0) {
+		ParticleSystem* pSystem = m_pAux->m_Particles[id];
 		switch (prop) {
-		case propOrientation:			retval = &pBody->m_StateT1.m_Orientation;	break;
+		case propParticleRadius:		retval = pSystem->m_Radius;			break;
+		case propParticleRestitution:	retval = pSystem->m_Restitution;	break;
+		case propParticleDrag:			retval = pSystem->m_Drag;			break;
 		}
 	}
 	else {
-		APILOG("GetRigidBodyQuatPtr - unknown id %d\n", id);
+		APILOG("GetParticleScalar - unknown id %d\n", id);
 	}
 	return retval;
 }
 
-void Physics::Engine :: SetRigidBodyVectorArray		(uint32 id,	ERigidBodyVectorArray	prop,	PMath::Vec3f const*const value, int byteStride, int count)
+int Physics::Engine :: GetParticleCount(uint32 id)
 {
-	if (m_pAux->m_Bodies.count(id) != 0) {
-		RigidBody* pBody = m_pAux->m_Bodies[id];
-		switch (prop) {
-		case propPositions:
-			if (pBody->GetInertialKind() == kI_SpringMesh) {
-				SpringMesh* pSM = (SpringMesh*) pBody;
-				pSM->SetPoints(count, byteStride, value);
-			}
-			break;
-		}
+	int retval = 0;
+	if (m_pAux->m_Particles.count(id) != 0) {
+		retval = m_pAux->m_Particles[id]->GetCount();
 	}
 	else {
-		APILOG("SetRigidBodyVectorArray - unknown id %d\n", id);
+		APILOG("GetParticleCount - unknown id %d\n", id);
 	}
+	return retval;
 }
 
-void Physics::Engine :: SetRigidBodyIntArray		(uint32 id, ERigidBodyIntArray		prop,	int const*const val, int count)
+int Physics::Engine :: SetParticleVectorArray(uint32 id, EParticleVectorArray prop, Vec3f const*const value, int byteStride, int first, int count)
 {
-	if (m_pAux->m_Bodies.count(id) != 0) {
-		RigidBody* pBody = m_pAux->m_Bodies[id];
-		switch (prop) {
-		case propIndices:
-			if (pBody->GetInertialKind() == kI_SpringMesh) {
-				SpringMesh* pSM = (SpringMesh*) pBody;
-				pSM->SetSprings(count, val);
-			}
-			break;
-		}
+	SyncForEdit();
+
+	int retval = 0;
+	if (m_pAux->m_Particles.count(id) != 0) {
+		ParticleSystem* pSystem = m_pAux->m_Particles[id];
+		retval = pSystem->SetVectors(prop == propParticleVelocities, first, count, value, byteStride);
 	}
 	else {
-		APILOG("SetRigidBodyIntArray - unknown id %d\n", id);
+		APILOG("SetParticleVectorArray - unknown id %d\n", id);
 	}
+	return retval;
 }
 
-void Physics::Engine :: GetRigidBodyTransformMatrix(uint32 id, Mat44& pResult)
+int Physics::Engine :: GetParticleVectorArray(uint32 id, EParticleVectorArray prop, Vec3f* pResult, int byteStride, int first, int count)
 {
-	if (m_pAux->m_Bodies.count(id) != 0) {
-		RigidBody* pBody = m_pAux->m_Bodies[id];
-		if (pBody->GetSpinnable()) {
-			QuatToBasis(pResult, pBody->m_StateT1.m_Orientation);
-			pResult[3] = k0; pResult[7] = k0; pResult[11] = k0; pResult[15] = k1;
-		}
-		else {
-			Mat44Identity(pResult);
-		}
-		Mat44SetTranslation(pResult, pBody->m_StateT1.m_Position);
+	Sync();
+
+	int retval = 0;
+	if (m_pAux->m_Particles.count(id) != 0) {
+		ParticleSystem* pSystem = m_pAux->m_Particles[id];
+		retval = pSystem->GetVectors(prop == propParticleVelocities, first, count, pResult, byteStride);
 	}
 	else {
-		APILOG("GetRigidBodyTransformMatrix - unknown id %d\n", id);
+		APILOG("GetParticleVectorArray - unknown id %d\n", id);
 	}
+	return retval;
 }
 
 void Physics::Engine :: SetSpringBool(uint32 id, ESpringBool prop, bool value)
 {
+	PendingCommand cmd(PendingCommand::kSpringBool, id, prop);
+	cmd.m_Bool = value;
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
 	if (m_pAux->m_Springs.count(id) != 0) {
 		Spring* pSpring = m_pAux->m_Springs[id];
-		if (prop == propResistCompression) {
-			pSpring->m_ResistCompression = value;
+		switch (prop) {
+		case propResistCompression:	pSpring->m_ResistCompression = value;	break;
+		case propSpringImplicit:	pSpring->m_Implicit = value;			break;
 		}
 	}
 	else {
@@ -595,8 +2683,9 @@ bool Physics::Engine :: GetSpringBool(uint32 id, ESpringBool prop)
 	bool retval = false;
 	if (m_pAux->m_Springs.count(id) != 0) {
 		Spring* pSpring = m_pAux->m_Springs[id];
-		if (prop == propResistCompression) {
-			retval = pSpring->m_ResistCompression;
+		switch (prop) {
+		case propResistCompression:	retval = pSpring->m_ResistCompression;	break;
+		case propSpringImplicit:	retval = pSpring->m_Implicit;			break;
 		}
 	}
 	else {
@@ -607,6 +2696,12 @@ bool Physics::Engine :: GetSpringBool(uint32 id, ESpringBool prop)
 
 void Physics::Engine :: SetSpringUInt32(uint32 id, ESpringUint32 prop,	uint32 value)
 {
+	PendingCommand cmd(PendingCommand::kSpringUInt32, id, prop);
+	cmd.m_UInt = value;
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
 	if (m_pAux->m_Springs.count(id) != 0) {
 		Spring* pSpring = m_pAux->m_Springs[id];
 		if (prop == propBodyA) {
@@ -653,6 +2748,12 @@ uint32 Physics::Engine :: GetSpringUInt32(uint32 id, ESpringUint32 prop)
 
 void Physics::Engine :: SetSpringScalar(uint32 id, ESpringScalar prop,	Real value)
 {
+	PendingCommand cmd(PendingCommand::kSpringScalar, id, prop);
+	cmd.m_Scalar = value;
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
 	if (m_pAux->m_Springs.count(id) != 0) {
 		Spring* pSpring = m_pAux->m_Springs[id];
 		switch (prop) {
@@ -697,6 +2798,12 @@ Real Physics::Engine :: GetSpringScalar(uint32 id, ESpringScalar prop)
 
 void Physics::Engine :: SetSpringVec3f(uint32 id, ESpringVector prop,	PMath::Vec3f value)
 {
+	PendingCommand cmd(PendingCommand::kSpringVec3f, id, prop);
+	Vec3fSet(cmd.m_Vector, value);
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
 	if (m_pAux->m_Springs.count(id) != 0) {
 		Spring* pSpring = m_pAux->m_Springs[id];
 		if (prop == propAttachPointA) {
@@ -734,98 +2841,419 @@ PMath::Vec3f* Physics::Engine :: GetSpringVec3fPtr(uint32 id, ESpringVector prop
 
 uint32 Physics::Engine :: AddDistanceConstraint(uint32 a, uint32 b, Real distance, Real tolerance)
 {
+	Sync();
 	uint32 id = UniqueID();
 	RigidBody* pBodyA = m_pAux->m_Bodies[a];
 	RigidBody* pBodyB = m_pAux->m_Bodies[b];
-	DistanceConstraint* pConstraint = new DistanceConstraint(a, pBodyA, b, pBodyB, distance, tolerance);
+	void* pMem = m_pAux->m_DistanceConstraintPool.Alloc();
+	DistanceConstraint* pConstraint = new (pMem) DistanceConstraint(a, pBodyA, b, pBodyB, distance, tolerance);
 	m_pAux->m_Constraints[id] = pConstraint;
 	return id;
 }
 
 bool Physics::Engine :: RemoveConstraint(uint32 id)
 {
+	Sync();
+
 	bool retval = false;
 	if (m_pAux->m_Constraints.count(id) != 0) {
 		Constraint* pConstraint = m_pAux->m_Constraints[id];
 		m_pAux->m_Constraints.erase(id);
-		delete pConstraint;
+		m_pAux->DeleteConstraint(pConstraint);
+		retval = true;
+	}
+	else {
+		APILOG("RemoveConstraint - unknown id %d\n", id);
+	}
+
+	//--------------------------------------------------------------
+	APILOG("%s = RemoveConstraint(%d)\n", BOOLSTRING(retval), id);
+	//--------------------------------------------------------------
+
+	return retval;
+}
+
+void Physics::Engine :: SetConstraintBool(uint32 id, EConstraintBool prop, bool value)
+{
+	PendingCommand cmd(PendingCommand::kConstraintBool, id, prop);
+	cmd.m_Bool = value;
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
+	if (m_pAux->m_Constraints.count(id) != 0) {
+		Constraint* pConstraint = m_pAux->m_Constraints[id];
+		if (prop == propConstraintActive) {
+			pConstraint->m_Active = value;
+		}
+	}
+	else {
+		APILOG("SetConstraintBool - unknown id %d\n", id);
+	}
+}
+
+bool Physics::Engine :: GetConstraintBool(uint32 id, EConstraintBool prop)
+{
+	bool retval = false;
+	if (m_pAux->m_Springs.count(id) != 0) {
+		Constraint* pConstraint = m_pAux->m_Constraints[id];
+		if (prop == propConstraintActive) {
+			retval = pConstraint->m_Active;
+		}
+	}
+	else {
+		APILOG("GetConstraintBool - unknown id %d\n", id);
+	}
+	return retval;
+}
+
+void Physics::Engine :: SetConstraintScalar(uint32 id, EConstraintScalar prop, Real value)
+{
+	PendingCommand cmd(PendingCommand::kConstraintScalar, id, prop);
+	cmd.m_Scalar = value;
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
+	if (m_pAux->m_Constraints.count(id) != 0) {
+		Constraint* pConstraint = m_pAux->m_Constraints[id];
+		if (pConstraint->GetKind() == DistanceConstraint::GetStaticKind()) {
+			DistanceConstraint* pDC = (DistanceConstraint*) pConstraint;
+			if (prop == propConstraintDistance) {
+				pDC->m_Distance = value;
+			}
+		}
+	}
+	else {
+		APILOG("SetConstraintScalar - unknown id %d\n", id);
+	}
+}
+
+Real Physics::Engine :: GetConstraintScalar(uint32 id, EConstraintScalar prop)
+{
+	Real retval = k0;
+	if (m_pAux->m_Springs.count(id) != 0) {
+		Constraint* pConstraint = m_pAux->m_Constraints[id];
+		if (pConstraint->GetKind() == DistanceConstraint::GetStaticKind()) {
+			DistanceConstraint* pDC = (DistanceConstraint*) pConstraint;
+			if (prop == propConstraintDistance) {
+				retval = pDC->m_Distance;
+			}
+		}
+	}
+	else {
+		APILOG("GetConstraintScalar - unknown id %d\n", id);
+	}
+	return retval;
+}
+
+/*
+	An articulation's links stay bodies of the engine, in a bucket of their own which the
+	articulation steps; a fixed root is made immovable, so contacts push against it, and the
+	other links movable, so that contacts move them and their joints take up the change.
+	Removing the articulation gives the links back the flags they had before.
+ */
+
+uint32 Physics::Engine :: AddArticulation(uint32 root, bool fixedRoot)
+{
+	Sync();
+
+	uint32 id = 0;
+	if (m_pAux->m_Bodies.count(root) != 0 && m_pAux->m_Bodies[root]->m_pArticulation == 0) {
+		RigidBody* pRoot = m_pAux->m_Bodies[root];
+		if (fixedRoot) {
+			Vec3fZero(pRoot->m_StateT1.m_Velocity);
+			Vec3fZero(pRoot->m_StateT1.m_AngularVelocity);
+		}
+
+		id = UniqueID();
+		Articulation* pArticulation = m_pAux->m_ArticulationPool.New();
+		pArticulation->SetRoot(root, pRoot, fixedRoot);
+		pRoot->m_pArticulation = pArticulation;
+		m_pAux->m_Articulations[id] = pArticulation;
+	}
+	else {
+		APILOG("AddArticulation - unknown body %d, or already articulated\n", root);
+	}
+
+	//--------------------------------------------------------------
+	APILOG("%d = AddArticulation(%d, %s)\n", id, root, BOOLSTRING(fixedRoot));
+	//--------------------------------------------------------------
+
+	return id;
+}
+
+bool Physics::Engine :: AddArticulationJoint(uint32 id, uint32 parent, uint32 child, EJointKind kind, PMath::Vec3f pivot, PMath::Vec3f axis)
+{
+	Sync();
+
+	bool retval = false;
+	if (m_pAux->m_Articulations.count(id) != 0 && m_pAux->m_Bodies.count(parent) != 0 && m_pAux->m_Bodies.count(child) != 0) {
+		Articulation* pArticulation = m_pAux->m_Articulations[id];
+		RigidBody* pChild = m_pAux->m_Bodies[child];
+		if (pChild->m_pArticulation == 0 && pArticulation->Contains(parent)) {
+			retval = pArticulation->AddLink(child, pChild, m_pAux->m_Bodies[parent], kind, pivot, axis);
+			if (retval) {
+				pChild->m_pArticulation = pArticulation;
+			}
+		}
+	}
+	else {
+		APILOG("AddArticulationJoint - unknown id %d, %d or %d\n", id, parent, child);
+	}
+
+	//--------------------------------------------------------------
+	APILOG("%s = AddArticulationJoint(%d, %d, %d, %d, (%f, %f, %f), (%f, %f, %f))\n", BOOLSTRING(retval), id, parent, child, kind,
+		pivot[0], pivot[1], pivot[2], axis[0], axis[1], axis[2]);
+	//--------------------------------------------------------------
+
+	return retval;
+}
+
+bool Physics::Engine :: RemoveArticulation(uint32 id)
+{
+	Sync();
+
+	bool retval = false;
+	if (m_pAux->m_Articulations.count(id) != 0) {
+		Articulation* pArticulation = m_pAux->m_Articulations[id];
+		m_pAux->m_Articulations.erase(id);
+		pArticulation->Release();
+		m_pAux->m_ArticulationPool.Delete(pArticulation);
+		retval = true;
+	}
+	else {
+		APILOG("RemoveArticulation - unknown id %d\n", id);
+	}
+
+	//--------------------------------------------------------------
+	APILOG("%s = RemoveArticulation(%d)\n", BOOLSTRING(retval), id);
+	//--------------------------------------------------------------
+
+	return retval;
+}
+
+void Physics::Engine :: SetArticulationBool(uint32 id, EArticulationBool prop, bool value)
+{
+	PendingCommand cmd(PendingCommand::kArticulationBool, id, prop);
+	cmd.m_Bool = value;
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
+	if (m_pAux->m_Articulations.count(id) != 0) {
+		Articulation* pArticulation = m_pAux->m_Articulations[id];
+		if (prop == propArticulationActive) {
+			pArticulation->m_Active = value;
+		}
+	}
+	else {
+		APILOG("SetArticulationBool - unknown id %d\n", id);
+	}
+}
+
+bool Physics::Engine :: GetArticulationBool(uint32 id, EArticulationBool prop)
+{
+	bool retval = false;
+	if (m_pAux->m_Articulations.count(id) != 0) {
+		Articulation* pArticulation = m_pAux->m_Articulations[id];
+		if (prop == propArticulationActive) {
+			retval = pArticulation->m_Active;
+		}
+	}
+	else {
+		APILOG("GetArticulationBool - unknown id %d\n", id);
+	}
+	return retval;
+}
+
+void Physics::Engine :: SetArticulationScalar(uint32 id, EArticulationScalar prop, Real value)
+{
+	PendingCommand cmd(PendingCommand::kArticulationScalar, id, prop);
+	cmd.m_Scalar = value;
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
+	if (m_pAux->m_Articulations.count(id) != 0) {
+		Articulation* pArticulation = m_pAux->m_Articulations[id];
+		if (prop == propArticulationDamping) {
+			pArticulation->m_Damping = value;
+		}
+	}
+	else {
+		APILOG("SetArticulationScalar - unknown id %d\n", id);
+	}
+}
+
+Real Physics::Engine :: GetArticulationScalar(uint32 id, EArticulationScalar prop)
+{
+	Real retval = k0;
+	if (m_pAux->m_Articulations.count(id) != 0) {
+		Articulation* pArticulation = m_pAux->m_Articulations[id];
+		if (prop == propArticulationDamping) {
+			retval = pArticulation->m_Damping;
+		}
+	}
+	else {
+		APILOG("GetArticulationScalar - unknown id %d\n", id);
+	}
+	return retval;
+}
+
+uint32 Physics::Engine :: AddForceField(EForceFieldKind kind)
+{
+	Sync();
+	uint32 id = UniqueID();
+	ForceField* pField = m_pAux->m_ForceFieldPool.New();
+	pField->m_Kind = kind;
+	m_pAux->m_ForceFields[id] = pField;
+
+	//--------------------------------------------------------------
+	APILOG("%d = AddForceField(%d)\n", id, kind);
+	//--------------------------------------------------------------
+
+	return id;
+}
+
+bool Physics::Engine :: RemoveForceField(uint32 id)
+{
+	Sync();
+
+	bool retval = false;
+	if (m_pAux->m_ForceFields.count(id) != 0) {
+		ForceField* pField = m_pAux->m_ForceFields[id];
+		m_pAux->m_ForceFields.erase(id);
+		m_pAux->m_ForceFieldPool.Delete(pField);
 		retval = true;
 	}
 	else {
-		APILOG("RemoveConstraint - unknown id %d\n", id);
+		APILOG("RemoveForceField - unknown id %d\n", id);
 	}
 
 	//--------------------------------------------------------------
-	APILOG("%s = RemoveConstraint(%d)\n", BOOLSTRING(retval), id);
+	APILOG("%s = RemoveForceField(%d)\n", BOOLSTRING(retval), id);
 	//--------------------------------------------------------------
 
 	return retval;
 }
 
-void Physics::Engine :: SetConstraintBool(uint32 id, EConstraintBool prop, bool value)
+void Physics::Engine :: SetForceFieldBool(uint32 id, EForceFieldBool prop, bool value)
 {
-	if (m_pAux->m_Constraints.count(id) != 0) {
-		Constraint* pConstraint = m_pAux->m_Constraints[id];
-		if (prop == propConstraintActive) {
-			pConstraint->m_Active = value;
+	PendingCommand cmd(PendingCommand::kForceFieldBool, id, prop);
+	cmd.m_Bool = value;
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
+	if (m_pAux->m_ForceFields.count(id) != 0) {
+		ForceField* pField = m_pAux->m_ForceFields[id];
+		if (prop == propFieldActive) {
+			pField->m_Active = value;
 		}
 	}
 	else {
-		APILOG("SetConstraintBool - unknown id %d\n", id);
+		APILOG("SetForceFieldBool - unknown id %d\n", id);
 	}
 }
 
-bool Physics::Engine :: GetConstraintBool(uint32 id, EConstraintBool prop)
+bool Physics::Engine :: GetForceFieldBool(uint32 id, EForceFieldBool prop)
 {
 	bool retval = false;
-	if (m_pAux->m_Springs.count(id) != 0) {
-		Constraint* pConstraint = m_pAux->m_Constraints[id];
-		if (prop == propConstraintActive) {
-			retval = pConstraint->m_Active;
+	if (m_pAux->m_ForceFields.count(id) != 0) {
+		ForceField* pField = m_pAux->m_ForceFields[id];
+		if (prop == propFieldActive) {
+			retval = pField->m_Active;
 		}
 	}
 	else {
-		APILOG("GetConstraintBool - unknown id %d\n", id);
+		APILOG("GetForceFieldBool - unknown id %d\n", id);
 	}
 	return retval;
 }
 
-void Physics::Engine :: SetConstraintScalar(uint32 id, EConstraintScalar prop, Real value)
+void Physics::Engine :: SetForceFieldScalar(uint32 id, EForceFieldScalar prop, Real value)
 {
-	if (m_pAux->m_Constraints.count(id) != 0) {
-		Constraint* pConstraint = m_pAux->m_Constraints[id];
-		if (pConstraint->GetKind() == DistanceConstraint::GetStaticKind()) {
-			DistanceConstraint* pDC = (DistanceConstraint*) pConstraint;
-			if (prop == propConstraintDistance) {
-				pDC->m_Distance = value;
-			}
+	PendingCommand cmd(PendingCommand::kForceFieldScalar, id, prop);
+	cmd.m_Scalar = value;
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
+	if (m_pAux->m_ForceFields.count(id) != 0) {
+		ForceField* pField = m_pAux->m_ForceFields[id];
+		switch (prop) {
+		case propFieldStrength:			pField->m_Strength		= value;	break;
+		case propFieldRadius:			pField->m_Radius		= value;	break;
+		case propFieldLinearDrag:		pField->m_LinearDrag	= value;	break;
+		case propFieldQuadraticDrag:	pField->m_QuadraticDrag	= value;	break;
+		case propFieldDensity:			pField->m_Density		= value;	break;
 		}
 	}
 	else {
-		APILOG("SetConstraintScalar - unknown id %d\n", id);
+		APILOG("SetForceFieldScalar - unknown id %d\n", id);
 	}
 }
 
-Real Physics::Engine :: GetConstraintScalar(uint32 id, EConstraintScalar prop)
+Real Physics::Engine :: GetForceFieldScalar(uint32 id, EForceFieldScalar prop)
 {
 	Real retval = k0;
-	if (m_pAux->m_Springs.count(id) != 0) {
-		Constraint* pConstraint = m_pAux->m_Constraints[id];
-		if (pConstraint->GetKind() == DistanceConstraint::GetStaticKind()) {
-			DistanceConstraint* pDC = (DistanceConstraint*) pConstraint;
-			if (prop == propConstraintDistance) {
-				retval = pDC->m_Distance;
-			}
+	if (m_pAux->m_ForceFields.count(id) != 0) {
+		ForceField* pField = m_pAux->m_ForceFields[id];
+		switch (prop) {
+		case propFieldStrength:			retval = pField->m_Strength;		break;
+		case propFieldRadius:			retval = pField->m_Radius;			break;
+		case propFieldLinearDrag:		retval = pField->m_LinearDrag;		break;
+		case propFieldQuadraticDrag:	retval = pField->m_QuadraticDrag;	break;
+		case propFieldDensity:			retval = pField->m_Density;			break;
 		}
 	}
 	else {
-		APILOG("GetConstraintScalar - unknown id %d\n", id);
+		APILOG("GetForceFieldScalar - unknown id %d\n", id);
+	}
+	return retval;
+}
+
+void Physics::Engine :: SetForceFieldVec3f(uint32 id, EForceFieldVector prop, PMath::Vec3f value)
+{
+	PendingCommand cmd(PendingCommand::kForceFieldVec3f, id, prop);
+	Vec3fSet(cmd.m_Vector, value);
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
+	PMath::Vec3f* pTarget = GetForceFieldVec3fPtr(id, prop);
+	if (pTarget != 0) {
+		Vec3fSet(*pTarget, value);
+	}
+}
+
+PMath::Vec3f* Physics::Engine :: GetForceFieldVec3fPtr(uint32 id, EForceFieldVector prop)
+{
+	PMath::Vec3f* retval = 0;
+	if (m_pAux->m_ForceFields.count(id) != 0) {
+		ForceField* pField = m_pAux->m_ForceFields[id];
+		switch (prop) {
+		case propFieldCenter:			retval = &pField->m_Center;			break;
+		case propFieldMin:				retval = &pField->m_Min;			break;
+		case propFieldMax:				retval = &pField->m_Max;			break;
+		case propFieldVelocity:			retval = &pField->m_Velocity;		break;
+		}
+	}
+	else {
+		APILOG("GetForceFieldVec3fPtr - unknown id %d\n", id);
 	}
 	return retval;
 }
 
 void Physics::Engine :: AddImpulse(uint32 id, Vec3f force)
 {
+	PendingCommand cmd(PendingCommand::kImpulse, id, 0);
+	Vec3fSet(cmd.m_Vector, force);
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
 	if (m_pAux->m_Bodies.count(id) != 0) {
 		RigidBody* pBody = m_pAux->m_Bodies[id];
 		if (pBody->GetTranslatable()) {
@@ -839,6 +3267,12 @@ void Physics::Engine :: AddImpulse(uint32 id, Vec3f force)
 
 void Physics::Engine :: AddTwist(uint32 id, Vec3f torque)
 {
+	PendingCommand cmd(PendingCommand::kTwist, id, 0);
+	Vec3fSet(cmd.m_Vector, torque);
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
 	if (m_pAux->m_Bodies.count(id) != 0) {
 		RigidBody* pBody = m_pAux->m_Bodies[id];
 		if (pBody->GetSpinnable()) {
@@ -852,6 +3286,11 @@ void Physics::Engine :: AddTwist(uint32 id, Vec3f torque)
 
 void Physics::Engine :: StopMoving(uint32 id)
 {
+	PendingCommand cmd(PendingCommand::kStopMoving, id, 0);
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
 	if (m_pAux->m_Bodies.count(id) != 0) {
 		RigidBody* pBody = m_pAux->m_Bodies[id];
 		if (pBody->GetSpinnable()) {
@@ -867,6 +3306,11 @@ void Physics::Engine :: StopMoving(uint32 id)
 
 void Physics::Engine :: StopSpinning(uint32 id)
 {
+	PendingCommand cmd(PendingCommand::kStopSpinning, id, 0);
+	if (m_pAux->Defer(cmd)) {
+		return;
+	}
+
 	if (m_pAux->m_Bodies.count(id) != 0) {
 		RigidBody* pBody = m_pAux->m_Bodies[id];
 		if (pBody->GetSpinnable()) {
@@ -880,132 +3324,417 @@ void Physics::Engine :: StopSpinning(uint32 id)
 	}
 }
 
+void Physics::Engine :: GetMemoryStats(MemoryStats& stats)
+{
+	m_pAux->m_RigidBodyPool.GetStats(stats.m_RigidBodies);
+	m_pAux->m_SpringMeshPool.GetStats(stats.m_SpringMeshes);
+	m_pAux->m_SpringPool.GetStats(stats.m_Springs);
+	m_pAux->m_DistanceConstraintPool.GetStats(stats.m_DistanceConstraints);
+	m_pAux->m_CollisionEngine.GetMemoryStats(stats);
+	m_pAux->m_ParticleSystemPool.GetStats(stats.m_ParticleSystems);
+	m_pAux->m_ForceFieldPool.GetStats(stats.m_ForceFields);
+	m_pAux->m_ArticulationPool.GetStats(stats.m_Articulations);
+
+	stats.m_Particles = PoolStats();
+	stats.m_Particles.m_ObjectSize = 6 * sizeof(Real);
+	for (Physics::ParticleMap::iterator pIter = m_pAux->m_Particles.begin(); pIter != m_pAux->m_Particles.end(); ++pIter) {
+		ParticleSystem* pSystem = pIter->second;
+		stats.m_Particles.m_InUse		+= pSystem->GetCount();
+		stats.m_Particles.m_Capacity	+= (int) pSystem->m_X.capacity();
+		stats.m_Particles.m_Bytes		+= pSystem->GetBytes();
+	}
+
+	stats.m_TotalBytes =	stats.m_RigidBodies.m_Bytes + stats.m_SpringMeshes.m_Bytes + stats.m_Springs.m_Bytes +
+							stats.m_DistanceConstraints.m_Bytes + stats.m_Spheres.m_Bytes + stats.m_Planes.m_Bytes +
+							stats.m_Heightfields.m_Bytes + stats.m_Contacts.m_Bytes + stats.m_ParticleSystems.m_Bytes +
+							stats.m_Particles.m_Bytes + stats.m_ForceFields.m_Bytes + stats.m_Articulations.m_Bytes;
+}
+
+/*
+	The queries read the broadphase and the bodies without changing anything, so they don't
+	log through APILOG, which isn't safe to call from several threads at once.
+ */
+
+bool Physics::Engine :: RayCast(PMath::Vec3f origin, PMath::Vec3f direction, Real maxDistance, RayHit& hit)
+{
+	if (m_pAux->m_Simulating) {
+		hit.m_Body = 0;
+		return false;
+	}
+	return m_pAux->m_Broadphase.RayCast(origin, direction, maxDistance, hit);
+}
+
+int Physics::Engine :: RayCastAll(PMath::Vec3f origin, PMath::Vec3f direction, Real maxDistance, RayHit* pHits, int maxHits)
+{
+	if (m_pAux->m_Simulating) {
+		return 0;
+	}
+	return m_pAux->m_Broadphase.RayCastAll(origin, direction, maxDistance, pHits, maxHits);
+}
+
+int Physics::Engine :: RayCastBatch(int count, PMath::Vec3f const*const pOrigins, PMath::Vec3f const*const pDirections, Real maxDistance, RayHit* pHits)
+{
+	if (m_pAux->m_Simulating) {
+		for (int i = 0; i < count; ++i) {
+			pHits[i].m_Body = 0;
+		}
+		return 0;
+	}
+	return m_pAux->m_Broadphase.RayCastBatch(count, pOrigins, pDirections, maxDistance, pHits);
+}
+
+int Physics::Engine :: OverlapSphere(PMath::Vec3f center, Real radius, uint32* pBodies, int maxBodies)
+{
+	if (m_pAux->m_Simulating) {
+		return 0;
+	}
+	return m_pAux->m_Broadphase.OverlapSphere(center, radius, pBodies, maxBodies);
+}
+
+int Physics::Engine :: OverlapAABB(PMath::Vec3f boxMin, PMath::Vec3f boxMax, uint32* pBodies, int maxBodies)
+{
+	if (m_pAux->m_Simulating) {
+		return 0;
+	}
+	return m_pAux->m_Broadphase.OverlapAABB(boxMin, boxMax, pBodies, maxBodies);
+}
+
 void Physics::Engine :: SetMinTimeStep(Real dt)
 {
+	Sync();
 	m_pAux->m_MinTimeStep = dt;
 }
 
-void Physics::Engine :: Simulate(Real dt)
+void Physics::Engine :: SetSubstepBudget(int bodySubsteps, int maxSubsteps)
 {
-	/// @todo calculate timestep for numerical stability
-	// if the framerate is less than 50Hz, subdivide the time step
-	// 50Hz matches the stability requirement for stiffness with the demo's springs
-	// in reality, we would calculate the time step
+	Sync();
+	m_pAux->m_Islands.SetBudget(bodySubsteps, maxSubsteps);
 
-	int steps;
+	//--------------------------------------------------------------
+	APILOG("SetSubstepBudget(%d, %d)\n", bodySubsteps, maxSubsteps);
+	//--------------------------------------------------------------
+}
 
-	if (dt > m_pAux->m_MinTimeStep) {
-		steps = 1 + (int) (dt / m_pAux->m_MinTimeStep);
-		dt /= (float) steps;
-	}
-	else {
-		steps = 1;
+void Physics::Engine :: SetConstraintSolver(EConstraintSolver solver, int iterations)
+{
+	Sync();
+	m_pAux->m_ConstraintSolver.SetMode(solver, iterations);
+
+	//--------------------------------------------------------------
+	APILOG("SetConstraintSolver(%s, %d)\n", solver == kCS_Jacobi ? "kCS_Jacobi" : "kCS_GaussSeidel", iterations);
+	//--------------------------------------------------------------
+}
+
+void Physics::Engine :: SetLODFocusPoints(int count, Vec3f const*const pPoints)
+{
+	Sync();
+	m_pAux->m_LODFocus.resize(count * 3);
+	for (int i = 0; i < count; ++i) {
+		m_pAux->m_LODFocus[i * 3]		= pPoints[i][0];
+		m_pAux->m_LODFocus[i * 3 + 1]	= pPoints[i][1];
+		m_pAux->m_LODFocus[i * 3 + 2]	= pPoints[i][2];
 	}
+}
 
-	for (int i = 0; i < steps; ++i) {
-		Physics::RigidBodyMap::iterator		rbIter;
-		Physics::SpringMap::iterator		springIter;
-		Physics::ConstraintMap::iterator	cIter;
+void Physics::Engine :: SetLODDistances(Real halfRate, Real quarterRate)
+{
+	Sync();
+	m_pAux->m_LODHalfRate = halfRate;
+	m_pAux->m_LODQuarterRate = quarterRate;
 
-		// reset simulation
+	//--------------------------------------------------------------
+	APILOG("SetLODDistances(%f, %f)\n", halfRate, quarterRate);
+	//--------------------------------------------------------------
+}
 
-		for (rbIter = m_pAux->m_Bodies.begin(); rbIter != m_pAux->m_Bodies.end(); ++rbIter) {
-			RigidBody* pBody = rbIter->second;
+void Physics::Engine :: SetImpactOrdering(int maxEvents)
+{
+	Sync();
+	m_pAux->m_MaxImpacts = maxEvents > 0 ? maxEvents : 0;
 
-			// if the body is taking part in the simulation (asleep or awake)
-			if (pBody->GetActive()) {
-				/// @todo reawaken objects which have been put to sleep but which can't sleep any more
-				/// @todo bail early if asleep
-				pBody->ResetForNextTimeStep();
-			}
-		}
+	//--------------------------------------------------------------
+	APILOG("SetImpactOrdering(%d)\n", maxEvents);
+	//--------------------------------------------------------------
+}
 
-		// loop over all objects,
-		//			if not asleep
-		//				integrate first half of time step
+void Physics::Engine :: SetSpeculativeContacts(Real fraction)
+{
+	Sync();
+	m_pAux->m_SpeculativeFraction = fraction > k0 ? fraction : k0;
 
-		for (rbIter = m_pAux->m_Bodies.begin(); rbIter != m_pAux->m_Bodies.end(); ++rbIter) {
-			RigidBody* pBody = rbIter->second;
+	//--------------------------------------------------------------
+	APILOG("SetSpeculativeContacts(%f)\n", fraction);
+	//--------------------------------------------------------------
+}
 
-			// if the body is taking part in the simulation (asleep or awake)
-			if (pBody->GetActive()) {
-				/// @todo do any initial constraint set up here
-				/// @todo reset the collided with an immovable object flag here
-				pBody->Integrate1(dt, m_pAux->m_Gravity);
-			}
-		}
+void Physics::Engine :: SetThreadCount(int count)
+{
+	Sync();
+	m_pAux->m_Threads.SetThreadCount(count);
+
+	//--------------------------------------------------------------
+	APILOG("SetThreadCount(%d)\n", count);
+	//--------------------------------------------------------------
+}
+
+/*
+	The energy and momentum are summed when asked for, rather than every step, so that
+	measuring costs nothing unless someone is watching.
+ */
+
+void Physics::Engine :: GetStepStats(StepStats& stats)
+{
+	Sync();
+	stats = m_pAux->m_StepStats;
+	m_pAux->MeasureEnergy(stats);
+}
+
+void Physics::Engine :: SetTimeBudget(double seconds)
+{
+	Sync();
+	m_pAux->m_TimeBudget = seconds > 0 ? seconds : 0;
+	m_pAux->m_DegradeStage = 0;
+	m_pAux->m_WorldStepSeconds = 0;
 
-		// loop over all springs
-		//		add forces to appropriate bodies
+	//--------------------------------------------------------------
+	APILOG("SetTimeBudget(%f)\n", seconds);
+	//--------------------------------------------------------------
+}
 
-		for (springIter = m_pAux->m_Springs.begin(); springIter != m_pAux->m_Springs.end(); ++ springIter) {
-			Spring* pSpring = springIter->second;
+void Physics::Engine :: SetStabilityMonitor(Real growth)
+{
+	Sync();
+	m_pAux->m_StabilityGrowth = growth > k0 ? growth : k0;
+	m_pAux->m_PrevBodyCount = -1;
 
-			Vec3f* pPosA = &pSpring->mp_BodyA->m_StateT1.m_Position;
-			Vec3f* pPosB = &pSpring->mp_BodyB->m_StateT1.m_Position;
+	//--------------------------------------------------------------
+	APILOG("SetStabilityMonitor(%f)\n", growth);
+	//--------------------------------------------------------------
+}
 
-			Vec3f direction;
-			Vec3fSubtract(direction, *pPosA, *pPosB);
-			Real length = Vec3fLength(direction);
+/*
+	Each time step is tried on a fresh copy of the scene, so one that blows up can't spoil the
+	next. A copy is judged unstable as soon as one of its steps is; halving finds a stable step
+	within a factor of two of the largest, and bisecting between the two narrows it further.
+ */
 
-			Real x = length - pSpring->m_RestLength;
+Real Physics::Engine :: FindStableTimeStep(Real frameTime, int frames)
+{
+	Sync();
 
-			if (pSpring->m_ResistCompression || (x > k0)) {
-				Real force = pSpring->m_Stiffness * x;
+	//--------------------------------------------------------------
+	APILOG("FindStableTimeStep(%f, %d)\n", frameTime, frames);
+	//--------------------------------------------------------------
 
-				// damping -b * difference in length between this frame and previous
-				Real v = (pSpring->m_PrevLength - x);
-				force += v * pSpring->m_Damping;
+	if (frameTime <= k0) {
+		return k0;
+	}
 
-				pSpring->m_PrevLength = length;
+	Real stable = k0;
+	Real unstable = k0;
+	for (Real dt = frameTime; dt >= frameTime * Real(1.0f / 256.0f); dt *= kHalf) {
+		if (SteppedStably(dt, frameTime, frames)) {
+			stable = dt;
+			break;
+		}
+		unstable = dt;
+	}
 
-				Vec3fMultiplyAccumulate(pSpring->mp_BodyA->m_Acc.m_Force, -force, direction);
-				Vec3fMultiplyAccumulate(pSpring->mp_BodyB->m_Acc.m_Force,  force, direction);
+	if (stable > k0 && unstable > k0) {
+		for (int i = 0; i < kStableSearchBisections; ++i) {
+			Real dt = kHalf * (stable + unstable);
+			if (SteppedStably(dt, frameTime, frames)) {
+				stable = dt;
+			}
+			else {
+				unstable = dt;
 			}
 		}
+	}
+	return stable;
+}
 
-		// loop over all contraints
-		//		if active, 
-		//			satisfy constraints
+bool Physics::Engine :: SteppedStably(Real dt, Real frameTime, int frames)
+{
+	Engine scratch;
+	scratch.m_pAux->CopyScene(*m_pAux);
+	scratch.m_pAux->m_MinTimeStep		= dt;
+	scratch.m_pAux->m_StabilityGrowth	= m_pAux->m_StabilityGrowth > k0 ? m_pAux->m_StabilityGrowth : kDefaultStabilityGrowth;
+
+	for (int f = 0; f < frames; ++f) {
+		scratch.Simulate(frameTime);
+		if (scratch.m_pAux->m_StepStats.m_Unstable) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void Physics::Engine :: Simulate(Real dt)
+{
+	Sync();
+	Step(dt);
+	m_pAux->m_SnapshotStale = true;
+
+	m_pAux->TakeDeferredCommands();
+	ApplyPendingCommands();
+}
+
+/*
+	The step runs on the worker thread, so it must not call any function that could be deferred.
+	When it completes, the readable state is written to the back snapshot, which Sync() publishes.
+ */
+
+void Physics::Engine :: AsyncStep(void* pData)
+{
+	Physics::Engine* pEngine = (Physics::Engine*) pData;
+	PEAux* pAux = pEngine->m_pAux;
+	pEngine->Step(pAux->m_AsyncDt);
+	pAux->CaptureSnapshot(pAux->m_Snapshots[pAux->m_FrontSnapshot ^ 1]);
+}
+
+void Physics::Engine :: SimulateAsync(Real dt)
+{
+	Sync();
+
+	// changes made since the last step have to be visible in the snapshot read during this one
+	if (m_pAux->m_SnapshotStale) {
+		m_pAux->CaptureSnapshot(m_pAux->m_Snapshots[m_pAux->m_FrontSnapshot]);
+		m_pAux->m_SnapshotStale = false;
+	}
+
+	m_pAux->m_AsyncDt = dt;
+	m_pAux->m_Simulating = true;
+	m_pAux->m_Worker.Kick(AsyncStep, this);
+}
+
+void Physics::Engine :: Sync()
+{
+	if (m_pAux->m_Simulating) {
+		m_pAux->m_Worker.Wait();
+		m_pAux->m_FrontSnapshot ^= 1;
+		m_pAux->m_Simulating = false;
+		m_pAux->TakeDeferredCommands();
+		ApplyPendingCommands();
+	}
+}
+
+bool Physics::Engine :: IsSimulating() const
+{
+	return m_pAux->m_Simulating;
+}
 
-		for (cIter = m_pAux->m_Constraints.begin(); cIter != m_pAux->m_Constraints.end(); ++ cIter) {
-			Constraint* pConstraint = cIter->second;
-			pConstraint->Apply();
+void Physics::Engine :: SyncForEdit()
+{
+	Sync();
+	m_pAux->m_SnapshotStale = true;
+}
+
+void Physics::Engine :: ApplyPendingCommands()
+{
+	std::vector<PendingCommand>::iterator iter;
+	for (iter = m_pAux->m_PendingCommands.begin(); iter != m_pAux->m_PendingCommands.end(); ++iter) {
+		PendingCommand& cmd = *iter;
+		switch (cmd.m_Kind) {
+		case PendingCommand::kRigidBodyBool:	SetRigidBodyBool(cmd.m_Id,		(ERigidBodyBool) cmd.m_Prop,		cmd.m_Bool);	break;
+		case PendingCommand::kRigidBodyScalar:	SetRigidBodyScalar(cmd.m_Id,	(ERigidBodyScalar) cmd.m_Prop,		cmd.m_Scalar);	break;
+		case PendingCommand::kRigidBodyInt:		SetRigidBodyInt(cmd.m_Id,		(ERigidBodyInt) cmd.m_Prop,			cmd.m_Int);		break;
+		case PendingCommand::kRigidBodyVec3f:	SetRigidBodyVec3f(cmd.m_Id,		(ERigidBodyVector) cmd.m_Prop,		cmd.m_Vector);	break;
+		case PendingCommand::kRigidBodyQuat:	SetRigidBodyQuat(cmd.m_Id,		(ERigidBodyQuat) cmd.m_Prop,		cmd.m_Quat);	break;
+		case PendingCommand::kSpringBool:		SetSpringBool(cmd.m_Id,			(ESpringBool) cmd.m_Prop,			cmd.m_Bool);	break;
+		case PendingCommand::kSpringUInt32:		SetSpringUInt32(cmd.m_Id,		(ESpringUint32) cmd.m_Prop,			cmd.m_UInt);	break;
+		case PendingCommand::kSpringScalar:		SetSpringScalar(cmd.m_Id,		(ESpringScalar) cmd.m_Prop,			cmd.m_Scalar);	break;
+		case PendingCommand::kSpringVec3f:		SetSpringVec3f(cmd.m_Id,		(ESpringVector) cmd.m_Prop,			cmd.m_Vector);	break;
+		case PendingCommand::kConstraintBool:	SetConstraintBool(cmd.m_Id,		(EConstraintBool) cmd.m_Prop,		cmd.m_Bool);	break;
+		case PendingCommand::kConstraintScalar:	SetConstraintScalar(cmd.m_Id,	(EConstraintScalar) cmd.m_Prop,		cmd.m_Scalar);	break;
+		case PendingCommand::kParticleBool:		SetParticleBool(cmd.m_Id,		(EParticleBool) cmd.m_Prop,			cmd.m_Bool);	break;
+		case PendingCommand::kParticleScalar:	SetParticleScalar(cmd.m_Id,		(EParticleScalar) cmd.m_Prop,		cmd.m_Scalar);	break;
+		case PendingCommand::kForceFieldBool:	SetForceFieldBool(cmd.m_Id,		(EForceFieldBool) cmd.m_Prop,		cmd.m_Bool);	break;
+		case PendingCommand::kForceFieldScalar:	SetForceFieldScalar(cmd.m_Id,	(EForceFieldScalar) cmd.m_Prop,		cmd.m_Scalar);	break;
+		case PendingCommand::kForceFieldVec3f:	SetForceFieldVec3f(cmd.m_Id,	(EForceFieldVector) cmd.m_Prop,		cmd.m_Vector);	break;
+		case PendingCommand::kArticulationBool:	SetArticulationBool(cmd.m_Id,	(EArticulationBool) cmd.m_Prop,		cmd.m_Bool);	break;
+		case PendingCommand::kArticulationScalar:	SetArticulationScalar(cmd.m_Id,	(EArticulationScalar) cmd.m_Prop,	cmd.m_Scalar);	break;
+		case PendingCommand::kImpulse:			AddImpulse(cmd.m_Id, cmd.m_Vector);		break;
+		case PendingCommand::kTwist:			AddTwist(cmd.m_Id, cmd.m_Vector);		break;
+		case PendingCommand::kStopMoving:		StopMoving(cmd.m_Id);					break;
+		case PendingCommand::kStopSpinning:		StopSpinning(cmd.m_Id);					break;
+		case PendingCommand::kGravity:			SetGravity(cmd.m_Vector);				break;
+		case PendingCommand::kRemoveRigidBody:	RemoveRigidBody(cmd.m_Id);				break;
 		}
+	}
+	m_pAux->m_PendingCommands.clear();
+}
 
-		// loop over all objects,
-		//			if not asleep
-		//				integrate second half of time step
+void Physics::Engine :: Step(Real dt)
+{
+	// if the framerate is less than 50Hz, subdivide the time step
+	// 50Hz matches the stability requirement for collisions in the demo
+	// within each of these world steps, every island is substepped as finely as its own springs need
 
-		for (rbIter = m_pAux->m_Bodies.begin(); rbIter != m_pAux->m_Bodies.end(); ++rbIter) {
-			RigidBody* pBody = rbIter->second;
+	int steps;
+	double stepStart = Physics::ClockSeconds();
+	Physics::StepStats& stats = m_pAux->m_StepStats;
+	stats = Physics::StepStats();
+
+	if (dt > m_pAux->m_MinTimeStep) {
+		steps = 1 + (int) (dt / m_pAux->m_MinTimeStep);
+		dt /= (float) steps;
+	}
+	else {
+		steps = 1;
+	}
+
+	// a time budget runs only the world steps that fit, and degrades them as far as it has to
+
+	bool budgeted = m_pAux->m_TimeBudget > 0;
+	if (budgeted) {
+		steps = m_pAux->BeginBudget(steps, dt, stats);
+	}
+
+	if (m_pAux->BeginLODFrame(dt * Real(steps), budgeted && m_pAux->m_DegradeStage >= 2)) {
+		stats.m_Degraded |= kDG_FarIslands;
+	}
+	m_pAux->BuildIslands(dt);
+	m_pAux->m_ContactEvents.clear();
+	stats.m_WorldSteps	= steps;
+	stats.m_Islands		= m_pAux->m_Islands.GetIslandCount();
+
+	// pushing resting bodies out of what they touch lifts them, so the stability monitor leaves contacts out
+
+	bool monitored = m_pAux->m_StabilityGrowth > k0;
+	m_pAux->m_ContactWork = k0;
+
+	for (int i = 0; i < steps; ++i) {
+		Physics::RigidBodyMap::iterator		rbIter;
+		double integrateStart = Physics::ClockSeconds();
 
-			// if the body is taking part in the simulation (asleep or awake)
-			if (pBody->GetActive()) {
-				/// @todo do any initial constraint set up here
-				/// @todo reset the collided with an immovable object flag here
-				pBody->Integrate2(dt, m_pAux->m_Gravity);
+		m_pAux->GatherForceFields();
+
+		for (int g = 0; g < m_pAux->m_Islands.GetGroupCount(); ++g) {
+			IslandGroup& group = m_pAux->m_Islands.GetGroup(g);
+			if (!m_pAux->m_TierDue[group.m_Tier]) {
+				m_pAux->HoldSkipped(group);
+				continue;
+			}
+			Real substep = dt * m_pAux->m_TierScale[group.m_Tier] / Real(group.m_Substeps);
+			for (int j = 0; j < group.m_Substeps; ++j) {
+				m_pAux->Integrate(group, m_pAux->m_FieldBatches[g], substep);
 			}
+			stats.m_BodySubsteps += (int) group.m_Bodies.size() * group.m_Substeps;
 		}
 
+		double collideStart = Physics::ClockSeconds();
+		stats.m_IntegrateSeconds += collideStart - integrateStart;
+		Real energyBeforeContacts = monitored ? m_pAux->TotalEnergy() : k0;
+
 		// loop over all objects,
 		//		if active, 
 		//			detect and resolve collisions
 
 		m_pAux->m_CollisionEngine.Begin();
 
-		for (rbIter = m_pAux->m_Bodies.begin(); rbIter != m_pAux->m_Bodies.end(); ++rbIter) {
-			RigidBody* pBodyA = rbIter->second;
-			if (pBodyA->GetCollidable()) {
-				Physics::RigidBodyMap::iterator rbIter2;
-				rbIter2 = rbIter;
-				++rbIter2;													// get the rigid body beyond the current outer loop
-				for ( ; rbIter2 != m_pAux->m_Bodies.end(); ++rbIter2) {
-					RigidBody* pBodyB = rbIter2->second;
-					m_pAux->m_CollisionEngine.TestCollision(pBodyA, pBodyB);			
-				}
-			}
-		}
+		m_pAux->BuildBroadphase(dt);
+		m_pAux->FindContacts();
 
 		//
 		// this demo is intended to demonstrate integration, not collisiond detection and integration,
@@ -1031,6 +3760,9 @@ void Physics::Engine :: Simulate(Real dt)
 		// Adam Moravanszky, and Pierre Terdiman
 		// Games Programming Gems IV
 		//
+		// Collision::Engine::TestPairs reduces each pair's contacts to four as they describe; a sphere
+		// wedged into the faces of a heightfield is the pair that finds more.
+		//
 		// If a robust scheme such as that one is used, a constraint system or a temporary spring
 		// solution can be used to resolve instead.
 		//
@@ -1040,14 +3772,35 @@ void Physics::Engine :: Simulate(Real dt)
 		// the involved objects are combinations of spheres and planes.
 		//
 
-		std::vector<Contact*>::iterator contactIter;
+		// SetImpactOrdering chooses the scheme above, with a cap on the events per step
 
-		for (contactIter = m_pAux->m_CollisionEngine.m_Contacts.begin(); contactIter != m_pAux->m_CollisionEngine.m_Contacts.end(); ++contactIter) {
-			m_pAux->m_CollisionEngine.Resolve(*contactIter);
+		if (m_pAux->m_MaxImpacts > 0) {
+			m_pAux->ResolveInTimeOrder();
+		}
+		else {
+			std::vector<Contact*>::iterator contactIter;
+			for (contactIter = m_pAux->m_CollisionEngine.m_Contacts.begin(); contactIter != m_pAux->m_CollisionEngine.m_Contacts.end(); ++contactIter) {
+				m_pAux->ResolveContact(*contactIter);
+			}
 		}
+		stats.m_Contacts += (int) m_pAux->m_CollisionEngine.m_Contacts.size();
+		Real penetration = m_pAux->m_CollisionEngine.GetMaxPenetration();
+		stats.m_MaxPenetration = penetration > stats.m_MaxPenetration ? penetration : stats.m_MaxPenetration;
 
 		m_pAux->m_CollisionEngine.End();
 
+		// contacts treated the links of articulations as free bodies; their joints take it from here
+
+		m_pAux->AbsorbContacts();
+
+		// spring meshes have no collision geometry of their own; their points are collided here
+
+		m_pAux->CollideSpringMeshes();
+		if (monitored) {
+			m_pAux->m_ContactWork += m_pAux->TotalEnergy() - energyBeforeContacts;
+		}
+		stats.m_CollideSeconds += Physics::ClockSeconds() - collideStart;
+
 		// loop over all objects,
 		//		if active, 
 		//			renormalize states
@@ -1056,6 +3809,37 @@ void Physics::Engine :: Simulate(Real dt)
 			RigidBody* pBody = rbIter->second;
 			pBody->Renormalize();
 		}
+
+		// particles move after the bodies, so they bounce off where the bodies ended up
+
+		m_pAux->IntegrateParticles(dt);
+
+		// if another world step would run over the budget, the rest are dropped
+
+		if (budgeted && i + 1 < steps) {
+			double elapsed = Physics::ClockSeconds() - stepStart;
+			if (elapsed + elapsed / double(i + 1) > m_pAux->m_TimeBudget) {
+				stats.m_Degraded |= kDG_SimulatedTime;
+				stats.m_TimeDropped += dt * Real(steps - i - 1);
+				stats.m_WorldSteps = i + 1;
+				break;
+			}
+		}
+	}
+
+	m_pAux->EndLODFrame();
+
+	// resolution moved some bodies; bring the bounds up to date for queries made before the next step
+
+	m_pAux->m_Broadphase.Refit();
+
+	if (monitored) {
+		m_pAux->MonitorStability(stats);
+	}
+	stats.m_StepSeconds = Physics::ClockSeconds() - stepStart;
+
+	if (budgeted) {
+		m_pAux->EndBudget(stats.m_StepSeconds, stats.m_WorldSteps, (stats.m_Degraded & kDG_SimulatedTime) != 0);
 	}
 }
 
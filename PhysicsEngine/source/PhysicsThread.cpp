@@ -0,0 +1,339 @@
+
+/** @file PhysicsThread.cpp
+	@brief	minimal worker thread, Win32 and pthreads */
+
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#ifdef WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <pthread.h>
+	#include <unistd.h>
+	#include <sys/time.h>
+#endif
+
+#include "PhysicsThread.h"
+
+namespace Physics {
+
+/** @class WorkerThreadAux
+	The platform specific parts of a WorkerThread
+ */
+
+	class WorkerThreadAux
+	{
+	public:
+		WorkerThreadAux() : m_Job(0), m_pData(0), m_Pending(false), m_Quit(false), m_Started(false) { }
+
+		WorkerThread::Job	m_Job;
+		void*				m_pData;
+		bool				m_Pending;			//!< a job has been posted and not yet completed
+		bool				m_Quit;				//!< the thread should exit
+		bool				m_Started;			//!< the thread has been created
+
+#ifdef WIN32
+		HANDLE				m_Thread;
+		HANDLE				m_KickEvent;		//!< auto-reset, signalled when a job is posted
+		HANDLE				m_DoneEvent;		//!< auto-reset, signalled when a job completes
+#else
+		pthread_t			m_Thread;
+		pthread_mutex_t		m_Mutex;
+		pthread_cond_t		m_Cond;				//!< signalled on both post and completion
+#endif
+
+		void Start();
+		void Stop();
+		void Post(WorkerThread::Job job, void* pData);
+		void WaitDone();
+		void Run();
+	};
+
+#ifdef WIN32
+
+	static DWORD WINAPI WorkerThreadProc(LPVOID pData)
+	{
+		((WorkerThreadAux*) pData)->Run();
+		return 0;
+	}
+
+	void WorkerThreadAux::Start()
+	{
+		m_KickEvent	= CreateEvent(0, FALSE, FALSE, 0);
+		m_DoneEvent	= CreateEvent(0, FALSE, FALSE, 0);
+		m_Thread	= CreateThread(0, 0, WorkerThreadProc, this, 0, 0);
+		m_Started	= true;
+	}
+
+	void WorkerThreadAux::Stop()
+	{
+		m_Quit = true;
+		SetEvent(m_KickEvent);
+		WaitForSingleObject(m_Thread, INFINITE);
+		CloseHandle(m_Thread);
+		CloseHandle(m_KickEvent);
+		CloseHandle(m_DoneEvent);
+		m_Started = false;
+	}
+
+	void WorkerThreadAux::Post(WorkerThread::Job job, void* pData)
+	{
+		m_Job		= job;
+		m_pData		= pData;
+		m_Pending	= true;
+		SetEvent(m_KickEvent);
+	}
+
+	void WorkerThreadAux::WaitDone()
+	{
+		if (m_Pending) {
+			WaitForSingleObject(m_DoneEvent, INFINITE);
+			m_Pending = false;
+		}
+	}
+
+	void WorkerThreadAux::Run()
+	{
+		for (;;) {
+			WaitForSingleObject(m_KickEvent, INFINITE);
+			if (m_Quit) {
+				break;
+			}
+			m_Job(m_pData);
+			SetEvent(m_DoneEvent);
+		}
+	}
+
+#else
+
+	static void* WorkerThreadProc(void* pData)
+	{
+		((WorkerThreadAux*) pData)->Run();
+		return 0;
+	}
+
+	void WorkerThreadAux::Start()
+	{
+		pthread_mutex_init(&m_Mutex, 0);
+		pthread_cond_init(&m_Cond, 0);
+		pthread_create(&m_Thread, 0, WorkerThreadProc, this);
+		m_Started = true;
+	}
+
+	void WorkerThreadAux::Stop()
+	{
+		pthread_mutex_lock(&m_Mutex);
+		m_Quit = true;
+		pthread_cond_broadcast(&m_Cond);
+		pthread_mutex_unlock(&m_Mutex);
+		pthread_join(m_Thread, 0);
+		pthread_cond_destroy(&m_Cond);
+		pthread_mutex_destroy(&m_Mutex);
+		m_Started = false;
+	}
+
+	void WorkerThreadAux::Post(WorkerThread::Job job, void* pData)
+	{
+		pthread_mutex_lock(&m_Mutex);
+		m_Job		= job;
+		m_pData		= pData;
+		m_Pending	= true;
+		pthread_cond_broadcast(&m_Cond);
+		pthread_mutex_unlock(&m_Mutex);
+	}
+
+	void WorkerThreadAux::WaitDone()
+	{
+		pthread_mutex_lock(&m_Mutex);
+		while (m_Pending) {
+			pthread_cond_wait(&m_Cond, &m_Mutex);
+		}
+		pthread_mutex_unlock(&m_Mutex);
+	}
+
+	void WorkerThreadAux::Run()
+	{
+		pthread_mutex_lock(&m_Mutex);
+		for (;;) {
+			while (!m_Pending && !m_Quit) {
+				pthread_cond_wait(&m_Cond, &m_Mutex);
+			}
+			if (m_Quit) {
+				break;
+			}
+			pthread_mutex_unlock(&m_Mutex);
+			m_Job(m_pData);
+			pthread_mutex_lock(&m_Mutex);
+			m_Pending = false;
+			pthread_cond_broadcast(&m_Cond);
+		}
+		pthread_mutex_unlock(&m_Mutex);
+	}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	WorkerThread :: WorkerThread() : m_pAux(new WorkerThreadAux()), m_Busy(false)
+	{
+	}
+
+	WorkerThread :: ~WorkerThread()
+	{
+		Wait();
+		if (m_pAux->m_Started) {
+			m_pAux->Stop();
+		}
+		delete m_pAux;
+	}
+
+	void WorkerThread :: Kick(Job job, void* pData)
+	{
+		Wait();
+		if (!m_pAux->m_Started) {
+			m_pAux->Start();
+		}
+		m_Busy = true;
+		m_pAux->Post(job, pData);
+	}
+
+	void WorkerThread :: Wait()
+	{
+		if (m_Busy) {
+			m_pAux->WaitDone();
+			m_Busy = false;
+		}
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	/// one contiguous piece of a ThreadPool::Run
+	class ThreadPool::Slice
+	{
+	public:
+		ThreadPool::RangeJob	m_Job;
+		void*					m_pData;
+		int						m_Begin;
+		int						m_End;
+
+		static void Execute(void* pData)
+		{
+			Slice* pSlice = (Slice*) pData;
+			pSlice->m_Job(pSlice->m_pData, pSlice->m_Begin, pSlice->m_End);
+		}
+	};
+
+	ThreadPool :: ThreadPool() : m_ThreadCount(1), m_pWorkers(0), m_pSlices(0)
+	{
+	}
+
+	ThreadPool :: ~ThreadPool()
+	{
+		delete [] m_pWorkers;
+		delete [] m_pSlices;
+	}
+
+	void ThreadPool :: SetThreadCount(int count)
+	{
+		if (count <= 0) {
+			count = ProcessorCount();
+		}
+		if (count == m_ThreadCount) {
+			return;
+		}
+
+		delete [] m_pWorkers;
+		delete [] m_pSlices;
+		m_ThreadCount	= count;
+		m_pWorkers		= count > 1 ? new WorkerThread[count - 1] : 0;
+		m_pSlices		= new Slice[count];
+	}
+
+	void ThreadPool :: Run(int count, RangeJob job, void* pData, int minBatch)
+	{
+		if (count <= 0) {
+			return;
+		}
+		if (minBatch < 1) {
+			minBatch = 1;
+		}
+
+		int slices = count / minBatch;
+		if (slices > m_ThreadCount) {
+			slices = m_ThreadCount;
+		}
+		if (slices <= 1) {
+			job(pData, 0, count);
+			return;
+		}
+
+		// workers take slices 1..n-1, the caller takes slice 0
+		int i;
+		for (i = 0; i < slices; ++i) {
+			m_pSlices[i].m_Job		= job;
+			m_pSlices[i].m_pData	= pData;
+			m_pSlices[i].m_Begin	= (count * i) / slices;
+			m_pSlices[i].m_End		= (count * (i + 1)) / slices;
+		}
+		for (i = 1; i < slices; ++i) {
+			m_pWorkers[i - 1].Kick(Slice::Execute, &m_pSlices[i]);
+		}
+		Slice::Execute(&m_pSlices[0]);
+		for (i = 1; i < slices; ++i) {
+			m_pWorkers[i - 1].Wait();
+		}
+	}
+
+	int ThreadPool :: ProcessorCount()
+	{
+#ifdef WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		int count = (int) info.dwNumberOfProcessors;
+#else
+		int count = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		return count > 0 ? count : 1;
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	double ClockSeconds()
+	{
+#ifdef WIN32
+		LARGE_INTEGER frequency, counter;
+		QueryPerformanceFrequency(&frequency);
+		QueryPerformanceCounter(&counter);
+		return (double) counter.QuadPart / (double) frequency.QuadPart;
+#else
+		struct timeval now;
+		gettimeofday(&now, 0);
+		return (double) now.tv_sec + (double) now.tv_usec * 1.0e-6;
+#endif
+	}
+
+}	// end namespace Physics
@@ -0,0 +1,116 @@
+
+/** @file PhysicsThread.h
+
+	an internal implementation file, hides the platform threading API from the engine
+ */
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#ifndef _PHYSICSTHREAD_H_
+#define _PHYSICSTHREAD_H_
+
+#include "PhysicsEngineDef.h"
+
+namespace Physics {
+
+	class WorkerThreadAux;	// forward declaration - hidden platform implementation
+
+	/** @class	WorkerThread
+		@brief	A single persistent thread that runs one job at a time
+
+		The thread is created lazily on the first Kick, and sleeps between jobs.
+		Kick and Wait must not be called concurrently from different threads.
+	 */
+
+	class WorkerThread
+	{
+	public:
+		typedef void (*Job)(void* pData);
+
+		WorkerThread();
+		~WorkerThread();
+
+		/// start running job on the worker; waits for any previous job to finish first
+		void	Kick(Job job, void* pData);
+
+		/// block until the current job, if any, has finished
+		void	Wait();
+
+		/// @return true if a job has been kicked and not yet waited for
+		bool	Busy() const { return m_Busy; }
+
+	protected:
+		WorkerThreadAux*	m_pAux;
+		bool				m_Busy;
+	};
+
+	/** @class	ThreadPool
+		@brief	Splits a range of work across worker threads and the calling thread
+
+		Run returns when the whole range is done. A pool with a thread count of one
+		runs everything on the calling thread.
+	 */
+
+	class ThreadPool
+	{
+	public:
+		/// process the items in [begin, end)
+		typedef void (*RangeJob)(void* pData, int begin, int end);
+
+		ThreadPool();
+		~ThreadPool();
+
+		/// set the number of threads to use, including the caller; zero means one per processor
+		void	SetThreadCount(int count);
+		int		GetThreadCount() const { return m_ThreadCount; }
+
+		/**
+		* Run job over [0, count), in contiguous slices of at least minBatch items
+		*
+		* @param count		number of items
+		* @param job		called once per slice, possibly concurrently
+		* @param pData		passed through to job
+		* @param minBatch	smallest slice worth handing to another thread
+		*/
+		void	Run(int count, RangeJob job, void* pData, int minBatch);
+
+		/// @return the number of processors in the machine
+		static int ProcessorCount();
+
+	protected:
+		class Slice;
+
+		int						m_ThreadCount;
+		WorkerThread*			m_pWorkers;			//!< m_ThreadCount - 1 workers; the caller does the first slice
+		Slice*					m_pSlices;
+	};
+
+	/// @return seconds since an arbitrary moment, from the finest clock the platform has
+	double	ClockSeconds();
+
+}	// end Physics namespace
+
+#endif
@@ -0,0 +1,136 @@
+
+/** @file Pool.h
+
+	an internal implementation file, fixed size object pools
+ */
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <new>
+#include <vector>
+
+#include "PhysicsEngineDef.h"
+
+namespace Physics {
+
+	/** @class	Pool
+		@brief	Allocates objects of a single type from contiguous chunks
+
+		Alloc and Free are O(1); freed slots are kept on an intrusive free list and reused
+		most recently freed first. A fresh chunk is threaded onto the free list in address
+		order, so objects allocated in sequence sit next to each other in memory.
+		Chunks are only returned to the heap when the pool is destroyed.
+	 */
+
+	template <class T>
+	class Pool
+	{
+	public:
+		Pool(int chunkSize = 256) : m_ChunkSize(chunkSize), m_pFree(0), m_InUse(0) { }
+
+		~Pool()
+		{
+			for (typename std::vector<Slot*>::iterator iter = m_Chunks.begin(); iter != m_Chunks.end(); ++iter) {
+				delete [] *iter;
+			}
+		}
+
+		/// @return uninitialized storage for one T
+		void* Alloc()
+		{
+			if (m_pFree == 0) {
+				Grow();
+			}
+			Slot* pSlot = m_pFree;
+			m_pFree = pSlot->m_pNext;
+			++m_InUse;
+			return pSlot;
+		}
+
+		/// return storage obtained from Alloc to the pool; the object must already be destroyed
+		void Free(void* p)
+		{
+			Slot* pSlot = (Slot*) p;
+			pSlot->m_pNext = m_pFree;
+			m_pFree = pSlot;
+			--m_InUse;
+		}
+
+		T*		New()						{ return new (Alloc()) T();		}
+		template <class A>
+		T*		New(const A& a)				{ return new (Alloc()) T(a);	}
+
+		void	Delete(T* p)				{ if (p) { p->~T(); Free(p); }	}
+
+		/// make sure at least count objects can be allocated without touching the heap
+		void Reserve(int count)
+		{
+			while (Capacity() - m_InUse < count) {
+				Grow();
+			}
+		}
+
+		int		InUse() const				{ return m_InUse; }
+		int		Capacity() const			{ return (int) m_Chunks.size() * m_ChunkSize; }
+
+		void GetStats(PoolStats& stats) const
+		{
+			stats.m_InUse		= m_InUse;
+			stats.m_Capacity	= Capacity();
+			stats.m_ObjectSize	= sizeof(Slot);
+			stats.m_Bytes		= Capacity() * sizeof(Slot);
+		}
+
+	protected:
+		/// a slot either holds a live T, or links to the next free slot
+		union Slot {
+			Slot*	m_pNext;
+			char	m_Storage[sizeof(T)];
+			double	m_Align;				//!< force the strictest alignment the engine's types need
+		};
+
+		void Grow()
+		{
+			Slot* pChunk = new Slot[m_ChunkSize];
+			m_Chunks.push_back(pChunk);
+			for (int i = m_ChunkSize - 1; i >= 0; --i) {
+				pChunk[i].m_pNext = m_pFree;
+				m_pFree = &pChunk[i];
+			}
+		}
+
+		int					m_ChunkSize;
+		Slot*				m_pFree;
+		int					m_InUse;
+		std::vector<Slot*>	m_Chunks;
+	};
+
+}	// end Physics namespace
+
+#endif
@@ -48,6 +48,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "PhysicsEngine.h"
 #include "RigidBody.h"
 #include "CollisionEngine.h"
+#include "Integrator.h"
 
 //////////////////// namespace hoists
 
@@ -56,13 +57,14 @@ using Physics::RigidBody;
 
 //////////////////// constructor/destructor
 
-RigidBody::RigidBody() : m_Active(true), m_Spinnable(false), m_Translatable(false), m_Collidable(false), m_pCollideGeo(0),
-	m_Collided(false)
+RigidBody::RigidBody() : m_Active(true), m_Spinnable(false), m_Translatable(false), m_Collidable(false), m_pCollideGeo(0), m_ShapeKind(0),
+	m_Collided(false), m_SolverIndex(-1), m_Island(0), m_Group(0), m_LODTier(0), m_LODPromote(kNumLODTiers - 1), m_Impacts(0), m_LookAhead(0), m_pArticulation(0),
+	m_Integrator(Physics::kIN_Verlet), m_Gravity(true)
 {
 	SetDefaults();
 }
 
-RigidBody::~RigidBody() { delete m_pCollideGeo; }
+RigidBody::~RigidBody() { }
 
 void RigidBody::SetDefaults()
 {
@@ -200,96 +202,18 @@ bool RigidBody::ResetForNextTimeStep()
 {
 	bool fellAsleep = false;
 
-	// normally in a Verlet integrator, you need the previous state in order to derive velocity
-	// in this engine, since we are tracking velocity explicitly, we can simply copy t1 over t0
-	// if you were to switch the engine to derive acceleration from velocity, you would need a different approach
-	m_StateT0 = m_StateT1;
-
 	if (m_Translatable) {
-		if (m_Collided) {
-			// much more interesting friction is anisotropic; for example, a tire has much more transverse than lateral friction
-			// coulomb friction - a force opposing motion
-
-			Real vel = Vec3fLength(m_StateT0.m_Velocity);
-			Vec3fMultiplyAccumulate(m_Acc.m_Force, Real(-0.95f) * vel, m_StateT0.m_Velocity);
-		}
-		else {
-			// linear velocity damping, use to simulate viscosity
-			Real forceSquared = Vec3fDot(m_Acc.m_Force, m_Acc.m_Force);
-			if (forceSquared < kEps) {
-				Vec3fScale(m_StateT0.m_Velocity, m_LinearVelocityDamp);
-			}
-		}
-
-		//! @todo put body to sleep, if it is moving at less than v = sqrt(2*g*eps), the velocity
-		// of an object initially at rest would have falling through the collision envelope [Mirtich95]
-		// and if the body was in contact with an immobile object in the last frame
+		if (m_Spinnable)	Reset<true, true>();
+		else				Reset<true, false>();
 	}
-
-	if (m_Spinnable) {
-		Real aDamp = -m_Mass * m_AngularVelocityDamp;
-
-		/// @todo work out proper angular damping
-		Vec3fMultiplyAccumulate(m_Acc.m_Torque, aDamp, m_StateT0.m_AngularVelocity);	// input a torque opposing the angular velocity
+	else {
+		if (m_Spinnable)	Reset<false, true>();
+		else				Reset<false, false>();
 	}
 
-	m_Collided = false;
-
 	return fellAsleep;
 }
 
-// this is called before springs are calculated
-void RigidBody::Integrate1(Real dt, Vec3f gravity)
-{
-	// if the body's position can change:
-	if (m_Translatable) {
-		Vec3fMultiplyAccumulate(m_StateT1.m_Velocity, dt * kHalf,		m_AccelPrev);					// v += 1/2 a * t
-		Vec3fMultiplyAccumulate(m_StateT1.m_Position, dt,				m_StateT1.m_Velocity);			// pos += v * dt
-		Vec3fMultiplyAccumulate(m_StateT1.m_Position, kHalf * dt * dt,	m_AccelPrev);					// pos += 1/2 a * t * t
-	}
-
-	// if the body can spin:			
-	if (m_Spinnable) {		
-		Vec3fMultiplyAccumulate(m_StateT1.m_AngularMomentum, dt * kHalf, m_TorquePrev);					// L += 1/2 T * t
-																										// update angular velocity from momentum
-		if (m_InertialKind == Physics::kI_Sphere) {														// spheres are common enough to treat specially
-			Vec3fSetScaled(m_StateT1.m_AngularVelocity, m_InertiaITD[0], m_StateT1.m_AngularMomentum);
-		}
-		else {	// must use the inertia tensor diagonal instead
-			// note, since the tensor is diagonal, world space and local space tensor is the same, so this works.
-			Vec3fMultiply(m_StateT1.m_AngularVelocity, m_InertiaITD, m_StateT1.m_AngularMomentum);
-		}
-		//else { 
-		/// @todo if using full matrix for tensor, must do worldTensor = orientation * inverseinertiatensor * transpose(orientation) before multiplying
-		//} 
-		QuatInputAngularVelocity(m_StateT1.m_Orientation, dt, m_StateT1.m_Orientation, m_StateT1.m_AngularVelocity);				// R += t * angular velocity
-	}
-}
-
 void RigidBody::Renormalize()
 {
 }
-
-// this is called after springs are calculated
-void RigidBody::Integrate2(Real dt, Vec3f gravity)
-{
-	// if the body's position can change:
-	if (m_Translatable) {
-		Vec3fSetScaled(m_AccelPrev, m_OOMass, m_Acc.m_Force);											// dvdt = f / m     works for gravity? yes:  f = mg    a = mg / m = g
-		if (m_Gravity) {
-			Vec3fAdd(m_AccelPrev, gravity);
-		}
-
-		Vec3fMultiplyAccumulate(m_StateT1.m_Velocity, dt * kHalf, m_AccelPrev);							// v += 1/2 a * t
-		Vec3fZero(m_Acc.m_Force);																		// clear out the force accumulator
-	}
-
-	// if the body can spin:
-	if (m_Spinnable) {
-		Vec3fSet(m_TorquePrev, m_Acc.m_Torque);
-		Vec3fMultiplyAccumulate(m_StateT1.m_AngularMomentum, dt * kHalf, m_Acc.m_Torque);				// L += 1/2 T * t
-
-		Vec3fZero(m_Acc.m_Torque);																		// clear the torque accumulator
-	}
-}
-
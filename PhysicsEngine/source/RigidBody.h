@@ -38,6 +38,10 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 
 namespace Physics {
 
+class Articulation;
+
+static const int kNumLODTiers = 3;		//!< level of detail tier t is stepped once every 2^t frames
+
 /** @class RigidAccumulator
 	An accumulator for forces and torques in a single frame
  */
@@ -80,19 +84,33 @@ public:
 	RigidBody();
 	virtual ~RigidBody();
 
-	virtual bool			ResetForNextTimeStep();							//!< reset body for next time step. @return true fell asleep, false = didn't fall asleep
-	virtual	void			Integrate1(Real dt, PMath::Vec3f gravity);
-	virtual	void			Integrate2(Real dt, PMath::Vec3f gravity);
+			bool			ResetForNextTimeStep();							//!< reset body for next time step. @return true fell asleep, false = didn't fall asleep
 
-	virtual void			SetCollisionObject(Collision::IGeometry* collide) { m_pCollideGeo = collide; }
+	/// @name	the steps of one substep, see Integrator.h; kTranslate and kSpin must match the body's flags
+	//@{
+	template <bool kTranslate, bool kSpin>
+	inline	void			Reset();
+	template <class Scheme, bool kTranslate, bool kSpin>
+	inline	void			Integrate1(Real dt);									//!< before the forces are gathered
+	template <class Scheme, bool kTranslate, bool kSpin>
+	inline	void			Integrate2(Real dt, const PMath::Vec3f gravity);		//!< after the forces are gathered
+	//@}
+
+	virtual void			SetCollisionObject(Collision::IGeometry* collide) { m_pCollideGeo = collide; m_ShapeKind = collide != 0 ? collide->GetKind() : 0; }
 	virtual void			SetInertialKind(EInertialKind ikind);
 	inline	EInertialKind	GetInertialKind() const { return m_InertialKind; }
+	inline	void			SetIntegrator(EIntegrator integrator)	{ m_Integrator = integrator; }
+	inline	EIntegrator		GetIntegrator() const					{ return m_Integrator; }
 	virtual void			SetMass(Real mass);
 	inline	Real			GetMass() const { return m_Translatable ? m_Mass : Real(1.0e6f); }	// if it can't move, it weighs 1,000,000
 	inline	Real			GetOOMass() const { return m_Translatable ? m_OOMass : k0; }		// if it can't move, it weighs 1,000,000
+	inline	Real			GetRawMass() const { return m_Mass; }								// the mass it was given, whether or not it can move
 			void			CalculateInertiaTensor();
 
 	virtual	void			Renormalize();
+
+	/// @return the largest time step the body's own internal forces can take stably; RigidBody has none
+	virtual	Real			StableTimeStep() const		{ return Real(1.0e30f); }
 			void			SetDefaults();
 
 	inline	void			SetGravity(bool val)		{ m_Gravity = val;			}
@@ -117,9 +135,18 @@ public:
 	DynamicState			m_StateT1;				//!< state at the end of the time step
 	PMath::Vec3f			m_Extent;				//!< extent in each dimension from local origin
 
-	Collision::IGeometry*	m_pCollideGeo;			//!< pointer to collision geometry
+	Collision::IGeometry*	m_pCollideGeo;			//!< pointer to collision geometry, owned by the engine's geometry pools
+	uint32					m_ShapeKind;			//!< m_pCollideGeo's ECollisionKind, kept here so the narrowphase needn't ask it
 	PMath::Vec3f			m_InertiaITD;			//!< Inverse of Inertia Tensor Diagonal
 	bool					m_Collided;				//!< indicates collided during the frame
+	int						m_SolverIndex;			//!< index in the constraint solver's body list during a step, -1 otherwise
+	int						m_Island;				//!< index in the island builder's body list, valid during a step if active
+	int						m_Group;				//!< index of the island group the body is stepped with, valid during a step if active
+	int						m_LODTier;				//!< level of detail; stepped once every 2^m_LODTier frames
+	int						m_LODPromote;			//!< the fastest tier of the bodies it touched since it was last stepped
+	int						m_Impacts;				//!< counts the contacts resolved on it, so contacts queued before one are known stale
+	Real					m_LookAhead;			//!< how far ahead in time speculative contacts are found for it, zero if it is slow
+	Articulation*			m_pArticulation;		//!< the articulation that steps it as one of its links, or 0
 
 protected:
 	Real					m_LinearVelocityDamp;	//!< linear velocity damping can be used to control friction-like effects
@@ -129,12 +156,13 @@ protected:
 	PMath::Vec3f			m_TorquePrev;			//!< the torque applied in the previous time step
 
 	EInertialKind			m_InertialKind;			//!< indicates the inertia calculation to use (point, sphere, diagonal tensor matrix, tensor matrix)
+	EIntegrator				m_Integrator;			//!< the scheme the body is stepped with
 
 	bool					m_Active;				//!< true if participates in simulation
 	bool					m_Spinnable;			//!< can spin
 	bool					m_Translatable;			//!< can move
 	bool					m_Collidable;			//!< participates in collisions
-	bool					m_Gravity;				//!< affected by gravity
+	bool					m_Gravity;				//!< affected by gravity, on by default
 
 	Real					m_Mass;					//!< mass of the object
 	Real					m_OOMass;				//!< reciprocal of the object's mass, cached to avoid lots of divisions
@@ -0,0 +1,149 @@
+
+/** @file SceneFile.h
+
+	an internal implementation file, the layout of a binary scene file
+ */
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#ifndef _SCENEFILE_H_
+#define _SCENEFILE_H_
+
+#include "PhysicsEngineDef.h"
+
+namespace Physics {
+
+	/*
+		A scene file is a SceneHeader followed by tables of fixed size records, in the byte order
+		and Real of the machine that wrote it. Every table starts on a multiple of kSceneAlign
+		bytes, so a mapped file can be read in place. Bodies refer to heights, springs, constraints
+		and joints refer to bodies, and articulations refer to joints, by index rather than by
+		pointer or id, so the only fix up on loading is from index to the id each body is given.
+	 */
+
+	static const uint32	kSceneMagic		= ('s' << 24) | ('c' << 16) | ('n' << 8) | 'e';	// 'scne', spelled out to keep the compiler quiet
+	static const uint32	kSceneVersion	= 2;
+	static const int	kSceneAlign		= 16;
+
+	/// a table of count records, offset bytes from the start of the file
+	class SceneTable {
+	public:
+		uint32		m_Offset;
+		uint32		m_Count;
+	};
+
+	class SceneHeader {
+	public:
+		uint32		m_Magic;
+		uint32		m_Version;
+		uint32		m_RealSize;				//!< sizeof(Real) of the writer
+		uint32		m_FileSize;
+		Real		m_Gravity[3];
+		Real		m_MinTimeStep;
+		SceneTable	m_Bodies;				//!< of SceneBody
+		SceneTable	m_Springs;				//!< of SceneSpring
+		SceneTable	m_Constraints;			//!< of SceneConstraint
+		SceneTable	m_Heights;				//!< of Real, the heights of every heightfield
+		SceneTable	m_Articulations;		//!< of SceneArticulation
+		SceneTable	m_Joints;				//!< of SceneJoint, each articulation's together, in the order of its links
+	};
+
+	enum ESceneBodyFlags {	kSB_Active = 1, kSB_UseGravity = 2, kSB_Collidable = 4, kSB_Spinnable = 8, kSB_Translatable = 16,
+							kSB_IntegratorShift = 5, kSB_IntegratorMask = 3 << 5 };		// the EIntegrator, in bits 5 and 6
+
+	class SceneBody {
+	public:
+		uint32		m_Kind;					//!< ECollisionKind of the body's geometry; kC_Sphere, kC_Plane, or kC_Heightfield
+		uint32		m_Flags;				//!< ESceneBodyFlags
+		Real		m_Mass;
+		Real		m_LinearDamp;
+		Real		m_AngularDamp;
+		Real		m_Extent[3];
+		Real		m_Position[3];
+		Real		m_Velocity[3];
+		Real		m_Orientation[4];
+		Real		m_AngularVelocity[3];
+		Real		m_Vector[3];			//!< a plane's normal, or a heightfield's origin
+		Real		m_Scalar;				//!< a sphere's radius, a plane's distance, or a heightfield's cell size
+		int			m_Columns;				//!< of a heightfield
+		int			m_Rows;
+		uint32		m_FirstHeight;			//!< index of a heightfield's first height in the height table
+	};
+
+	enum ESceneSpringFlags {	kSS_ResistCompression = 1, kSS_Implicit = 2 };
+
+	class SceneSpring {
+	public:
+		int			m_BodyA;				//!< index in the body table, or -1 if unattached
+		int			m_BodyB;
+		uint32		m_Flags;				//!< ESceneSpringFlags
+		Real		m_Stiffness;
+		Real		m_Damping;
+		Real		m_RestLength;
+		Real		m_PosA[3];
+		Real		m_PosB[3];
+	};
+
+	class SceneConstraint {
+	public:
+		int			m_BodyA;				//!< indices in the body table
+		int			m_BodyB;
+		uint32		m_Active;
+		Real		m_Distance;
+		Real		m_Tolerance;
+	};
+
+	enum ESceneArticulationFlags {	kSA_Active = 1, kSA_FixedRoot = 2 };
+
+	class SceneArticulation {
+	public:
+		uint32		m_Flags;				//!< ESceneArticulationFlags
+		Real		m_Damping;
+		uint32		m_FirstJoint;			//!< index of the root's record in the joint table
+		uint32		m_Links;				//!< the number of joint records, the root's first
+	};
+
+	enum ESceneJointFlags {	kSJ_WasTranslatable = 1, kSJ_WasSpinnable = 2 };
+
+	/// the joint joining a link to its parent, and its state; the root's record only names its body and flags
+	class SceneJoint {
+	public:
+		int			m_Body;					//!< index in the body table
+		int			m_Parent;				//!< index of the parent link in the articulation, always lower; -1 for the root
+		uint32		m_Kind;					//!< EJointKind
+		uint32		m_Flags;				//!< ESceneJointFlags, the body's flags before it was joined
+		Real		m_PivotInParent[3];
+		Real		m_PivotInChild[3];
+		Real		m_Axis[3];
+		Real		m_RestOrientation[4];
+		Real		m_JointOrientation[4];
+		Real		m_Q;
+		Real		m_QDot[3];
+	};
+
+}	// end Physics namespace
+
+#endif
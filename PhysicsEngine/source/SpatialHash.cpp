@@ -0,0 +1,180 @@
+
+/** @file SpatialHash.cpp
+	@brief	a hashed grid over a set of points, built by a parallel counting sort */
+
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#include "SpatialHash.h"
+#include "PhysicsThread.h"
+
+namespace Physics {
+
+	static const int kMinHashBatch		= 1024;		// smallest number of points worth hashing on another thread
+	static const int kMinHashBlock		= 4096;		// smallest number of points worth a histogram of their own
+	static const int kMaxHashBlocks		= 16;
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	SpatialHash :: SpatialHash() : m_Count(0), m_TableSize(1), m_OOSpacing(k1), m_NumBlocks(1), m_BlockSize(0),
+		m_pBuildPoints(0), m_BuildStride(0)
+	{
+	}
+
+	void SpatialHash :: Build(int count, const Real* pPoints, int byteStride, Real spacing, ThreadPool* pThreads)
+	{
+		m_Count = count;
+		m_OOSpacing = k1 / spacing;
+		m_TableSize = 1;
+		while (m_TableSize < count) {
+			m_TableSize <<= 1;
+		}
+
+		int threads = (pThreads != 0) ? pThreads->GetThreadCount() : 1;
+		m_NumBlocks = count / kMinHashBlock;
+		m_NumBlocks = m_NumBlocks < threads ? m_NumBlocks : threads;
+		m_NumBlocks = m_NumBlocks < kMaxHashBlocks ? m_NumBlocks : kMaxHashBlocks;
+		m_NumBlocks = m_NumBlocks > 1 ? m_NumBlocks : 1;
+		m_BlockSize = (count + m_NumBlocks - 1) / m_NumBlocks;
+
+		m_Hashes.resize(count);
+		m_Sorted.resize(count);
+		m_SortedHashes.resize(count);
+		m_BlockCounts.assign(m_NumBlocks * m_TableSize, 0);
+		m_ChunkTotals.resize(m_NumBlocks);
+		m_BucketStart.resize(m_TableSize + 1);
+		m_pBuildPoints = (const char*) pPoints;
+		m_BuildStride = byteStride;
+
+		// the buckets are summed in as many chunks as there are blocks of points
+		if (pThreads != 0) {
+			pThreads->Run(count, HashRange, this, kMinHashBatch);
+			pThreads->Run(m_NumBlocks, CountBlocks, this, 1);
+			pThreads->Run(m_NumBlocks, SumChunks, this, 1);
+		}
+		else {
+			HashRange(this, 0, count);
+			CountBlocks(this, 0, m_NumBlocks);
+			SumChunks(this, 0, m_NumBlocks);
+		}
+
+		int first = 0;
+		for (int c = 0; c < m_NumBlocks; ++c) {
+			int total = m_ChunkTotals[c];
+			m_ChunkTotals[c] = first;
+			first += total;
+		}
+		m_BucketStart[m_TableSize] = count;
+
+		if (pThreads != 0) {
+			pThreads->Run(m_NumBlocks, OffsetChunks, this, 1);
+			pThreads->Run(m_NumBlocks, ScatterBlocks, this, 1);
+		}
+		else {
+			OffsetChunks(this, 0, m_NumBlocks);
+			ScatterBlocks(this, 0, m_NumBlocks);
+		}
+
+		m_pBuildPoints = 0;
+	}
+
+	void SpatialHash :: HashRange(void* pData, int begin, int end)
+	{
+		SpatialHash* pHash = (SpatialHash*) pData;
+		for (int i = begin; i < end; ++i) {
+			const Real* p = (const Real*) (pHash->m_pBuildPoints + i * pHash->m_BuildStride);
+			pHash->m_Hashes[i] = pHash->CellHash(pHash->CellCoordinate(p[0]), pHash->CellCoordinate(p[1]), pHash->CellCoordinate(p[2]));
+		}
+	}
+
+	void SpatialHash :: CountBlocks(void* pData, int begin, int end)
+	{
+		SpatialHash* pHash = (SpatialHash*) pData;
+		for (int b = begin; b < end; ++b) {
+			int* pCounts = &pHash->m_BlockCounts[b * pHash->m_TableSize];
+			int last = (b + 1) * pHash->m_BlockSize;
+			last = last < pHash->m_Count ? last : pHash->m_Count;
+			for (int i = b * pHash->m_BlockSize; i < last; ++i) {
+				++pCounts[pHash->Bucket(pHash->m_Hashes[i])];
+			}
+		}
+	}
+
+	void SpatialHash :: SumChunks(void* pData, int begin, int end)
+	{
+		SpatialHash* pHash = (SpatialHash*) pData;
+		int chunkSize = (pHash->m_TableSize + pHash->m_NumBlocks - 1) / pHash->m_NumBlocks;
+		for (int c = begin; c < end; ++c) {
+			int last = (c + 1) * chunkSize;
+			last = last < pHash->m_TableSize ? last : pHash->m_TableSize;
+			int total = 0;
+			for (int bucket = c * chunkSize; bucket < last; ++bucket) {
+				for (int b = 0; b < pHash->m_NumBlocks; ++b) {
+					total += pHash->m_BlockCounts[b * pHash->m_TableSize + bucket];
+				}
+			}
+			pHash->m_ChunkTotals[c] = total;
+		}
+	}
+
+	/// turn each block's counts into the slots its points go to, in order of bucket, then of block
+	void SpatialHash :: OffsetChunks(void* pData, int begin, int end)
+	{
+		SpatialHash* pHash = (SpatialHash*) pData;
+		int chunkSize = (pHash->m_TableSize + pHash->m_NumBlocks - 1) / pHash->m_NumBlocks;
+		for (int c = begin; c < end; ++c) {
+			int last = (c + 1) * chunkSize;
+			last = last < pHash->m_TableSize ? last : pHash->m_TableSize;
+			int next = pHash->m_ChunkTotals[c];
+			for (int bucket = c * chunkSize; bucket < last; ++bucket) {
+				pHash->m_BucketStart[bucket] = next;
+				for (int b = 0; b < pHash->m_NumBlocks; ++b) {
+					int& slot = pHash->m_BlockCounts[b * pHash->m_TableSize + bucket];
+					int count = slot;
+					slot = next;
+					next += count;
+				}
+			}
+		}
+	}
+
+	void SpatialHash :: ScatterBlocks(void* pData, int begin, int end)
+	{
+		SpatialHash* pHash = (SpatialHash*) pData;
+		for (int b = begin; b < end; ++b) {
+			int* pSlots = &pHash->m_BlockCounts[b * pHash->m_TableSize];
+			int last = (b + 1) * pHash->m_BlockSize;
+			last = last < pHash->m_Count ? last : pHash->m_Count;
+			for (int i = b * pHash->m_BlockSize; i < last; ++i) {
+				uint32 hash = pHash->m_Hashes[i];
+				int slot = pSlots[pHash->Bucket(hash)]++;
+				pHash->m_Sorted[slot] = i;
+				pHash->m_SortedHashes[slot] = hash;
+			}
+		}
+	}
+
+}	// end namespace Physics
@@ -0,0 +1,143 @@
+
+/** @file SpatialHash.h
+
+	an internal implementation file, a hashed grid over a set of points
+ */
+/*
+---------------------------------------------------------------------------------------------------
+Meshula Physics Demo
+Created for Games Programming Gems IV
+Copyright (c) 2003 Nick Porcino, http://meshula.net
+
+The MIT License: http://www.opensource.org/licenses/mit-license.php
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+and associated documentation files (the "Software"), to deal in the Software without restriction, 
+including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is 
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or 
+substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE 
+AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+---------------------------------------------------------------------------------------------------
+*/
+
+#ifndef _SPATIALHASH_H_
+#define _SPATIALHASH_H_
+
+#include <vector>
+
+#include "PhysicsEngineDef.h"
+
+namespace Physics {
+
+	class ThreadPool;
+
+	/** @class	SpatialHash
+		@brief	Points sorted into the cells of an unbounded grid, hashed into a table about as large as the point set
+
+		Build finds each point's cell, then sorts the point indices by cell with a counting sort:
+		the points are split into blocks, each block counts its cells into its own histogram, the
+		histograms are summed into each cell's offsets, and each block scatters its points to those
+		offsets. Every pass runs in parallel, so the build costs a few linear passes over the points
+		and the table. Cells that hash to the same bucket share it, so each point keeps its cell's
+		full hash, and a query passes on only the points of the cells it asked for; the caller
+		tests the distances.
+	 */
+
+	class SpatialHash
+	{
+	public:
+		SpatialHash();
+
+		/// sort count points, byteStride bytes apart, into cells spacing wide; pThreads may be zero
+		void		Build(int count, const Real* pPoints, int byteStride, Real spacing, ThreadPool* pThreads);
+
+		/// call visitor(index) for every point in the cells within radius of p; radius must not exceed the spacing
+		template <class Visitor>
+		void		Query(const Real* p, Real radius, Visitor& visitor) const;
+
+	protected:
+		uint32		CellHash(int x, int y, int z) const;
+		int			Bucket(uint32 hash) const		{ return (int) (hash & (uint32) (m_TableSize - 1)); }
+		int			CellCoordinate(Real value) const;
+
+		static void	HashRange(void* pData, int begin, int end);
+		static void	CountBlocks(void* pData, int begin, int end);
+		static void	SumChunks(void* pData, int begin, int end);
+		static void	OffsetChunks(void* pData, int begin, int end);
+		static void	ScatterBlocks(void* pData, int begin, int end);
+
+		int					m_Count;
+		int					m_TableSize;			//!< a power of two
+		Real				m_OOSpacing;
+		int					m_NumBlocks;			//!< of points, counted and scattered in parallel
+		int					m_BlockSize;
+
+		std::vector<uint32>	m_Hashes;				//!< cell hash of each point
+		std::vector<int>	m_BlockCounts;			//!< per block, per bucket; becomes each block's next slot in m_Sorted
+		std::vector<int>	m_ChunkTotals;			//!< points in each chunk of buckets, then the chunk's first slot
+		std::vector<int>	m_BucketStart;			//!< first slot of each bucket in m_Sorted; one extra at the end
+		std::vector<int>	m_Sorted;				//!< point indices, by bucket
+		std::vector<uint32>	m_SortedHashes;			//!< their cell hashes
+
+		// the arguments of the Build in progress, for the parallel passes
+		const char*			m_pBuildPoints;
+		int					m_BuildStride;
+	};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	inline uint32 SpatialHash :: CellHash(int x, int y, int z) const
+	{
+		return ((uint32) x * 92837111u) ^ ((uint32) y * 689287499u) ^ ((uint32) z * 283923481u);
+	}
+
+	inline int SpatialHash :: CellCoordinate(Real value) const
+	{
+		Real scaled = value * m_OOSpacing;
+		int cell = (int) scaled;
+		return (Real(cell) > scaled) ? cell - 1 : cell;		// floor, for negative coordinates too
+	}
+
+	template <class Visitor>
+	void SpatialHash :: Query(const Real* p, Real radius, Visitor& visitor) const
+	{
+		if (m_Count == 0) {
+			return;
+		}
+
+		int x0 = CellCoordinate(p[0] - radius), x1 = CellCoordinate(p[0] + radius);
+		int y0 = CellCoordinate(p[1] - radius), y1 = CellCoordinate(p[1] + radius);
+		int z0 = CellCoordinate(p[2] - radius), z1 = CellCoordinate(p[2] + radius);
+
+		// a radius of one cell spans three cells at most, but rounding may reach a fourth
+		x1 = x1 < x0 + 2 ? x1 : x0 + 2;
+		y1 = y1 < y0 + 2 ? y1 : y0 + 2;
+		z1 = z1 < z0 + 2 ? z1 : z0 + 2;
+
+		for (int x = x0; x <= x1; ++x) {
+			for (int y = y0; y <= y1; ++y) {
+				for (int z = z0; z <= z1; ++z) {
+					uint32 hash = CellHash(x, y, z);
+					int bucket = Bucket(hash);
+					for (int i = m_BucketStart[bucket]; i < m_BucketStart[bucket + 1]; ++i) {
+						if (m_SortedHashes[i] == hash) {
+							visitor(m_Sorted[i]);
+						}
+					}
+				}
+			}
+		}
+	}
+
+}	// end Physics namespace
+
+#endif
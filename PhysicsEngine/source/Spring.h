@@ -34,6 +34,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 namespace Physics {
 
 	class Engine;
+	class PEAux;
 	class RigidBody;
 
 	/** @class	Spring
@@ -54,11 +55,16 @@ namespace Physics {
 			m_CenterAttachA = true;
 			m_CenterAttachB = true;
 			m_ResistCompression = true;
+			m_Implicit = false;
 		}
 
 		~Spring() { }
 
+		RigidBody*	GetBodyA() const		{ return mp_BodyA; }
+		RigidBody*	GetBodyB() const		{ return mp_BodyB; }
+
 		bool		m_ResistCompression;	//!< spring pushes back if compressed
+		bool		m_Implicit;				//!< integrated by backward Euler rather than as an explicit force
 	
 		Real		m_Stiffness;			//!< k in Hooke's law
 		Real		m_Damping;				//!< b in Hooke's law
@@ -68,6 +74,7 @@ namespace Physics {
 		PMath::Vec3f	m_PosA, m_PosB;		//!< attachment points of spring, relative to bodies' centers of mass
 
 		friend class Engine;
+		friend class PEAux;
 
 	private:
 		// the following are derived values
@@ -29,15 +29,23 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 
 #include "stdio.h"
 #include "SpringMesh.h"
+#include "PhysicsThread.h"
 #include "PMath.h"
 
 using PMath::Vec3f;
 
 namespace Physics {
 
+	static const int kMaxParallelBatches	= 32;		// springs that don't fit in a parallel batch go in one extra, sequential batch
+	static const int kMinSpringBatch		= 128;		// smallest number of springs worth handing to another thread
+	static const int kMinCollideBatch		= 1024;		// smallest number of points worth colliding on another thread
+
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
-	SpringMesh :: SpringMesh() : m_Springs(0), m_Points(0), m_ResistCompression(true)
+	SpringMesh :: SpringMesh() : m_Springs(0), m_Points(0), m_NumPoints(0), m_NumSprings(0),
+		m_Stiffness(Real(100.0f)), m_Damping(Real(0.1f)), m_Compliance(k0), m_Solver(kSM_Explicit), m_Substeps(8),
+		m_pThreads(0), m_ResistCompression(true), m_Thickness(k0), m_BatchesDirty(true), m_MaxDegree(0), m_MaxRestLength(k0),
+		m_BatchBase(0), m_AlphaTilde(k0), m_Gamma(k0), m_CollideDt(k0)
 	{
 	}
 
@@ -53,6 +61,7 @@ namespace Physics {
 
 	void SpringMesh :: SetPoints(int numPoints, int byteStride, Vec3f const*const pPoints)
 	{
+		delete [] m_Points;
 		m_Points	= new SpringMeshBody[numPoints];
 		m_NumPoints = numPoints;
 
@@ -63,8 +72,11 @@ namespace Physics {
 
 			PMath::Vec3fSet(m_Points[i].m_Pos0, *pCurrPoint);
 			PMath::Vec3fSet(m_Points[i].m_Pos1, *pCurrPoint);
+			PMath::Vec3fSet(m_Points[i].m_Rest, *pCurrPoint);
 			PMath::Vec3fZero(m_Points[i].m_Vel0);
 			PMath::Vec3fZero(m_Points[i].m_Vel1);
+			PMath::Vec3fZero(m_Points[i].m_AccelPrev);
+			PMath::Vec3fZero(m_Points[i].m_AccForce);
 
 			pCurr += byteStride;
 		}
@@ -74,6 +86,7 @@ namespace Physics {
 
 	void SpringMesh :: SetSprings(int numSprings, int const*const pBodies)
 	{
+		delete [] m_Springs;
 		m_Springs 	 = new SpringMeshSpring[numSprings];
 		m_NumSprings = numSprings;
 		
@@ -81,6 +94,42 @@ namespace Physics {
 			m_Springs[i].m_BodyA = pBodies[i * 2];
 			m_Springs[i].m_BodyB = pBodies[i * 2 + 1];
 		}
+
+		m_BatchesDirty = true;
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	void SpringMesh :: CopyFrom(const SpringMesh& other)
+	{
+		RigidBody::operator=(other);
+
+		int i;
+		delete [] m_Points;
+		m_Points	= new SpringMeshBody[other.m_NumPoints];
+		m_NumPoints	= other.m_NumPoints;
+		for (i = 0; i < m_NumPoints; ++i) {
+			m_Points[i] = other.m_Points[i];
+		}
+
+		delete [] m_Springs;
+		m_Springs	 = new SpringMeshSpring[other.m_NumSprings];
+		m_NumSprings = other.m_NumSprings;
+		for (i = 0; i < m_NumSprings; ++i) {
+			m_Springs[i] = other.m_Springs[i];
+		}
+
+		m_Stiffness			= other.m_Stiffness;
+		m_Damping			= other.m_Damping;
+		m_Compliance		= other.m_Compliance;
+		m_Solver			= other.m_Solver;
+		m_Substeps			= other.m_Substeps;
+		m_ResistCompression	= other.m_ResistCompression;
+		m_Thickness			= other.m_Thickness;
+		m_MaxDegree			= other.m_MaxDegree;
+		m_MaxRestLength		= other.m_MaxRestLength;
+		m_Implicit.SetIterations(other.m_Implicit.GetIterations(), other.m_Implicit.GetTolerance());
+		m_BatchesDirty		= true;
 	}
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -88,10 +137,22 @@ namespace Physics {
 	void SpringMesh :: SetRestLengths()
 	{
 		if (m_Springs != 0 && m_Points != 0) {
+			std::vector<int> degree(m_NumPoints, 0);
+			m_MaxDegree = 0;
+			m_MaxRestLength = k0;
 			for (int i = 0; i < m_NumSprings; ++i) {
+				int a = ++degree[m_Springs[i].m_BodyA];
+				int b = ++degree[m_Springs[i].m_BodyB];
+				if (a > m_MaxDegree) m_MaxDegree = a;
+				if (b > m_MaxDegree) m_MaxDegree = b;
+
 				Vec3f dx;
+				PMath::Vec3fSubtract(dx, m_Points[m_Springs[i].m_BodyA].m_Pos1, m_Points[m_Springs[i].m_BodyB].m_Pos1);
 				m_Springs[i].m_RestLength = PMath::Vec3fLength(dx);
 				m_Springs[i].m_PrevLength = m_Springs[i].m_RestLength;
+				if (m_Springs[i].m_RestLength > m_MaxRestLength) {
+					m_MaxRestLength = m_Springs[i].m_RestLength;
+				}
 			}
 		}
 		else {
@@ -105,6 +166,18 @@ namespace Physics {
 	{
 	}
 
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	Real SpringMesh :: StableTimeStep() const
+	{
+		// spring forces scale with length here, so the effective stiffness does too
+		Real omegaSquared = k2 * m_Stiffness * m_MaxRestLength * m_OOMass * Real(m_MaxDegree);
+		if (m_Solver != kSM_Explicit || omegaSquared <= k0) {
+			return RigidBody::StableTimeStep();
+		}
+		return k1 / PMath::Sqrt(omegaSquared);
+	}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
 	bool SpringMesh :: ResetForNextTimeStep()
@@ -126,6 +199,15 @@ namespace Physics {
 
 	void SpringMesh :: Integrate1(Real dt, PMath::Vec3f gravity)
 	{
+		if (m_Solver == kSM_XPBD) {
+			IntegrateXPBD(dt, gravity);		// the whole step happens here
+			return;
+		}
+		if (m_Solver == kSM_Implicit) {
+			IntegrateImplicit(dt, gravity);
+			return;
+		}
+
 		int i;
 
 		for (i = 0; i < m_NumPoints; ++i) {
@@ -165,18 +247,374 @@ namespace Physics {
 
 	void SpringMesh :: Integrate2(Real dt, PMath::Vec3f gravity)
 	{
-		for (int i = 0; i < m_NumPoints; ++i) {
-			PMath::Vec3fSetScaled(m_Points[i].m_AccelPrev, m_OOMass, m_Acc.m_Force);									// dvdt = f / m     works for gravity? yes:  f = mg    a = mg / m = g
-			if (m_Gravity) {
-				PMath::Vec3fAdd(m_Points[i].m_AccelPrev, gravity);
+		if (m_Solver == kSM_Explicit) {
+			for (int i = 0; i < m_NumPoints; ++i) {
+				PMath::Vec3fAdd(m_Points[i].m_AccForce, m_Acc.m_Force);													// the spring forces, and the forces on the whole mesh
+				PMath::Vec3fSetScaled(m_Points[i].m_AccelPrev, m_OOMass, m_Points[i].m_AccForce);							// dvdt = f / m     works for gravity? yes:  f = mg    a = mg / m = g
+				if (m_Gravity) {
+					PMath::Vec3fAdd(m_Points[i].m_AccelPrev, gravity);
+				}
+				PMath::Vec3fMultiplyAccumulate(m_Points[i].m_Vel1, dt * kHalf, m_Points[i].m_AccelPrev);					// v += 1/2 a * t
+				PMath::Vec3fZero(m_Points[i].m_AccForce);
 			}
-			PMath::Vec3fMultiplyAccumulate(m_Points[i].m_Vel1, dt * kHalf, m_Points[i].m_AccelPrev);					// v += 1/2 a * t
-		}
 
-		// calculate average velocity and place it in the velocity, this is used for friction force
+			// calculate average velocity and place it in the velocity, this is used for friction force
+		}
 
 		// finally, clear out the accumulator for next time
 		PMath::Vec3fZero(m_Acc.m_Force);																// clear out the force accumulator
+
+		// every solver has moved the points to the end of the step by now
+		if (m_Thickness > k0) {
+			CollideSelf(dt);
+		}
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	void SpringMesh :: BuildBatches()
+	{
+		// greedy coloring; each point records the batches its springs are already in
+		std::vector<uint32> used(m_NumPoints, 0);
+		std::vector<int> batch(m_NumSprings);
+		int numBatches = 0;
+		int i;
+
+		for (i = 0; i < m_NumSprings; ++i) {
+			uint32 a = m_Springs[i].m_BodyA;
+			uint32 b = m_Springs[i].m_BodyB;
+			uint32 taken = used[a] | used[b];
+			int c = 0;
+			while (c < kMaxParallelBatches && (taken & (1 << c)) != 0) {
+				++c;
+			}
+			if (c < kMaxParallelBatches) {
+				used[a] |= 1 << c;
+				used[b] |= 1 << c;
+			}
+			batch[i] = c;
+			if (c >= numBatches) {
+				numBatches = c + 1;
+			}
+		}
+
+		// counting sort of the springs by batch
+		m_BatchStart.assign(numBatches + 1, 0);
+		for (i = 0; i < m_NumSprings; ++i) {
+			++m_BatchStart[batch[i] + 1];
+		}
+		for (i = 0; i < numBatches; ++i) {
+			m_BatchStart[i + 1] += m_BatchStart[i];
+		}
+		m_BatchOrder.resize(m_NumSprings);
+		std::vector<int> fill(m_BatchStart.begin(), m_BatchStart.end() - 1);
+		for (i = 0; i < m_NumSprings; ++i) {
+			m_BatchOrder[fill[batch[i]]++] = i;
+		}
+
+		m_BatchesDirty = false;
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	void SpringMesh :: ProjectBatch(void* pData, int begin, int end)
+	{
+		SpringMesh* pMesh = (SpringMesh*) pData;
+		SpringMeshBody* pPoints = pMesh->m_Points;
+		Real w = pMesh->m_OOMass;
+		Real alphaTilde = pMesh->m_AlphaTilde;
+		Real gamma = pMesh->m_Gamma;
+		Real denominator = (k1 + gamma) * (w + w) + alphaTilde;
+
+		for (int k = begin; k < end; ++k) {
+			SpringMeshSpring& spring = pMesh->m_Springs[pMesh->m_BatchOrder[pMesh->m_BatchBase + k]];
+			SpringMeshBody& a = pPoints[spring.m_BodyA];
+			SpringMeshBody& b = pPoints[spring.m_BodyB];
+
+			Vec3f n;
+			PMath::Vec3fSubtract(n, a.m_Pos1, b.m_Pos1);
+			Real length = PMath::Vec3fLength(n);
+			Real c = length - spring.m_RestLength;
+			if (length < kEps || (c < k0 && !pMesh->m_ResistCompression)) {
+				continue;
+			}
+			PMath::Vec3fScale(n, k1 / length);
+
+			// damping acts on the rate of change of the constraint over this substep
+			Vec3f moved, movedB;
+			PMath::Vec3fSubtract(moved, a.m_Pos1, a.m_Pos0);
+			PMath::Vec3fSubtract(movedB, b.m_Pos1, b.m_Pos0);
+			PMath::Vec3fSubtract(moved, movedB);
+
+			Real dLambda = (-c - gamma * PMath::Vec3fDot(n, moved)) / denominator;
+
+			PMath::Vec3fMultiplyAccumulate(a.m_Pos1,  w * dLambda, n);
+			PMath::Vec3fMultiplyAccumulate(b.m_Pos1, -w * dLambda, n);
+		}
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	void SpringMesh :: IntegrateXPBD(Real dt, PMath::Vec3f gravity)
+	{
+		if (m_BatchesDirty) {
+			BuildBatches();
+		}
+
+		int substeps = m_Substeps > 0 ? m_Substeps : 1;
+		Real h = dt / Real(substeps);
+		Real ooh = k1 / h;
+
+		Vec3f accel;
+		PMath::Vec3fSetScaled(accel, m_OOMass, m_Acc.m_Force);
+		if (m_Gravity) {
+			PMath::Vec3fAdd(accel, gravity);
+		}
+
+		m_AlphaTilde	= m_Compliance * ooh * ooh;
+		m_Gamma			= m_Compliance * m_Damping * ooh;
+
+		int numBatches = (int) m_BatchStart.size() - 1;
+		int i;
+
+		for (int step = 0; step < substeps; ++step) {
+			// predict
+			for (i = 0; i < m_NumPoints; ++i) {
+				SpringMeshBody& point = m_Points[i];
+				PMath::Vec3fSet(point.m_Pos0, point.m_Pos1);
+				PMath::Vec3fMultiplyAccumulate(point.m_Vel1, h, accel);
+				PMath::Vec3fMultiplyAccumulate(point.m_Pos1, h, point.m_Vel1);
+			}
+
+			// project; the springs within a batch share no points
+			for (int batch = 0; batch < numBatches; ++batch) {
+				m_BatchBase = m_BatchStart[batch];
+				int count = m_BatchStart[batch + 1] - m_BatchBase;
+				if (m_pThreads != 0 && batch < kMaxParallelBatches) {
+					m_pThreads->Run(count, ProjectBatch, this, kMinSpringBatch);
+				}
+				else {
+					ProjectBatch(this, 0, count);
+				}
+			}
+
+			// derive the velocity from the distance moved
+			for (i = 0; i < m_NumPoints; ++i) {
+				SpringMeshBody& point = m_Points[i];
+				PMath::Vec3fSubtract(point.m_Vel1, point.m_Pos1, point.m_Pos0);
+				PMath::Vec3fScale(point.m_Vel1, ooh);
+			}
+		}
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	void SpringMesh :: IntegrateImplicit(Real dt, PMath::Vec3f gravity)
+	{
+		Vec3f force;
+		PMath::Vec3fSet(force, m_Acc.m_Force);
+		if (m_Gravity) {
+			PMath::Vec3fMultiplyAccumulate(force, m_Mass, gravity);
+		}
+
+		int i;
+		m_Implicit.Reset(m_NumPoints);
+		for (i = 0; i < m_NumPoints; ++i) {
+			m_Implicit.SetPoint(i, m_Points[i].m_Pos1, m_Points[i].m_Vel1, m_OOMass, force);
+		}
+		for (i = 0; i < m_NumSprings; ++i) {
+			SpringMeshSpring& spring = m_Springs[i];
+			m_Implicit.AddSpring(spring.m_BodyA, spring.m_BodyB, spring.m_RestLength, m_Stiffness, m_Damping, m_ResistCompression);
+		}
+
+		m_Implicit.Solve(dt, m_pThreads);
+
+		// v1 = v0 + dv, x1 = x0 + dt * v1
+		for (i = 0; i < m_NumPoints; ++i) {
+			PMath::Vec3fAdd(m_Points[i].m_Vel1, m_Implicit.GetVelocityChange(i));
+			PMath::Vec3fMultiplyAccumulate(m_Points[i].m_Pos1, dt, m_Points[i].m_Vel1);
+		}
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	void SpringMesh :: UpdateBounds(Real margin)
+	{
+		int k;
+		for (k = 0; k < 3; ++k) {
+			m_BoundsMin[k] = m_NumPoints > 0 ? m_Points[0].m_Pos1[k] : k0;
+			m_BoundsMax[k] = m_BoundsMin[k];
+		}
+		for (int i = 1; i < m_NumPoints; ++i) {
+			const Real* p = m_Points[i].m_Pos1;
+			for (k = 0; k < 3; ++k) {
+				m_BoundsMin[k] = p[k] < m_BoundsMin[k] ? p[k] : m_BoundsMin[k];
+				m_BoundsMax[k] = p[k] > m_BoundsMax[k] ? p[k] : m_BoundsMax[k];
+			}
+		}
+		for (k = 0; k < 3; ++k) {
+			m_BoundsMin[k] -= margin;
+			m_BoundsMax[k] += margin;
+		}
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	void SpringMesh :: CollidePlane(const PMath::Plane& plane, Real radius)
+	{
+		const Real* n = plane.m_Normal;
+
+		// the bounds' corner deepest behind the plane
+		Real nearest = plane.m_D - radius;
+		for (int k = 0; k < 3; ++k) {
+			nearest += n[k] * (n[k] > k0 ? m_BoundsMin[k] : m_BoundsMax[k]);
+		}
+		if (nearest >= k0) {
+			return;
+		}
+
+		for (int i = 0; i < m_NumPoints; ++i) {
+			SpringMeshBody& point = m_Points[i];
+			Real dist = PMath::Vec3fDot(n, point.m_Pos1) + plane.m_D - radius;
+			if (dist >= k0) {
+				continue;
+			}
+			PMath::Vec3fMultiplyAccumulate(point.m_Pos1, -dist, n);
+			Real vn = PMath::Vec3fDot(n, point.m_Vel1);
+			if (vn < k0) {
+				PMath::Vec3fMultiplyAccumulate(point.m_Vel1, -vn, n);
+			}
+		}
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	void SpringMesh :: CollideSphere(RigidBody* pSphere, Real sphereRadius, Real radius)
+	{
+		const Vec3f& center = pSphere->m_StateT1.m_Position;
+		Vec3f& sphereVel = pSphere->m_StateT1.m_Velocity;
+		Real reach = sphereRadius + radius;
+		Real wPoint = m_OOMass;
+		Real wSphere = pSphere->GetOOMass();
+		Real ooW = (wPoint + wSphere) > k0 ? k1 / (wPoint + wSphere) : k0;
+
+		for (int i = 0; i < m_NumPoints; ++i) {
+			SpringMeshBody& point = m_Points[i];
+			Vec3f n;
+			PMath::Vec3fSubtract(n, point.m_Pos1, center);
+			Real dist2 = PMath::Vec3fDot(n, n);
+			if (dist2 >= reach * reach || dist2 < kEps * kEps) {
+				continue;
+			}
+			Real dist = PMath::Sqrt(dist2);
+			PMath::Vec3fScale(n, k1 / dist);
+			PMath::Vec3fMultiplyAccumulate(point.m_Pos1, reach - dist, n);
+
+			// an inelastic impulse along the normal, shared by inverse mass
+			Vec3f relative;
+			PMath::Vec3fSubtract(relative, point.m_Vel1, sphereVel);
+			Real vn = PMath::Vec3fDot(relative, n);
+			if (vn < k0) {
+				Real impulse = -vn * ooW;
+				PMath::Vec3fMultiplyAccumulate(point.m_Vel1, impulse * wPoint, n);
+				PMath::Vec3fMultiplyAccumulate(sphereVel, -impulse * wSphere, n);
+			}
+		}
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	void SpringMesh :: CollideSelf(Real dt)
+	{
+		if (m_NumPoints < 2) {
+			return;
+		}
+
+		// the points are read from a copy, so that each one can be moved by its own thread
+		m_CollidePos.resize(m_NumPoints * 3);
+		for (int i = 0; i < m_NumPoints; ++i) {
+			m_CollidePos[i * 3 + 0] = m_Points[i].m_Pos1[0];
+			m_CollidePos[i * 3 + 1] = m_Points[i].m_Pos1[1];
+			m_CollidePos[i * 3 + 2] = m_Points[i].m_Pos1[2];
+		}
+		m_Hash.Build(m_NumPoints, &m_CollidePos[0], 3 * sizeof(Real), k2 * m_Thickness, m_pThreads);
+
+		m_CollideDt = dt;
+		if (m_pThreads != 0) {
+			m_pThreads->Run(m_NumPoints, CollideRange, this, kMinCollideBatch);
+		}
+		else {
+			CollideRange(this, 0, m_NumPoints);
+		}
+	}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+	/** @class	SelfContacts
+		Sums how far one point must move to get clear of the points too close to it
+	 */
+
+	class SelfContacts
+	{
+	public:
+		SelfContacts(const SpringMesh* pMesh, const Real* pPositions, int self) :
+			m_pMesh(pMesh), m_pPositions(pPositions), m_Self(self)
+		{
+			PMath::Vec3fZero(m_Correction);
+		}
+
+		void operator()(int other)
+		{
+			if (other == m_Self) {
+				return;
+			}
+
+			const Real* p = &m_pPositions[m_Self * 3];
+			const Real* q = &m_pPositions[other * 3];
+			Vec3f d;
+			d[0] = p[0] - q[0];
+			d[1] = p[1] - q[1];
+			d[2] = p[2] - q[2];
+			Real dist2 = PMath::Vec3fDot(d, d);
+			Real thickness = m_pMesh->m_Thickness;
+			if (dist2 >= thickness * thickness || dist2 < kEps * kEps) {
+				return;
+			}
+
+			// points given closer than the thickness keep their original distance instead
+			Vec3f rest;
+			PMath::Vec3fSubtract(rest, m_pMesh->m_Points[m_Self].m_Rest, m_pMesh->m_Points[other].m_Rest);
+			Real rest2 = PMath::Vec3fDot(rest, rest);
+			if (dist2 >= rest2) {
+				return;
+			}
+			Real minDist = (rest2 < thickness * thickness) ? PMath::Sqrt(rest2) : thickness;
+
+			Real dist = PMath::Sqrt(dist2);
+			PMath::Vec3fMultiplyAccumulate(m_Correction, kHalf * (minDist - dist) / dist, d);
+		}
+
+		const SpringMesh*	m_pMesh;
+		const Real*			m_pPositions;
+		int					m_Self;
+		Vec3f				m_Correction;
+	};
+
+	void SpringMesh :: CollideRange(void* pData, int begin, int end)
+	{
+		SpringMesh* pMesh = (SpringMesh*) pData;
+		const Real* pPositions = &pMesh->m_CollidePos[0];
+		Real ooDt = pMesh->m_CollideDt > k0 ? k1 / pMesh->m_CollideDt : k0;
+
+		for (int i = begin; i < end; ++i) {
+			SelfContacts contacts(pMesh, pPositions, i);
+			pMesh->m_Hash.Query(&pPositions[i * 3], pMesh->m_Thickness, contacts);
+
+			// the velocity follows the position, as in position based dynamics
+			SpringMeshBody& point = pMesh->m_Points[i];
+			PMath::Vec3fAdd(point.m_Pos1, contacts.m_Correction);
+			PMath::Vec3fMultiplyAccumulate(point.m_Vel1, ooDt, contacts.m_Correction);
+		}
 	}
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -32,11 +32,17 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #ifndef _SPRINGMESH_H_
 #define _SPRINGMESH_H_
 
+#include	<vector>
+
 #include	"RigidBody.h"
+#include	"ImplicitSpringSolver.h"
+#include	"SpatialHash.h"
 #include	"PMath.h"
 
 namespace Physics {
 
+	class ThreadPool;
+
 	/// A single spring mesh spring; much simplified compared to Spring
 
 	class SpringMeshSpring {
@@ -55,9 +61,34 @@ namespace Physics {
 		PMath::Vec3f				m_Vel1;
 		PMath::Vec3f				m_AccelPrev;
 		PMath::Vec3f				m_AccForce;
+		PMath::Vec3f				m_Rest;				//!< where the point was given, for self collision
 	};
 
-	/// SpringMesh efficiently executes a spring based mesh
+	/** @class	SpringMesh
+		@brief	SpringMesh efficiently executes a spring based mesh
+
+		Every point has the mesh's mass. In kSM_Explicit mode the springs apply Hooke's law forces,
+		and the mesh needs time steps small enough for its stiffness. In kSM_XPBD mode each spring
+		is a compliant distance constraint, solved by extended position based dynamics: the mesh
+		divides every time step into m_Substeps substeps of its own, and projects each constraint
+		once per substep. Since a single projection starts with a zero Lagrange multiplier, the
+		multipliers need not be stored. The constraints are colored so that no two in a batch share
+		a point, and each batch is projected in parallel. In kSM_Implicit mode the whole mesh takes
+		one backward Euler step per time step, which is stable for any stiffness; m_Implicit solves
+		for the velocity change.
+
+		If m_Thickness is set, the points also keep that far from each other. After each time step
+		the points are hashed into cells twice m_Thickness wide, and every point is pushed away
+		from the points too close to it, by half the overlap, in parallel. Points that were closer
+		than m_Thickness when they were given only keep from getting closer than they were then,
+		so neighbors on a fine mesh aren't forced apart.
+
+		A collidable mesh's points, as balls of half m_Thickness, are pushed out of the world's
+		planes and spheres once per world step, after the rigid bodies' contacts are resolved.
+		The engine first culls the colliders against the bounds of the whole mesh. The points lose
+		the part of their velocity into the collider; a sphere that can move is given the momentum
+		they lose, and each point's impulse is shared between the point and the sphere by their masses.
+	 */
 
 	class SpringMesh : public RigidBody {
 	public:
@@ -78,23 +109,39 @@ namespace Physics {
 		/// Calculate rest lengths after springs and bodies have been set
 		void SetRestLengths();
 
+		/// become a copy of other, points, springs, settings and state, for another engine; the thread pool is kept
+		void CopyFrom(const SpringMesh& other);
+
 		/// reset body for next time step. @return true fell asleep, false = didn't fall asleep
-		virtual bool ResetForNextTimeStep();	
+		/// these hide RigidBody's; the engine steps spring meshes in a bucket of their own, see Integrator.h
+		bool ResetForNextTimeStep();	
 
 		/// integrate from t0 to t0 + 1/2 dt
-		virtual	void Integrate1(
+		void	Integrate1(
 			Real dt,					///< time step, seconds
 			PMath::Vec3f gravity		///< acceleration due to gravity length/sec
 			);
 
 		/// integrate from t0 + 1/2 dt  to  t0+dt
-		virtual	void 	Integrate2(
+		void	Integrate2(
 			Real dt,					///< time step, seconds
 			PMath::Vec3f gravity		///< acceleration due to gravity length/sec
 			);
 
 		virtual	void					Render();			//!< render physics body, for debugging only
 
+		/// the explicit springs' stable step, from a Gershgorin bound on their stiffness; unlimited for XPBD and implicit
+		virtual	Real					StableTimeStep() const;
+
+		/// find the bounds of the points, grown by margin, in m_BoundsMin and m_BoundsMax
+		void							UpdateBounds(Real margin);
+
+		/// push the points, as balls of radius, out of the plane; does nothing if the bounds are clear of it
+		void							CollidePlane(const PMath::Plane& plane, Real radius);
+
+		/// push the points, as balls of radius, out of the sphere, and exchange momentum with it
+		void							CollideSphere(RigidBody* pSphere, Real sphereRadius, Real radius);
+
 		SpringMeshSpring*				m_Springs;
 		SpringMeshBody*					m_Points;
 
@@ -102,9 +149,42 @@ namespace Physics {
 		int								m_NumSprings;
 
 		Real							m_Stiffness;		//!< k in Hooke's law, applies to all
-		Real							m_Damping;			//!< b in Hooke's law, applies to all
+		Real							m_Damping;			//!< b in Hooke's law, or the XPBD damping coefficient, applies to all
+		Real							m_Compliance;		//!< XPBD inverse stiffness, applies to all; zero is inextensible
+
+		ESpringMeshSolver				m_Solver;
+		int								m_Substeps;			//!< XPBD substeps per time step
+
+		ThreadPool*						m_pThreads;			//!< used to run XPBD batches and the implicit solver in parallel, owned by the engine
+		ImplicitSpringSolver			m_Implicit;
 
 		bool							m_ResistCompression;
+		Real							m_Thickness;		//!< distance the points keep apart; zero, the default, is no self collision
+		Real							m_BoundsMin[3];		//!< of the points, found by UpdateBounds
+		Real							m_BoundsMax[3];
+
+	protected:
+		void							IntegrateXPBD(Real dt, PMath::Vec3f gravity);
+		void							IntegrateImplicit(Real dt, PMath::Vec3f gravity);
+		void							BuildBatches();
+		static void						ProjectBatch(void* pData, int begin, int end);
+		void							CollideSelf(Real dt);
+		static void						CollideRange(void* pData, int begin, int end);
+
+		std::vector<int>				m_BatchOrder;		//!< spring indices, sorted by batch
+		std::vector<int>				m_BatchStart;		//!< first entry of each batch in m_BatchOrder; one extra at the end
+		bool							m_BatchesDirty;
+
+		int								m_MaxDegree;		//!< most springs at any one point
+		Real							m_MaxRestLength;
+
+		int								m_BatchBase;		//!< the batch being projected, its offset in m_BatchOrder
+		Real							m_AlphaTilde;		//!< compliance / substep^2
+		Real							m_Gamma;			//!< XPBD damping factor for the current substep
+
+		SpatialHash						m_Hash;				//!< the points, rebuilt each time step for self collision
+		std::vector<Real>				m_CollidePos;		//!< the points' positions before self collision moves them
+		Real							m_CollideDt;
 	};
 }
 